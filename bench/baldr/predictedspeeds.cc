@@ -0,0 +1,71 @@
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <vector>
+
+#include "baldr/predictedspeeds.h"
+
+using namespace valhalla::baldr;
+
+namespace {
+
+// A week of speeds that swing through rush hours every day, compressed the way the tiles have them
+std::array<int16_t, kCoefficientCount> GetCoefficients() {
+  std::array<float, kBucketsPerWeek> speeds;
+  for (uint32_t i = 0; i < kBucketsPerWeek; ++i) {
+    speeds[i] = roundf(50.f + 20.f * sinf(i * 6.2831853f / kBucketsPerDay));
+  }
+  return compress_speed_buckets(speeds.data());
+}
+
+void BM_DecompressSpeedBucket(benchmark::State& state) {
+  const auto coefficients = GetCoefficients();
+  uint32_t bucket = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(decompress_speed_bucket(coefficients.data(), bucket));
+    bucket = (bucket + 97) % kBucketsPerWeek;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_DecompressSpeedBucket);
+
+// Decodes a whole day at once, compare the items per second with the single bucket decode
+void BM_DecompressSpeedBucketsDay(benchmark::State& state) {
+  const auto coefficients = GetCoefficients();
+  std::vector<float> speeds(kBucketsPerDay);
+  uint32_t day = 0;
+  for (auto _ : state) {
+    decompress_speed_buckets(coefficients.data(), day * kBucketsPerDay, kBucketsPerDay,
+                             speeds.data());
+    benchmark::DoNotOptimize(speeds.data());
+    day = (day + 1) % 7;
+  }
+  state.SetItemsProcessed(state.iterations() * kBucketsPerDay);
+}
+
+BENCHMARK(BM_DecompressSpeedBucketsDay);
+
+// Many edges at the same time of the week, with and without the decoded speed cache
+void BM_PredictedSpeedsCache(benchmark::State& state) {
+  const uint32_t edge_count = 10000;
+  const auto coefficients = GetCoefficients();
+  std::vector<int16_t> profiles(coefficients.begin(), coefficients.end());
+  std::vector<uint32_t> offsets(edge_count, 0);
+  PredictedSpeeds predicted;
+  predicted.set_offset(offsets.data());
+  predicted.set_profiles(profiles.data());
+  predicted.enable_cache(state.range(0));
+
+  uint32_t idx = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(predicted.speed(idx, 8 * 3600));
+    idx = (idx + 1) % edge_count;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_PredictedSpeedsCache)->Arg(0)->Arg(1 << 14);
+
+} // namespace
+
+BENCHMARK_MAIN();
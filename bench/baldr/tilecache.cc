@@ -0,0 +1,102 @@
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include "baldr/graphreader.h"
+
+using namespace valhalla::baldr;
+
+namespace {
+
+constexpr size_t kMaxCacheSize = 1073741824;
+const std::string kTileDir = VALHALLA_SOURCE_DIR "test/data/utrecht_tiles";
+
+enum class CacheKind { Simple, LRU, Concurrent };
+
+// All the threads of a benchmark run hit the same cache, the non thread-safe caches are wrapped
+// with a mutex the way global_synchronized_cache does it
+struct shared_cache_t {
+  std::unique_ptr<TileCache> backing;
+  std::unique_ptr<TileCache> cache;
+  std::mutex mutex;
+  std::vector<std::pair<GraphId, graph_tile_ptr>> tiles;
+
+  explicit shared_cache_t(CacheKind kind) {
+    switch (kind) {
+      case CacheKind::Simple:
+        backing.reset(new SimpleTileCache(kMaxCacheSize));
+        cache.reset(new SynchronizedTileCache(*backing, mutex));
+        break;
+      case CacheKind::LRU:
+        backing.reset(new TileCacheLRU(kMaxCacheSize, TileCacheLRU::MemoryLimitControl::HARD));
+        cache.reset(new SynchronizedTileCache(*backing, mutex));
+        break;
+      case CacheKind::Concurrent:
+        cache.reset(new ConcurrentTileCache(kMaxCacheSize));
+        break;
+    }
+
+    // load every tile we have so that lookups are what we measure
+    boost::property_tree::ptree pt;
+    pt.put("tile_dir", kTileDir);
+    GraphReader reader(pt);
+    for (const auto& id : reader.GetTileSet()) {
+      auto tile = GraphTile::Create(kTileDir, id);
+      if (tile) {
+        tiles.emplace_back(id, tile);
+        cache->Put(id, tile, tile->header()->end_offset());
+      }
+    }
+  }
+};
+
+std::unique_ptr<shared_cache_t> shared_cache;
+
+void BM_TileCacheGet(benchmark::State& state) {
+  if (state.thread_index == 0) {
+    shared_cache.reset(new shared_cache_t(static_cast<CacheKind>(state.range(0))));
+  }
+
+  // every thread walks the tiles in its own random order, occasionally putting one back in
+  std::mt19937 gen(state.thread_index);
+  size_t hits = 0;
+  for (auto _ : state) {
+    const auto& tiles = shared_cache->tiles;
+    const auto& entry = tiles[gen() % tiles.size()];
+    auto tile = shared_cache->cache->Get(entry.first);
+    if (!tile) {
+      tile = shared_cache->cache->Put(entry.first, entry.second,
+                                      entry.second->header()->end_offset());
+    } else {
+      ++hits;
+    }
+    benchmark::DoNotOptimize(tile);
+  }
+  state.counters["hits"] = benchmark::Counter(hits, benchmark::Counter::kIsRate);
+
+  if (state.thread_index == 0) {
+    shared_cache.reset();
+  }
+}
+
+BENCHMARK(BM_TileCacheGet)
+    ->ArgName("simple")
+    ->Arg(static_cast<int>(CacheKind::Simple))
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK(BM_TileCacheGet)
+    ->ArgName("lru")
+    ->Arg(static_cast<int>(CacheKind::LRU))
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK(BM_TileCacheGet)
+    ->ArgName("concurrent")
+    ->Arg(static_cast<int>(CacheKind::Concurrent))
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -7,6 +7,9 @@
 #include "baldr/rapidjson_utils.h"
 #include "meili/map_matcher_factory.h"
 #include "meili/measurement.h"
+#include "meili/routing.h"
+#include "meili/viterbi_search.h"
+#include "midgard/distanceapproximator.h"
 #include "sif/costconstants.h"
 #include "sif/costfactory.h"
 #include "tyr/actor.h"
@@ -117,6 +120,96 @@ static void BM_ManyCases(benchmark::State& state) {
 
 BENCHMARK(BM_ManyCases)->DenseRange(0, kBenchmarkCases.size() - 1);
 
+// Routing from every candidate of a column to the next column one search at a time, like the
+// matcher did before it routed the candidates waiting in the queue together, or all at once
+
+static void BM_ColumnRoutes(benchmark::State& state) {
+  logging::Configure({{"type", ""}});
+  boost::property_tree::ptree config;
+  rapidjson::read_json(VALHALLA_SOURCE_DIR "bench/meili/config.json", config);
+  rapidjson::Document doc;
+  doc.Parse(LoadFile(kBenchmarkCases.back()).c_str());
+  std::vector<PointLL> shape;
+  for (const auto& point : doc["shape"].GetArray()) {
+    shape.emplace_back(point["lon"].GetDouble(), point["lat"].GetDouble());
+  }
+  MapMatcherFactory factory(config);
+  std::unique_ptr<MapMatcher> matcher(factory.Create(valhalla::Costing::auto_));
+  const auto costing = matcher->costing();
+  float turn_costs[181] = {0.f};
+
+  // the candidates of the columns are found up front so that only the routing is timed
+  std::vector<std::vector<valhalla::baldr::PathLocation>> columns;
+  for (const auto& point : shape) {
+    columns.push_back(matcher->candidatequery().Query(point,
+                                                      valhalla::baldr::Location::StopType::BREAK,
+                                                      kSearchRadiusMeters * kSearchRadiusMeters,
+                                                      costing));
+  }
+  const bool together = state.range(0);
+  size_t routes = 0;
+  for (auto _ : state) {
+    for (size_t i = 0; i + 1 < columns.size(); ++i) {
+      const DistanceApproximator<PointLL> approximator(shape[i + 1]);
+      const auto& origins = columns[i];
+      if (together) {
+        const std::vector<const Label*> edgelabels(origins.size(), nullptr);
+        benchmark::DoNotOptimize(find_shortest_paths(matcher->graphreader(), origins, edgelabels,
+                                                     columns[i + 1], approximator,
+                                                     kSearchRadiusMeters, costing, turn_costs,
+                                                     2000.f, -1.f));
+      } else {
+        for (const auto& origin : origins) {
+          std::vector<valhalla::baldr::PathLocation> locations{origin};
+          locations.insert(locations.end(), columns[i + 1].begin(), columns[i + 1].end());
+          auto labelset = std::make_shared<LabelSet>(2000.f);
+          benchmark::DoNotOptimize(find_shortest_path(matcher->graphreader(), locations, 0,
+                                                      labelset, approximator, kSearchRadiusMeters,
+                                                      costing, nullptr, turn_costs, 2000.f, -1.f));
+        }
+      }
+      routes += origins.size();
+    }
+  }
+  state.SetItemsProcessed(routes);
+}
+
+BENCHMARK(BM_ColumnRoutes)->Arg(0)->Arg(1);
+
+// Scaling of the viterbi search with the length of the trace, on a synthetic trellis so that the
+// cost of routing between candidates does not hide the cost of the search itself
+
+constexpr uint32_t kCandidatesPerColumn = 8;
+
+float SyntheticEmissionCost(const StateId& stateid) {
+  return (stateid.time() * 7 + stateid.id() * 3) % 11;
+}
+
+float SyntheticTransitionCost(const StateId& lhs, const StateId& rhs) {
+  // Leave some transitions out so that the search has to back track now and then
+  const auto hash = lhs.time() * 31 + lhs.id() * 17 + rhs.id() * 13;
+  return hash % 5 == 0 ? -1.f : (hash % 23) * 0.5f;
+}
+
+static void BM_ViterbiSearchScaling(benchmark::State& state) {
+  const auto trace_length = static_cast<StateId::Time>(state.range(0));
+  // The same search is reused like a map matcher reuses it from one trace to the next
+  ViterbiSearch vs(SyntheticEmissionCost, SyntheticTransitionCost);
+  for (auto _ : state) {
+    vs.Clear();
+    for (StateId::Time time = 0; time < trace_length; ++time) {
+      for (StateId::Id id = 0; id < kCandidatesPerColumn; ++id) {
+        vs.AddStateId(StateId(time, id));
+      }
+    }
+    std::vector<StateId> path(vs.SearchPathVS(trace_length - 1), vs.PathEnd());
+    benchmark::DoNotOptimize(path);
+  }
+  state.SetItemsProcessed(state.iterations() * trace_length);
+}
+
+BENCHMARK(BM_ViterbiSearchScaling)->RangeMultiplier(10)->Range(100, 100000);
+
 } // namespace
 
 BENCHMARK_MAIN();
@@ -0,0 +1,80 @@
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "midgard/sequence.h"
+#include "mjolnir/osmdata.h"
+
+using namespace valhalla::midgard;
+using namespace valhalla::mjolnir;
+
+namespace {
+
+const std::string kFileName = "bench_way_nodes.bin";
+
+// Way nodes in the order the parser writes them when ways come in a random order
+void WriteWayNodes(size_t count) {
+  sequence<OSMWayNode> way_nodes(kFileName, true);
+  std::mt19937 generator(11);
+  std::uniform_int_distribution<uint32_t> way_index(0, static_cast<uint32_t>(count / 10));
+  for (size_t i = 0; i < count;) {
+    const uint32_t way = way_index(generator);
+    for (uint32_t shape = 0; shape < 10 && i < count; ++shape, ++i) {
+      OSMWayNode way_node{};
+      way_node.way_index = way;
+      way_node.way_shape_node_index = shape;
+      way_nodes.push_back(way_node);
+    }
+  }
+}
+
+bool WayNodeLess(const OSMWayNode& a, const OSMWayNode& b) {
+  if (a.way_index == b.way_index) {
+    return a.way_shape_node_index < b.way_shape_node_index;
+  }
+  return a.way_index < b.way_index;
+}
+
+// The in place sort of the whole memory mapped file
+void BM_SequenceSort(benchmark::State& state) {
+  const size_t count = state.range(0);
+  for (auto _ : state) {
+    state.PauseTiming();
+    WriteWayNodes(count);
+    state.ResumeTiming();
+    sequence<OSMWayNode> way_nodes(kFileName, false);
+    way_nodes.sort(WayNodeLess);
+  }
+  std::remove(kFileName.c_str());
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+BENCHMARK(BM_SequenceSort)->Arg(1 << 20)->Arg(1 << 23)->Unit(benchmark::kMillisecond);
+
+// The external sort with a buffer of a quarter of the elements split over the threads
+void BM_SequenceExternalSort(benchmark::State& state) {
+  const size_t count = state.range(0);
+  const unsigned int threads = state.range(1);
+  for (auto _ : state) {
+    state.PauseTiming();
+    WriteWayNodes(count);
+    state.ResumeTiming();
+    sequence<OSMWayNode> way_nodes(kFileName, false);
+    way_nodes.external_sort(WayNodeLess, count / 4, threads);
+  }
+  std::remove(kFileName.c_str());
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+BENCHMARK(BM_SequenceExternalSort)
+    ->Args({1 << 20, 1})
+    ->Args({1 << 20, 4})
+    ->Args({1 << 23, 1})
+    ->Args({1 << 23, 4})
+    ->Args({1 << 23, 8})
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+BENCHMARK_MAIN();
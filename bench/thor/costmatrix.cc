@@ -7,8 +7,10 @@
 #include "baldr/graphreader.h"
 #include "loki/search.h"
 #include "midgard/pointll.h"
+#include "mjolnir/chbuilder.h"
 #include "sif/autocost.h"
 #include "sif/costfactory.h"
+#include "thor/chmatrix.h"
 #include "thor/costmatrix.h"
 #include <valhalla/proto/options.pb.h>
 
@@ -60,11 +62,9 @@ const auto config = json_to_pt(R"({
 
 constexpr float kMaxRange = 256;
 
-static void BM_UtrechtCostMatrix(benchmark::State& state) {
-  const int size = state.range(0);
-  baldr::GraphReader reader(config.get_child("mjolnir"));
-
-  // Generate N random locations within the Utrect bounding box;
+// Generates N random locations within the Utrecht bounding box and snaps them for auto
+google::protobuf::RepeatedPtrField<valhalla::Location>
+GetLocations(const int size, baldr::GraphReader& reader, const sif::cost_ptr_t& cost) {
   std::vector<valhalla::baldr::Location> locations;
   const double min_lon = 5.0163;
   const double max_lon = 5.1622;
@@ -80,14 +80,6 @@ static void BM_UtrechtCostMatrix(benchmark::State& state) {
     locations.emplace_back(midgard::PointLL{lng_distribution(gen), lat_distribution(gen)});
   }
 
-  Options options;
-  options.set_costing(Costing::auto_);
-  rapidjson::Document doc;
-  sif::ParseCostingOptions(doc, "/costing_options", options);
-  sif::TravelMode mode;
-  auto costs = sif::CostFactory().CreateModeCosting(options, mode);
-  auto cost = costs[static_cast<size_t>(mode)];
-
   const auto projections = loki::Search(locations, reader, cost);
   if (projections.size() == 0) {
     throw std::runtime_error("Found no matching locations");
@@ -99,11 +91,32 @@ static void BM_UtrechtCostMatrix(benchmark::State& state) {
     auto* p = sources.Add();
     baldr::PathLocation::toPBF(projection.second, p, reader);
   }
+  return sources;
+}
+
+sif::mode_costing_t GetAutoCosting(sif::TravelMode& mode) {
+  Options options;
+  options.set_costing(Costing::auto_);
+  rapidjson::Document doc;
+  sif::ParseCostingOptions(doc, "/costing_options", options);
+  return sif::CostFactory().CreateModeCosting(options, mode);
+}
+
+static void BM_UtrechtCostMatrix(benchmark::State& state) {
+  const int size = state.range(0);
+  const int threads = state.range(1);
+  baldr::GraphReader reader(config.get_child("mjolnir"));
+
+  sif::TravelMode mode;
+  auto costs = GetAutoCosting(mode);
+  auto sources = GetLocations(size, reader, costs[static_cast<size_t>(mode)]);
 
   std::size_t result_size = 0;
 
+  auto matrix_config = config;
+  matrix_config.put("thor.costmatrix_threads", threads);
+  thor::CostMatrix matrix(matrix_config);
   for (auto _ : state) {
-    thor::CostMatrix matrix;
     auto result = matrix.SourceToTarget(sources, sources, reader, costs, mode, 100000.);
     matrix.Clear();
     result_size += result.size();
@@ -112,6 +125,33 @@ static void BM_UtrechtCostMatrix(benchmark::State& state) {
 }
 
 BENCHMARK(BM_UtrechtCostMatrix)
+    ->Unit(benchmark::kMillisecond)
+    ->RangeMultiplier(2)
+    ->Ranges({{1, kMaxRange}, {0, 8}});
+
+// Same locations as above but answered from a contraction hierarchy overlay, which is built once
+// outside of the timing
+static void BM_UtrechtCHMatrix(benchmark::State& state) {
+  const int size = state.range(0);
+  baldr::GraphReader reader(config.get_child("mjolnir"));
+
+  sif::TravelMode mode;
+  auto costs = GetAutoCosting(mode);
+  auto sources = GetLocations(size, reader, costs[static_cast<size_t>(mode)]);
+
+  static std::shared_ptr<const baldr::CHOverlay> overlay =
+      mjolnir::CHBuilder::Contract(reader, costs[static_cast<size_t>(mode)]);
+  thor::CHMatrix matrix(overlay);
+
+  std::size_t result_size = 0;
+  for (auto _ : state) {
+    auto result = matrix.SourceToTarget(sources, sources, reader, costs, mode, 100000.);
+    result_size += result.size();
+  }
+  state.counters["Routes"] = benchmark::Counter(size, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+BENCHMARK(BM_UtrechtCHMatrix)
     ->Unit(benchmark::kMillisecond)
     ->RangeMultiplier(2)
     ->Range(1, kMaxRange);
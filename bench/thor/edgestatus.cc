@@ -0,0 +1,86 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+#include "baldr/graphreader.h"
+#include "thor/edgestatus.h"
+
+using namespace valhalla::baldr;
+using namespace valhalla::thor;
+
+namespace {
+
+const std::string kTileDir = VALHALLA_SOURCE_DIR "test/data/utrecht_tiles";
+
+// Random edges over all of the utrecht tiles, in the order a search would visit them
+struct edges_t {
+  std::vector<graph_tile_ptr> tiles;
+  std::vector<std::pair<GraphId, size_t>> edges;
+
+  explicit edges_t(size_t count) {
+    boost::property_tree::ptree pt;
+    pt.put("tile_dir", kTileDir);
+    GraphReader reader(pt);
+    for (const auto& id : reader.GetTileSet()) {
+      auto tile = reader.GetGraphTile(id);
+      if (tile && tile->header()->directededgecount() > 0) {
+        tiles.push_back(tile);
+      }
+    }
+
+    std::mt19937 gen(42);
+    for (size_t i = 0; i < count && !tiles.empty(); ++i) {
+      const size_t t = std::uniform_int_distribution<size_t>(0, tiles.size() - 1)(gen);
+      const auto* header = tiles[t]->header();
+      const uint32_t id =
+          std::uniform_int_distribution<uint32_t>(0, header->directededgecount() - 1)(gen);
+      edges.emplace_back(GraphId(header->graphid().tileid(), header->graphid().level(), id), t);
+    }
+  }
+};
+
+// What a search does with the edge status: check it when expanding, set it when the edge gets
+// labeled and update it when its label is settled
+void Search(EdgeStatus& edgestatus, const edges_t& edges) {
+  uint32_t index = 0;
+  for (const auto& edge : edges.edges) {
+    auto* es = edgestatus.GetPtr(edge.first, edges.tiles[edge.second]);
+    if (es->set() == EdgeSet::kUnreachedOrReset) {
+      edgestatus.Set(edge.first, EdgeSet::kTemporary, index++, edges.tiles[edge.second]);
+    }
+  }
+  for (const auto& edge : edges.edges) {
+    if (edgestatus.Get(edge.first).set() == EdgeSet::kTemporary) {
+      edgestatus.Update(edge.first, EdgeSet::kPermanent);
+    }
+  }
+  benchmark::DoNotOptimize(index);
+}
+
+// A new edge status for every search
+void BM_EdgeStatusFresh(benchmark::State& state) {
+  edges_t edges(state.range(0));
+  for (auto _ : state) {
+    EdgeStatus edgestatus;
+    Search(edgestatus, edges);
+  }
+  state.SetItemsProcessed(state.iterations() * edges.edges.size());
+}
+
+// One edge status cleared between searches, the way the path algorithms reuse theirs
+void BM_EdgeStatusReused(benchmark::State& state) {
+  edges_t edges(state.range(0));
+  EdgeStatus edgestatus;
+  for (auto _ : state) {
+    Search(edgestatus, edges);
+    edgestatus.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * edges.edges.size());
+}
+
+BENCHMARK(BM_EdgeStatusFresh)->RangeMultiplier(10)->Range(100, 100000);
+BENCHMARK(BM_EdgeStatusReused)->RangeMultiplier(10)->Range(100, 100000);
+
+} // namespace
+
+BENCHMARK_MAIN();
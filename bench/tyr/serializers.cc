@@ -0,0 +1,131 @@
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <vector>
+
+#include "baldr/json.h"
+#include "proto_conversions.h"
+#include "thor/costmatrix.h"
+#include "tyr/serializers.h"
+
+using namespace valhalla;
+using namespace valhalla::baldr;
+using namespace valhalla::thor;
+
+// Count every allocation so the benchmarks can report how many a response takes
+namespace {
+std::atomic<size_t> allocations(0);
+} // namespace
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+namespace {
+
+// A square matrix request with a result for every cell but the diagonal
+Api MakeMatrix(const size_t count, std::vector<TimeDistance>& time_distances) {
+  Api request;
+  auto& options = *request.mutable_options();
+  options.set_units(Options::kilometers);
+  for (size_t i = 0; i < count; ++i) {
+    for (auto* location : {options.add_sources(), options.add_targets()}) {
+      location->mutable_ll()->set_lat(52.0 + i * 0.001);
+      location->mutable_ll()->set_lng(5.0 + i * 0.001);
+    }
+  }
+  time_distances.clear();
+  for (size_t i = 0; i < count * count; ++i) {
+    time_distances.emplace_back(i % (count + 1) ? 300 + i % 1000 : kMaxCost, 4000 + i % 7000);
+  }
+  return request;
+}
+
+// The matrix as a tree of json values, which is how the serializer used to build it
+std::string SerializeTree(const Api& request, const std::vector<TimeDistance>& tds) {
+  const auto& options = request.options();
+  auto matrix = json::array({});
+  for (int source = 0; source < options.sources_size(); ++source) {
+    auto row = json::array({});
+    for (int target = 0; target < options.targets_size(); ++target) {
+      const auto& td = tds[source * options.targets_size() + target];
+      auto cell = json::map({{"from_index", static_cast<uint64_t>(source)},
+                             {"to_index", static_cast<uint64_t>(target)}});
+      if (td.time != kMaxCost) {
+        cell->emplace("time", static_cast<uint64_t>(td.time));
+        cell->emplace("distance", json::fp_t{td.dist * 0.001, 3});
+      } else {
+        cell->emplace("time", nullptr);
+        cell->emplace("distance", nullptr);
+      }
+      row->emplace_back(cell);
+    }
+    matrix->emplace_back(row);
+  }
+  auto locations = [](const google::protobuf::RepeatedPtrField<valhalla::Location>& list) {
+    auto array = json::array({});
+    for (const auto& location : list) {
+      array->emplace_back(json::map({{"lat", json::fp_t{location.ll().lat(), 6}},
+                                     {"lon", json::fp_t{location.ll().lng(), 6}}}));
+    }
+    return array;
+  };
+  auto json = json::map({{"sources_to_targets", matrix},
+                         {"units", Options_Units_Enum_Name(options.units())},
+                         {"targets", json::array({locations(options.targets())})},
+                         {"sources", json::array({locations(options.sources())})}});
+  std::stringstream ss;
+  ss << *json;
+  return ss.str();
+}
+
+void BM_MatrixTree(benchmark::State& state) {
+  std::vector<TimeDistance> time_distances;
+  const auto request = MakeMatrix(state.range(0), time_distances);
+  size_t bytes = 0;
+  const size_t allocations_before = allocations;
+  for (auto _ : state) {
+    auto json = SerializeTree(request, time_distances);
+    bytes += json.size();
+    benchmark::DoNotOptimize(json.data());
+  }
+  state.counters["allocs/response"] = benchmark::Counter((allocations - allocations_before) /
+                                                         static_cast<double>(state.iterations()));
+  state.SetBytesProcessed(bytes);
+}
+
+void BM_MatrixStreamed(benchmark::State& state) {
+  std::vector<TimeDistance> time_distances;
+  const auto request = MakeMatrix(state.range(0), time_distances);
+  size_t bytes = 0;
+  const size_t allocations_before = allocations;
+  for (auto _ : state) {
+    auto json = tyr::serializeMatrix(request, time_distances, 0.001);
+    bytes += json.size();
+    benchmark::DoNotOptimize(json.data());
+  }
+  state.counters["allocs/response"] = benchmark::Counter((allocations - allocations_before) /
+                                                         static_cast<double>(state.iterations()));
+  state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(BM_MatrixTree)->Arg(10)->Arg(50)->Arg(200)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_MatrixStreamed)->Arg(10)->Arg(50)->Arg(200)->Unit(benchmark::kMicrosecond);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,134 @@
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "baldr/ch_overlay.h"
+#include "filesystem.h"
+
+namespace {
+
+constexpr char kMagic[8] = {'V', 'A', 'L', 'H', 'C', 'H', '0', '1'};
+constexpr uint32_t kVersion = 2;
+
+// Fixed size header at the start of the file followed by the arrays in the order they appear here
+struct header_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t tile_count;
+  uint64_t dataset_id;
+  uint64_t node_count;
+  uint64_t up_arc_count;
+  uint64_t down_arc_count;
+};
+
+template <typename T> void write(std::ofstream& file, const std::vector<T>& values) {
+  file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T> std::vector<T> read(std::ifstream& file, size_t count) {
+  std::vector<T> values(count);
+  file.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+  return values;
+}
+
+} // namespace
+
+namespace valhalla {
+namespace baldr {
+
+constexpr uint32_t CHOverlay::kInvalidNode;
+
+CHOverlay::CHOverlay(const uint64_t dataset_id,
+                     std::vector<tile_t>&& tiles,
+                     std::vector<uint32_t>&& up_offsets,
+                     std::vector<arc_t>&& up_arcs,
+                     std::vector<uint32_t>&& down_offsets,
+                     std::vector<arc_t>&& down_arcs)
+    : dataset_id_(dataset_id), tiles_(std::move(tiles)), up_offsets_(std::move(up_offsets)),
+      up_arcs_(std::move(up_arcs)), down_offsets_(std::move(down_offsets)),
+      down_arcs_(std::move(down_arcs)) {
+  if (up_offsets_.empty() || up_offsets_.size() != down_offsets_.size() ||
+      up_offsets_.back() != up_arcs_.size() || down_offsets_.back() != down_arcs_.size()) {
+    throw std::runtime_error("Inconsistent contraction hierarchy overlay");
+  }
+  tile_index_.reserve(tiles_.size());
+  for (uint32_t i = 0; i < tiles_.size(); ++i) {
+    tile_index_.emplace(tiles_[i].tile_id, i);
+  }
+}
+
+std::shared_ptr<const CHOverlay> CHOverlay::Load(const std::string& file_name) {
+  std::ifstream file(file_name, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open contraction hierarchy overlay " + file_name);
+  }
+
+  header_t header{};
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion) {
+    throw std::runtime_error(file_name + " is not a contraction hierarchy overlay");
+  }
+
+  auto tiles = read<tile_t>(file, header.tile_count);
+  auto up_offsets = read<uint32_t>(file, header.node_count + 1);
+  auto up_arcs = read<arc_t>(file, header.up_arc_count);
+  auto down_offsets = read<uint32_t>(file, header.node_count + 1);
+  auto down_arcs = read<arc_t>(file, header.down_arc_count);
+  if (!file) {
+    throw std::runtime_error("Truncated contraction hierarchy overlay " + file_name);
+  }
+
+  return std::make_shared<const CHOverlay>(header.dataset_id, std::move(tiles),
+                                           std::move(up_offsets), std::move(up_arcs),
+                                           std::move(down_offsets), std::move(down_arcs));
+}
+
+void CHOverlay::Save(const std::string& file_name) const {
+  // Write to a temporary file and move it into place so readers never see a partial overlay
+  auto dir = filesystem::path(file_name);
+  dir.replace_filename("");
+  if (!dir.string().empty()) {
+    filesystem::create_directories(dir);
+  }
+  const std::string tmp_name = file_name + ".tmp";
+  std::ofstream file(tmp_name, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open " + tmp_name + " for writing");
+  }
+
+  header_t header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.tile_count = tiles_.size();
+  header.dataset_id = dataset_id_;
+  header.node_count = node_count();
+  header.up_arc_count = up_arcs_.size();
+  header.down_arc_count = down_arcs_.size();
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  write(file, tiles_);
+  write(file, up_offsets_);
+  write(file, up_arcs_);
+  write(file, down_offsets_);
+  write(file, down_arcs_);
+  file.close();
+  if (file.fail() || std::rename(tmp_name.c_str(), file_name.c_str()) != 0) {
+    throw std::runtime_error("Could not write contraction hierarchy overlay " + file_name);
+  }
+}
+
+std::string CHOverlay::FileName(const std::string& dir, const std::string& costing) {
+  return dir + filesystem::path::preferred_separator + costing + ".ch";
+}
+
+uint32_t CHOverlay::node_index(const GraphId& node) const {
+  auto found = tile_index_.find(node.tile_value());
+  if (found == tile_index_.cend()) {
+    return kInvalidNode;
+  }
+  const auto& tile = tiles_[found->second];
+  return node.id() < tile.node_count ? tile.first_node + node.id() : kInvalidNode;
+}
+
+} // namespace baldr
+} // namespace valhalla
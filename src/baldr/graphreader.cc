@@ -1,8 +1,15 @@
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <sys/stat.h>
+#include <thread>
+#include <tuple>
 #include <utility>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #include "baldr/connectivity_map.h"
 #include "baldr/curl_tilegetter.h"
@@ -21,36 +28,123 @@ constexpr size_t DEFAULT_MAX_CACHE_SIZE = 1073741824; // 1 gig
 constexpr size_t AVERAGE_TILE_SIZE = 2097152;         // 2 megs
 constexpr size_t AVERAGE_MM_TILE_SIZE = 1024;         // 1k
 
+// Milliseconds since start for logging how long the parts of starting up take
+size_t elapsed_ms(const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                               start)
+      .count();
+}
+
+// A tile directory that is a symlink to the live tileset is read through where it points to when
+// the reader is made. The link can then be swapped to a new tileset without the reader mixing the
+// tiles and ids of the two, it moves to the new one once it is made again
+std::string pinned_tile_dir(const std::string& tile_dir) {
+#ifndef _WIN32
+  std::string link = tile_dir;
+  while (link.size() > 1 && link.back() == filesystem::path::preferred_separator) {
+    link.pop_back();
+  }
+  struct stat s;
+  if (link.empty() || lstat(link.c_str(), &s) != 0 || !S_ISLNK(s.st_mode)) {
+    return tile_dir;
+  }
+  std::vector<char> target(s.st_size + 1);
+  auto size = readlink(link.c_str(), target.data(), target.size());
+  if (size <= 0 || static_cast<size_t>(size) >= target.size()) {
+    return tile_dir;
+  }
+  std::string path(target.data(), size);
+  auto parent = filesystem::path(link).parent_path().string();
+  return path.front() == filesystem::path::preferred_separator || parent.empty()
+             ? path
+             : parent + filesystem::path::preferred_separator + path;
+#else
+  return tile_dir;
+#endif
+}
+
 } // namespace
 
 namespace valhalla {
 namespace baldr {
 
+namespace {
+
+// Non owning handle to a cache that is shared by all the readers of the process
+class SharedTileCache final : public TileCache {
+public:
+  SharedTileCache(std::shared_ptr<TileCache> cache) : cache_(std::move(cache)) {
+  }
+  void Reserve(size_t tile_size) override {
+    cache_->Reserve(tile_size);
+  }
+  bool Contains(const GraphId& graphid) const override {
+    return cache_->Contains(graphid);
+  }
+  graph_tile_ptr Put(const GraphId& graphid, graph_tile_ptr tile, size_t size) override {
+    return cache_->Put(graphid, std::move(tile), size);
+  }
+  graph_tile_ptr Get(const GraphId& graphid) const override {
+    return cache_->Get(graphid);
+  }
+  bool OverCommitted() const override {
+    return cache_->OverCommitted();
+  }
+  void Clear() override {
+    cache_->Clear();
+  }
+  void Trim() override {
+    cache_->Trim();
+  }
+
+private:
+  std::shared_ptr<TileCache> cache_;
+};
+
+} // namespace
+
 GraphReader::tile_extract_t::tile_extract_t(const boost::property_tree::ptree& pt) {
   // if you really meant to load it
   if (pt.get_optional<std::string>("tile_extract")) {
     try {
-      // load the tar
-      archive.reset(new midgard::tar(pt.get<std::string>("tile_extract")));
-      // map files to graph ids
-      for (auto& c : archive->contents) {
-        try {
-          auto id = GraphTile::GetTileId(c.first);
-          tiles[id] = std::make_pair(const_cast<char*>(c.second.first), c.second.second);
-        } catch (...) {
-          // It's possible to put non-tile files inside the tarfile.  As we're only
-          // parsing the file *name* as a GraphId here, we will just silently skip
-          // any file paths that can't be parsed by GraphId::GetTileId()
-          // If we end up with *no* recognizable tile files in the tarball at all,
-          // checks lower down will warn on that.
+      // map the tar and look for the index at its start before going through all of it
+      const auto start = std::chrono::steady_clock::now();
+      const auto tile_extract = pt.get<std::string>("tile_extract");
+      archive.reset(new midgard::tar(tile_extract, true, false));
+      std::tie(tiles_begin, tiles_end) = TileExtract::Index(*archive);
+      const bool indexed = !empty();
+      if (!indexed) {
+        // map files to graph ids
+        archive.reset(new midgard::tar(tile_extract));
+        for (auto& c : archive->contents) {
+          try {
+            auto id = GraphTile::GetTileId(c.first);
+            scanned_tiles.push_back({id.value, static_cast<uint64_t>(c.second.first -
+                                                                     archive->mm.get()),
+                                     c.second.second});
+          } catch (...) {
+            // It's possible to put non-tile files inside the tarfile.  As we're only
+            // parsing the file *name* as a GraphId here, we will just silently skip
+            // any file paths that can't be parsed by GraphId::GetTileId()
+            // If we end up with *no* recognizable tile files in the tarball at all,
+            // checks lower down will warn on that.
+          }
         }
+        std::sort(scanned_tiles.begin(), scanned_tiles.end(),
+                  [](const TileExtract::tile_t& a, const TileExtract::tile_t& b) {
+                    return a.tile_id < b.tile_id;
+                  });
+        tiles_begin = scanned_tiles.data();
+        tiles_end = scanned_tiles.data() + scanned_tiles.size();
       }
       // couldn't load it
-      if (tiles.empty()) {
+      if (empty()) {
         LOG_WARN("Tile extract contained no usuable tiles");
       } // loaded ok but with possibly bad blocks
       else {
-        LOG_INFO("Tile extract successfully loaded with tile count: " + std::to_string(tiles.size()));
+        LOG_INFO("Tile extract successfully loaded with tile count: " +
+                 std::to_string(tiles_end - tiles_begin) + (indexed ? " from its index" : "") +
+                 " in " + std::to_string(elapsed_ms(start)) + " ms");
         if (archive->corrupt_blocks) {
           LOG_WARN("Tile extract had " + std::to_string(archive->corrupt_blocks) + " corrupt blocks");
         }
@@ -64,6 +158,7 @@ GraphReader::tile_extract_t::tile_extract_t(const boost::property_tree::ptree& p
   if (pt.get_optional<std::string>("traffic_extract")) {
     try {
       // load the tar
+      const auto start = std::chrono::steady_clock::now();
       traffic_archive.reset(new midgard::tar(pt.get<std::string>("traffic_extract")));
       // map files to graph ids
       for (auto& c : traffic_archive->contents) {
@@ -84,7 +179,8 @@ GraphReader::tile_extract_t::tile_extract_t(const boost::property_tree::ptree& p
       } // loaded ok but with possibly bad blocks
       else {
         LOG_INFO("Traffic tile extract successfully loaded with tile count: " +
-                 std::to_string(traffic_tiles.size()));
+                 std::to_string(traffic_tiles.size()) + " in " +
+                 std::to_string(elapsed_ms(start)) + " ms");
         if (traffic_archive->corrupt_blocks) {
           LOG_WARN("Traffic tile extract had " + std::to_string(traffic_archive->corrupt_blocks) +
                    " corrupt blocks");
@@ -97,6 +193,18 @@ GraphReader::tile_extract_t::tile_extract_t(const boost::property_tree::ptree& p
   }
 }
 
+std::pair<char*, size_t> GraphReader::tile_extract_t::find(uint64_t tile_id) const {
+  auto tile = std::lower_bound(tiles_begin, tiles_end, tile_id,
+                               [](const TileExtract::tile_t& t, uint64_t id) {
+                                 return t.tile_id < id;
+                               });
+  if (tile == tiles_end || tile->tile_id != tile_id ||
+      tile->offset + tile->size > archive->mm.size()) {
+    return {nullptr, 0};
+  }
+  return {archive->mm.get() + tile->offset, tile->size};
+}
+
 std::shared_ptr<const GraphReader::tile_extract_t>
 GraphReader::get_extract_instance(const boost::property_tree::ptree& pt) {
   static std::shared_ptr<const GraphReader::tile_extract_t> tile_extract(
@@ -368,6 +476,190 @@ graph_tile_ptr SynchronizedTileCache::Put(const GraphId& graphid, graph_tile_ptr
   return cache_.Put(graphid, std::move(tile), size);
 }
 
+// ----------------------------------------------------------------------------
+// ConcurrentTileCache implementation
+// ----------------------------------------------------------------------------
+
+// Constructor.
+ConcurrentTileCache::ConcurrentTileCache(size_t max_size, size_t shard_count)
+    : cache_size_(0), max_cache_size_(max_size) {
+  index_offsets_[0] = 0;
+  index_offsets_[1] = index_offsets_[0] + TileHierarchy::levels()[0].tiles.TileCount();
+  index_offsets_[2] = index_offsets_[1] + TileHierarchy::levels()[1].tiles.TileCount();
+  index_offsets_[3] = index_offsets_[2] + TileHierarchy::levels()[2].tiles.TileCount();
+  slot_count_ = index_offsets_[3] + TileHierarchy::GetTransitLevel().tiles.TileCount();
+
+  slots_.reset(new std::atomic<const GraphTile*>[slot_count_]);
+  referenced_.reset(new std::atomic<bool>[slot_count_]);
+  for (uint32_t i = 0; i < slot_count_; ++i) {
+    slots_[i].store(nullptr, std::memory_order_relaxed);
+    referenced_[i].store(false, std::memory_order_relaxed);
+  }
+
+  shard_count = std::max<size_t>(shard_count, 1);
+  shards_.reserve(shard_count);
+  for (size_t i = 0; i < shard_count; ++i) {
+    shards_.emplace_back(new Shard());
+  }
+  max_shard_size_ = max_cache_size_ / shard_count;
+}
+
+// Destructor. Nobody can be reading anymore so we can just drop our references
+ConcurrentTileCache::~ConcurrentTileCache() {
+  for (uint32_t i = 0; i < slot_count_; ++i) {
+    if (const auto* tile = slots_[i].load(std::memory_order_relaxed)) {
+      intrusive_ptr_release(tile);
+    }
+  }
+}
+
+// Slots are preallocated for every possible tile, nothing to reserve
+void ConcurrentTileCache::Reserve(size_t /*tile_size*/) {
+}
+
+// Checks if tile exists in the cache.
+bool ConcurrentTileCache::Contains(const GraphId& graphid) const {
+  auto offset = get_offset(graphid);
+  return offset < slot_count_ && slots_[offset].load() != nullptr;
+}
+
+// Lets you know if the cache is too large.
+bool ConcurrentTileCache::OverCommitted() const {
+  return cache_size_.load(std::memory_order_relaxed) > max_cache_size_;
+}
+
+// Get a pointer to a graph tile object given a GraphId. This is the hot path so rather than
+// locking we only announce ourselves to the writers of the shard while we take our reference
+graph_tile_ptr ConcurrentTileCache::Get(const GraphId& graphid) const {
+  auto offset = get_offset(graphid);
+  if (offset >= slot_count_) {
+    return nullptr;
+  }
+
+  // register as a reader of the current epoch, making sure it didnt flip while we did so
+  auto& shard = get_shard(offset);
+  uint32_t epoch;
+  while (true) {
+    epoch = shard.epoch.load() & 1;
+    shard.readers[epoch].fetch_add(1);
+    if ((shard.epoch.load() & 1) == epoch) {
+      break;
+    }
+    shard.readers[epoch].fetch_sub(1);
+  }
+
+  // the writers wont release the tile until we leave so its safe to add our reference
+  graph_tile_ptr tile(slots_[offset].load());
+  shard.readers[epoch].fetch_sub(1);
+
+  // give it a second chance the next time the eviction clock passes by
+  if (tile && !referenced_[offset].load(std::memory_order_relaxed)) {
+    referenced_[offset].store(true, std::memory_order_relaxed);
+  }
+  return tile;
+}
+
+// Puts a copy of a tile of into the cache.
+graph_tile_ptr ConcurrentTileCache::Put(const GraphId& graphid, graph_tile_ptr tile, size_t size) {
+  auto offset = get_offset(graphid);
+  if (offset >= slot_count_) {
+    return tile;
+  }
+
+  std::vector<graph_tile_ptr> evicted;
+  auto& shard = get_shard(offset);
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // someone else loaded this tile while we were doing the same, keep theirs
+    if (const auto* cached = slots_[offset].load()) {
+      return graph_tile_ptr(cached);
+    }
+
+    // the new tile goes right behind the clock hand so its the last one to be looked at
+    Evict(shard, size, evicted);
+    shard.hand = std::min(shard.hand, shard.resident.size());
+    shard.resident.insert(shard.resident.begin() + shard.hand++,
+                          Resident{offset, static_cast<uint32_t>(size)});
+    shard.size += size;
+    cache_size_.fetch_add(size, std::memory_order_relaxed);
+    referenced_[offset].store(false, std::memory_order_relaxed);
+    // publish it, the slot keeps the reference we detach here
+    slots_[offset].store(graph_tile_ptr(tile).detach());
+
+    // readers that saw the evicted tiles must be gone before we release them
+    if (!evicted.empty()) {
+      Synchronize(shard);
+    }
+  }
+  return tile;
+}
+
+// Clears the cache.
+void ConcurrentTileCache::Clear() {
+  for (auto& shard_ptr : shards_) {
+    auto& shard = *shard_ptr;
+    std::vector<graph_tile_ptr> evicted;
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    evicted.reserve(shard.resident.size());
+    for (const auto& resident : shard.resident) {
+      evicted.emplace_back(slots_[resident.offset].exchange(nullptr), false);
+    }
+    cache_size_.fetch_sub(shard.size, std::memory_order_relaxed);
+    shard.resident.clear();
+    shard.hand = 0;
+    shard.size = 0;
+    if (!evicted.empty()) {
+      Synchronize(shard);
+    }
+  }
+}
+
+// Evicts from every shard that is over its share of the budget
+void ConcurrentTileCache::Trim() {
+  for (auto& shard_ptr : shards_) {
+    auto& shard = *shard_ptr;
+    std::vector<graph_tile_ptr> evicted;
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Evict(shard, 0, evicted);
+    if (!evicted.empty()) {
+      Synchronize(shard);
+    }
+  }
+}
+
+// Runs the clock hand over the shard until the required size fits
+void ConcurrentTileCache::Evict(Shard& shard,
+                                size_t required_size,
+                                std::vector<graph_tile_ptr>& evicted) {
+  while (!shard.resident.empty() && shard.size + required_size > max_shard_size_) {
+    if (shard.hand >= shard.resident.size()) {
+      shard.hand = 0;
+    }
+    auto& candidate = shard.resident[shard.hand];
+
+    // recently used tiles get a second chance
+    if (referenced_[candidate.offset].exchange(false, std::memory_order_relaxed)) {
+      ++shard.hand;
+      continue;
+    }
+
+    // unpublish it, we adopt the reference the slot was holding
+    evicted.emplace_back(slots_[candidate.offset].exchange(nullptr), false);
+    shard.size -= candidate.size;
+    cache_size_.fetch_sub(candidate.size, std::memory_order_relaxed);
+    shard.resident.erase(shard.resident.begin() + shard.hand);
+  }
+}
+
+// Flips the epoch so that new readers are counted separately and waits for the old ones to leave
+void ConcurrentTileCache::Synchronize(Shard& shard) {
+  auto previous = shard.epoch.fetch_add(1) & 1;
+  while (shard.readers[previous].load() != 0) {
+    std::this_thread::yield();
+  }
+}
+
 // Constructs tile cache.
 TileCache* TileCacheFactory::createTileCache(const boost::property_tree::ptree& pt) {
   size_t max_cache_size = pt.get<size_t>("max_cache_size", DEFAULT_MAX_CACHE_SIZE);
@@ -379,6 +671,23 @@ TileCache* TileCacheFactory::createTileCache(const boost::property_tree::ptree&
 
   bool use_simple_cache = pt.get<bool>("use_simple_mem_cache", false);
 
+  // one lock free cache shared by all readers in the process
+  if (pt.get<bool>("use_concurrent_mem_cache", false)) {
+#ifndef ENABLE_THREAD_SAFE_TILE_REF_COUNT
+    LOG_WARN("use_concurrent_mem_cache requires ENABLE_THREAD_SAFE_TILE_REF_COUNT to be safe");
+#endif
+    static std::shared_ptr<TileCache> concurrentTileCache_;
+    static std::mutex factoryMutex;
+    std::lock_guard<std::mutex> lock(factoryMutex);
+    if (!concurrentTileCache_) {
+      concurrentTileCache_.reset(
+          new ConcurrentTileCache(max_cache_size,
+                                  pt.get<size_t>("concurrent_mem_cache_shards",
+                                                 ConcurrentTileCache::kDefaultShardCount)));
+    }
+    return new SharedTileCache(concurrentTileCache_);
+  }
+
   // wrap tile cache with thread-safe version
   if (pt.get<bool>("global_synchronized_cache", false)) {
     // Handle synchronization of cache
@@ -415,10 +724,20 @@ TileCache* TileCacheFactory::createTileCache(const boost::property_tree::ptree&
 // Constructor using separate tile files
 GraphReader::GraphReader(const boost::property_tree::ptree& pt,
                          std::unique_ptr<tile_getter_t>&& tile_getter)
-    : tile_extract_(get_extract_instance(pt)), tile_dir_(pt.get<std::string>("tile_dir", "")),
+    : tile_extract_(get_extract_instance(pt)),
+      tile_dir_(pinned_tile_dir(pt.get<std::string>("tile_dir", ""))),
       tile_getter_(std::move(tile_getter)),
       max_concurrent_users_(pt.get<size_t>("max_concurrent_reader_users", 1)),
-      tile_url_(pt.get<std::string>("tile_url", "")), cache_(TileCacheFactory::createTileCache(pt)) {
+      tile_url_(pt.get<std::string>("tile_url", "")),
+      predicted_speed_cache_size_(pt.get<uint32_t>("predicted_speed_cache_size", 0)) {
+  // Time the phases of starting up, loading the extracts logs its own time the first time around
+  auto start = std::chrono::steady_clock::now();
+  std::string phases;
+  auto phase_done = [&start, &phases](const std::string& phase) {
+    phases += (phases.empty() ? "" : ", ") + phase + " took " + std::to_string(elapsed_ms(start)) +
+              " ms";
+    start = std::chrono::steady_clock::now();
+  };
 
   // Make a tile fetcher if we havent passed one in from somewhere else
   if (!tile_getter_ && !tile_url_.empty()) {
@@ -431,9 +750,11 @@ GraphReader::GraphReader(const boost::property_tree::ptree& pt,
   if (!tile_url_.empty() && tile_url_.find(GraphTile::kTilePathPattern) == std::string::npos)
     throw std::runtime_error("Not found tilePath pattern in tile url");
 
-  // Reserve cache (based on whether using individual tile files or shared,
+  // Make the cache and reserve it (based on whether using individual tile files or shared,
   // mmap'd file
-  cache_->Reserve(tile_extract_->tiles.empty() ? AVERAGE_TILE_SIZE : AVERAGE_MM_TILE_SIZE);
+  cache_.reset(TileCacheFactory::createTileCache(pt));
+  cache_->Reserve(tile_extract_->empty() ? AVERAGE_TILE_SIZE : AVERAGE_MM_TILE_SIZE);
+  phase_done("tile cache");
 
   // Initialize the incident cache singleton if we have any kind of configuration to do so. if the
   // configuration is wrong or any kind of problem occurs this throws. the call below will spawn a
@@ -442,13 +763,27 @@ GraphReader::GraphReader(const boost::property_tree::ptree& pt,
                       !pt.get<std::string>("incident_dir", "").empty();
   if (enable_incidents_) {
     incident_singleton_t::get({}, pt,
-                              tile_extract_->tiles.empty() ? std::unordered_set<GraphId>{}
-                                                           : GetTileSet());
+                              tile_extract_->empty() ? std::unordered_set<GraphId>{}
+                                                     : GetTileSet());
+    phase_done("incidents");
   }
 
-  // Fill shortcut recovery cache if requested or by default in memmap mode
+  // Cache recovered shortcuts if requested, the cache fills itself a tile at a time
   if (pt.get<bool>("shortcut_caching", false)) {
-    shortcut_recovery_t::get_instance(this);
+    shortcut_recovery_t::get_instance(true);
+    phase_done("shortcut cache");
+  }
+
+  // Start loading tiles in the background if requested
+  prefetcher_ = tile_prefetcher_t::get_instance(pt);
+  phase_done("prefetcher");
+  // The first reader is the one a service waits for at startup, the others are only of interest
+  // when debugging
+  static std::atomic<bool> started_up{false};
+  if (!started_up.exchange(true)) {
+    LOG_INFO("GraphReader started up: " + phases);
+  } else {
+    LOG_DEBUG("GraphReader started up: " + phases);
   }
 }
 
@@ -458,8 +793,8 @@ bool GraphReader::DoesTileExist(const GraphId& graphid) const {
     return false;
   }
   // if you are using an extract only check that
-  if (!tile_extract_->tiles.empty()) {
-    return tile_extract_->tiles.find(graphid) != tile_extract_->tiles.cend();
+  if (!tile_extract_->empty()) {
+    return tile_extract_->find(graphid.value).first != nullptr;
   }
   // otherwise check memory or disk
   if (cache_->Contains(graphid)) {
@@ -486,6 +821,13 @@ private:
   const std::shared_ptr<midgard::tar> archive_;
 };
 
+void GraphReader::EnablePredictedSpeedCache(const graph_tile_ptr& tile) const {
+  if (predicted_speed_cache_size_ > 0 && tile->header()->predictedspeeds_count() > 0) {
+    // const_cast is only ok here because nobody else has the freshly loaded tile yet
+    const_cast<GraphTile&>(*tile).EnablePredictedSpeedCache(predicted_speed_cache_size_);
+  }
+}
+
 // Get a pointer to a graph tile object given a GraphId. Return nullptr
 // if the tile is not found/empty
 graph_tile_ptr GraphReader::GetGraphTile(const GraphId& graphid) {
@@ -500,18 +842,26 @@ graph_tile_ptr GraphReader::GetGraphTile(const GraphId& graphid) {
   auto base = graphid.Tile_Base();
   if (const auto& cached = cache_->Get(base)) {
     // LOG_DEBUG("Memory cache hit " + GraphTile::FileSuffix(base));
+    if (prefetcher_) {
+      prefetcher_->cache_hit(base);
+    }
     return cached;
   }
 
+  // We are going to block on loading it, let the prefetcher get ahead of us again
+  if (prefetcher_) {
+    prefetcher_->cache_miss(base);
+  }
+
   // Try getting it from the memmapped tar extract
-  if (!tile_extract_->tiles.empty()) {
+  if (!tile_extract_->empty()) {
     // Do we have this tile
-    auto t = tile_extract_->tiles.find(base);
-    if (t == tile_extract_->tiles.cend()) {
+    auto t = tile_extract_->find(base.value);
+    if (t.first == nullptr) {
       // LOG_DEBUG("Memory map cache miss " + GraphTile::FileSuffix(base));
       return nullptr;
     }
-    auto memory = std::make_unique<TarballGraphMemory>(tile_extract_->archive, t->second);
+    auto memory = std::make_unique<TarballGraphMemory>(tile_extract_->archive, t);
 
     auto traffic_ptr = tile_extract_->traffic_tiles.find(base);
     auto traffic_memory = traffic_ptr != tile_extract_->traffic_tiles.end()
@@ -527,6 +877,8 @@ graph_tile_ptr GraphReader::GetGraphTile(const GraphId& graphid) {
     }
     // LOG_DEBUG("Memory map cache hit " + GraphTile::FileSuffix(base));
 
+    EnablePredictedSpeedCache(tile);
+
     // Keep a copy in the cache and return it
     const size_t size = AVERAGE_MM_TILE_SIZE; // tile.end_offset();  // TODO what size??
     return cache_->Put(base, std::move(tile), size);
@@ -566,6 +918,8 @@ graph_tile_ptr GraphReader::GetGraphTile(const GraphId& graphid) {
       // LOG_DEBUG("Disk cache hit " + GraphTile::FileSuffix(base));
     }
 
+    EnablePredictedSpeedCache(tile);
+
     // Keep a copy in the cache and return it
     const size_t size = tile->header()->end_offset();
     return cache_->Put(base, std::move(tile), size);
@@ -803,9 +1157,9 @@ std::string GraphReader::encoded_edge_shape(const valhalla::baldr::GraphId& edge
 std::unordered_set<GraphId> GraphReader::GetTileSet() const {
   // either mmap'd tiles
   std::unordered_set<GraphId> tiles;
-  if (tile_extract_->tiles.size()) {
-    for (const auto& t : tile_extract_->tiles) {
-      tiles.emplace(t.first);
+  if (!tile_extract_->empty()) {
+    for (auto t = tile_extract_->tiles_begin; t != tile_extract_->tiles_end; ++t) {
+      tiles.emplace(t->tile_id);
     }
   } // or individually on disk
   else if (!tile_dir_.empty()) {
@@ -836,10 +1190,10 @@ std::unordered_set<GraphId> GraphReader::GetTileSet() const {
 std::unordered_set<GraphId> GraphReader::GetTileSet(const uint8_t level) const {
   // either mmap'd tiles
   std::unordered_set<GraphId> tiles;
-  if (tile_extract_->tiles.size()) {
-    for (const auto& t : tile_extract_->tiles) {
-      if (static_cast<GraphId>(t.first).level() == level) {
-        tiles.emplace(t.first);
+  if (!tile_extract_->empty()) {
+    for (auto t = tile_extract_->tiles_begin; t != tile_extract_->tiles_end; ++t) {
+      if (GraphId(t->tile_id).level() == level) {
+        tiles.emplace(t->tile_id);
       }
     } // or individually on disk
   } else if (!tile_dir_.empty()) {
@@ -1,5 +1,17 @@
 #include "baldr/predictedspeeds.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VALHALLA_SPEEDS_SSE2
+#endif
+
+// AVX2 is picked at runtime so that binaries built for any x86-64 still make use of it
+#if defined(VALHALLA_SPEEDS_SSE2) && (defined(__GNUC__) || defined(__clang__)) &&                  \
+    (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define VALHALLA_SPEEDS_AVX2
+#endif
+
 namespace valhalla {
 namespace baldr {
 
@@ -72,17 +84,158 @@ std::array<int16_t, kCoefficientCount> compress_speed_buckets(const float* speed
   return result;
 }
 
+namespace {
+
+// Lanes of the widest vectors we use, the coefficient count is a multiple of it
+constexpr uint32_t kLanes = 8;
+static_assert(kCoefficientCount % kLanes == 0, "Coefficients must fill whole vectors");
+
+// The first coefficient is scaled by 1/sqrt(2) while the dot products below treat it like the
+// others, its cos is always 1 so we correct for it afterwards
+inline float finish(const float dot, const float first) {
+  return (dot + first * (k1OverSqrt2 - 1.f)) * kSpeedNormalization;
+}
+
+using dot_t = float (*)(const int16_t*, const float*);
+using dot_float_t = float (*)(const float*, const float*);
+
+// Works for the coefficients as they are stored and for ones already converted to float
+template <typename coefficient_t>
+float dot_scalar(const coefficient_t* coefficients, const float* cos_values) {
+  // Use several accumulators so the additions don't all wait on each other
+  float sums[kLanes] = {};
+  for (uint32_t c = 0; c < kCoefficientCount; c += kLanes) {
+    for (uint32_t l = 0; l < kLanes; ++l) {
+      sums[l] += coefficients[c + l] * cos_values[c + l];
+    }
+  }
+  return ((sums[0] + sums[4]) + (sums[1] + sums[5])) + ((sums[2] + sums[6]) + (sums[3] + sums[7]));
+}
+
+#ifdef VALHALLA_SPEEDS_SSE2
+inline float horizontal_sum(__m128 v) {
+  v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+  return _mm_cvtss_f32(v);
+}
+
+float dot_sse2(const int16_t* coefficients, const float* cos_values) {
+  __m128 lo_sum = _mm_setzero_ps(), hi_sum = _mm_setzero_ps();
+  for (uint32_t c = 0; c < kCoefficientCount; c += kLanes) {
+    // Widen 8 coefficients to 32 bits by putting them in the upper halves and shifting them down
+    __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefficients + c));
+    __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16));
+    __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(packed, packed), 16));
+    lo_sum = _mm_add_ps(lo_sum, _mm_mul_ps(lo, _mm_loadu_ps(cos_values + c)));
+    hi_sum = _mm_add_ps(hi_sum, _mm_mul_ps(hi, _mm_loadu_ps(cos_values + c + 4)));
+  }
+  return horizontal_sum(_mm_add_ps(lo_sum, hi_sum));
+}
+
+float dot_float_sse2(const float* coefficients, const float* cos_values) {
+  __m128 lo_sum = _mm_setzero_ps(), hi_sum = _mm_setzero_ps();
+  for (uint32_t c = 0; c < kCoefficientCount; c += kLanes) {
+    lo_sum = _mm_add_ps(lo_sum, _mm_mul_ps(_mm_loadu_ps(coefficients + c),
+                                           _mm_loadu_ps(cos_values + c)));
+    hi_sum = _mm_add_ps(hi_sum, _mm_mul_ps(_mm_loadu_ps(coefficients + c + 4),
+                                           _mm_loadu_ps(cos_values + c + 4)));
+  }
+  return horizontal_sum(_mm_add_ps(lo_sum, hi_sum));
+}
+#endif
+
+#ifdef VALHALLA_SPEEDS_AVX2
+__attribute__((target("avx2,fma"))) inline float horizontal_sum_avx2(__m256 v) {
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma"))) float dot_avx2(const int16_t* coefficients,
+                                                    const float* cos_values) {
+  __m256 sum = _mm256_setzero_ps();
+  for (uint32_t c = 0; c < kCoefficientCount; c += kLanes) {
+    __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coefficients + c));
+    __m256 widened = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(packed));
+    sum = _mm256_fmadd_ps(widened, _mm256_loadu_ps(cos_values + c), sum);
+  }
+  return horizontal_sum_avx2(sum);
+}
+
+__attribute__((target("avx2,fma"))) float dot_float_avx2(const float* coefficients,
+                                                          const float* cos_values) {
+  __m256 sum = _mm256_setzero_ps();
+  for (uint32_t c = 0; c < kCoefficientCount; c += kLanes) {
+    sum = _mm256_fmadd_ps(_mm256_loadu_ps(coefficients + c), _mm256_loadu_ps(cos_values + c), sum);
+  }
+  return horizontal_sum_avx2(sum);
+}
+
+bool has_avx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+#endif
+
+// The best implementations this cpu can run, picked once at startup
+#if defined(VALHALLA_SPEEDS_AVX2)
+const dot_t dot = has_avx2() ? dot_avx2 : dot_sse2;
+const dot_float_t dot_float = has_avx2() ? dot_float_avx2 : dot_float_sse2;
+#elif defined(VALHALLA_SPEEDS_SSE2)
+const dot_t dot = dot_sse2;
+const dot_float_t dot_float = dot_float_sse2;
+#else
+const dot_t dot = dot_scalar<int16_t>;
+const dot_float_t dot_float = dot_scalar<float>;
+#endif
+
+} // namespace
+
 float decompress_speed_bucket(const int16_t* coefficients, uint32_t bucket_idx) {
   // Get a pointer to the precomputed cos values for this bucket
   const float* b = BucketCosTable::GetInstance().get(bucket_idx);
 
   // DCT-III with speed normalization
-  float speed = *coefficients * k1OverSqrt2;
-  const auto* coef_end = coefficients + kCoefficientCount;
-  for (++b, ++coefficients; coefficients < coef_end; ++coefficients, ++b) {
-    speed += *coefficients * *b;
+  return finish(dot(coefficients, b), coefficients[0]);
+}
+
+void decompress_speed_buckets(const int16_t* coefficients,
+                              uint32_t first_bucket,
+                              uint32_t count,
+                              float* speeds) {
+  // Convert the coefficients once rather than for every bucket
+  alignas(32) float converted[kCoefficientCount];
+  for (uint32_t c = 0; c < kCoefficientCount; ++c) {
+    converted[c] = coefficients[c];
+  }
+
+  const auto& table = BucketCosTable::GetInstance();
+  for (uint32_t i = 0, bucket = first_bucket % kBucketsPerWeek; i < count; ++i) {
+    speeds[i] = finish(dot_float(converted, table.get(bucket)), converted[0]);
+    if (++bucket == kBucketsPerWeek) {
+      bucket = 0;
+    }
+  }
+}
+
+void PredictedSpeeds::enable_cache(const uint32_t entries) {
+  if (entries == 0) {
+    cache_.reset();
+    cache_shift_ = 32;
+    return;
+  }
+
+  // Round up to a power of 2 so the slot is just the top bits of the hash
+  uint32_t bits = 6;
+  while (bits < 31 && (1u << bits) < entries) {
+    ++bits;
+  }
+  cache_.reset(new std::atomic<uint64_t>[1u << bits]);
+  for (uint32_t i = 0; i < (1u << bits); ++i) {
+    cache_[i].store(~uint64_t(0), std::memory_order_relaxed);
   }
-  return speed * kSpeedNormalization;
+  cache_shift_ = 32 - bits;
 }
 
 std::string encode_compressed_speeds(const int16_t* coefficients) {
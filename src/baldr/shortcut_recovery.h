@@ -5,88 +5,82 @@
 #include "midgard/logging.h"
 
 #include <cstdint>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 namespace {
 // TODO: break this out into a private header
-// a static cache for shortcut recovery that we can optionally pre-fill
+// a static cache for shortcut recovery that is filled as shortcuts are asked for
 struct shortcut_recovery_t {
 protected:
+  // the cached shortcuts are split by id so threads recovering different shortcuts rarely wait
+  static constexpr size_t kShardCount = 64;
+  struct shard_t {
+    std::mutex lock;
+    std::unordered_map<uint64_t, std::vector<valhalla::baldr::GraphId>> shortcuts;
+  };
+
   /**
-   * Constructs a shortcut cache from a graphreaders tileset by recovering all shortcuts. If the
-   * graphreader passed in is null nothing is cached and revoery will happen on the fly
-   * @param reader
+   * Constructs a shortcut cache. Nothing is recovered up front, the first time a shortcut is asked
+   * for it is recovered and cached along with its opposing shortcut. If the cache is disabled
+   * recovery always happens on the fly
+   * @param cache  whether to cache the recovered shortcuts
    */
-  shortcut_recovery_t(valhalla::baldr::GraphReader* reader) {
-    // do nothing if the reader is no good
-    if (!reader) {
+  shortcut_recovery_t(bool cache) : shards(cache ? kShardCount : 0) {
+    if (cache) {
+      LOG_INFO("Shortcut recovery cache enabled, it is filled as shortcuts are asked for");
+    } else {
       LOG_INFO("Shortcut recovery cache disabled");
-      return;
-    }
-    LOG_INFO("Shortcut recovery cache enabled");
-
-    // completely skip the levels that dont have shortcuts
-    for (const auto& level : valhalla::baldr::TileHierarchy::levels()) {
-      // we dont get shortcuts on level 2 and up
-      if (level.level > 1)
-        continue;
-      // for each tile
-      for (auto tile_id : reader->GetTileSet(level.level)) {
-        // cull cache if we are over allocated
-        if (reader->OverCommitted())
-          reader->Trim();
-        // this shouldnt fail but garbled files could cause it
-        auto tile = reader->GetGraphTile(tile_id);
-        assert(tile);
-        // for each edge in the tile
-        for (const auto& edge : tile->GetDirectedEdges()) {
-          // skip non-shortcuts or the shortcut is one we wont use
-          if (!edge.shortcut())
-            continue;
-          auto shortcut_id = tile->header()->graphid();
-          shortcut_id.set_id(&edge - tile->directededge(0));
-          // skip already found opposing edges
-          if (shortcuts.find(shortcut_id) != shortcuts.end())
-            continue;
-          // recover the shortcut and make a copy for opposing direction
-          auto recovered = recover_shortcut(*reader, shortcut_id);
-          decltype(recovered) opp_recovered = recovered;
-          std::reverse_copy(recovered.cbegin(), recovered.cend(), opp_recovered.begin());
-          // save some stats
-          bool failed = recovered.front() == shortcut_id;
-          unrecovered += failed;
-          superseded += failed ? 0 : recovered.size();
-          // cache it even if it failed (no point in trying the same thing twice)
-          shortcuts.emplace(shortcut_id, std::move(recovered));
-
-          // its cheaper to get the opposing without crawling the graph
-          auto opp_tile = tile;
-          auto opp_id = reader->GetOpposingEdgeId(shortcut_id, opp_tile);
-          if (!opp_id.Is_Valid())
-            continue; // dont store edges which arent in our tileset
-
-          for (auto& id : opp_recovered) {
-            id = reader->GetOpposingEdgeId(id, opp_tile);
-            if (!id.Is_Valid()) {
-              opp_recovered = {opp_id};
-              break;
-            }
-          }
-          // stats
-          failed = opp_recovered.front() == opp_id;
-          unrecovered += failed;
-          superseded += failed ? 0 : opp_recovered.size();
-          // cache it even if it failed (no point in trying the same thing twice)
-          shortcuts.emplace(opp_id, std::move(opp_recovered));
-        }
-      }
     }
+  }
 
-    LOG_INFO(std::to_string(shortcuts.size()) + " shortcuts recovered as " +
-             std::to_string(superseded) + " superseded edges. " + std::to_string(unrecovered) +
-             " shortcuts could not be recovered.");
+  shard_t& shard(const valhalla::baldr::GraphId& shortcut_id) const {
+    return shards[std::hash<valhalla::baldr::GraphId>()(shortcut_id) % shards.size()];
+  }
+
+  /**
+   * Caches the edges of a shortcut unless another thread beat us to it
+   * @param shortcut_id  the shortcut
+   * @param edges        the edges it supersedes
+   * @return the edges that are cached for the shortcut
+   */
+  std::vector<valhalla::baldr::GraphId> insert(const valhalla::baldr::GraphId& shortcut_id,
+                                               std::vector<valhalla::baldr::GraphId> edges) const {
+    auto& s = shard(shortcut_id);
+    std::lock_guard<std::mutex> lock(s.lock);
+    return s.shortcuts.emplace(shortcut_id.value, std::move(edges)).first->second;
+  }
+
+  /**
+   * The edges of the shortcut in the opposing direction are the opposing edges of a shortcut in
+   * reverse order, its cheaper to get them like that than by crawling the graph
+   * @param reader       the graphreader for graph data access
+   * @param shortcut_id  the shortcut
+   * @param edges        the edges the shortcut supersedes
+   * @param opp_id       set to the opposing shortcut, invalid if it is not in our tileset
+   * @return the edges the opposing shortcut supersedes
+   */
+  std::vector<valhalla::baldr::GraphId>
+  recover_opposing(valhalla::baldr::GraphReader& reader,
+                   const valhalla::baldr::GraphId& shortcut_id,
+                   const std::vector<valhalla::baldr::GraphId>& edges,
+                   valhalla::baldr::GraphId& opp_id) const {
+    valhalla::baldr::graph_tile_ptr opp_tile;
+    opp_id = reader.GetOpposingEdgeId(shortcut_id, opp_tile);
+    if (!opp_id.Is_Valid())
+      return {};
+    // a shortcut that could not be recovered is only itself, so is the opposing one then
+    if (edges.size() == 1 && edges.front() == shortcut_id)
+      return {opp_id};
+    std::vector<valhalla::baldr::GraphId> opp_edges(edges.crbegin(), edges.crend());
+    for (auto& id : opp_edges) {
+      id = reader.GetOpposingEdgeId(id, opp_tile);
+      if (!id.Is_Valid())
+        return {opp_id};
+    }
+    return opp_edges;
   }
 
   /**
@@ -194,23 +188,20 @@ protected:
     return edges;
   }
 
-  // a place to cache the recovered shortcuts
-  std::unordered_map<uint64_t, std::vector<valhalla::baldr::GraphId>> shortcuts;
-  // a place to keep some stats about the recovery
-  size_t unrecovered;
-  size_t superseded;
+  // the recovered shortcuts asked for so far and their opposing ones, empty if caching is disabled
+  mutable std::vector<shard_t> shards;
 
 public:
   /**
-   * returns a static instance of the cache after prefilling it. if on the first call,
-   * the reader is nullptr then the cache will not be filled and recovery will be on the fly
+   * returns a static instance of the cache. whether the first call asks for caching decides if
+   * the shortcuts are cached or always recovered on the fly
    *
-   * @param reader       the reader used to initialize the cache the first time
-   * @return a filled cache mapping shortcuts to superceeded edges
+   * @param cache        whether to cache the recovered shortcuts, only used on the first call
+   * @return the cache mapping shortcuts to superceeded edges
    */
-  static shortcut_recovery_t& get_instance(valhalla::baldr::GraphReader* reader = nullptr) {
-    static shortcut_recovery_t cache{reader};
-    return cache;
+  static shortcut_recovery_t& get_instance(bool cache = false) {
+    static shortcut_recovery_t instance{cache};
+    return instance;
   }
 
   /**
@@ -222,12 +213,29 @@ public:
    */
   std::vector<valhalla::baldr::GraphId> get(const valhalla::baldr::GraphId& shortcut_id,
                                             valhalla::baldr::GraphReader& reader) const {
-    // in the case that we didnt fill the cache we fallback to recovering on the fly
-    auto itr = shortcuts.find(shortcut_id);
-    if (itr == shortcuts.cend())
+    // in the case that we dont cache we fallback to recovering on the fly
+    if (shards.empty())
       return recover_shortcut(reader, shortcut_id);
-    // it was in cache
-    return itr->second;
+
+    // look for it in the cache
+    {
+      auto& s = shard(shortcut_id);
+      std::lock_guard<std::mutex> lock(s.lock);
+      auto itr = s.shortcuts.find(shortcut_id.value);
+      if (itr != s.shortcuts.cend())
+        return itr->second;
+    }
+
+    // recover it without holding the lock, cache it even if it failed (no point in trying the
+    // same thing twice). the opposing shortcut is likely asked for too and comes almost for free
+    if (!reader.GetGraphTile(shortcut_id))
+      return {shortcut_id};
+    auto recovered = recover_shortcut(reader, shortcut_id);
+    valhalla::baldr::GraphId opp_id;
+    auto opp_recovered = recover_opposing(reader, shortcut_id, recovered, opp_id);
+    if (opp_id.Is_Valid())
+      insert(opp_id, std::move(opp_recovered));
+    return insert(shortcut_id, std::move(recovered));
   }
 };
 
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include <sys/stat.h>
+
+#include "baldr/spatial_index.h"
+#include "filesystem.h"
+
+namespace {
+
+constexpr char kMagic[8] = {'V', 'A', 'L', 'H', 'S', 'I', '0', '1'};
+constexpr uint32_t kVersion = 2;
+
+// Fixed size header at the start of the file followed by the tiles and then the boxes
+struct header_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t tile_count;
+  uint64_t box_count;
+  uint64_t dataset_id;
+};
+
+// Round to a float that is no larger (or no smaller) than the value. We step one more float
+// outwards so that points projected onto the shape, which may be off by the last bit of a double,
+// are still inside the box
+float round_down(const double value) {
+  return std::nextafter(static_cast<float>(value), -std::numeric_limits<float>::infinity());
+}
+
+float round_up(const double value) {
+  return std::nextafter(static_cast<float>(value), std::numeric_limits<float>::infinity());
+}
+
+} // namespace
+
+namespace valhalla {
+namespace baldr {
+
+std::shared_ptr<const SpatialIndex> SpatialIndex::Load(const std::string& file_name) {
+  struct stat s;
+  if (stat(file_name.c_str(), &s) || static_cast<size_t>(s.st_size) < sizeof(header_t)) {
+    throw std::runtime_error(file_name + " is not a spatial index");
+  }
+
+  std::shared_ptr<SpatialIndex> index(new SpatialIndex());
+  index->file_.map(file_name, s.st_size);
+  header_t header{};
+  std::memcpy(&header, index->file_.get(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+    throw std::runtime_error(file_name + " is not a spatial index");
+  }
+  const size_t expected =
+      sizeof(header_t) + header.tile_count * sizeof(tile_t) + header.box_count * sizeof(box_t);
+  if (index->file_.size() != expected) {
+    throw std::runtime_error("Truncated spatial index " + file_name);
+  }
+
+  index->tiles_ = reinterpret_cast<const tile_t*>(index->file_.get() + sizeof(header_t));
+  index->tile_count_ = header.tile_count;
+  index->boxes_ = reinterpret_cast<const box_t*>(index->tiles_ + header.tile_count);
+  index->box_count_ = header.box_count;
+  index->dataset_id_ = header.dataset_id;
+  return index;
+}
+
+void SpatialIndex::Save(const std::string& file_name,
+                        const uint64_t dataset_id,
+                        const std::vector<tile_t>& tiles,
+                        const std::vector<box_t>& boxes) {
+  // Write to a temporary file and move it into place so readers never see a partial index
+  auto dir = filesystem::path(file_name);
+  dir.replace_filename("");
+  if (!dir.string().empty()) {
+    filesystem::create_directories(dir);
+  }
+  const std::string tmp_name = file_name + ".tmp";
+  std::ofstream file(tmp_name, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open " + tmp_name + " for writing");
+  }
+
+  header_t header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.tile_count = tiles.size();
+  header.box_count = boxes.size();
+  header.dataset_id = dataset_id;
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(tiles.data()), tiles.size() * sizeof(tile_t));
+  file.write(reinterpret_cast<const char*>(boxes.data()), boxes.size() * sizeof(box_t));
+  file.close();
+  if (file.fail() || std::rename(tmp_name.c_str(), file_name.c_str()) != 0) {
+    throw std::runtime_error("Could not write spatial index " + file_name);
+  }
+}
+
+SpatialIndex::box_t SpatialIndex::Box(const std::vector<midgard::PointLL>& shape) {
+  double min_lng = std::numeric_limits<double>::max(), min_lat = min_lng;
+  double max_lng = std::numeric_limits<double>::lowest(), max_lat = max_lng;
+  for (const auto& p : shape) {
+    min_lng = std::min(min_lng, p.lng());
+    min_lat = std::min(min_lat, p.lat());
+    max_lng = std::max(max_lng, p.lng());
+    max_lat = std::max(max_lat, p.lat());
+  }
+  // An edge without shape can't be near anything, give it a box that is as far away as it gets
+  if (shape.empty()) {
+    return {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+            std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+  }
+  return {round_down(min_lng), round_down(min_lat), round_up(max_lng), round_up(max_lat)};
+}
+
+uint64_t SpatialIndex::Checksum(const GraphTile& tile) {
+  // FNV-1a over the bytes of the header
+  const auto* bytes = reinterpret_cast<const uint8_t*>(tile.header());
+  uint64_t checksum = 14695981039346656037ull;
+  for (size_t i = 0; i < sizeof(GraphTileHeader); ++i) {
+    checksum = (checksum ^ bytes[i]) * 1099511628211ull;
+  }
+  return checksum;
+}
+
+const SpatialIndex::box_t* SpatialIndex::boxes(const GraphTile& tile) const {
+  const auto tile_id = tile.id().tile_value();
+  const auto* end = tiles_ + tile_count_;
+  const auto* found = std::lower_bound(tiles_, end, tile_id, [](const tile_t& t, uint32_t id) {
+    return t.tile_id < id;
+  });
+  if (found == end || found->tile_id != tile_id || tile.header()->dataset_id() != dataset_id_ ||
+      found->box_count != tile.header()->bin_offset(kBinCount - 1).second ||
+      found->checksum != Checksum(tile)) {
+    return nullptr;
+  }
+  return boxes_ + found->first_box;
+}
+
+bool SpatialIndex::Matches(GraphReader& reader) const {
+  for (size_t i = 0; i < tile_count_; ++i) {
+    const GraphId tile_id(tiles_[i].tile_id);
+    if (!reader.DoesTileExist(tile_id)) {
+      continue;
+    }
+    auto tile = reader.GetGraphTile(tile_id);
+    return tile && tile->header()->dataset_id() == dataset_id_ &&
+           tiles_[i].checksum == Checksum(*tile);
+  }
+  return false;
+}
+
+} // namespace baldr
+} // namespace valhalla
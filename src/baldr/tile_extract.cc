@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "baldr/graphtile.h"
+#include "baldr/tile_extract.h"
+#include "filesystem.h"
+
+using valhalla::midgard::tar;
+
+namespace {
+
+constexpr uint64_t kBlockSize = sizeof(tar::header_t);
+
+constexpr char kMagic[8] = {'V', 'A', 'L', 'H', 'T', 'X', '0', '1'};
+constexpr uint32_t kVersion = 1;
+// Reads back as another number on a machine with the other byte order
+constexpr uint32_t kByteOrder = 0x01020304;
+
+// Fixed size header at the start of the index followed by the tiles
+struct index_header_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t tile_count;
+};
+static_assert(sizeof(index_header_t) % alignof(valhalla::baldr::TileExtract::tile_t) == 0,
+              "The tiles of the index have to be aligned");
+
+// The size of the data of a tar entry once it is padded out to whole blocks
+uint64_t blocks(const uint64_t size) {
+  return (size + kBlockSize - 1) / kBlockSize * kBlockSize;
+}
+
+// A pax extended header that takes up exactly size bytes of the tar, which is a whole number of
+// blocks. The only thing it holds is a comment to fill it up
+std::string padding(const uint64_t size) {
+  const uint64_t record_size = size - kBlockSize;
+  auto header = tar::header_t::make("padding", record_size, 'x');
+  std::string entry(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (record_size > 0) {
+    // the length at the start of a record counts its own digits
+    std::string record = std::to_string(record_size) + " comment=";
+    record.append(record_size - record.size() - 1, '0');
+    record.push_back('\n');
+    entry += record;
+  }
+  return entry;
+}
+
+} // namespace
+
+namespace valhalla {
+namespace baldr {
+
+const std::string TileExtract::kIndexName = "index.bin";
+
+std::pair<const TileExtract::tile_t*, const TileExtract::tile_t*>
+TileExtract::Index(const midgard::tar& archive) {
+  // It has to be the first entry, that is what lets it be found without going through the tar
+  auto index = archive.contents.find(kIndexName);
+  if (index == archive.contents.cend() || index->second.first != archive.mm.get() + kBlockSize ||
+      index->second.second < sizeof(index_header_t)) {
+    return {nullptr, nullptr};
+  }
+
+  // It has to be one this code wrote, on a machine with the same byte order
+  index_header_t header;
+  std::memcpy(&header, index->second.first, sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+      header.byte_order != kByteOrder ||
+      index->second.second != sizeof(header) + header.tile_count * sizeof(tile_t)) {
+    return {nullptr, nullptr};
+  }
+  auto begin = reinterpret_cast<const tile_t*>(index->second.first + sizeof(header));
+  return {begin, begin + header.tile_count};
+}
+
+size_t TileExtract::Save(const std::string& file_name, const std::string& tile_dir) {
+  std::string root = tile_dir;
+  while (root.size() > 1 && root.back() == filesystem::path::preferred_separator) {
+    root.pop_back();
+  }
+
+  // The tiles of every level sorted by id
+  std::vector<tile_t> tiles;
+  for (filesystem::recursive_directory_iterator i(root), end; i != end; ++i) {
+    if (!i->is_regular_file() || i->path().extension().string() != SUFFIX_NON_COMPRESSED) {
+      continue;
+    }
+    try {
+      auto tile_id = GraphTile::GetTileId(i->path().string());
+      struct stat s;
+      if (stat(i->path().string().c_str(), &s) == 0) {
+        tiles.push_back({tile_id.value, 0, static_cast<uint64_t>(s.st_size)});
+      }
+    } catch (...) {
+      // not a tile
+    }
+  }
+  std::sort(tiles.begin(), tiles.end(),
+            [](const tile_t& a, const tile_t& b) { return a.tile_id < b.tile_id; });
+
+  // Lay the tiles out after the index so that the index can be written first
+  std::vector<uint64_t> paddings;
+  const uint64_t index_size = sizeof(index_header_t) + tiles.size() * sizeof(tile_t);
+  uint64_t position = kBlockSize + blocks(index_size);
+  for (auto& tile : tiles) {
+    // The padding has to take at least a block for its header
+    uint64_t misaligned = (position + kBlockSize) % kAlignment;
+    paddings.push_back(misaligned == 0 ? 0 : kAlignment - misaligned);
+    tile.offset = position + paddings.back() + kBlockSize;
+    position = tile.offset + blocks(tile.size);
+  }
+
+  // Write to a temporary file and move it into place so readers never see a partial extract
+  auto dir = filesystem::path(file_name);
+  dir.replace_filename("");
+  if (!dir.string().empty()) {
+    filesystem::create_directories(dir);
+  }
+  const std::string tmp_name = file_name + ".tmp";
+  std::ofstream file(tmp_name, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open " + tmp_name + " for writing");
+  }
+
+  // Every entry is padded out to whole blocks with zeros
+  const std::vector<char> zeros(kAlignment, 0);
+  auto write_entry = [&file, &zeros](const std::string& name, const char* data, uint64_t size) {
+    auto header = tar::header_t::make(name, size);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(data, size);
+    file.write(zeros.data(), blocks(size) - size);
+  };
+
+  index_header_t header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrder;
+  header.tile_count = tiles.size();
+  std::string index(reinterpret_cast<const char*>(&header), sizeof(header));
+  index.append(reinterpret_cast<const char*>(tiles.data()), tiles.size() * sizeof(tile_t));
+  write_entry(kIndexName, index.data(), index.size());
+  std::vector<char> data;
+  for (size_t i = 0; i < tiles.size() && file; ++i) {
+    const auto& tile = tiles[i];
+    if (paddings[i] > 0) {
+      file << padding(paddings[i]);
+    }
+    const auto suffix = GraphTile::FileSuffix(GraphId(tile.tile_id));
+    std::ifstream in(root + filesystem::path::preferred_separator + suffix, std::ios::binary);
+    data.resize(tile.size);
+    if (!in.read(data.data(), data.size())) {
+      file.close();
+      std::remove(tmp_name.c_str());
+      throw std::runtime_error("Could not read tile " + suffix);
+    }
+    // tar names always use forward slashes
+    write_entry(GraphTile::FileSuffix(GraphId(tile.tile_id), SUFFIX_NON_COMPRESSED, false),
+                data.data(), data.size());
+  }
+  // A tar ends with two empty blocks
+  file.write(zeros.data(), 2 * kBlockSize);
+
+  const bool laid_out = file.tellp() == static_cast<std::streamoff>(position + 2 * kBlockSize);
+  file.close();
+  if (file.fail() || !laid_out || std::rename(tmp_name.c_str(), file_name.c_str()) != 0) {
+    std::remove(tmp_name.c_str());
+    throw std::runtime_error("Could not write tile extract " + file_name);
+  }
+  return tiles.size();
+}
+
+} // namespace baldr
+} // namespace valhalla
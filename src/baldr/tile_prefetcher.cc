@@ -0,0 +1,233 @@
+#include "baldr/tile_prefetcher.h"
+#include "baldr/graphreader.h"
+#include "baldr/tilehierarchy.h"
+#include "midgard/logging.h"
+
+namespace {
+
+constexpr size_t DEFAULT_PREFETCH_QUEUE_SIZE = 4096;
+constexpr uint32_t DEFAULT_PREFETCH_STATS_INTERVAL = 300;
+
+} // namespace
+
+namespace valhalla {
+namespace baldr {
+
+std::shared_ptr<tile_prefetcher_t>
+tile_prefetcher_t::get_instance(const boost::property_tree::ptree& pt) {
+  if (pt.get<size_t>("prefetch_threads", 0) == 0) {
+    return nullptr;
+  }
+  if (!pt.get<bool>("use_concurrent_mem_cache", false)) {
+    LOG_WARN("prefetch_threads requires use_concurrent_mem_cache, tile prefetching is disabled");
+    return nullptr;
+  }
+
+  static std::mutex instance_mutex;
+  static std::shared_ptr<tile_prefetcher_t> instance;
+  std::lock_guard<std::mutex> lock(instance_mutex);
+  if (!instance) {
+    instance.reset(new tile_prefetcher_t(pt));
+  }
+  return instance;
+}
+
+tile_prefetcher_t::tile_prefetcher_t(const boost::property_tree::ptree& pt)
+    : cache_(TileCacheFactory::createTileCache(pt)),
+      max_queue_size_(pt.get<size_t>("prefetch_queue_size", DEFAULT_PREFETCH_QUEUE_SIZE)),
+      stats_interval_(pt.get<uint32_t>("prefetch_stats_interval", DEFAULT_PREFETCH_STATS_INTERVAL)),
+      done_(false), requested_(0), dropped_(0), loaded_(0), redundant_(0), hits_(0), late_(0),
+      misses_(0), evicted_(0), missing_(0) {
+  index_offsets_[0] = 0;
+  index_offsets_[1] = index_offsets_[0] + TileHierarchy::levels()[0].tiles.TileCount();
+  index_offsets_[2] = index_offsets_[1] + TileHierarchy::levels()[1].tiles.TileCount();
+  index_offsets_[3] = index_offsets_[2] + TileHierarchy::levels()[2].tiles.TileCount();
+  states_ = std::vector<std::atomic<uint8_t>>(index_offsets_[3] +
+                                              TileHierarchy::GetTransitLevel().tiles.TileCount());
+  for (auto& state : states_) {
+    state.store(kIdle, std::memory_order_relaxed);
+  }
+
+  // the readers of the background threads must not prefetch themselves
+  auto worker_pt = pt;
+  worker_pt.put("prefetch_threads", 0);
+  worker_pt.put("shortcut_caching", false);
+  auto thread_count = pt.get<size_t>("prefetch_threads");
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back(&tile_prefetcher_t::work, this, worker_pt,
+                          i == 0 && stats_interval_.count() > 0);
+  }
+  LOG_INFO("Prefetching tiles with " + std::to_string(thread_count) + " threads");
+}
+
+tile_prefetcher_t::~tile_prefetcher_t() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+  }
+  signal_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void tile_prefetcher_t::prefetch(const GraphId& tile_id) {
+  // skip invalid tiles, tiles someone already asked for and tiles we already have
+  auto offset = get_offset(tile_id);
+  if (offset >= states_.size() || states_[offset].load(std::memory_order_relaxed) != kIdle ||
+      cache_->Contains(tile_id)) {
+    return;
+  }
+  uint8_t expected = kIdle;
+  if (!states_[offset].compare_exchange_strong(expected, kQueued)) {
+    return;
+  }
+
+  // queue it unless we are too far behind already
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.size() < max_queue_size_) {
+      queue_.push_back(tile_id.Tile_Base());
+      ++requested_;
+    } else {
+      states_[offset].store(kIdle);
+      ++dropped_;
+      return;
+    }
+  }
+  signal_.notify_one();
+}
+
+void tile_prefetcher_t::prefetch_neighbors(const GraphId& tile_id) {
+  if (tile_id.level() > TileHierarchy::get_max_level()) {
+    return;
+  }
+  const auto& tiles = tile_id.level() == TileHierarchy::GetTransitLevel().level
+                          ? TileHierarchy::GetTransitLevel().tiles
+                          : TileHierarchy::levels()[tile_id.level()].tiles;
+  int32_t id = tile_id.tileid();
+  int32_t top = tiles.TopNeighbor(id), bottom = tiles.BottomNeighbor(id);
+  for (int32_t row : {bottom, id, top}) {
+    for (int32_t col : {tiles.LeftNeighbor(row), row, tiles.RightNeighbor(row)}) {
+      if (col != id) {
+        prefetch({static_cast<uint32_t>(col), tile_id.level(), 0});
+      }
+    }
+  }
+}
+
+void tile_prefetcher_t::cache_hit(const GraphId& tile_id) {
+  // only the first use of a prefetched tile is interesting
+  auto offset = get_offset(tile_id);
+  if (offset >= states_.size() || states_[offset].load(std::memory_order_relaxed) != kPrefetched) {
+    return;
+  }
+  uint8_t expected = kPrefetched;
+  if (states_[offset].compare_exchange_strong(expected, kIdle)) {
+    ++hits_;
+    prefetch_neighbors(tile_id);
+  }
+}
+
+void tile_prefetcher_t::cache_miss(const GraphId& tile_id) {
+  auto offset = get_offset(tile_id);
+  uint8_t state = offset < states_.size() ? states_[offset].load() : static_cast<uint8_t>(kIdle);
+  if (state == kMissing) {
+    // there is nothing around a tile that doesn't exist worth asking for again
+    return;
+  }
+  if (state == kQueued) {
+    ++late_;
+  } else if (state == kPrefetched && states_[offset].compare_exchange_strong(state, kIdle)) {
+    // it was evicted before anyone used it, let it be prefetched again
+    ++evicted_;
+  } else {
+    ++misses_;
+  }
+  prefetch_neighbors(tile_id);
+}
+
+tile_prefetcher_t::stats_t tile_prefetcher_t::stats() const {
+  return stats_t{requested_.load(), dropped_.load(), loaded_.load(),  redundant_.load(),
+                 hits_.load(),      late_.load(),    misses_.load(),  evicted_.load(),
+                 missing_.load()};
+}
+
+void tile_prefetcher_t::log_stats() const {
+  const auto s = stats();
+  LOG_INFO("Tile prefetching: " + std::to_string(s.requested) + " requested, " +
+           std::to_string(s.dropped) + " dropped, " + std::to_string(s.loaded) + " loaded, " +
+           std::to_string(s.redundant) + " redundant, " + std::to_string(s.hits) + " hits, " +
+           std::to_string(s.late) + " late, " + std::to_string(s.misses) + " misses, " +
+           std::to_string(s.evicted) + " evicted, " + std::to_string(s.missing) + " missing");
+}
+
+void tile_prefetcher_t::work(boost::property_tree::ptree pt, const bool report) {
+  // our own reader, with the concurrent cache configured it fills the cache the searches use
+  GraphReader reader(pt);
+  auto next_report = std::chrono::steady_clock::now() + stats_interval_;
+  uint64_t reported = 0;
+
+  while (true) {
+    // wait for something to do
+    GraphId tile_id;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      const auto ready = [this]() { return done_ || !queue_.empty(); };
+      if (report) {
+        signal_.wait_until(lock, next_report, ready);
+      } else {
+        signal_.wait(lock, ready);
+      }
+      if (done_) {
+        return;
+      }
+      if (!queue_.empty()) {
+        tile_id = queue_.front();
+        queue_.pop_front();
+      }
+    }
+
+    // every so often say how it goes, unless the searches did not ask for anything since
+    if (report && std::chrono::steady_clock::now() >= next_report) {
+      next_report = std::chrono::steady_clock::now() + stats_interval_;
+      const auto activity = requested_.load() + hits_.load() + late_.load() + misses_.load();
+      if (activity != reported) {
+        reported = activity;
+        log_stats();
+      }
+    }
+    if (!tile_id.Is_Valid()) {
+      continue;
+    }
+
+    // the search may have beaten us to it
+    auto& state = states_[get_offset(tile_id)];
+    if (cache_->Contains(tile_id)) {
+      ++redundant_;
+      state.store(kIdle);
+      continue;
+    }
+
+    // load it into the cache, a failure here will just come up again in the search
+    graph_tile_ptr tile;
+    try {
+      tile = reader.GetGraphTile(tile_id);
+    } catch (const std::exception& e) {
+      LOG_WARN("Failed to prefetch tile " + std::to_string(tile_id) + ": " + e.what());
+      state.store(kIdle);
+      continue;
+    }
+    if (tile) {
+      ++loaded_;
+      state.store(kPrefetched);
+    } else {
+      // its not in the tileset so dont keep asking for it
+      ++missing_;
+      state.store(kMissing);
+    }
+  }
+}
+
+} // namespace baldr
+} // namespace valhalla
@@ -236,8 +236,10 @@ struct bin_handler_t {
   std::vector<projector_wrapper> pps;
   valhalla::baldr::GraphReader& reader;
   std::shared_ptr<DynamicCost> costing;
+  std::shared_ptr<const SpatialIndex> spatial_index;
   unsigned int max_reach_limit;
   std::vector<candidate_t> bin_candidates;
+  projector_batch_t projections;
   std::unordered_set<uint64_t> correlated_edges;
   Reach reach_finder;
 
@@ -247,8 +249,9 @@ struct bin_handler_t {
 
   bin_handler_t(const std::vector<valhalla::baldr::Location>& locations,
                 valhalla::baldr::GraphReader& reader,
-                const std::shared_ptr<DynamicCost>& costing)
-      : reader(reader), costing(costing) {
+                const std::shared_ptr<DynamicCost>& costing,
+                const std::shared_ptr<const SpatialIndex>& spatial_index)
+      : reader(reader), costing(costing), spatial_index(spatial_index) {
     // get the unique set of input locations and the max reachability of them all
     std::unordered_set<Location> uniq_locations(locations.begin(), locations.end());
     pps.reserve(uniq_locations.size());
@@ -477,13 +480,62 @@ struct bin_handler_t {
     return reach;
   }
 
+  // whether an edge whose shape is inside of the box can be skipped without looking at its shape.
+  // that is the case when every location already has a reachable candidate and the edge cannot be
+  // closer than that one, within the radius or closer than the closest reachable candidate outside
+  // of the radius. the edge also has to be assumed or known to be reachable so that looking at it
+  // would not have remembered anything about it either
+  bool out_of_reach(std::vector<projector_wrapper>::iterator begin,
+                    std::vector<projector_wrapper>::iterator end,
+                    const SpatialIndex::box_t& box,
+                    const DirectedEdge* edge) const {
+    const directed_reach* reach = nullptr;
+    if (max_reach_limit != 0) {
+      auto found = directed_reaches.find(edge);
+      if (found != directed_reaches.cend())
+        reach = &found->second;
+    }
+
+    auto c_itr = bin_candidates.begin();
+    for (auto p_itr = begin; p_itr != end; ++p_itr, ++c_itr) {
+      if (p_itr->reachable.empty())
+        return false;
+      if (c_itr->prefiltered)
+        continue;
+      if (reach && (reach->outbound < p_itr->location.min_outbound_reach_ ||
+                    reach->inbound < p_itr->location.min_inbound_reach_))
+        return false;
+      // the closest point of the box can't be further than the closest point of the shape
+      PointLL closest(std::min(std::max(p_itr->project.lng, double(box.min_lng)),
+                               double(box.max_lng)),
+                      std::min(std::max(p_itr->project.lat, double(box.min_lat)),
+                               double(box.max_lat)));
+      auto sq_distance = p_itr->project.approx.DistanceSquared(closest);
+      if (sq_distance < p_itr->sq_radius || sq_distance < p_itr->reachable.back().sq_distance ||
+          sq_distance < p_itr->closest_external_reachable)
+        return false;
+    }
+    return true;
+  }
+
   // handle a bin for the range of candidates that share it
   void handle_bin(std::vector<projector_wrapper>::iterator begin,
                   std::vector<projector_wrapper>::iterator end) {
     // iterate over the edges in the bin
     auto tile = begin->cur_tile;
     auto edges = tile->GetBin(begin->bin_index);
+    // along with their boxes if the tile is indexed
+    const auto* boxes = spatial_index ? spatial_index->boxes(*tile) : nullptr;
+    if (boxes) {
+      boxes += tile->header()->bin_offset(begin->bin_index).first;
+    }
+    // the locations that share the bin project each segment together
+    projections.clear();
+    for (auto p_itr = begin; p_itr != end; ++p_itr) {
+      projections.add(p_itr->project);
+    }
     for (auto edge_id : edges) {
+      const auto* box = boxes ? boxes++ : nullptr;
       // get the tile and edge
       if (!reader.GetGraphTile(edge_id, tile)) {
         continue;
@@ -509,12 +561,13 @@ struct bin_handler_t {
         c_itr->sq_distance = std::numeric_limits<double>::max();
         c_itr->prefiltered =
             is_search_filter_triggered(edge, *costing, tile, p_itr->location.search_filter_);
+        projections.reset(c_itr - bin_candidates.begin(), c_itr->prefiltered);
         // set to false if even one candidate was not filtered
         all_prefiltered = all_prefiltered && c_itr->prefiltered;
       }
 
-      // short-circuit if all candidates were prefiltered
-      if (all_prefiltered) {
+      // short-circuit if all candidates were prefiltered or the edge is too far away to matter
+      if (all_prefiltered || (box && out_of_reach(begin, end, *box, edge))) {
         continue;
       }
 
@@ -538,22 +591,16 @@ struct bin_handler_t {
       for (size_t i = 0; !shape.empty(); ++i) {
         auto u = v;
         v = shape.pop();
-        // for each input point
-        c_itr = bin_candidates.begin();
-        for (p_itr = begin; p_itr != end; ++p_itr, ++c_itr) {
-          // skip updating this candidate because it was prefiltered
-          if (c_itr->prefiltered) {
-            continue;
-          }
-          // how close is the input to this segment
-          auto point = p_itr->project(u, v);
-          auto sq_distance = p_itr->project.approx.DistanceSquared(point);
-          // do we want to keep it
-          if (sq_distance < c_itr->sq_distance) {
-            c_itr->sq_distance = sq_distance;
-            c_itr->point = std::move(point);
-            c_itr->index = i;
-          }
+        projections(u, v, i);
+      }
+
+      // keep how close each input is to the edge, the prefiltered ones were never projected
+      c_itr = bin_candidates.begin();
+      for (size_t j = 0; j < projections.size(); ++j, ++c_itr) {
+        if (!c_itr->prefiltered && projections.sq_distance(j) < c_itr->sq_distance) {
+          c_itr->sq_distance = projections.sq_distance(j);
+          c_itr->point = projections.closest(j);
+          c_itr->index = projections.closest_index(j);
         }
       }
 
@@ -784,7 +831,8 @@ namespace loki {
 std::unordered_map<valhalla::baldr::Location, PathLocation>
 Search(const std::vector<valhalla::baldr::Location>& locations,
        GraphReader& reader,
-       const std::shared_ptr<DynamicCost>& costing) {
+       const std::shared_ptr<DynamicCost>& costing,
+       const std::shared_ptr<const SpatialIndex>& spatial_index) {
   // we cannot continue without costing
   if (!costing)
     throw std::runtime_error("No costing was provided for edge candidate search");
@@ -793,8 +841,14 @@ Search(const std::vector<valhalla::baldr::Location>& locations,
   if (locations.empty())
     return std::unordered_map<valhalla::baldr::Location, PathLocation>{};
 
+  // the routes from these locations will need the tiles under them at every level so if we are
+  // prefetching get them loading while we search
+  for (const auto& location : locations) {
+    reader.Prefetch(location.latlng_);
+  }
+
   // setup the unique list of locations
-  bin_handler_t handler(locations, reader, costing);
+  bin_handler_t handler(locations, reader, costing, spatial_index);
   // search over the bins doing multiple locations per bin
   handler.search();
   // turn each locations candidate set into path locations
@@ -119,6 +119,10 @@ namespace loki {
 
 void loki_worker_t::init_trace(Api& request) {
   parse_costing(request);
+  init_trace_shape(request);
+}
+
+void loki_worker_t::init_trace_shape(Api& request) {
   auto& options = *request.mutable_options();
 
   // we require shape or encoded polyline but we dont know which at first
@@ -170,6 +174,75 @@ void loki_worker_t::trace(Api& request) {
   };
 }
 
+void loki_worker_t::trace_batch(Api& request) {
+  // time this whole method and save that statistic
+  auto _ = measure_scope_time(request, "loki_worker_t::trace_batch");
+
+  parse_costing(request);
+  auto& options = *request.mutable_options();
+  if (options.costing() == Costing::multimodal) {
+    throw valhalla_exception_t{140, Options_Action_Enum_Name(options.action())};
+  }
+  if (!options.traces_size()) {
+    throw valhalla_exception_t{115};
+  }
+  if (static_cast<size_t>(options.traces_size()) > max_traces) {
+    throw valhalla_exception_t{167, " (" + std::to_string(options.traces_size()) +
+                                        "). The limit is " + std::to_string(max_traces)};
+  }
+
+  // Each trace is validated on its own so that a bad one only fails itself and not the batch
+  options.clear_locations();
+  for (auto& trace : *options.mutable_traces()) {
+    options.mutable_shape()->Swap(trace.mutable_shape());
+    try {
+      init_trace_shape(request);
+      trace.mutable_locations()->Swap(options.mutable_locations());
+    } catch (const valhalla_exception_t& e) {
+      trace.set_error_code(e.code);
+      if (e.extra) {
+        trace.set_error_detail(*e.extra);
+      }
+    }
+    options.mutable_shape()->Swap(trace.mutable_shape());
+    options.clear_locations();
+  }
+}
+
+void loki_worker_t::online_match(Api& request) {
+  // time this whole method and save that statistic
+  auto _ = measure_scope_time(request, "loki_worker_t::online_match");
+
+  // A session keeps the costing it was started with
+  auto& options = *request.mutable_options();
+  if (!options.has_session_id()) {
+    parse_costing(request);
+    if (options.costing() == Costing::multimodal) {
+      throw valhalla_exception_t{140, Options_Action_Enum_Name(options.action())};
+    }
+  }
+
+  // Points come a few at a time so there is no minimum, but there has to be something to do
+  if (!options.shape_size() && !options.finish()) {
+    throw valhalla_exception_t{114};
+  }
+  if (static_cast<size_t>(options.shape_size()) > max_trace_shape) {
+    throw valhalla_exception_t{153, "(" + std::to_string(options.shape_size()) +
+                                        "). The limit is " + std::to_string(max_trace_shape)};
+  }
+
+  // Validate optional trace options
+  if (options.has_gps_accuracy()) {
+    check_gps_accuracy(options.gps_accuracy(), max_gps_accuracy);
+  }
+  if (options.has_search_radius()) {
+    check_search_radius(options.search_radius(), max_search_radius);
+  }
+  if (options.has_turn_penalty_factor()) {
+    check_turn_penalty_factor(options.turn_penalty_factor());
+  }
+}
+
 void loki_worker_t::locations_from_shape(Api& request) {
   auto& options = *request.mutable_options();
   std::vector<baldr::Location> locations{PathLocation::fromPBF(*options.shape().begin()),
@@ -193,7 +266,7 @@ void loki_worker_t::locations_from_shape(Api& request) {
 
     // Project first and last shape point onto nearest edge(s). Clear current locations list
     // and set the path locations
-    auto projections = loki::Search(locations, *reader, costing);
+    auto projections = loki::Search(locations, *reader, costing, spatial_index);
     options.clear_locations();
     PathLocation::toPBF(projections.at(locations.front()), options.mutable_locations()->Add(),
                         *reader);
@@ -1,6 +1,7 @@
 #include <boost/property_tree/ptree.hpp>
 #include <cstdint>
 #include <functional>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -9,6 +10,7 @@
 
 #include "baldr/json.h"
 #include "baldr/rapidjson_utils.h"
+#include "filesystem.h"
 #include "midgard/logging.h"
 #include "sif/autocost.h"
 #include "sif/bicyclecost.h"
@@ -27,6 +29,28 @@ using namespace valhalla::baldr;
 using namespace valhalla::sif;
 using namespace valhalla::loki;
 
+namespace {
+
+// Maps the spatial index, sharing it with the other workers of the process. An index that was not
+// built from the tiles of the reader is not used at all
+std::shared_ptr<const SpatialIndex> load_spatial_index(const std::string& file_name,
+                                                       GraphReader& reader) {
+  static std::mutex indices_mutex;
+  static std::unordered_map<std::string, std::shared_ptr<const SpatialIndex>> indices;
+  std::lock_guard<std::mutex> lock(indices_mutex);
+  auto& index = indices[file_name];
+  if (!index) {
+    index = SpatialIndex::Load(file_name);
+  }
+  if (!index->Matches(reader)) {
+    LOG_WARN("Not using the spatial index " + file_name + ", it was built from other tiles");
+    return nullptr;
+  }
+  return index;
+}
+
+} // namespace
+
 namespace valhalla {
 namespace loki {
 void loki_worker_t::parse_locations(google::protobuf::RepeatedPtrField<valhalla::Location>* locations,
@@ -92,7 +116,7 @@ void loki_worker_t::parse_costing(Api& api, bool allow_none) {
   if (options.avoid_locations_size()) {
     try {
       auto avoid_locations = PathLocation::fromPBF(options.avoid_locations());
-      auto results = loki::Search(avoid_locations, *reader, costing);
+      auto results = loki::Search(avoid_locations, *reader, costing, spatial_index);
       std::unordered_set<uint64_t> avoids;
       auto* co = options.mutable_costing_options(static_cast<uint8_t>(costing->travel_mode()));
       for (const auto& result : results) {
@@ -145,7 +169,9 @@ loki_worker_t::loki_worker_t(const boost::property_tree::ptree& config,
       max_contour_min(config.get<size_t>("service_limits.isochrone.max_time_contour")),
       max_contour_km(config.get<size_t>("service_limits.isochrone.max_distance_contour")),
       max_trace_shape(config.get<size_t>("service_limits.trace.max_shape")),
-      sample(config.get<std::string>("additional_data.elevation", "")),
+      sample(config.get<std::string>("additional_data.elevation", ""),
+             config.get<size_t>("additional_data.elevation_cache_size",
+                                skadi::kDefaultElevationCacheSize)),
       max_elevation_shape(config.get<size_t>("service_limits.skadi.max_shape")),
       min_resample(config.get<float>("service_limits.skadi.min_resample")) {
   // If we weren't provided with a graph reader make our own
@@ -227,7 +253,14 @@ loki_worker_t::loki_worker_t(const boost::property_tree::ptree& config,
   max_search_radius = config.get<float>("service_limits.trace.max_search_radius");
   max_best_paths = config.get<unsigned int>("service_limits.trace.max_best_paths");
   max_best_paths_shape = config.get<size_t>("service_limits.trace.max_best_paths_shape");
+  max_traces = config.get<size_t>("service_limits.trace.max_traces", kDefaultMaxTraces);
   max_alternates = config.get<unsigned int>("service_limits.max_alternates");
+
+  // Use the boxes of the edges to speed up searching for locations if they were built
+  auto spatial_index_file = config.get<std::string>("mjolnir.spatial_index_file", "");
+  if (!spatial_index_file.empty() && filesystem::exists(spatial_index_file)) {
+    spatial_index = load_spatial_index(spatial_index_file, *reader);
+  }
 }
 
 void loki_worker_t::cleanup() {
@@ -297,6 +330,14 @@ loki_worker_t::work(const std::list<zmq::message_t>& job,
         trace(request);
         result.messages.emplace_back(request.SerializeAsString());
         break;
+      case Options::trace_attributes_batch:
+        trace_batch(request);
+        result.messages.emplace_back(request.SerializeAsString());
+        break;
+      case Options::online_match:
+        online_match(request);
+        result.messages.emplace_back(request.SerializeAsString());
+        break;
       case Options::height:
         result = to_response(height(request), info, request);
         break;
@@ -162,23 +162,48 @@ void IndexBin(const graph_tile_ptr& tile,
   }
 }
 
+std::shared_ptr<const CandidateGridCache::grid_t>
+CandidateGridCache::Find(const int32_t bin_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = grids_.find(bin_id);
+  return it == grids_.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<const CandidateGridCache::grid_t>
+CandidateGridCache::Insert(const int32_t bin_id, std::shared_ptr<const grid_t> grid) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return grids_.emplace(bin_id, std::move(grid)).first->second;
+}
+
+size_t CandidateGridCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return grids_.size();
+}
+
+void CandidateGridCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  grids_.clear();
+}
+
 CandidateGridQuery::CandidateGridQuery(baldr::GraphReader& reader,
                                        float cell_width,
-                                       float cell_height)
-    : reader_(reader), cell_width_(cell_width), cell_height_(cell_height), grid_cache_() {
+                                       float cell_height,
+                                       const std::shared_ptr<CandidateGridCache>& grid_cache)
+    : reader_(reader), cell_width_(cell_width), cell_height_(cell_height),
+      grid_cache_(grid_cache ? grid_cache : std::make_shared<CandidateGridCache>()) {
   bin_level_ = baldr::TileHierarchy::levels().back().level;
 }
 
 CandidateGridQuery::~CandidateGridQuery() = default;
 
-inline const CandidateGridQuery::grid_t*
+inline std::shared_ptr<const CandidateGridQuery::grid_t>
 CandidateGridQuery::GetGrid(const int32_t bin_id,
                             const Tiles<PointLL>& tiles,
                             const Tiles<PointLL>& bins) const {
   // Check if the bin is in the cache
-  const auto it = grid_cache_.find(bin_id);
-  if (it != grid_cache_.end()) {
-    return &(it->second);
+  auto grid = grid_cache_->Find(bin_id);
+  if (grid) {
+    return grid;
   }
 
   // Not in the cache. Get the tile and Index the bin within the tile.
@@ -196,11 +221,10 @@ CandidateGridQuery::GetGrid(const int32_t bin_id,
   int32_t bin_col = rc.second % ndiv;
   int32_t bin_index = (bin_row * ndiv) + bin_col;
 
-  // Insert the bin into the cache and index the bin
-  const auto inserted =
-      grid_cache_.emplace(bin_id, grid_t(tile->BoundingBox(), cell_width_, cell_height_));
-  IndexBin(tile, bin_index, reader_, inserted.first->second);
-  return &(inserted.first->second);
+  // Index the bin outside of the cache so other threads are not held up and insert it
+  auto indexed = std::make_shared<grid_t>(tile->BoundingBox(), cell_width_, cell_height_);
+  IndexBin(tile, bin_index, reader_, *indexed);
+  return grid_cache_->Insert(bin_id, std::move(indexed));
 }
 
 std::unordered_set<baldr::GraphId>
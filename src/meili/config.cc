@@ -102,6 +102,10 @@ void Config::Routing::Read(const boost::property_tree::ptree& params) {
   ReadParamOptional(interpolation_distance_meters, params, "default.interpolation_distance");
   CHECK_THROWS(interpolation_distance_meters > 0.f,
                POSITIVE_VALUE_MSG(interpolation_distance_meters, "interpolation_distance"));
+  ReadParamOptional(max_online_lag, params, "default.max_online_lag");
+  CHECK_THROWS(max_online_lag > 1,
+               std::string("Expect 'max_online_lag' to be greater than 1 (got: ") +
+                   std::to_string(max_online_lag) + ")");
 
   if (const auto node = params.get_child_optional("customizable")) {
     is_interpolation_distance_customizable = FindValue(*node, "interpolation_distance");
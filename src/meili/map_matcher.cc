@@ -506,7 +506,8 @@ MapMatcher::MapMatcher(const Config& config,
                              container_,
                              mode_costing_,
                              travelmode_,
-                             config_.transition_cost) {
+                             config_.transition_cost),
+      online_interpolated_(), online_anchored_(false) {
   vs_.set_emission_cost_model(emission_cost_model_);
   vs_.set_transition_cost_model(transition_cost_model_);
 }
@@ -516,11 +517,14 @@ MapMatcher::~MapMatcher() {
 
 void MapMatcher::Clear() {
   vs_.Clear();
+  transition_cost_model_.Clear();
   // reset cost models because they were possibly replaced by topk
   vs_.set_emission_cost_model(emission_cost_model_);
   vs_.set_transition_cost_model(transition_cost_model_);
   ts_.Clear();
   container_.Clear();
+  online_interpolated_.clear();
+  online_anchored_ = false;
 }
 
 void MapMatcher::RemoveRedundancies(const std::vector<StateId>& result,
@@ -824,6 +828,183 @@ std::vector<MatchResults> MapMatcher::OfflineMatch(const std::vector<Measurement
   return best_paths;
 }
 
+MatchResults MapMatcher::OnlineMatch(const Measurement& measurement) {
+  const float sq_max_search_radius = config_.candidate_search.max_search_radius_meters *
+                                     config_.candidate_search.max_search_radius_meters;
+  const float sq_interpolation_distance =
+      config_.routing.interpolation_distance_meters * config_.routing.interpolation_distance_meters;
+
+  // Always match the first measurement
+  if (container_.size() == 0) {
+    AppendMeasurement(measurement, sq_max_search_radius);
+    return MatchResults(std::vector<MatchResult>{}, std::vector<EdgeSegment>{}, 0);
+  }
+
+  // Interpolate it if its close to the last match point, just like offline
+  auto time = container_.size() - 1;
+  const auto& last = container_.measurement(time);
+  if (GreatCircleDistanceSquared(last, measurement) <= sq_interpolation_distance) {
+    online_interpolated_[time].push_back(measurement);
+    return MatchResults(std::vector<MatchResult>{}, std::vector<EdgeSegment>{}, 0);
+  }
+
+  // If the trace lingered at the last match point use the time it left as AppendMeasurements does
+  const auto interpolated = online_interpolated_.find(time);
+  if (interpolated != online_interpolated_.cend() &&
+      interpolated->second.back().epoch_time() != -1) {
+    auto p = interpolated->second.back().lnglat().Project(last.lnglat(), measurement.lnglat());
+    if (p.Distance(last.lnglat()) / last.lnglat().Distance(measurement.lnglat()) < .2f) {
+      container_.SetMeasurementLeaveTime(time, interpolated->second.back().epoch_time());
+    }
+  }
+  time = AppendMeasurement(measurement, sq_max_search_radius);
+
+  // Commit to whatever the best paths to all the states of the new column agree on
+  vs_.SearchWinner(time);
+  const auto converged = vs_.ConvergedState();
+  if (converged.IsValid() && (converged.time() > 0 || !online_anchored_)) {
+    return CommitOnline(converged.time(), converged, false);
+  }
+
+  // If they don't agree for too long we commit to the best path so far for half of the window
+  if (time < config_.routing.max_online_lag) {
+    return MatchResults(std::vector<MatchResult>{}, std::vector<EdgeSegment>{}, 0);
+  }
+  const auto commit_time = time - config_.routing.max_online_lag / 2;
+  auto stateid = vs_.SearchPathVS(time, true);
+  for (auto t = time; t > commit_time; --t) {
+    ++stateid;
+  }
+  return CommitOnline(commit_time, *stateid, false);
+}
+
+MatchResults MapMatcher::FinishOnlineMatch() {
+  // Nothing to do
+  if (container_.size() == 0) {
+    Clear();
+    return MatchResults(std::vector<MatchResult>{}, std::vector<EdgeSegment>{}, 0);
+  }
+
+  // Always match the last measurement
+  auto time = container_.size() - 1;
+  const auto interpolated = online_interpolated_.find(time);
+  if (interpolated != online_interpolated_.end()) {
+    const auto last = interpolated->second.back();
+    interpolated->second.pop_back();
+    if (interpolated->second.empty()) {
+      online_interpolated_.erase(interpolated);
+    }
+    const float sq_max_search_radius = config_.candidate_search.max_search_radius_meters *
+                                       config_.candidate_search.max_search_radius_meters;
+    time = AppendMeasurement(last, sq_max_search_radius);
+  }
+
+  // Take the rest of the best path, discontinuities and all
+  auto results = CommitOnline(time, vs_.SearchWinner(time), true);
+  Clear();
+  return results;
+}
+
+MatchResults MapMatcher::CommitOnline(StateId::Time time, const StateId& stateid, bool finish) {
+  // Get the states of the path up to the one we commit to, we jump to the best state of the
+  // previous column wherever it breaks like the path of OfflineMatch does
+  std::vector<StateId> stateids(time + 1);
+  stateids[time] = stateid;
+  for (auto t = time; t > 0; --t) {
+    auto predecessor = stateids[t].IsValid() ? vs_.Predecessor(stateids[t]) : StateId();
+    stateids[t - 1] = predecessor.IsValid() ? predecessor : vs_.SearchWinner(t - 1);
+  }
+
+  // Look past it along the best path so far so its match knows which way the path goes on
+  const auto last = container_.size() - 1;
+  if (stateid.IsValid() && time < last) {
+    std::vector<StateId> ahead(last - time);
+    auto next = vs_.SearchWinner(last);
+    for (auto t = last; t > time && next.IsValid(); --t) {
+      ahead[t - time - 1] = next;
+      next = vs_.Predecessor(next);
+    }
+    if (next == stateid) {
+      stateids.insert(stateids.end(), ahead.cbegin(), ahead.cend());
+    }
+  }
+  const double accumulated_cost =
+      stateid.IsValid() ? vs_.AccumulatedCost(stateid) : MAX_ACCUMULATED_COST;
+
+  // Get the match result for each of the states and insert the interpolated ones between them
+  auto results = FindMatchResults(*this, stateids, graphreader_);
+  std::vector<MatchResult> path;
+  for (StateId::Time t = 0; t <= time; ++t) {
+    path.emplace_back(results[t]);
+    const auto it = online_interpolated_.find(t);
+    if (it == online_interpolated_.end() || t == time) {
+      continue;
+    }
+    const auto interpolated_results = InterpolateMeasurements(*this, it->second, stateids[t],
+                                                              stateids[t + 1], results[t],
+                                                              results[t + 1]);
+    path.insert(path.cend(), interpolated_results.cbegin(), interpolated_results.cend());
+  }
+  auto segments = ConstructRoute(*this, path);
+
+  // The first state of an anchored window was given back with the previous commit
+  if (online_anchored_) {
+    path.erase(path.begin());
+    for (auto& segment : segments) {
+      segment.first_match_idx = std::max(segment.first_match_idx - 1, -1);
+      segment.last_match_idx = std::max(segment.last_match_idx - 1, -1);
+    }
+  }
+
+  // Without a state to anchor the next window on the points after it can't be interpolated
+  const auto pending = online_interpolated_.find(time);
+  if (pending != online_interpolated_.end() && (finish || !stateid.IsValid())) {
+    for (const auto& measurement : pending->second) {
+      path.emplace_back(CreateMatchResult(measurement));
+    }
+    online_interpolated_.erase(pending);
+  }
+
+  if (!finish) {
+    ReanchorOnline(stateid.IsValid() ? time : time + 1, stateid);
+  }
+  return MatchResults(std::move(path), std::move(segments), accumulated_cost);
+}
+
+void MapMatcher::ReanchorOnline(StateId::Time time, const StateId& anchor) {
+  // Keep what we know about the measurements that are not final yet
+  std::vector<Measurement> measurements;
+  std::vector<double> leave_times;
+  std::vector<std::vector<baldr::PathLocation>> candidates;
+  for (auto t = time; t < container_.size(); ++t) {
+    measurements.push_back(container_.measurement(t));
+    leave_times.push_back(container_.leave_time(t));
+    candidates.emplace_back();
+    if (anchor.IsValid() && t == anchor.time()) {
+      candidates.back().push_back(container_.state(anchor).candidate());
+      continue;
+    }
+    for (const auto& state : container_.column(t)) {
+      candidates.back().push_back(state.candidate());
+    }
+  }
+  std::unordered_map<StateId::Time, std::vector<Measurement>> interpolated;
+  for (auto& kv : online_interpolated_) {
+    if (time <= kv.first) {
+      interpolated.emplace(kv.first - time, std::move(kv.second));
+    }
+  }
+
+  // Start over with a window that begins with the state we committed to
+  Clear();
+  online_interpolated_ = std::move(interpolated);
+  online_anchored_ = anchor.IsValid();
+  for (size_t i = 0; i < measurements.size(); ++i) {
+    const auto t = AppendMeasurement(measurements[i], candidates[i]);
+    container_.SetMeasurementLeaveTime(t, leave_times[i]);
+  }
+}
+
 std::unordered_map<StateId::Time, std::vector<Measurement>>
 MapMatcher::AppendMeasurements(const std::vector<Measurement>& measurements) {
   const float sq_max_search_radius = config_.candidate_search.max_search_radius_meters *
@@ -883,6 +1064,11 @@ StateId::Time MapMatcher::AppendMeasurement(const Measurement& measurement,
   const auto& candidates =
       candidatequery_.Query(measurement.lnglat(), measurement.stop_type(), sq_radius, costing());
 
+  return AppendMeasurement(measurement, candidates);
+}
+
+StateId::Time MapMatcher::AppendMeasurement(const Measurement& measurement,
+                                            const std::vector<baldr::PathLocation>& candidates) {
   const auto time = container_.AppendMeasurement(measurement);
 
   for (const auto& candidate : candidates) {
@@ -48,7 +48,11 @@ MapMatcher* MapMatcherFactory::Create(const Options& options) {
   mode_costing_[static_cast<uint32_t>(mode)] = cost;
 
   // TODO investigate exception safety
-  return new MapMatcher(config, *graphreader_, *candidatequery_, mode_costing_, mode);
+  auto* matcher = new MapMatcher(config, *graphreader_, *candidatequery_, mode_costing_, mode);
+  if (transitioncache_) {
+    matcher->set_transition_cache(transitioncache_, options.costing());
+  }
+  return matcher;
 }
 
 Config MapMatcherFactory::MergeConfig(const Options& options) const {
@@ -77,6 +81,15 @@ Config MapMatcherFactory::MergeConfig(const Options& options) const {
   return config;
 }
 
+void MapMatcherFactory::ShareCaches(const MapMatcherFactory& other) {
+  // The grids are shared but each query indexes the bins it misses with the reader of its factory
+  candidatequery_.reset(
+      new CandidateGridQuery(*graphreader_, local_tile_size() / config_.candidate_search.grid_size,
+                             local_tile_size() / config_.candidate_search.grid_size,
+                             other.candidatequery_->grid_cache()));
+  transitioncache_ = other.transitioncache_;
+}
+
 void MapMatcherFactory::ClearFullCache() {
   if (graphreader_->OverCommitted()) {
     graphreader_->Trim();
@@ -90,6 +103,9 @@ void MapMatcherFactory::ClearFullCache() {
 void MapMatcherFactory::ClearCache() {
   graphreader_->Clear();
   candidatequery_->Clear();
+  if (transitioncache_) {
+    transitioncache_->Clear();
+  }
 }
 
 } // namespace meili
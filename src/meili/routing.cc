@@ -322,7 +322,7 @@ inline uint16_t get_outbound_edge_heading(const graph_tile_ptr& tile,
 // and expand any edges from that node. In this manner, no transition edges
 // get added to the label set.
 //
-// Also uses a heuristic function (lambda) that estimates cost
+// Also uses a heuristic function (ExpansionCache::heuristic) that estimates cost
 // from current node (incorporated in the approximator) to a cluster of
 // destinations within a circle formed by the search radius around the
 // lnglat (the location of next measurement).
@@ -341,16 +341,66 @@ inline uint16_t get_outbound_edge_heading(const graph_tile_ptr& tile,
 // Therefore, the heuristic cost is max(0, distance_to_lnglat -
 // search_radius)
 
+// What the expansion of a node does not owe to the label it is reached
+// with is worked out once and kept in an ExpansionCache, which the
+// searches from all the candidates of a column share
+
+const ExpansionCache::Node& ExpansionCache::node(baldr::GraphReader& reader,
+                                                 const sif::cost_ptr_t& costing,
+                                                 const baldr::GraphId& nodeid) {
+  const auto found = nodes_.find(nodeid);
+  if (found != nodes_.end()) {
+    return found->second;
+  }
+
+  // Get the node's info, it is not expanded if it is not found or not allowed by costing
+  auto& node = nodes_[nodeid];
+  node.tile = reader.GetGraphTile(nodeid);
+  node.nodeinfo = node.tile ? node.tile->node(nodeid) : nullptr;
+  node.allowed = node.nodeinfo && costing->Allowed(node.nodeinfo);
+  if (!node.allowed) {
+    return node;
+  }
+
+  const auto& tile = node.tile;
+  const auto* nodeinfo = node.nodeinfo;
+  baldr::GraphId edgeid = {nodeid.tileid(), nodeid.level(), nodeinfo->edge_index()};
+  const baldr::DirectedEdge* directededge = tile->directededge(edgeid);
+  node.edges.reserve(nodeinfo->edge_count());
+  for (uint32_t i = 0; i < nodeinfo->edge_count(); ++i, ++directededge, ++edgeid) {
+    // Skip it if its a shortcut or transit connection
+    if (directededge->is_shortcut() || directededge->use() == baldr::Use::kTransitConnection) {
+      continue;
+    }
+
+    // Get the end node tile to compute the heuristic
+    graph_tile_ptr endtile =
+        directededge->leaves_tile() ? reader.GetGraphTile(directededge->endnode()) : tile;
+    const float end_heuristic =
+        endtile ? heuristic(endtile->get_node_ll(directededge->endnode())) : 0.f;
+    node.edges.push_back({edgeid, directededge,
+                          get_outbound_edge_heading(tile, directededge, nodeinfo),
+                          costing->EdgeCost(directededge, tile).secs, endtile != nullptr,
+                          end_heuristic});
+  }
+
+  const baldr::NodeTransition* trans = tile->transition(nodeinfo->transition_index());
+  for (uint32_t i = 0; i < nodeinfo->transition_count(); ++i, ++trans) {
+    node.transitions.push_back(trans->endnode());
+  }
+  return node;
+}
+
 /**
- * Find the shortest path(s) from an origin to set of destinations.
+ * Find the shortest path(s) from an origin to set of destinations, expanding the nodes through
+ * the cache.
  */
 std::unordered_map<uint16_t, uint32_t>
 find_shortest_path(baldr::GraphReader& reader,
                    const std::vector<baldr::PathLocation>& destinations,
                    uint16_t origin_idx,
                    labelset_ptr_t labelset,
-                   const midgard::DistanceApproximator<midgard::PointLL>& approximator,
-                   const float search_radius,
+                   ExpansionCache& cache,
                    sif::cost_ptr_t costing,
                    const Label* edgelabel,
                    const float turn_cost_table[181],
@@ -365,43 +415,27 @@ find_shortest_path(baldr::GraphReader& reader,
   // Destinations at nodes
   std::unordered_map<baldr::GraphId, std::unordered_set<uint16_t>> node_dests;
 
-  // Lambda for heuristic
-  float search_rad2 = search_radius * search_radius;
-  const auto heuristic = [&approximator, &search_radius,
-                          &search_rad2](const midgard::PointLL& lnglat) {
-    float d2 = approximator.DistanceSquared(lnglat);
-    return (d2 < search_rad2) ? 0.0f : sqrtf(d2) - search_radius;
-  };
-
   // Lambda method to expand along edges from this node. This method has to
   // be set-up to be called recursively (for transition edges) so we set up
   // a function reference.
   std::function<void(const baldr::GraphId&, const uint32_t, const bool)> expand;
   expand = [&](const baldr::GraphId& node, const uint32_t label_idx, const bool from_transition) {
-    // Get the node's info. The tile will be guaranteed to be nodeid's tile
-    // in this block. Return if node is not found or is not allowed by
-    // costing
-    graph_tile_ptr tile = reader.GetGraphTile(node);
-    if (tile == nullptr) {
-      return;
-    }
-    const baldr::NodeInfo* nodeinfo = tile->node(node);
-    if (!costing->Allowed(nodeinfo)) {
+    // Return if node is not found or is not allowed by costing
+    const auto& expansion = cache.node(reader, costing, node);
+    if (!expansion.allowed) {
       return;
     }
+    const auto& tile = expansion.tile;
 
     // Get the inbound edge heading (clamped to range [0,360])
-    const auto inbound_hdg =
-        label.edgeid().Is_Valid() ? get_inbound_edgelabel_heading(reader, label, nodeinfo) : 0;
+    const auto inbound_hdg = label.edgeid().Is_Valid()
+                                 ? get_inbound_edgelabel_heading(reader, label, expansion.nodeinfo)
+                                 : 0;
 
     // Expand from end node in forward direction.
-    baldr::GraphId edgeid = {node.tileid(), node.level(), nodeinfo->edge_index()};
-    const baldr::DirectedEdge* directededge = tile->directededge(edgeid);
-    for (uint32_t i = 0; i < nodeinfo->edge_count(); ++i, ++directededge, ++edgeid) {
-      // Skip it if its a shortcut or transit connection
-      if (directededge->is_shortcut() || directededge->use() == baldr::Use::kTransitConnection) {
-        continue;
-      }
+    for (const auto& edge : expansion.edges) {
+      const auto& edgeid = edge.edgeid;
+      const baldr::DirectedEdge* directededge = edge.directededge;
 
       // Skip it if its not allowed
       uint8_t restriction_idx = -1;
@@ -409,12 +443,11 @@ find_shortest_path(baldr::GraphReader& reader,
         continue;
       }
 
-      // Get outbound heading (clamped to range [0,360]) and add to turn
-      // cost based on turn degree
+      // Add to turn cost based on turn degree
       float turn_cost = label.turn_cost();
       if (label.edgeid().Is_Valid()) {
-        const auto outbound_hdg = get_outbound_edge_heading(tile, directededge, nodeinfo);
-        turn_cost += turn_cost_table[midgard::get_turn_degree180(inbound_hdg, outbound_hdg)];
+        turn_cost +=
+            turn_cost_table[midgard::get_turn_degree180(inbound_hdg, edge.outbound_heading)];
       }
 
       // If destinations found along the edge, add segments to each
@@ -422,37 +455,33 @@ find_shortest_path(baldr::GraphReader& reader,
       const auto it = edge_dests.find(edgeid);
       if (it != edge_dests.end()) {
         for (const auto dest : it->second) {
-          for (const auto& edge : destinations[dest].edges) {
-            if (edge.id == edgeid) {
+          for (const auto& dest_edge : destinations[dest].edges) {
+            if (dest_edge.id == edgeid) {
               // Get cost - use EdgeCost to get time along the edge.
               // Override cost portion to be distance. Heuristic cost from a
               // destination to itself must be 0, so sortcost = cost
-              sif::Cost cost(label.cost().cost + directededge->length() * edge.percent_along,
-                             label.cost().secs +
-                                 costing->EdgeCost(directededge, tile).secs * edge.percent_along);
+              sif::Cost cost(label.cost().cost + directededge->length() * dest_edge.percent_along,
+                             label.cost().secs + edge.secs * dest_edge.percent_along);
               // We only add the labels if we are under the limits for
               // distance and for time or time limit is 0
               if (cost.cost < max_dist && (max_time < 0 || cost.secs < max_time)) {
-                labelset->put(dest, edgeid, 0.f, edge.percent_along, cost, turn_cost, cost.cost,
-                              label_idx, directededge, travelmode, restriction_idx);
+                labelset->put(dest, edgeid, 0.f, dest_edge.percent_along, cost, turn_cost,
+                              cost.cost, label_idx, directededge, travelmode, restriction_idx);
               }
             }
           }
         }
       }
 
-      // Get the end node tile and nodeinfo (to compute heuristic)
-      graph_tile_ptr endtile =
-          directededge->leaves_tile() ? reader.GetGraphTile(directededge->endnode()) : tile;
-      if (endtile != nullptr) {
+      // Only go on to the end node if its tile could be loaded
+      if (edge.reachable) {
         // Get cost - use EdgeCost to get time along the edge. Override
         // cost portion to be distance. Add heuristic to get sort cost.
-        sif::Cost cost(label.cost().cost + directededge->length(),
-                       label.cost().secs + costing->EdgeCost(directededge, tile).secs);
+        sif::Cost cost(label.cost().cost + directededge->length(), label.cost().secs + edge.secs);
         // We only add the labels if we are under the limits for distance
         // and for time or time limit is 0
         if (cost.cost < max_dist && (max_time < 0 || cost.secs < max_time)) {
-          float sortcost = cost.cost + heuristic(endtile->get_node_ll(directededge->endnode()));
+          float sortcost = cost.cost + edge.heuristic;
           labelset->put(directededge->endnode(), edgeid, 0.0f, 1.0f, cost, turn_cost, sortcost,
                         label_idx, directededge, travelmode, restriction_idx);
         }
@@ -460,10 +489,9 @@ find_shortest_path(baldr::GraphReader& reader,
     }
 
     // Handle transitions - expand from the end node each transition
-    if (!from_transition && nodeinfo->transition_count() > 0) {
-      const baldr::NodeTransition* trans = tile->transition(nodeinfo->transition_index());
-      for (uint32_t i = 0; i < nodeinfo->transition_count(); ++i, ++trans) {
-        expand(trans->endnode(), label_idx, true);
+    if (!from_transition) {
+      for (const auto& endnode : expansion.transitions) {
+        expand(endnode, label_idx, true);
       }
     }
   };
@@ -601,7 +629,8 @@ find_shortest_path(baldr::GraphReader& reader,
           if (endtile == nullptr) {
             continue;
           }
-          float sortcost = cost.cost + heuristic(endtile->get_node_ll(directed_edge->endnode()));
+          float sortcost =
+              cost.cost + cache.heuristic(endtile->get_node_ll(directed_edge->endnode()));
           labelset->put(directed_edge->endnode(), origin_edge.id, origin_edge.percent_along, 1.f,
                         cost, turn_cost, sortcost, label_idx, directed_edge, travelmode,
                         restriction_idx);
@@ -615,6 +644,65 @@ find_shortest_path(baldr::GraphReader& reader,
   return results;
 }
 
+/**
+ * Find the shortest path(s) from an origin to set of destinations.
+ */
+std::unordered_map<uint16_t, uint32_t>
+find_shortest_path(baldr::GraphReader& reader,
+                   const std::vector<baldr::PathLocation>& destinations,
+                   uint16_t origin_idx,
+                   labelset_ptr_t labelset,
+                   const midgard::DistanceApproximator<midgard::PointLL>& approximator,
+                   const float search_radius,
+                   sif::cost_ptr_t costing,
+                   const Label* edgelabel,
+                   const float turn_cost_table[181],
+                   const float max_dist,
+                   const float max_time) {
+  ExpansionCache cache(approximator, search_radius);
+  return find_shortest_path(reader, destinations, origin_idx, labelset, cache, costing, edgelabel,
+                            turn_cost_table, max_dist, max_time);
+}
+
+/**
+ * Find the shortest paths from each origin to the same set of destinations.
+ */
+std::vector<ColumnRoute>
+find_shortest_paths(baldr::GraphReader& reader,
+                    const std::vector<baldr::PathLocation>& origins,
+                    const std::vector<const Label*>& edgelabels,
+                    const std::vector<baldr::PathLocation>& destinations,
+                    const midgard::DistanceApproximator<midgard::PointLL>& approximator,
+                    const float search_radius,
+                    sif::cost_ptr_t costing,
+                    const float turn_cost_table[181],
+                    const float max_dist,
+                    const float max_time) {
+  if (origins.size() != edgelabels.size()) {
+    throw std::invalid_argument("expect an edge label, or null, for each origin");
+  }
+
+  // The origin goes in front of the destinations, only it changes from one search to the next
+  ExpansionCache cache(approximator, search_radius);
+  std::vector<baldr::PathLocation> locations;
+  locations.reserve(destinations.size() + 1);
+  std::vector<ColumnRoute> routes;
+  routes.reserve(origins.size());
+  for (size_t i = 0; i < origins.size(); ++i) {
+    if (locations.empty()) {
+      locations.push_back(origins[i]);
+      locations.insert(locations.end(), destinations.begin(), destinations.end());
+    } else {
+      locations.front() = origins[i];
+    }
+    auto labelset = std::make_shared<LabelSet>(max_dist);
+    auto results = find_shortest_path(reader, locations, 0, labelset, cache, costing, edgelabels[i],
+                                      turn_cost_table, max_dist, max_time);
+    routes.push_back({std::move(results), std::move(labelset)});
+  }
+  return routes;
+}
+
 } // namespace meili
 
 } // namespace valhalla
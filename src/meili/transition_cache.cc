@@ -0,0 +1,87 @@
+#include "meili/transition_cache.h"
+#include "midgard/util.h"
+
+namespace valhalla {
+namespace meili {
+
+TransitionCache::Transition::Transition(const Costing costing,
+                                        const Label* edgelabel,
+                                        const baldr::PathLocation& origin,
+                                        const std::vector<baldr::PathLocation>& destinations,
+                                        const midgard::PointLL& target,
+                                        const float search_radius,
+                                        const float max_distance,
+                                        const float max_time)
+    : costing(costing), predecessor(edgelabel ? edgelabel->edgeid() : baldr::GraphId{}),
+      restriction_idx(edgelabel ? edgelabel->restriction_idx() : 0), stop_type(origin.stoptype_),
+      target(target), search_radius(search_radius), max_distance(max_distance),
+      max_time(max_time) {
+  // The rest of the label leading into the origin follows from its edge and restriction
+  size_t edge_count = origin.edges.size() + destinations.size() + 1;
+  for (const auto& destination : destinations) {
+    edge_count += destination.edges.size();
+  }
+  edges.reserve(edge_count);
+  const auto add = [this](const baldr::PathLocation& location) {
+    for (const auto& edge : location.edges) {
+      edges.emplace_back(edge.id, edge.percent_along);
+    }
+    edges.emplace_back(baldr::GraphId{}, 0.0);
+  };
+  add(origin);
+  for (const auto& destination : destinations) {
+    add(destination);
+  }
+}
+
+bool TransitionCache::Transition::operator==(const Transition& other) const {
+  return costing == other.costing && predecessor == other.predecessor &&
+         restriction_idx == other.restriction_idx && stop_type == other.stop_type &&
+         target == other.target && search_radius == other.search_radius &&
+         max_distance == other.max_distance && max_time == other.max_time && edges == other.edges;
+}
+
+size_t TransitionCache::TransitionHash::operator()(const Transition& transition) const {
+  size_t seed = std::hash<int>()(transition.costing);
+  // The first edge of the origin and the first edge of the first destination
+  auto edge = transition.edges.cbegin();
+  midgard::hash_combine(seed, edge->first);
+  while (edge != transition.edges.cend() && edge->first.Is_Valid()) {
+    ++edge;
+  }
+  if (edge != transition.edges.cend() && ++edge != transition.edges.cend()) {
+    midgard::hash_combine(seed, edge->first);
+  }
+  return seed;
+}
+
+TransitionCache::TransitionCache(const size_t max_size) : max_size_(max_size) {
+}
+
+std::shared_ptr<const ColumnRoute> TransitionCache::Find(const Transition& transition) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = routes_.find(transition);
+  return it == routes_.end() ? nullptr : it->second;
+}
+
+void TransitionCache::Insert(Transition transition, const ColumnRoute& route) {
+  std::shared_ptr<const ColumnRoute> cached(new ColumnRoute(route));
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (routes_.size() >= max_size_) {
+    routes_.clear();
+  }
+  routes_.emplace(std::move(transition), std::move(cached));
+}
+
+size_t TransitionCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return routes_.size();
+}
+
+void TransitionCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  routes_.clear();
+}
+
+} // namespace meili
+} // namespace valhalla
@@ -1,6 +1,8 @@
 #include "meili/transition_cost_model.h"
 #include "meili/routing.h"
 
+#include <boost/optional.hpp>
+
 namespace {
 inline float GreatCircleDistance(const valhalla::meili::Measurement& left,
                                  const valhalla::meili::Measurement& right) {
@@ -26,7 +28,8 @@ TransitionCostModel::TransitionCostModel(baldr::GraphReader& graphreader,
       travelmode_(travelmode), beta_(beta), inv_beta_(1.f / beta_),
       breakage_distance_(breakage_distance), max_route_distance_factor_(max_route_distance_factor),
       max_route_time_factor_(max_route_time_factor),
-      turn_penalty_factor_(turn_penalty_factor), turn_cost_table_{0.f} {
+      turn_penalty_factor_(turn_penalty_factor), turn_cost_table_{0.f}, costing_(Costing::none_),
+      speculative_routes_(std::make_shared<StateIdMap<speculative_route_t>>()) {
   if (beta_ <= 0.f) {
     throw std::invalid_argument("Expect beta to be positive");
   }
@@ -91,12 +94,13 @@ void TransitionCostModel::UpdateRoute(const StateId& lhs, const StateId& rhs) co
 
   // Prepare edgelabel
   const Label* edgelabel = nullptr;
+  const State* prev_state = nullptr;
   const auto& prev_stateid = vs_.Predecessor(left.stateid());
   if (prev_stateid.IsValid()) {
     const auto& original_prev_stateid = ts_.GetOrigin(prev_stateid);
-    const auto& prev_state =
-        container_.state(original_prev_stateid.IsValid() ? original_prev_stateid : prev_stateid);
-    if (!prev_state.routed()) {
+    prev_state =
+        &container_.state(original_prev_stateid.IsValid() ? original_prev_stateid : prev_stateid);
+    if (!prev_state->routed()) {
       // When ViterbiSearch calls this method, the left state is
       // guaranteed to be optimal, its predecessor is therefore
       // guaranteed to be expanded (and routed). When
@@ -106,7 +110,7 @@ void TransitionCostModel::UpdateRoute(const StateId& lhs, const StateId& rhs) co
       throw std::logic_error("The predecessor of current state must have been routed."
                              " Check if you have misused the TransitionCost method");
     }
-    edgelabel = prev_state.last_label(left);
+    edgelabel = prev_state->last_label(left);
   }
 
   // Prepare locations and stateids
@@ -131,6 +135,22 @@ void TransitionCostModel::UpdateRoute(const StateId& lhs, const StateId& rhs) co
     //}
   }
 
+  // The route may have been found along with another state of the column already, it is the same
+  // as long as it was started from the same label
+  const auto* speculative = speculative_routes_->find(lhs);
+  if (speculative) {
+    const bool same_label = speculative->predecessor ==
+                                (edgelabel ? edgelabel->edgeid() : baldr::GraphId{}) &&
+                            speculative->restriction_idx ==
+                                (edgelabel ? edgelabel->restriction_idx() : 0);
+    const auto route = speculative->route;
+    speculative_routes_->erase(lhs);
+    if (same_label) {
+      left.SetRoute(unreached_stateids, route.results, route.labelset);
+      return;
+    }
+  }
+
   const auto& left_measurement = container_.measurement(lhs.time());
   const auto& right_measurement = container_.measurement(rhs.time());
 
@@ -149,13 +169,74 @@ void TransitionCostModel::UpdateRoute(const StateId& lhs, const StateId& rhs) co
     max_route_time = std::ceil(max_route_time);
   }
 
-  labelset_ptr_t labelset = std::make_shared<LabelSet>(max_route_distance);
-  const auto& results = find_shortest_path(graphreader_, locations, 0, labelset, approximator,
-                                           right_measurement.search_radius(),
-                                           mode_costing_[static_cast<size_t>(travelmode_)], edgelabel,
-                                           turn_cost_table_, max_route_distance, max_route_time);
+  // Most of the time the states of a column are all reached through the same state of the column
+  // before, so route the ones that wait to be expanded along with this one as if they were. The
+  // searches share most of their work, and a guess that turns out wrong only costs its search.
+  // States the search has not reached may never be expanded, so they are not guessed at
+  std::vector<const State*> origins{&left};
+  std::vector<const Label*> edgelabels{edgelabel};
+  for (const auto& state : container_.column(lhs.time())) {
+    if (state.stateid() == lhs || state.routed() ||
+        speculative_routes_->contains(state.stateid()) || !vs_.Pending(state.stateid())) {
+      continue;
+    }
+    const auto* guess = prev_state ? prev_state->last_label(state) : nullptr;
+    if (prev_state && !guess) {
+      continue;
+    }
+    origins.push_back(&state);
+    edgelabels.push_back(guess);
+  }
+
+  // Another matcher sharing the cache may have routed the very same transitions already
+  std::vector<baldr::PathLocation> destinations(locations.begin() + 1, locations.end());
+  std::vector<ColumnRoute> routes(origins.size());
+  std::vector<TransitionCache::Transition> transitions;
+  std::vector<baldr::PathLocation> search_origins;
+  std::vector<const Label*> search_edgelabels;
+  std::vector<size_t> searched;
+  for (size_t i = 0; i < origins.size(); ++i) {
+    if (cache_) {
+      transitions.emplace_back(costing_, edgelabels[i], origins[i]->candidate(), destinations,
+                               right_measurement.lnglat(), right_measurement.search_radius(),
+                               max_route_distance, max_route_time);
+      const auto route = cache_->Find(transitions.back());
+      if (route) {
+        routes[i] = *route;
+        continue;
+      }
+    }
+    search_origins.push_back(origins[i]->candidate());
+    search_edgelabels.push_back(edgelabels[i]);
+    searched.push_back(i);
+  }
+
+  if (!searched.empty()) {
+    auto found = find_shortest_paths(graphreader_, search_origins, search_edgelabels, destinations,
+                                     approximator, right_measurement.search_radius(),
+                                     mode_costing_[static_cast<size_t>(travelmode_)],
+                                     turn_cost_table_, max_route_distance, max_route_time);
+    for (size_t j = 0; j < searched.size(); ++j) {
+      const auto i = searched[j];
+      if (cache_) {
+        cache_->Insert(std::move(transitions[i]), found[j]);
+      }
+      routes[i] = std::move(found[j]);
+    }
+  }
+
+  left.SetRoute(unreached_stateids, routes.front().results, routes.front().labelset);
+  for (size_t i = 1; i < origins.size(); ++i) {
+    speculative_route_t speculative_route;
+    speculative_route.predecessor = edgelabels[i] ? edgelabels[i]->edgeid() : baldr::GraphId{};
+    speculative_route.restriction_idx = edgelabels[i] ? edgelabels[i]->restriction_idx() : 0;
+    speculative_route.route = std::move(routes[i]);
+    speculative_routes_->emplace(origins[i]->stateid(), speculative_route);
+  }
+}
 
-  left.SetRoute(unreached_stateids, results, labelset);
+void TransitionCostModel::Clear() {
+  speculative_routes_->clear();
 }
 
 } // namespace meili
@@ -124,15 +124,15 @@ void IViterbiSearch::Clear() {
 }
 
 bool IViterbiSearch::AddStateId(const StateId& stateid) {
-  return added_states_.insert(stateid).second;
+  return added_states_.emplace(stateid, true);
 }
 
 bool IViterbiSearch::RemoveStateId(const StateId& stateid) {
-  return added_states_.erase(stateid) > 0;
+  return added_states_.erase(stateid);
 }
 
 bool IViterbiSearch::HasStateId(const StateId& stateid) const {
-  return added_states_.find(stateid) != added_states_.end();
+  return added_states_.contains(stateid);
 }
 
 StateIdIterator IViterbiSearch::SearchPathVS(StateId::Time time, bool allow_breaks) {
@@ -427,20 +427,56 @@ StateId ViterbiSearch::SearchWinner(StateId::Time time) {
 }
 
 StateId ViterbiSearch::Predecessor(const StateId& stateid) const {
-  const auto it = scanned_labels_.find(stateid);
-  if (it == scanned_labels_.end()) {
-    return {};
-  } else {
-    return (it->second).predecessor();
-  }
+  const auto* label = scanned_labels_.find(stateid);
+  return label ? label->predecessor() : StateId{};
 }
 
 double ViterbiSearch::AccumulatedCost(const StateId& stateid) const {
-  const auto it = scanned_labels_.find(stateid);
-  if (it == scanned_labels_.end()) {
-    return -1.f;
-  } else {
-    return it->second.costsofar();
+  const auto* label = scanned_labels_.find(stateid);
+  return label ? label->costsofar() : -1.f;
+}
+
+bool ViterbiSearch::Pending(const StateId& stateid) const {
+  return queue_.contains(stateid);
+}
+
+StateId ViterbiSearch::ConvergedState() const {
+  // Future winners extend either the winner of the last column searched or one of the labels still
+  // in the queue, which in turn extends its predecessor
+  if (winner_by_time.empty() || !winner_by_time.back().IsValid()) {
+    return {};
+  }
+  std::vector<StateId> heads{winner_by_time.back()};
+  for (const auto& label : queue_) {
+    if (label.stateid().time() < earliest_time_) {
+      continue;
+    }
+    // A label that starts a new path has nothing in common with the others
+    if (!label.predecessor().IsValid()) {
+      return {};
+    }
+    heads.push_back(label.predecessor());
+  }
+
+  // Walk the latest heads back until they all meet in the same state
+  while (true) {
+    std::sort(heads.begin(), heads.end(), [](const StateId& lhs, const StateId& rhs) {
+      return lhs.time() > rhs.time() || (lhs.time() == rhs.time() && lhs.id() < rhs.id());
+    });
+    heads.erase(std::unique(heads.begin(), heads.end()), heads.end());
+    if (heads.size() == 1) {
+      return heads.front();
+    }
+    const auto latest = heads.front().time();
+    for (auto& head : heads) {
+      if (head.time() != latest) {
+        break;
+      }
+      head = Predecessor(head);
+      if (!head.IsValid()) {
+        return {};
+      }
+    }
   }
 }
 
@@ -475,11 +511,11 @@ void ViterbiSearch::AddSuccessorsToQueue(const StateId& stateid) {
                            " is impossible to have successors");
   }
 
-  const auto it = scanned_labels_.find(stateid);
-  if (it == scanned_labels_.end()) {
+  const auto* label = scanned_labels_.find(stateid);
+  if (!label) {
     throw std::logic_error("the state must be scanned");
   }
-  const auto costsofar = it->second.costsofar();
+  const auto costsofar = label->costsofar();
   if (IsInvalidCost(costsofar)) {
     // All invalid ones should be filtered out before pushing labels
     // into the queue
@@ -554,8 +590,7 @@ StateId::Time ViterbiSearch::IterativeSearch(StateId::Time target, bool request_
     }
 
     // Mark it as scanned and remember its cost and predecessor
-    const auto& inserted = scanned_labels_.emplace(stateid, label);
-    if (!inserted.second) {
+    if (!scanned_labels_.emplace(stateid, label)) {
       throw std::logic_error("the principle of optimality is violated in the viterbi search,"
                              " probably negative costs occurred");
     }
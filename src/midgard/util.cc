@@ -23,6 +23,11 @@
 #include <boost/archive/iterators/remove_whitespace.hpp>
 #include <boost/archive/iterators/transform_width.hpp>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VALHALLA_PROJECT_SSE2
+#endif
+
 namespace {
 
 constexpr double RAD_PER_METER = 1.0 / 6378160.187;
@@ -51,6 +56,97 @@ resample_at_1hz(const std::vector<valhalla::midgard::gps_segment_t>& segments) {
   return resampled;
 }
 
+// What the kernels that project a segment onto a batch of points work on
+struct project_args_t {
+  double ux, uy, vx, vy;
+  uint64_t index;
+  size_t count;
+  const double* lng;
+  const double* lat;
+  const double* lon_scale;
+  const double* m_per_lng_degree;
+  double* sq_distance;
+  double* closest_lng;
+  double* closest_lat;
+  uint64_t* closest_index;
+};
+
+// The same arithmetic as projector_t and DistanceApproximator::DistanceSquared, so that every
+// kernel gives the very same results. The simd one computes all the cases and selects between them
+void project_scalar(const project_args_t& a, size_t i) {
+  const double bx = a.vx - a.ux;
+  const double by = a.vy - a.uy;
+  for (; i < a.count; ++i) {
+    double x = a.ux, y = a.uy;
+    if (a.ux != a.vx || a.uy != a.vy) {
+      const double bx2 = bx * a.lon_scale[i];
+      const double sq = bx2 * bx2 + by * by;
+      double scale = (a.lng[i] - a.ux) * a.lon_scale[i] * bx2 + (a.lat[i] - a.uy) * by;
+      if (scale >= sq) {
+        x = a.vx;
+        y = a.vy;
+      } else if (scale > 0.0) {
+        scale /= sq;
+        x = a.ux + bx * scale;
+        y = a.uy + by * scale;
+      }
+    }
+    const double dlat = (y - a.lat[i]) * valhalla::midgard::kMetersPerDegreeLat;
+    const double dlng = (x - a.lng[i]) * a.m_per_lng_degree[i];
+    const double sq_distance = dlat * dlat + dlng * dlng;
+    if (sq_distance < a.sq_distance[i]) {
+      a.sq_distance[i] = sq_distance;
+      a.closest_lng[i] = x;
+      a.closest_lat[i] = y;
+      a.closest_index[i] = a.index;
+    }
+  }
+}
+
+#ifdef VALHALLA_PROJECT_SSE2
+inline __m128d select_pd(__m128d mask, __m128d a, __m128d b) {
+  return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+void project_sse2(const project_args_t& a) {
+  const __m128d ux = _mm_set1_pd(a.ux), uy = _mm_set1_pd(a.uy);
+  const __m128d vx = _mm_set1_pd(a.vx), vy = _mm_set1_pd(a.vy);
+  const __m128d bx = _mm_set1_pd(a.vx - a.ux), by = _mm_set1_pd(a.vy - a.uy);
+  const __m128d by_sq = _mm_mul_pd(by, by);
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d meters_per_lat = _mm_set1_pd(valhalla::midgard::kMetersPerDegreeLat);
+  const __m128d index = _mm_castsi128_pd(_mm_set1_epi64x(a.index));
+  size_t i = 0;
+  for (; i + 2 <= a.count; i += 2) {
+    const __m128d lng = _mm_loadu_pd(a.lng + i), lat = _mm_loadu_pd(a.lat + i);
+    const __m128d lon_scale = _mm_loadu_pd(a.lon_scale + i);
+    const __m128d bx2 = _mm_mul_pd(bx, lon_scale);
+    const __m128d sq = _mm_add_pd(_mm_mul_pd(bx2, bx2), by_sq);
+    const __m128d scale =
+        _mm_add_pd(_mm_mul_pd(_mm_mul_pd(_mm_sub_pd(lng, ux), lon_scale), bx2),
+                   _mm_mul_pd(_mm_sub_pd(lat, uy), by));
+    // nan for zero length segments but then the scale is 0 and u is selected
+    const __m128d along = _mm_div_pd(scale, sq);
+    __m128d x = _mm_add_pd(ux, _mm_mul_pd(bx, along));
+    __m128d y = _mm_add_pd(uy, _mm_mul_pd(by, along));
+    const __m128d after = _mm_cmpge_pd(scale, sq), before = _mm_cmple_pd(scale, zero);
+    x = select_pd(before, ux, select_pd(after, vx, x));
+    y = select_pd(before, uy, select_pd(after, vy, y));
+    const __m128d dlat = _mm_mul_pd(_mm_sub_pd(y, lat), meters_per_lat);
+    const __m128d dlng = _mm_mul_pd(_mm_sub_pd(x, lng), _mm_loadu_pd(a.m_per_lng_degree + i));
+    const __m128d sq_distance = _mm_add_pd(_mm_mul_pd(dlat, dlat), _mm_mul_pd(dlng, dlng));
+    const __m128d closest_sq_distance = _mm_loadu_pd(a.sq_distance + i);
+    const __m128d closer = _mm_cmplt_pd(sq_distance, closest_sq_distance);
+    _mm_storeu_pd(a.sq_distance + i, select_pd(closer, sq_distance, closest_sq_distance));
+    _mm_storeu_pd(a.closest_lng + i, select_pd(closer, x, _mm_loadu_pd(a.closest_lng + i)));
+    _mm_storeu_pd(a.closest_lat + i, select_pd(closer, y, _mm_loadu_pd(a.closest_lat + i)));
+    auto* closest_index = reinterpret_cast<double*>(a.closest_index + i);
+    _mm_storeu_pd(closest_index, select_pd(closer, index, _mm_loadu_pd(closest_index)));
+  }
+  project_scalar(a, i);
+}
+#endif
+
 } // namespace
 
 namespace valhalla {
@@ -729,6 +825,29 @@ polygon_t to_boundary(const std::unordered_set<uint32_t>& region, const Tiles<Po
 constexpr char PADDING_ENCODED = '=';
 constexpr char ZERO_ENCODED = 'A';
 
+void projector_batch_t::operator()(const PointLL& u, const PointLL& v, uint64_t index) {
+  const project_args_t args{u.first,
+                            u.second,
+                            v.first,
+                            v.second,
+                            index,
+                            size(),
+                            lng_.data(),
+                            lat_.data(),
+                            lon_scale_.data(),
+                            m_per_lng_degree_.data(),
+                            sq_distance_.data(),
+                            closest_lng_.data(),
+                            closest_lat_.data(),
+                            closest_index_.data()};
+  // SSE2 is part of every x86-64 so there is nothing to pick at runtime
+#ifdef VALHALLA_PROJECT_SSE2
+  project_sse2(args);
+#else
+  project_scalar(args, 0);
+#endif
+}
+
 std::string encode64(const std::string& text) {
   using namespace boost::archive::iterators;
   using Base64Encode = base64_from_binary<transform_width<std::string::const_iterator, 6, 8>>;
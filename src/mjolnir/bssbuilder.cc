@@ -21,6 +21,7 @@
 #include "midgard/sequence.h"
 #include "midgard/util.h"
 #include "mjolnir/osmnode.h"
+#include "mjolnir/tilescheduler.h"
 
 using namespace valhalla::midgard;
 using namespace valhalla::baldr;
@@ -324,12 +325,15 @@ void add_bss_nodes_and_edges(GraphTileBuilder& tilebuilder_local,
 
 void project_and_add_bss_nodes(const boost::property_tree::ptree& pt,
                                std::mutex& lock,
-                               bss_by_tile_t::const_iterator tile_start,
-                               bss_by_tile_t::const_iterator tile_end,
+                               const bss_by_tile_t& bss_by_tile,
+                               TileScheduler& scheduler,
+                               const unsigned int worker,
                                std::vector<BSSConnection>& all) {
 
   GraphReader reader_local_level(pt);
-  for (; tile_start != tile_end; ++tile_start) {
+  GraphId tile_key;
+  while (scheduler.Next(worker, tile_key)) {
+    auto tile_start = bss_by_tile.find(tile_key);
 
     graph_tile_ptr local_tile = nullptr;
     std::unique_ptr<GraphTileBuilder> tilebuilder_local = nullptr;
@@ -471,11 +475,14 @@ void create_edges(GraphTileBuilder& tilebuilder_local,
 void create_edges_from_way_node(
     const boost::property_tree::ptree& pt,
     std::mutex& lock,
-    std::unordered_map<GraphId, std::vector<BSSConnection>>::const_iterator tile_start,
-    std::unordered_map<GraphId, std::vector<BSSConnection>>::const_iterator tile_end) {
+    const std::unordered_map<GraphId, std::vector<BSSConnection>>& connections_by_tile,
+    TileScheduler& scheduler,
+    const unsigned int worker) {
 
   GraphReader reader_local_level(pt);
-  for (; tile_start != tile_end; ++tile_start) {
+  GraphId tile_key;
+  while (scheduler.Next(worker, tile_key)) {
+    auto tile_start = connections_by_tile.find(tile_key);
 
     graph_tile_ptr local_tile = nullptr;
     std::unique_ptr<GraphTileBuilder> tilebuilder_local = nullptr;
@@ -594,7 +601,6 @@ void BssBuilder::Build(const boost::property_tree::ptree& pt, const std::string&
   size_t nb_threads =
       std::max(static_cast<uint32_t>(1),
                pt.get<uint32_t>("mjolnir.concurrency", std::thread::hardware_concurrency()));
-  std::vector<std::shared_ptr<std::thread>> threads(nb_threads);
 
   // An atomic object we can use to do the synchronization
   std::mutex lock;
@@ -606,25 +612,24 @@ void BssBuilder::Build(const boost::property_tree::ptree& pt, const std::string&
 
   std::vector<BSSConnection> all;
   {
-    size_t floor = bss_by_tile.size() / threads.size();
-    size_t at_ceiling = bss_by_tile.size() - (threads.size() * floor);
-    bss_by_tile_t::const_iterator tile_start, tile_end = bss_by_tile.begin();
-
-    for (size_t i = 0; i < threads.size(); ++i) {
-      // Figure out how many this thread will work on (either ceiling or floor)
-      size_t tile_count = (i < at_ceiling ? floor + 1 : floor);
-      // Where the range begins
-      tile_start = tile_end;
-      // Where the range ends
-      std::advance(tile_end, tile_count);
-      // Make the thread
+    // Every station is projected onto the edges of its tile, tiles with more stations take longer
+    TileScheduler::tile_costs_t costs;
+    for (const auto& tile : bss_by_tile) {
+      costs.emplace_back(tile.first, tile.second.size());
+    }
+    TileScheduler scheduler(std::move(costs), nb_threads);
+    std::vector<std::shared_ptr<std::thread>> threads(scheduler.concurrency());
+
+    for (unsigned int i = 0; i < threads.size(); ++i) {
       threads[i].reset(new std::thread(project_and_add_bss_nodes, std::cref(pt.get_child("mjolnir")),
-                                       std::ref(lock), tile_start, tile_end, std::ref(all)));
+                                       std::ref(lock), std::cref(bss_by_tile), std::ref(scheduler),
+                                       i, std::ref(all)));
     }
 
     for (auto& thread : threads) {
       thread->join();
     }
+    scheduler.LogUtilization("Added bike share stations to");
   }
 
   // the collection is sorted so that the search will be much faster later.
@@ -648,26 +653,22 @@ void BssBuilder::Build(const boost::property_tree::ptree& pt, const std::string&
   }
 
   {
-    size_t floor = map.size() / threads.size();
-    size_t at_ceiling = map.size() - (threads.size() * floor);
-    std::unordered_map<GraphId, std::vector<BSSConnection>>::const_iterator tile_start,
-        tile_end = map.begin();
-
-    for (size_t i = 0; i < threads.size(); ++i) {
-      // Figure out how many this thread will work on (either ceiling or floor)
-      size_t tile_count = (i < at_ceiling ? floor + 1 : floor);
-      // Where the range begins
-      tile_start = tile_end;
-      // Where the range ends
-      std::advance(tile_end, tile_count);
-      // Make the thread
+    TileScheduler::tile_costs_t costs;
+    for (const auto& tile : map) {
+      costs.emplace_back(tile.first, tile.second.size());
+    }
+    TileScheduler scheduler(std::move(costs), nb_threads);
+    std::vector<std::shared_ptr<std::thread>> threads(scheduler.concurrency());
+
+    for (unsigned int i = 0; i < threads.size(); ++i) {
       threads[i].reset(new std::thread(create_edges_from_way_node, std::cref(pt.get_child("mjolnir")),
-                                       std::ref(lock), tile_start, tile_end));
+                                       std::ref(lock), std::cref(map), std::ref(scheduler), i));
     }
 
     for (auto& thread : threads) {
       thread->join();
     }
+    scheduler.LogUtilization("Connected bike share stations in");
   }
 }
 
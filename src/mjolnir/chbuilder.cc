@@ -0,0 +1,328 @@
+#include "mjolnir/chbuilder.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "baldr/graphconstants.h"
+#include "baldr/graphid.h"
+#include "baldr/graphreader.h"
+#include "baldr/graphtile.h"
+#include "baldr/rapidjson_utils.h"
+#include "baldr/tilehierarchy.h"
+#include "midgard/logging.h"
+#include "proto_conversions.h"
+#include "sif/costfactory.h"
+
+using namespace valhalla::baldr;
+using namespace valhalla::mjolnir;
+
+namespace {
+
+using arc_t = CHOverlay::arc_t;
+
+// Witness searches give up after settling this many nodes. Giving up early only costs shortcuts
+// that might not have been needed, the overlay is correct either way
+constexpr uint32_t kMaxWitnessSettled = 500;
+
+constexpr float kUnreached = std::numeric_limits<float>::max();
+
+/**
+ * Contracts the nodes of a graph one at a time, cheapest first, where the price of a node is its
+ * edge difference: the shortcuts needed to bypass it less the arcs removed along with it, plus the
+ * neighbors already contracted to spread the contraction out evenly. Once a node is contracted
+ * its arcs all lead to or come from higher ranked nodes and become its up and down arcs.
+ */
+class contractor_t {
+public:
+  explicit contractor_t(const size_t node_count)
+      : out_(node_count), in_(node_count), deleted_neighbors_(node_count, 0),
+        witness_cost_(node_count, kUnreached) {
+  }
+
+  // Adds an arc, keeping only the cheapest one between two nodes
+  void add_arc(const uint32_t from, const arc_t& arc) {
+    auto existing = std::find_if(out_[from].begin(), out_[from].end(),
+                                 [&arc](const arc_t& a) { return a.node == arc.node; });
+    if (existing == out_[from].end()) {
+      out_[from].push_back(arc);
+      in_[arc.node].push_back({from, arc.cost, arc.secs, arc.length});
+    } else if (arc.cost < existing->cost) {
+      *existing = arc;
+      for (auto& reverse : in_[arc.node]) {
+        if (reverse.node == from) {
+          reverse = {from, arc.cost, arc.secs, arc.length};
+          break;
+        }
+      }
+    }
+  }
+
+  void contract() {
+    using entry_t = std::pair<int32_t, uint32_t>;
+    std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> queue;
+    for (uint32_t node = 0; node < out_.size(); ++node) {
+      queue.emplace(priority(node), node);
+    }
+
+    // Priorities only ever go up as the graph shrinks so we update them lazily: a node whose
+    // priority went up since it was queued goes back in the queue instead of being contracted
+    size_t contracted = 0;
+    while (!queue.empty()) {
+      auto node = queue.top().second;
+      queue.pop();
+      auto current = priority(node);
+      if (!queue.empty() && current > queue.top().first) {
+        queue.emplace(current, node);
+        continue;
+      }
+      shortcuts(node, true);
+      remove(node);
+      if (++contracted % 1000000 == 0) {
+        LOG_INFO("Contracted " + std::to_string(contracted) + " of " +
+                 std::to_string(out_.size()) + " nodes");
+      }
+    }
+  }
+
+  // Turns the remaining arcs of each node into the overlay
+  std::shared_ptr<CHOverlay> overlay(const uint64_t dataset_id,
+                                     std::vector<CHOverlay::tile_t>&& tiles) {
+    std::vector<uint32_t> up_offsets{0}, down_offsets{0};
+    std::vector<arc_t> up_arcs, down_arcs;
+    up_offsets.reserve(out_.size() + 1);
+    down_offsets.reserve(in_.size() + 1);
+    for (size_t node = 0; node < out_.size(); ++node) {
+      up_arcs.insert(up_arcs.end(), out_[node].begin(), out_[node].end());
+      down_arcs.insert(down_arcs.end(), in_[node].begin(), in_[node].end());
+      up_offsets.push_back(up_arcs.size());
+      down_offsets.push_back(down_arcs.size());
+      std::vector<arc_t>().swap(out_[node]);
+      std::vector<arc_t>().swap(in_[node]);
+    }
+    return std::make_shared<CHOverlay>(dataset_id, std::move(tiles), std::move(up_offsets),
+                                       std::move(up_arcs), std::move(down_offsets),
+                                       std::move(down_arcs));
+  }
+
+protected:
+  int32_t priority(const uint32_t node) {
+    return shortcuts(node, false) - static_cast<int32_t>(in_[node].size() + out_[node].size()) +
+           deleted_neighbors_[node];
+  }
+
+  // Counts and, if asked to, adds the shortcuts needed to keep the costs between the neighbors of
+  // the node once it is gone
+  int32_t shortcuts(const uint32_t node, const bool add) {
+    int32_t count = 0;
+    for (const auto& in : in_[node]) {
+      float max_cost = -1.f;
+      for (const auto& out : out_[node]) {
+        if (out.node != in.node) {
+          max_cost = std::max(max_cost, in.cost + out.cost);
+        }
+      }
+      if (max_cost < 0.f) {
+        continue;
+      }
+
+      witness(in.node, node, max_cost);
+      for (const auto& out : out_[node]) {
+        float cost = in.cost + out.cost;
+        if (out.node == in.node || witness_cost_[out.node] <= cost) {
+          continue;
+        }
+        ++count;
+        if (add) {
+          add_arc(in.node, {out.node, cost, in.secs + out.secs, in.length + out.length});
+        }
+      }
+    }
+    return count;
+  }
+
+  // Bounded search for paths from source that don't go through the node being contracted
+  void witness(const uint32_t source, const uint32_t skip, const float max_cost) {
+    for (auto node : touched_) {
+      witness_cost_[node] = kUnreached;
+    }
+    touched_.clear();
+
+    using entry_t = std::pair<float, uint32_t>;
+    std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> queue;
+    witness_cost_[source] = 0.f;
+    touched_.push_back(source);
+    queue.emplace(0.f, source);
+    uint32_t settled = 0;
+    while (!queue.empty() && settled < kMaxWitnessSettled) {
+      auto cost = queue.top().first;
+      auto node = queue.top().second;
+      queue.pop();
+      if (cost > witness_cost_[node]) {
+        continue;
+      }
+      if (cost > max_cost) {
+        break;
+      }
+      ++settled;
+      for (const auto& arc : out_[node]) {
+        float next = cost + arc.cost;
+        if (arc.node == skip || next >= witness_cost_[arc.node]) {
+          continue;
+        }
+        if (witness_cost_[arc.node] == kUnreached) {
+          touched_.push_back(arc.node);
+        }
+        witness_cost_[arc.node] = next;
+        queue.emplace(next, arc.node);
+      }
+    }
+  }
+
+  // Takes the node out of the remaining graph, what's left of its arcs is its up and down arcs
+  void remove(const uint32_t node) {
+    auto is_node = [node](const arc_t& arc) { return arc.node == node; };
+    for (const auto& out : out_[node]) {
+      auto& arcs = in_[out.node];
+      arcs.erase(std::remove_if(arcs.begin(), arcs.end(), is_node), arcs.end());
+      ++deleted_neighbors_[out.node];
+    }
+    for (const auto& in : in_[node]) {
+      auto& arcs = out_[in.node];
+      arcs.erase(std::remove_if(arcs.begin(), arcs.end(), is_node), arcs.end());
+      ++deleted_neighbors_[in.node];
+    }
+  }
+
+  // Arcs leaving and reaching each node, the node of an in arc is where it starts
+  std::vector<std::vector<arc_t>> out_;
+  std::vector<std::vector<arc_t>> in_;
+  std::vector<int32_t> deleted_neighbors_;
+
+  // Scratch space of the witness searches
+  std::vector<float> witness_cost_;
+  std::vector<uint32_t> touched_;
+};
+
+} // namespace
+
+namespace valhalla {
+namespace mjolnir {
+
+std::shared_ptr<CHOverlay> CHBuilder::Contract(GraphReader& reader,
+                                               const sif::cost_ptr_t& costing) {
+  // Number the nodes tile by tile, in a stable order so rebuilding gives the same overlay
+  std::vector<CHOverlay::tile_t> tiles;
+  std::unordered_map<uint32_t, uint32_t> first_nodes;
+  uint32_t node_count = 0;
+  uint64_t dataset_id = 0;
+  for (const auto& level : TileHierarchy::levels()) {
+    auto tile_set = reader.GetTileSet(level.level);
+    std::vector<GraphId> tile_ids(tile_set.begin(), tile_set.end());
+    std::sort(tile_ids.begin(), tile_ids.end());
+    for (const auto& tile_id : tile_ids) {
+      graph_tile_ptr tile = reader.GetGraphTile(tile_id);
+      if (!tile) {
+        continue;
+      }
+      // All the tiles of a build share the dataset id, its how the matrix notices a new tileset
+      dataset_id = tile->header()->dataset_id();
+      tiles.push_back({tile_id.tile_value(), node_count, tile->header()->nodecount()});
+      first_nodes.emplace(tile_id.tile_value(), node_count);
+      node_count += tile->header()->nodecount();
+    }
+  }
+  auto node_index = [&first_nodes](const GraphId& node) {
+    auto found = first_nodes.find(node.tile_value());
+    return found == first_nodes.cend() ? CHOverlay::kInvalidNode : found->second + node.id();
+  };
+
+  // Add an arc for every edge the costing can use and for every transition between levels
+  contractor_t contractor(node_count);
+  for (const auto& t : tiles) {
+    GraphId tile_id(t.tile_id);
+    graph_tile_ptr tile = reader.GetGraphTile(tile_id);
+    for (uint32_t i = 0; i < t.node_count; ++i) {
+      const NodeInfo* node = tile->node(i);
+      if (!costing->Allowed(node)) {
+        continue;
+      }
+      uint32_t from = t.first_node + i;
+      for (uint32_t j = 0; j < node->edge_count(); ++j) {
+        GraphId edge_id(tile_id.tileid(), tile_id.level(), node->edge_index() + j);
+        const DirectedEdge* edge = tile->directededge(edge_id);
+        uint8_t restriction_idx = kInvalidRestriction;
+        if (edge->is_shortcut() || edge->destonly() || edge->surface() == Surface::kImpassable ||
+            !costing->Allowed(edge, tile, sif::kDisallowNone) ||
+            !costing->EvaluateRestrictions(costing->access_mode(), edge, tile, edge_id, 0, 0,
+                                           restriction_idx)) {
+          continue;
+        }
+        uint32_t to = node_index(edge->endnode());
+        if (to == CHOverlay::kInvalidNode || to == from) {
+          continue;
+        }
+        auto cost = costing->EdgeCost(edge, tile);
+        contractor.add_arc(from, {to, cost.cost, cost.secs, edge->length()});
+      }
+      for (const auto& transition : tile->GetNodeTransitions(node)) {
+        uint32_t to = node_index(transition.endnode());
+        if (to != CHOverlay::kInvalidNode) {
+          contractor.add_arc(from, {to, 0.f, 0.f, 0});
+        }
+      }
+    }
+    if (reader.OverCommitted()) {
+      reader.Trim();
+    }
+  }
+
+  LOG_INFO("Contracting " + std::to_string(node_count) + " nodes");
+  contractor.contract();
+  return contractor.overlay(dataset_id, std::move(tiles));
+}
+
+void CHBuilder::Build(const boost::property_tree::ptree& pt) {
+  auto dir = pt.get<std::string>("mjolnir.ch_overlay_dir", "");
+  if (dir.empty()) {
+    LOG_INFO("Skipping contraction hierarchy overlays");
+    return;
+  }
+
+  std::vector<std::string> costings;
+  if (auto configured = pt.get_child_optional("mjolnir.ch_overlay_costings")) {
+    for (const auto& costing : *configured) {
+      costings.push_back(costing.second.get_value<std::string>());
+    }
+  } else {
+    costings = {"auto", "truck"};
+  }
+
+  GraphReader reader(pt.get_child("mjolnir"));
+  for (const auto& costing_str : costings) {
+    Costing costing;
+    if (!Costing_Enum_Parse(costing_str, &costing)) {
+      LOG_WARN("Skipping contraction hierarchy overlay for unknown costing " + costing_str);
+      continue;
+    }
+
+    // The overlay is only valid for the default options of the costing
+    const rapidjson::Document doc;
+    CostingOptions options;
+    sif::ParseCostingOptions(doc, "/costing_options/" + costing_str, &options, costing);
+
+    LOG_INFO("Building contraction hierarchy overlay for " + costing_str);
+    auto overlay = Contract(reader, sif::CostFactory().Create(options));
+    overlay->Save(CHOverlay::FileName(dir, costing_str));
+    LOG_INFO("Finished contraction hierarchy overlay for " + costing_str + " with " +
+             std::to_string(overlay->node_count()) + " nodes");
+  }
+}
+
+} // namespace mjolnir
+} // namespace valhalla
@@ -19,8 +19,7 @@
 
 #include "mjolnir/elevationbuilder.h"
 #include "mjolnir/graphtilebuilder.h"
-
-#include <deque>
+#include "mjolnir/tilescheduler.h"
 
 using namespace valhalla::midgard;
 using namespace valhalla::baldr;
@@ -35,10 +34,11 @@ constexpr double POSTING_INTERVAL = 60;
 constexpr double kMinimumInterval = 10.0f;
 
 /**
- * Adds elevation to a set of tiles. Each thread pulls a tile of the queue
+ * Adds elevation to a set of tiles. Each thread takes its tiles from the scheduler
  */
 void add_elevation(const boost::property_tree::ptree& pt,
-                   std::deque<GraphId>& tilequeue,
+                   TileScheduler& scheduler,
+                   const unsigned int worker,
                    std::mutex& lock,
                    const std::unique_ptr<const valhalla::skadi::sample>& sample,
                    std::promise<uint32_t>& /*result*/) {
@@ -52,17 +52,8 @@ void add_elevation(const boost::property_tree::ptree& pt,
       geo_attribute_cache;
 
   // Check for more tiles
-  while (true) {
-    lock.lock();
-    if (tilequeue.empty()) {
-      lock.unlock();
-      break;
-    }
-    // Get the next tile Id
-    GraphId tile_id = tilequeue.front();
-    tilequeue.pop_front();
-    lock.unlock();
-
+  GraphId tile_id;
+  while (scheduler.Next(worker, tile_id)) {
     // Get the tile. Serialize the entire tile?
     GraphTileBuilder tilebuilder(graphreader.tile_dir(), tile_id, true);
 
@@ -176,42 +167,37 @@ void ElevationBuilder::Build(const boost::property_tree::ptree& pt) {
   boost::optional<std::string> elevation = pt.get_optional<std::string>("additional_data.elevation");
   std::unique_ptr<const skadi::sample> sample;
   if (elevation && filesystem::exists(*elevation)) {
-    sample.reset(new skadi::sample(*elevation));
+    sample.reset(new skadi::sample(*elevation,
+                                   pt.get<size_t>("additional_data.elevation_cache_size",
+                                                  skadi::kDefaultElevationCacheSize)));
   } else {
     LOG_INFO("ElevationBuilder: no elevation data, skipping");
     return;
   }
 
-  // Create a randomized queue of tiles (at all levels) to work from
-  std::deque<GraphId> tilequeue;
+  // Schedule the tiles (at all levels), the larger a tile the more shape there is to sample
   GraphReader reader(pt.get_child("mjolnir"));
-  auto tileset = reader.GetTileSet();
-  for (const auto& id : tileset) {
-    tilequeue.emplace_back(id);
-  }
-  std::random_device rd;
-  std::shuffle(tilequeue.begin(), tilequeue.end(), std::mt19937(rd()));
+  TileScheduler scheduler(TileScheduler::FileSizes(reader.tile_dir(), reader.GetTileSet()),
+                          std::max(static_cast<unsigned int>(1),
+                                   pt.get<unsigned int>("mjolnir.concurrency",
+                                                        std::thread::hardware_concurrency())));
 
   // An mutex we can use to do the synchronization
   std::mutex lock;
 
   // Setup threads
-  uint32_t nthreads =
-      std::max(static_cast<unsigned int>(1),
-               pt.get<unsigned int>("mjolnir.concurrency", std::thread::hardware_concurrency()));
-  std::vector<std::shared_ptr<std::thread>> threads(nthreads);
+  std::vector<std::shared_ptr<std::thread>> threads(scheduler.concurrency());
 
   // Setup promises. Hold the results for the threads
-  std::vector<std::promise<uint32_t>> results(nthreads);
+  std::vector<std::promise<uint32_t>> results(threads.size());
 
-  LOG_INFO("Adding elevation to " + std::to_string(tilequeue.size()) + " tiles with " +
-           std::to_string(nthreads) + " threads...");
+  LOG_INFO("Adding elevation to " + std::to_string(scheduler.size()) + " tiles with " +
+           std::to_string(threads.size()) + " threads...");
 
   // Spawn the threads
-  for (auto& thread : threads) {
-    results.emplace_back();
-    thread.reset(new std::thread(add_elevation, std::cref(pt), std::ref(tilequeue), std::ref(lock),
-                                 std::cref(sample), std::ref(results.back())));
+  for (unsigned int i = 0; i < threads.size(); ++i) {
+    threads[i].reset(new std::thread(add_elevation, std::cref(pt), std::ref(scheduler), i,
+                                     std::ref(lock), std::cref(sample), std::ref(results[i])));
   }
 
   // Wait for threads to finish
@@ -229,7 +215,7 @@ void ElevationBuilder::Build(const boost::property_tree::ptree& pt) {
       }
     }
   } **/
-  LOG_INFO("Finished");
+  scheduler.LogUtilization("Added elevation to");
 }
 
 } // namespace mjolnir
@@ -25,6 +25,7 @@
 #include "mjolnir/graphtilebuilder.h"
 #include "mjolnir/linkclassification.h"
 #include "mjolnir/node_expander.h"
+#include "mjolnir/tilescheduler.h"
 #include "mjolnir/util.h"
 
 using namespace valhalla::midgard;
@@ -337,8 +338,9 @@ void BuildTileSet(const std::string& ways_file,
                   const std::string& complex_restriction_to_file,
                   const std::string& tile_dir,
                   const OSMData& osmdata,
-                  std::map<GraphId, size_t>::const_iterator tile_start,
-                  std::map<GraphId, size_t>::const_iterator tile_end,
+                  const std::map<GraphId, size_t>& tiles,
+                  TileScheduler& scheduler,
+                  const unsigned int worker,
                   const uint32_t tile_creation_date,
                   const boost::property_tree::ptree& pt,
                   std::promise<DataQuality>& result) {
@@ -397,7 +399,9 @@ void BuildTileSet(const std::string& ways_file,
 
   ////////////////////////////////////////////////////////////////////////////
   // Iterate over tiles
-  for (; tile_start != tile_end; ++tile_start) {
+  GraphId tile_key;
+  while (scheduler.Next(worker, tile_key)) {
+    auto tile_start = tiles.find(tile_key);
     try {
       // What actually writes the tile
       GraphId tile_id = tile_start->first.Tile_Base();
@@ -445,7 +449,7 @@ void BuildTileSet(const std::string& ways_file,
       auto node_itr = nodes[tile_start->second];
       // to avoid realloc we guess how many edges there might be in a given tile
       geo_attribute_cache.clear();
-      geo_attribute_cache.reserve(5 * (std::next(tile_start) == tile_end
+      geo_attribute_cache.reserve(5 * (std::next(tile_start) == tiles.end()
                                            ? nodes.end() - node_itr
                                            : std::next(tile_start)->second - tile_start->second));
 
@@ -1007,35 +1011,34 @@ void BuildLocalTiles(const unsigned int thread_count,
   uint32_t tile_creation_date =
       DateTime::days_from_pivot_date(DateTime::get_formatted_date(DateTime::iso_date_time(tz)));
 
+  // The tiles with the most nodes take the longest to build so they are started first
+  TileScheduler::tile_costs_t costs;
+  const size_t node_count = sequence<Node>(nodes_file, false).size();
+  for (auto tile = tiles.cbegin(); tile != tiles.cend(); ++tile) {
+    auto next = std::next(tile);
+    costs.emplace_back(tile->first,
+                       (next == tiles.cend() ? node_count : next->second) - tile->second);
+  }
+  TileScheduler scheduler(std::move(costs), thread_count);
   LOG_INFO("Building " + std::to_string(tiles.size()) + " tiles with " +
-           std::to_string(thread_count) + " threads...");
+           std::to_string(scheduler.concurrency()) + " threads...");
 
   // A place to hold worker threads and their results, be they exceptions or otherwise
-  std::vector<std::shared_ptr<std::thread>> threads(thread_count);
+  std::vector<std::shared_ptr<std::thread>> threads(scheduler.concurrency());
 
   // Hold the results (DataQuality/stats) for the threads
   std::vector<std::promise<DataQuality>> results(threads.size());
 
-  // Divvy up the work
-  size_t floor = tiles.size() / threads.size();
-  size_t at_ceiling = tiles.size() - (threads.size() * floor);
-  std::map<GraphId, size_t>::const_iterator tile_start, tile_end = tiles.begin();
-
   // Atomically pass around stats info
   for (size_t i = 0; i < threads.size(); ++i) {
-    // Figure out how many this thread will work on (either ceiling or floor)
-    size_t tile_count = (i < at_ceiling ? floor + 1 : floor);
-    // Where the range begins
-    tile_start = tile_end;
-    // Where the range ends
-    std::advance(tile_end, tile_count);
     // Make the thread
     threads[i].reset(new std::thread(BuildTileSet, std::cref(ways_file), std::cref(way_nodes_file),
                                      std::cref(nodes_file), std::cref(edges_file),
                                      std::cref(complex_from_restriction_file),
                                      std::cref(complex_to_restriction_file), std::cref(tile_dir),
-                                     std::cref(osmdata), tile_start, tile_end, tile_creation_date,
-                                     std::cref(pt.get_child("mjolnir")), std::ref(results[i])));
+                                     std::cref(osmdata), std::cref(tiles), std::ref(scheduler), i,
+                                     tile_creation_date, std::cref(pt.get_child("mjolnir")),
+                                     std::ref(results[i])));
   }
 
   // Join all the threads to wait for them to finish up their work
@@ -1043,7 +1046,7 @@ void BuildLocalTiles(const unsigned int thread_count,
     thread->join();
   }
 
-  LOG_INFO("Finished");
+  scheduler.LogUtilization("Built");
 
   // Check all of the outcomes and accumulate stats
   for (auto& result : results) {
@@ -2,15 +2,15 @@
 #include "mjolnir/admin.h"
 #include "mjolnir/countryaccess.h"
 #include "mjolnir/graphtilebuilder.h"
+#include "mjolnir/tilescheduler.h"
 #include "mjolnir/util.h"
 
 #include <cinttypes>
+#include <cstdio>
 #include <future>
 #include <limits>
 #include <list>
 #include <memory>
-#include <mutex>
-#include <queue>
 #include <set>
 #include <stdexcept>
 #include <thread>
@@ -37,6 +37,7 @@
 #include "baldr/streetnames_factory.h"
 #include "baldr/streetnames_us.h"
 #include "baldr/tilehierarchy.h"
+#include "filesystem.h"
 #include "midgard/aabb2.h"
 #include "midgard/constants.h"
 #include "midgard/distanceapproximator.h"
@@ -207,8 +208,7 @@ void UpdateSpeed(DirectedEdge& directededge,
 void GetTurnTypes(const DirectedEdge& directededge,
                   std::set<Turn::Type>& outgoing_turn_type,
                   graph_tile_ptr tile,
-                  GraphReader& reader,
-                  std::mutex& lock) {
+                  GraphReader& reader) {
   // Get the heading value at the end of incoming edge based on edge shape
   auto incoming_shape = tile->edgeinfo(directededge.edgeinfo_offset()).shape();
   if (directededge.forward()) {
@@ -222,9 +222,7 @@ void GetTurnTypes(const DirectedEdge& directededge,
   // Get the tile at the end node. and find inbound heading of the candidate
   // edge to the end node.
   if (tile->id() != directededge.endnode().Tile_Base()) {
-    lock.lock();
     tile = reader.GetGraphTile(directededge.endnode());
-    lock.unlock();
   }
   const NodeInfo* node = tile->node(directededge.endnode());
 
@@ -258,10 +256,9 @@ void GetTurnTypes(const DirectedEdge& directededge,
 void EnhanceRightLane(const DirectedEdge& directededge,
                       const graph_tile_ptr& tilebuilder,
                       GraphReader& reader,
-                      std::mutex& lock,
                       std::vector<uint16_t>& enhanced_tls) {
   std::set<Turn::Type> outgoing_turn_type;
-  GetTurnTypes(directededge, outgoing_turn_type, tilebuilder, reader, lock);
+  GetTurnTypes(directededge, outgoing_turn_type, tilebuilder, reader);
 
   size_t index = enhanced_tls.size() - 1;
   uint16_t tl = enhanced_tls[index];
@@ -285,10 +282,9 @@ void EnhanceRightLane(const DirectedEdge& directededge,
 void EnhanceLeftLane(const DirectedEdge& directededge,
                      const graph_tile_ptr& tilebuilder,
                      GraphReader& reader,
-                     std::mutex& lock,
                      std::vector<uint16_t>& enhanced_tls) {
   std::set<Turn::Type> outgoing_turn_type;
-  GetTurnTypes(directededge, outgoing_turn_type, tilebuilder, reader, lock);
+  GetTurnTypes(directededge, outgoing_turn_type, tilebuilder, reader);
 
   uint16_t tl = enhanced_tls[0];
   if (outgoing_turn_type.find(Turn::Type::kSlightLeft) != outgoing_turn_type.end()) {
@@ -363,7 +359,6 @@ void UpdateTurnLanes(const OSMData& osmdata,
                      DirectedEdge& directededge,
                      boost::intrusive_ptr<GraphTileBuilder>& tilebuilder,
                      GraphReader& reader,
-                     std::mutex& lock,
                      std::vector<TurnLanes>& turn_lanes) {
 
   // Lambda to check if the turn set includes a right turn type
@@ -398,7 +393,7 @@ void UpdateTurnLanes(const OSMData& osmdata,
       enhanced_tls = TurnLanes::lanemasks(str);
 
       std::set<Turn::Type> outgoing_turn_type;
-      GetTurnTypes(directededge, outgoing_turn_type, tilebuilder, reader, lock);
+      GetTurnTypes(directededge, outgoing_turn_type, tilebuilder, reader);
       if (outgoing_turn_type.empty()) {
         directededge.set_turnlanes(false);
         return;
@@ -411,7 +406,7 @@ void UpdateTurnLanes(const OSMData& osmdata,
         if (has_turn_left(outgoing_turn_type)) {
           // check for a right.
           if (!directededge.start_restriction())
-            EnhanceRightLane(directededge, tilebuilder, reader, lock, enhanced_tls);
+            EnhanceRightLane(directededge, tilebuilder, reader, enhanced_tls);
         }
       }
     }
@@ -424,7 +419,7 @@ void UpdateTurnLanes(const OSMData& osmdata,
           (enhanced_tls.front() == kTurnLaneEmpty || enhanced_tls.front() == kTurnLaneNone)) {
 
         std::set<Turn::Type> outgoing_turn_type;
-        GetTurnTypes(directededge, outgoing_turn_type, tilebuilder, reader, lock);
+        GetTurnTypes(directededge, outgoing_turn_type, tilebuilder, reader);
         if (outgoing_turn_type.empty()) {
           directededge.set_turnlanes(false);
           return;
@@ -437,7 +432,7 @@ void UpdateTurnLanes(const OSMData& osmdata,
           if (has_turn_right(outgoing_turn_type)) {
             // check for a left
             if (!directededge.start_restriction())
-              EnhanceLeftLane(directededge, tilebuilder, reader, lock, enhanced_tls);
+              EnhanceLeftLane(directededge, tilebuilder, reader, enhanced_tls);
           }
         }
       }
@@ -463,9 +458,9 @@ void UpdateTurnLanes(const OSMData& osmdata,
 
         if (bUpdated && !directededge.start_restriction()) {
           // check for a right.
-          EnhanceRightLane(directededge, tilebuilder, reader, lock, enhanced_tls);
+          EnhanceRightLane(directededge, tilebuilder, reader, enhanced_tls);
           // check for a left
-          EnhanceLeftLane(directededge, tilebuilder, reader, lock, enhanced_tls);
+          EnhanceLeftLane(directededge, tilebuilder, reader, enhanced_tls);
         }
       }
     }
@@ -491,9 +486,9 @@ void UpdateTurnLanes(const OSMData& osmdata,
 
         if (bUpdated && !directededge.start_restriction()) {
           // check for a right.
-          EnhanceRightLane(directededge, tilebuilder, reader, lock, enhanced_tls);
+          EnhanceRightLane(directededge, tilebuilder, reader, enhanced_tls);
           // check for a left
-          EnhanceLeftLane(directededge, tilebuilder, reader, lock, enhanced_tls);
+          EnhanceLeftLane(directededge, tilebuilder, reader, enhanced_tls);
         }
       }
     }
@@ -519,11 +514,10 @@ constexpr uint32_t kUnreachableIterations = 20;
  * edge cannot reach higher class roads and a search cannot expand after
  * a set number of iterations the edge is considered unreachable.
  * @param  reader        Graph reader
- * @param  lock          Mutex for locking while tiles are retrieved
  * @param  directededge  Directed edge to test.
  * @return  Returns true if the edge is found to be unreachable.
  */
-bool IsUnreachable(GraphReader& reader, std::mutex& lock, DirectedEdge& directededge) {
+bool IsUnreachable(GraphReader& reader, DirectedEdge& directededge) {
   // Only check driveable edges. If already on a higher class road consider
   // the edge reachable
   if (!(directededge.forwardaccess() & kAutoAccess) ||
@@ -538,8 +532,8 @@ bool IsUnreachable(GraphReader& reader, std::mutex& lock, DirectedEdge& directed
 
   // Expand until we either find a tertiary or higher classification,
   // expand more than kUnreachableIterations nodes, or cannot expand
-  // any further. To reduce calls to lock and unlock keep a record of
-  // current tile and only read a new tile when needed.
+  // any further. To reduce tile lookups keep a record of current tile
+  // and only read a new tile when needed.
   uint32_t n = 0;
   GraphId prior_tile;
   graph_tile_ptr tile;
@@ -555,9 +549,7 @@ bool IsUnreachable(GraphReader& reader, std::mutex& lock, DirectedEdge& directed
     expandset.erase(expandset.begin());
     visitedset.insert(expandnode);
     if (expandnode.Tile_Base() != prior_tile) {
-      lock.lock();
       tile = reader.GetGraphTile(expandnode);
-      lock.unlock();
       prior_tile = expandnode.Tile_Base();
     }
     const NodeInfo* nodeinfo = tile->node(expandnode);
@@ -583,7 +575,6 @@ bool IsUnreachable(GraphReader& reader, std::mutex& lock, DirectedEdge& directed
 // Test if this is a "not thru" edge. These are edges that enter a region that
 // has no exit other than the edge entering the region
 bool IsNotThruEdge(GraphReader& reader,
-                   std::mutex& lock,
                    const GraphId& startnode,
                    DirectedEdge& directededge) {
   // Add the end node to the expand list
@@ -609,8 +600,8 @@ bool IsNotThruEdge(GraphReader& reader,
 
   // Expand edges until exhausted, the maximum number of expansions occur,
   // or end up back at the starting node. No node can be visited twice.
-  // To reduce calls to lock and unlock keep a record of current tile and
-  // only read a new tile when needed.
+  // To reduce tile lookups keep a record of current tile and only read
+  // a new tile when needed.
   GraphId prior_tile;
   graph_tile_ptr tile;
   for (uint32_t n = 0; n < kMaxNoThruTries; n++) {
@@ -625,9 +616,7 @@ bool IsNotThruEdge(GraphReader& reader,
     const GraphId expandnode = expandset[expand_pos++];
     visitedset.insert(expandnode);
     if (expandnode.Tile_Base() != prior_tile) {
-      lock.lock();
       tile = reader.GetGraphTile(expandnode);
-      lock.unlock();
       prior_tile = expandnode.Tile_Base();
     }
     const NodeInfo* nodeinfo = tile->node(expandnode);
@@ -664,7 +653,6 @@ bool IsNotThruEdge(GraphReader& reader,
 // Test if the edge is internal to an intersection.
 bool IsIntersectionInternal(const graph_tile_ptr& start_tile,
                             GraphReader& reader,
-                            std::mutex& lock,
                             const NodeInfo& startnodeinfo,
                             const DirectedEdge& directededge,
                             const uint32_t idx) {
@@ -746,9 +734,7 @@ bool IsIntersectionInternal(const graph_tile_ptr& start_tile,
   // Get the tile at the end node. and find inbound heading of the candidate
   // edge to the end node.
   if (tile->id() != directededge.endnode().Tile_Base()) {
-    lock.lock();
     tile = reader.GetGraphTile(directededge.endnode());
-    lock.unlock();
   }
   const NodeInfo* node = tile->node(directededge.endnode());
   diredge = tile->directededge(node->edge_index());
@@ -862,7 +848,6 @@ bool IsNextEdgeInternalImpl(const DirectedEdge directededge,
                             const graph_tile_ptr& end_node_tile,
                             const NodeInfo& end_node_info,
                             GraphReader& reader,
-                            std::mutex& lock,
                             bool infer_internal_intersections) {
   // Iterate through outbound edges to find the next edge
   for (uint32_t i = 0; i < end_node_info.edge_count(); i++) {
@@ -883,7 +868,7 @@ bool IsNextEdgeInternalImpl(const DirectedEdge directededge,
       if (!infer_internal_intersections)
         return diredge->internal();
       else
-        return IsIntersectionInternal(end_node_tile, reader, lock, end_node_info, *diredge, i);
+        return IsIntersectionInternal(end_node_tile, reader, end_node_info, *diredge, i);
     }
   }
   return false;
@@ -893,18 +878,15 @@ bool IsNextEdgeInternalImpl(const DirectedEdge directededge,
 bool IsNextEdgeInternal(const DirectedEdge directededge,
                         const graph_tile_ptr& tilebuilder,
                         GraphReader& reader,
-                        std::mutex& lock,
                         bool infer_internal_intersections) {
   if (tilebuilder->id() == directededge.endnode().Tile_Base()) {
     const NodeInfo& end_node_info = *tilebuilder->node(directededge.endnode().id());
-    return IsNextEdgeInternalImpl(directededge, tilebuilder, tilebuilder, end_node_info, reader, lock,
+    return IsNextEdgeInternalImpl(directededge, tilebuilder, tilebuilder, end_node_info, reader,
                                   infer_internal_intersections);
   } else {
     // Get the tile at the end node. and find inbound heading of the candidate
     // edge to the end node.
-    lock.lock();
     auto end_node_tile = GraphTile::Create(reader.tile_dir(), directededge.endnode());
-    lock.unlock();
 
     // this tile may not have been updated yet; therefore, we must
     // compute the headings for the end node as they are needed for the
@@ -914,7 +896,7 @@ bool IsNextEdgeInternal(const DirectedEdge directededge,
     uint32_t ntrans = std::min(count, kNumberOfEdgeTransitions);
     GetHeadings(end_node_tile, end_node_info, ntrans);
     return IsNextEdgeInternalImpl(directededge, tilebuilder, end_node_tile, end_node_info, reader,
-                                  lock, infer_internal_intersections);
+                                  infer_internal_intersections);
   }
 }
 
@@ -923,7 +905,6 @@ bool IsNextEdgeInternal(const DirectedEdge directededge,
  * value from 0-15 indicating a relative road density. This can be used
  * in costing methods to help avoid dense, urban areas.
  * @param  reader        Graph reader
- * @param  lock          Mutex for locking while tiles are retrieved
  * @param  ll            Lat,lng position
  * @param  maxdensity    (OUT) max density found
  * @param  tiles         Tiling (for getting list of required tiles)
@@ -932,7 +913,6 @@ bool IsNextEdgeInternal(const DirectedEdge directededge,
  *          more dense.
  */
 uint32_t GetDensity(GraphReader& reader,
-                    std::mutex& lock,
                     const PointLL& ll,
                     enhancer_stats& stats,
                     const Tiles<PointLL>& tiles,
@@ -956,9 +936,7 @@ uint32_t GetDensity(GraphReader& reader,
   for (const auto t : tilelist) {
     // Check all the nodes within the tile. Skip if tile has no nodes (can be
     // an empty tile added for connectivity map logic).
-    lock.lock();
     auto newtile = reader.GetGraphTile(GraphId(t, local_level, 0));
-    lock.unlock();
     if (!newtile || newtile->header()->nodecount() == 0) {
       continue;
     }
@@ -1415,14 +1393,16 @@ bool ConsistentNames(const std::string& country_code,
   return (!(street_names1->FindCommonBaseNames(*street_names2)->empty()));
 }
 
-// We make sure to lock on reading and writing because we dont want to race
-// since difference threads, use for the tilequeue as well
+// Tiles are read from tile_dir, which nothing writes while the threads run, and the
+// enhanced tiles are written to staging_dir. So no thread ever reads a tile that
+// another one is writing and they can all read the tiles they need without locking
 void enhance(const boost::property_tree::ptree& pt,
              const OSMData& osmdata,
              const std::string& access_file,
              const boost::property_tree::ptree& hierarchy_properties,
-             std::queue<GraphId>& tilequeue,
-             std::mutex& lock,
+             TileScheduler& scheduler,
+             const unsigned int worker,
+             const std::string& staging_dir,
              std::promise<enhancer_stats>& result) {
 
   auto less_than = [](const OSMAccess& a, const OSMAccess& b) { return a.way_id() < b.way_id(); };
@@ -1466,31 +1446,26 @@ void enhance(const boost::property_tree::ptree& pt,
   const auto& local_level = TileHierarchy::levels().back().level;
   const auto& tiles = TileHierarchy::levels().back().tiles;
 
-  // Iterate through the tiles in the queue and perform enhancements
+  // Iterate through the tiles handed out by the scheduler and perform enhancements
   while (true) {
-    // Get the next tile Id from the queue and get writeable and readable
-    // tile. Lock while we access the tile queue and get the tile.
-    lock.lock();
-    if (tilequeue.empty()) {
-      lock.unlock();
+    // Get the next tile Id from the scheduler and get writeable and readable
+    // tile.
+    GraphId tile_id;
+    if (!scheduler.Next(worker, tile_id)) {
       break;
     }
-    GraphId tile_id = tilequeue.front();
-    tilequeue.pop();
 
     // Get a readable tile.If the tile is empty, skip it. Empty tiles are
     // added where ways go through a tile but no end not is within the tile.
     // This allows creation of connectivity maps using the tile set,
     graph_tile_ptr tile = reader.GetGraphTile(tile_id);
     if (!tile || tile->header()->nodecount() == 0) {
-      lock.unlock();
       continue;
     }
 
     // Tile builder - serialize in existing tile so we can add admin names
     boost::intrusive_ptr<GraphTileBuilder> tilebuilder =
         new GraphTileBuilder(reader.tile_dir(), tile_id, true, false);
-    lock.unlock();
 
     // this will be our updated list of restrictions.
     // need to do some conversions on weights; therefore, we must update
@@ -1557,9 +1532,7 @@ void enhance(const boost::property_tree::ptree& pt,
         if (tile->id() == directededge.endnode().Tile_Base()) {
           endnodetile = tile;
         } else {
-          lock.lock();
           endnodetile = reader.GetGraphTile(directededge.endnode());
-          lock.unlock();
         }
 
         // If this edge is a link, update its use (potentially change short
@@ -1585,7 +1558,7 @@ void enhance(const boost::property_tree::ptree& pt,
       // Get relative road density and local density if the urban tag is not set
       uint32_t density = 0;
       if (!use_urban_tag) {
-        density = GetDensity(reader, lock, nodeinfo.latlng(base_ll), stats, tiles, local_level);
+        density = GetDensity(reader, nodeinfo.latlng(base_ll), stats, tiles, local_level);
         nodeinfo.set_density(density);
       }
 
@@ -1613,9 +1586,7 @@ void enhance(const boost::property_tree::ptree& pt,
           end_admin_index = tile->node(directededge.endnode().id())->admin_index();
           end_node_code = tile->admin(end_admin_index)->country_iso();
         } else {
-          lock.lock();
           endnodetile = reader.GetGraphTile(directededge.endnode());
-          lock.unlock();
           end_admin_index = endnodetile->node(directededge.endnode().id())->admin_index();
           end_node_code = endnodetile->admin(end_admin_index)->country_iso();
         }
@@ -1744,7 +1715,7 @@ void enhance(const boost::property_tree::ptree& pt,
         // Test if an internal intersection edge. Must do this after setting
         // opposing edge index
         if (infer_internal_intersections &&
-            IsIntersectionInternal(tilebuilder, reader, lock, nodeinfo, directededge, j)) {
+            IsIntersectionInternal(tilebuilder, reader, nodeinfo, directededge, j)) {
           directededge.set_internal(true);
         }
 
@@ -1755,14 +1726,14 @@ void enhance(const boost::property_tree::ptree& pt,
         // Enhance and add turn lanes if not an internal edge.
         if (directededge.turnlanes()) {
           // Update turn lanes.
-          UpdateTurnLanes(osmdata, nodeinfo.edge_index() + j, directededge, tilebuilder, reader, lock,
+          UpdateTurnLanes(osmdata, nodeinfo.edge_index() + j, directededge, tilebuilder, reader,
                           turn_lanes);
         }
 
         // Check for not_thru edge (only on low importance edges). Exclude
         // transit edges
         if (directededge.classification() > RoadClass::kTertiary) {
-          if (IsNotThruEdge(reader, lock, startnode, directededge)) {
+          if (IsNotThruEdge(reader, startnode, directededge)) {
             directededge.set_not_thru(true);
             stats.not_thru++;
           }
@@ -1819,16 +1790,14 @@ void enhance(const boost::property_tree::ptree& pt,
     }
     tilebuilder->AddTurnLanes(turn_lanes);
 
-    // Write the new file
-    lock.lock();
-    tilebuilder->StoreTileData();
+    // Write the new file next to the tiles the other threads are still reading
+    tilebuilder->StoreTileData(staging_dir);
     LOG_TRACE((boost::format("GraphEnhancer completed tile %1%") % tile_id).str());
 
     // Check if we need to clear the tile cache
     if (reader.OverCommitted()) {
       reader.Trim();
     }
-    lock.unlock();
   }
 
   if (admin_db_handle) {
@@ -1850,42 +1819,57 @@ void GraphEnhancer::Enhance(const boost::property_tree::ptree& pt,
                             const std::string& access_file) {
   LOG_INFO("Enhancing local graph...");
 
+  // Hand out the local tiles, the largest ones first
+  boost::property_tree::ptree hierarchy_properties = pt.get_child("mjolnir");
+  auto local_level = TileHierarchy::levels().back().level;
+  GraphReader reader(hierarchy_properties);
+  auto local_tiles = reader.GetTileSet(local_level);
+  TileScheduler scheduler(TileScheduler::FileSizes(reader.tile_dir(), local_tiles),
+                          std::max(static_cast<unsigned int>(1),
+                                   pt.get<unsigned int>("mjolnir.concurrency",
+                                                        std::thread::hardware_concurrency())));
+
   // A place to hold worker threads and their results, exceptions or otherwise
-  std::vector<std::shared_ptr<std::thread>> threads(
-      std::max(static_cast<unsigned int>(1),
-               pt.get<unsigned int>("mjolnir.concurrency", std::thread::hardware_concurrency())));
+  std::vector<std::shared_ptr<std::thread>> threads(scheduler.concurrency());
 
   // A place to hold the results of those threads, exceptions or otherwise
   std::list<std::promise<enhancer_stats>> results;
 
-  // Create a randomized queue of tiles to work from
-  std::deque<GraphId> tempqueue;
-  boost::property_tree::ptree hierarchy_properties = pt.get_child("mjolnir");
-  auto local_level = TileHierarchy::levels().back().level;
-  GraphReader reader(hierarchy_properties);
-  auto local_tiles = reader.GetTileSet(local_level);
-  for (const auto& tile_id : local_tiles) {
-    tempqueue.emplace_back(tile_id);
+  // The enhanced tiles are kept apart until every thread is done reading the tiles
+  std::string tile_dir = reader.tile_dir();
+  while (tile_dir.size() > 1 && tile_dir.back() == filesystem::path::preferred_separator) {
+    tile_dir.pop_back();
+  }
+  const std::string staging_dir = tile_dir + ".enhance";
+  if (filesystem::exists(staging_dir)) {
+    filesystem::remove_all(staging_dir);
   }
-  std::random_device rd;
-  std::shuffle(tempqueue.begin(), tempqueue.end(), std::mt19937(rd()));
-  std::queue<GraphId> tilequeue(tempqueue);
-
-  // An atomic object we can use to do the synchronization
-  std::mutex lock;
 
   // Start the threads
-  for (auto& thread : threads) {
+  for (size_t i = 0; i < threads.size(); ++i) {
     results.emplace_back();
-    thread.reset(new std::thread(enhance, std::cref(hierarchy_properties), std::cref(osmdata),
-                                 std::cref(access_file), std::ref(hierarchy_properties),
-                                 std::ref(tilequeue), std::ref(lock), std::ref(results.back())));
+    threads[i].reset(new std::thread(enhance, std::cref(hierarchy_properties), std::cref(osmdata),
+                                     std::cref(access_file), std::ref(hierarchy_properties),
+                                     std::ref(scheduler), i, std::cref(staging_dir),
+                                     std::ref(results.back())));
   }
 
   // Wait for them to finish up their work
   for (auto& thread : threads) {
     thread->join();
   }
+  scheduler.LogUtilization("Enhanced");
+
+  // Move the enhanced tiles into place. Empty tiles are not enhanced so they stay as they are
+  for (const auto& tile_id : local_tiles) {
+    const auto suffix = filesystem::path::preferred_separator + GraphTile::FileSuffix(tile_id);
+    const auto staged = staging_dir + suffix;
+    if (filesystem::exists(staged) &&
+        std::rename(staged.c_str(), (tile_dir + suffix).c_str()) != 0) {
+      throw std::runtime_error("Could not move " + staged + " to " + tile_dir + suffix);
+    }
+  }
+  filesystem::remove_all(staging_dir);
 
   // Check all of the outcomes, to see about maximum density (km/km2)
   enhancer_stats stats{std::numeric_limits<float>::min(), 0};
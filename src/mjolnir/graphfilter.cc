@@ -1,9 +1,16 @@
 #include "mjolnir/graphfilter.h"
 #include "mjolnir/graphtilebuilder.h"
+#include "mjolnir/tilescheduler.h"
 
+#include <algorithm>
 #include <boost/property_tree/ptree.hpp>
+#include <future>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <thread>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "baldr/graphconstants.h"
@@ -22,28 +29,41 @@ using namespace valhalla::mjolnir;
 
 namespace {
 
-uint32_t n_original_edges = 0;
-uint32_t n_original_nodes = 0;
-uint32_t n_filtered_edges = 0;
-uint32_t n_filtered_nodes = 0;
-uint32_t can_aggregate = 0;
+// What a thread found while filtering its tiles
+struct filter_result_t {
+  uint32_t n_original_edges = 0;
+  uint32_t n_original_nodes = 0;
+  uint32_t n_filtered_edges = 0;
+  uint32_t n_filtered_nodes = 0;
+  uint32_t can_aggregate = 0;
+  // Original node Ids and the new node Ids they became (after filtering)
+  std::vector<std::pair<GraphId, GraphId>> old_to_new;
+};
 
 // Group wheelchair and pedestrian access together
 constexpr uint32_t kAllPedestrianAccess = (kPedestrianAccess | kWheelchairAccess);
 
 /**
- * Filter edges to optionally remove edges by access.
- * @param  reader  Graph reader.
- * @param  old_to_new  Map of original node Ids to new nodes Ids (after filtering).
+ * Filter edges to optionally remove edges by access. Tiles are taken from the scheduler until it
+ * has none left. A tile is only read from and written to by the thread that took it.
+ * @param  pt  Configuration.
+ * @param  scheduler  Hands out the tiles left to filter.
+ * @param  worker  Index of this thread in the scheduler.
  * @param  include_driving  Include edge if driving (any vehicular) access in either direction.
  * @param  include_bicycle  Include edge if bicycle access in either direction.
  * @param  include_pedestrian  Include edge if pedestrian or wheelchair access in either direction.
+ * @param  result  Counts and the association of original node Ids to new node Ids.
  */
-void FilterTiles(GraphReader& reader,
-                 std::unordered_map<GraphId, GraphId>& old_to_new,
+void FilterTiles(const boost::property_tree::ptree& pt,
+                 TileScheduler& scheduler,
+                 const unsigned int worker,
                  const bool include_driving,
                  const bool include_bicycle,
-                 const bool include_pedestrian) {
+                 const bool include_pedestrian,
+                 std::promise<filter_result_t>& result) {
+  // Each thread reads its tiles on its own
+  GraphReader reader(pt.get_child("mjolnir"));
+  filter_result_t stats;
 
   // lambda to check if an edge should be included
   auto include_edge = [&include_driving, &include_bicycle,
@@ -59,13 +79,12 @@ void FilterTiles(GraphReader& reader,
            (pedestrian_access && include_pedestrian);
   };
 
-  // Iterate through all tiles in the local level
-  auto local_tiles = reader.GetTileSet(TileHierarchy::levels().back().level);
-  for (const auto& tile_id : local_tiles) {
+  GraphId tile_id;
+  while (scheduler.Next(worker, tile_id)) {
     // Create a new tilebuilder - should copy header information
     GraphTileBuilder tilebuilder(reader.tile_dir(), tile_id, false);
-    n_original_nodes += tilebuilder.header()->nodecount();
-    n_original_edges += tilebuilder.header()->directededgecount();
+    stats.n_original_nodes += tilebuilder.header()->nodecount();
+    stats.n_original_edges += tilebuilder.header()->directededgecount();
 
     // Get the graph tile. Read from this tile to create the new tile.
     graph_tile_ptr tile = reader.GetGraphTile(tile_id);
@@ -89,7 +108,7 @@ void FilterTiles(GraphReader& reader,
         // Check if the directed edge should be included
         const DirectedEdge* directededge = tile->directededge(edgeid);
         if (!include_edge(directededge)) {
-          ++n_filtered_edges;
+          ++stats.n_filtered_edges;
           continue;
         }
 
@@ -183,15 +202,15 @@ void FilterTiles(GraphReader& reader,
         }
 
         // Associate the old node to the new node.
-        old_to_new[nodeid] = new_node;
+        stats.old_to_new.emplace_back(nodeid, new_node);
 
         // Check if edges at this node can be aggregated. Only 2 edges, same way Id (so that
         // edge attributes should match), don't end at same node (no loops).
         if (edge_count == 2 && wayid[0] == wayid[1] && endnode[0] != endnode[1]) {
-          ++can_aggregate;
+          ++stats.can_aggregate;
         }
       } else {
-        ++n_filtered_nodes;
+        ++stats.n_filtered_nodes;
       }
     }
 
@@ -210,27 +229,27 @@ void FilterTiles(GraphReader& reader,
       reader.Trim();
     }
   }
-  LOG_INFO("Filtered " + std::to_string(n_filtered_nodes) + " nodes out of " +
-           std::to_string(n_original_nodes));
-  LOG_INFO("Filtered " + std::to_string(n_filtered_edges) + " directededges out of " +
-           std::to_string(n_original_edges));
-  LOG_INFO("Can aggregate: " + std::to_string(can_aggregate));
+
+  // Fill promise with return data
+  result.set_value(std::move(stats));
 }
 
 /**
- * Update end nodes of all directed edges.
- * @param  reader  Graph reader.
+ * Update end nodes of all directed edges. Tiles are taken from the scheduler until it has none
+ * left.
+ * @param  pt  Configuration.
+ * @param  scheduler  Hands out the tiles left to update.
+ * @param  worker  Index of this thread in the scheduler.
  * @param  old_to_new  Map of original node Ids to new nodes Ids (after filtering).
  */
-void UpdateEndNodes(GraphReader& reader, std::unordered_map<GraphId, GraphId>& old_to_new) {
-  LOG_INFO("Update end nodes of directed edges");
-
-  int found = 0;
-  int not_found = 0;
-
-  // Iterate through all tiles in the local level
-  auto local_tiles = reader.GetTileSet(TileHierarchy::levels().back().level);
-  for (const auto& tile_id : local_tiles) {
+void UpdateEndNodes(const boost::property_tree::ptree& pt,
+                    TileScheduler& scheduler,
+                    const unsigned int worker,
+                    const std::unordered_map<GraphId, GraphId>& old_to_new) {
+  // Each thread reads its tiles on its own
+  GraphReader reader(pt.get_child("mjolnir"));
+  GraphId tile_id;
+  while (scheduler.Next(worker, tile_id)) {
     // Get the graph tile. Skip if no tile exists (should not happen!?)
     graph_tile_ptr tile = reader.GetGraphTile(tile_id);
     assert(tile);
@@ -258,7 +277,6 @@ void UpdateEndNodes(GraphReader& reader, std::unordered_map<GraphId, GraphId>& o
         LOG_ERROR("UpdateEndNodes - failed to find associated node");
       } else {
         end_node = iter->second;
-        found++;
       }
 
       // Copy the edge to the directededges vector and update the end node
@@ -284,8 +302,6 @@ namespace mjolnir {
 // Optionally filter edges and nodes based on access.
 void GraphFilter::Filter(const boost::property_tree::ptree& pt) {
 
-  // TODO: thread this. Could be difficult due to sequence creates to associate nodes
-
   // Edge filtering (optionally exclude edges)
   bool include_driving = pt.get_child("mjolnir").get<bool>("include_driving", true);
   if (!include_driving) {
@@ -305,21 +321,66 @@ void GraphFilter::Filter(const boost::property_tree::ptree& pt) {
     return;
   }
 
-  // Map of old node Ids to new node Ids (after filtering).
-  std::unordered_map<baldr::GraphId, baldr::GraphId> old_to_new;
-
-  // Construct GraphReader
+  // Every tile is filtered on its own so they can be spread over the threads
+  unsigned int concurrency =
+      std::max(static_cast<unsigned int>(1),
+               pt.get<unsigned int>("mjolnir.concurrency", std::thread::hardware_concurrency()));
   GraphReader reader(pt.get_child("mjolnir"));
+  auto local_level = TileHierarchy::levels().back().level;
+  std::unique_ptr<TileScheduler> scheduler(new TileScheduler(
+      TileScheduler::FileSizes(reader.tile_dir(), reader.GetTileSet(local_level)), concurrency));
 
   // Filter edges (and nodes) by access
-  FilterTiles(reader, old_to_new, include_driving, include_bicycle, include_pedestrian);
+  std::vector<std::shared_ptr<std::thread>> threads(scheduler->concurrency());
+  std::list<std::promise<filter_result_t>> results;
+  for (unsigned int i = 0; i < threads.size(); ++i) {
+    results.emplace_back();
+    threads[i].reset(new std::thread(FilterTiles, std::cref(pt), std::ref(*scheduler), i,
+                                     include_driving, include_bicycle, include_pedestrian,
+                                     std::ref(results.back())));
+  }
+  for (auto& thread : threads) {
+    thread->join();
+  }
+
+  // Map of old node Ids to new node Ids (after filtering). The threads only know the nodes of
+  // their own tiles so associating them is done here, once all the tiles are filtered
+  std::unordered_map<baldr::GraphId, baldr::GraphId> old_to_new;
+  filter_result_t stats;
+  for (auto& result : results) {
+    auto thread_stats = result.get_future().get();
+    stats.n_original_nodes += thread_stats.n_original_nodes;
+    stats.n_original_edges += thread_stats.n_original_edges;
+    stats.n_filtered_nodes += thread_stats.n_filtered_nodes;
+    stats.n_filtered_edges += thread_stats.n_filtered_edges;
+    stats.can_aggregate += thread_stats.can_aggregate;
+    old_to_new.reserve(old_to_new.size() + thread_stats.old_to_new.size());
+    old_to_new.insert(thread_stats.old_to_new.begin(), thread_stats.old_to_new.end());
+  }
+  scheduler->LogUtilization("Filtered");
+  LOG_INFO("Filtered " + std::to_string(stats.n_filtered_nodes) + " nodes out of " +
+           std::to_string(stats.n_original_nodes));
+  LOG_INFO("Filtered " + std::to_string(stats.n_filtered_edges) + " directededges out of " +
+           std::to_string(stats.n_original_edges));
+  LOG_INFO("Can aggregate: " + std::to_string(stats.can_aggregate));
 
   // TODO - aggregate / combine edges across false nodes (only 2 directed edges)
   // where way Ids are equal
 
-  // Update end nodes. Clear the GraphReader cache first.
-  reader.Clear();
-  UpdateEndNodes(reader, old_to_new);
+  // Update end nodes of the tiles that are left
+  LOG_INFO("Update end nodes of directed edges");
+  scheduler.reset(new TileScheduler(TileScheduler::FileSizes(reader.tile_dir(),
+                                                              reader.GetTileSet(local_level)),
+                                    concurrency));
+  threads.resize(scheduler->concurrency());
+  for (unsigned int i = 0; i < threads.size(); ++i) {
+    threads[i].reset(new std::thread(UpdateEndNodes, std::cref(pt), std::ref(*scheduler), i,
+                                     std::cref(old_to_new)));
+  }
+  for (auto& thread : threads) {
+    thread->join();
+  }
+  scheduler->LogUtilization("Updated the end nodes of");
 
   LOG_INFO("Done GraphFilter");
 }
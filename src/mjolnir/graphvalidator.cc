@@ -1,6 +1,7 @@
 
 #include "mjolnir/graphvalidator.h"
 #include "mjolnir/graphtilebuilder.h"
+#include "mjolnir/tilescheduler.h"
 #include "mjolnir/util.h"
 
 #include <boost/format.hpp>
@@ -248,7 +249,8 @@ uint32_t GetOpposingEdgeIndex(const GraphId& startnode,
 using tweeners_t = GraphTileBuilder::tweeners_t;
 void validate(
     const boost::property_tree::ptree& pt,
-    std::deque<GraphId>& tilequeue,
+    TileScheduler& scheduler,
+    const unsigned int worker,
     std::mutex& lock,
     std::promise<std::tuple<std::vector<uint32_t>, std::vector<std::vector<float>>, tweeners_t>>&
         result) {
@@ -270,16 +272,8 @@ void validate(
   std::set<uint32_t> problem_ways;
 
   // Check for more tiles
-  while (true) {
-    lock.lock();
-    if (tilequeue.empty()) {
-      lock.unlock();
-      break;
-    }
-    // Get the next tile Id
-    GraphId tile_id = tilequeue.front();
-    tilequeue.pop_front();
-    lock.unlock();
+  GraphId tile_id;
+  while (scheduler.Next(worker, tile_id)) {
 
     // Point tiles to the set we need for current level
     const auto& tiles = tile_id.level() == TileHierarchy::GetTransitLevel().level
@@ -543,28 +537,25 @@ void GraphValidator::Validate(const boost::property_tree::ptree& pt) {
   auto hierarchy_properties = pt.get_child("mjolnir");
   std::string tile_dir = hierarchy_properties.get<std::string>("tile_dir");
 
-  // Create a randomized queue of tiles (at all levels) to work from
-  std::deque<GraphId> tilequeue;
+  // Hand out the tiles (at all levels), the largest ones first
   GraphReader reader(pt.get_child("mjolnir"));
   auto tileset = reader.GetTileSet();
-  for (const auto& id : tileset) {
-    tilequeue.emplace_back(id);
-  }
-  // fixed seed for reproducible tile build
-  std::shuffle(tilequeue.begin(), tilequeue.end(), std::mt19937(3));
+  TileScheduler scheduler(TileScheduler::FileSizes(tile_dir, tileset),
+                          std::max(static_cast<unsigned int>(1),
+                                   pt.get<unsigned int>("mjolnir.concurrency",
+                                                        std::thread::hardware_concurrency())));
 
   // Remember what the dataset id is in case we have to make some tiles
-  graph_tile_ptr first_tile = GraphTile::Create(tile_dir, *tilequeue.begin());
-  assert(tilequeue.size() && first_tile);
+  assert(tileset.size());
+  graph_tile_ptr first_tile = GraphTile::Create(tile_dir, *tileset.begin());
+  assert(first_tile);
   auto dataset_id = first_tile->header()->dataset_id();
 
   // An mutex we can use to do the synchronization
   std::mutex lock;
 
   // Setup threads
-  std::vector<std::shared_ptr<std::thread>> threads(
-      std::max(static_cast<unsigned int>(1),
-               pt.get<unsigned int>("mjolnir.concurrency", std::thread::hardware_concurrency())));
+  std::vector<std::shared_ptr<std::thread>> threads(scheduler.concurrency());
 
   // Setup promises
   std::list<
@@ -572,16 +563,18 @@ void GraphValidator::Validate(const boost::property_tree::ptree& pt) {
       results;
 
   // Spawn the threads
-  for (auto& thread : threads) {
+  for (size_t i = 0; i < threads.size(); ++i) {
     results.emplace_back();
-    thread.reset(new std::thread(validate, std::cref(pt), std::ref(tilequeue), std::ref(lock),
-                                 std::ref(results.back())));
+    threads[i].reset(new std::thread(validate, std::cref(pt), std::ref(scheduler), i,
+                                     std::ref(lock), std::ref(results.back())));
   }
 
   // Wait for threads to finish
   for (auto& thread : threads) {
     thread->join();
   }
+  scheduler.LogUtilization("Validated");
+
   // Get the promise from the future
   std::vector<uint32_t> duplicates(TileHierarchy::levels().size(), 0);
   std::vector<std::vector<float>> densities(3);
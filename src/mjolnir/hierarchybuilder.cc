@@ -1,14 +1,18 @@
 #include "mjolnir/hierarchybuilder.h"
 #include "mjolnir/graphtilebuilder.h"
+#include "mjolnir/tilescheduler.h"
 
 #include <boost/format.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include <algorithm>
 #include <iostream>
 #include <map>
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -121,10 +125,20 @@ bool OpposingEdgeInfoMatches(const graph_tile_ptr& tile, const DirectedEdge* edg
   return false;
 }
 
-// Form tiles in the new level.
-void FormTilesInNewLevel(GraphReader& reader,
+// The range of new nodes in the (sorted) new to old sequence that belong to each new tile
+using tile_ranges_t = std::unordered_map<GraphId, std::pair<size_t, size_t>>;
+
+// Form the new tiles the scheduler hands out. A new tile only depends on the base tiles and on the
+// node associations so the tiles can be formed in any order and on any thread
+void FormTilesInNewLevel(const boost::property_tree::ptree& pt,
                          const std::string& new_to_old_file,
-                         const std::string& old_to_new_file) {
+                         const std::string& old_to_new_file,
+                         const tile_ranges_t& tile_ranges,
+                         TileScheduler& scheduler,
+                         const unsigned int worker) {
+  // Each thread reads the base tiles on its own
+  GraphReader reader(pt.get_child("mjolnir"));
+
   // Use the sequence that associate new nodes to old nodes
   sequence<std::pair<GraphId, GraphId>> new_to_old(new_to_old_file, false);
 
@@ -158,218 +172,205 @@ void FormTilesInNewLevel(GraphReader& reader,
     }
   };
 
-  // Iterate through the new nodes. They have been sorted by level so that
-  // highway level is done first.
-  reader.Clear();
   bool added = false;
-  uint8_t current_level;
-  GraphId tile_id;
   std::hash<std::string> hasher;
-  PointLL base_ll;
-  GraphTileBuilder* tilebuilder = nullptr;
-  for (auto new_node = new_to_old.begin(); new_node != new_to_old.end(); new_node++) {
-    // Get the node - check if a new tile
-    GraphId nodea = (*new_node).first;
-    if (nodea.Tile_Base() != tile_id) {
-      // Store the prior tile
-      if (tilebuilder != nullptr) {
-        tilebuilder->StoreTileData();
-        delete tilebuilder;
-      }
-
-      // New tilebuilder for the next tile. Update current level.
-      tile_id = nodea.Tile_Base();
-      tilebuilder = new GraphTileBuilder(reader.tile_dir(), tile_id, false);
-      current_level = nodea.level();
-
-      // Set the base ll for this tile
-      base_ll = TileHierarchy::get_tiling(current_level).Base(tile_id.tileid());
-      tilebuilder->header_builder().set_base_ll(base_ll);
+  GraphId tile_id;
+  while (scheduler.Next(worker, tile_id)) {
+    // New tilebuilder for the tile. Update current level.
+    const auto& range = tile_ranges.at(tile_id);
+    auto new_node = new_to_old.at(range.first);
+    GraphTileBuilder tilebuilder(reader.tile_dir(), tile_id, false);
+    uint8_t current_level = tile_id.level();
 
-      // Check if we need to clear the base/local tile cache
-      if (reader.OverCommitted()) {
-        reader.Trim();
-      }
-    }
+    // Set the base ll for this tile
+    PointLL base_ll = TileHierarchy::get_tiling(current_level).Base(tile_id.tileid());
+    tilebuilder.header_builder().set_base_ll(base_ll);
 
-    // Get the node in the base level
-    GraphId base_node = (*new_node).second;
-    graph_tile_ptr tile = reader.GetGraphTile(base_node);
-    if (tile == nullptr) {
-      LOG_ERROR("Base tile is null? ");
-      continue;
-    }
+    for (size_t n = range.first; n < range.second; ++n, ++new_node) {
+      GraphId nodea = (*new_node).first;
 
-    // Copy the data version
-    tilebuilder->header_builder().set_dataset_id(tile->header()->dataset_id());
-
-    // Copy node information and set the node lat,lon offsets within the new tile
-    NodeInfo baseni = *(tile->node(base_node.id()));
-    tilebuilder->nodes().push_back(baseni);
-    const auto& admin = tile->admininfo(baseni.admin_index());
-    NodeInfo& node = tilebuilder->nodes().back();
-    node.set_latlng(base_ll, baseni.latlng(tile->header()->base_ll()));
-    node.set_edge_index(tilebuilder->directededges().size());
-    node.set_timezone(baseni.timezone());
-    node.set_admin_index(tilebuilder->AddAdmin(admin.country_text(), admin.state_text(),
-                                               admin.country_iso(), admin.state_iso()));
-
-    // Update node LL based on tile base
-    // Density at this node
-    uint32_t density1 = baseni.density();
-
-    // Current edge count
-    size_t edge_count = tilebuilder->directededges().size();
-
-    // Iterate through directed edges of the base node to get remaining
-    // directed edges (based on classification/importance cutoff)
-    GraphId base_edge_id(base_node.tileid(), base_node.level(), baseni.edge_index());
-    for (uint32_t i = 0; i < baseni.edge_count(); i++, ++base_edge_id) {
-      // Check if the directed edge should exist on this level
-      const DirectedEdge* directededge = tile->directededge(base_edge_id);
-      if (!include_edge(directededge, base_node, current_level)) {
+      // Get the node in the base level
+      GraphId base_node = (*new_node).second;
+      graph_tile_ptr tile = reader.GetGraphTile(base_node);
+      if (tile == nullptr) {
+        LOG_ERROR("Base tile is null? ");
         continue;
       }
 
-      // Copy the directed edge information
-      DirectedEdge newedge = *directededge;
-
-      // Set the end node for this edge. Transit connection edges
-      // remain connected to the same node on the transit level.
-      // Need to set nodeb for use in AddEdgeInfo
-      uint32_t density2 = 32;
-      GraphId nodeb;
-      if (directededge->use() == Use::kTransitConnection ||
-          directededge->use() == Use::kEgressConnection ||
-          directededge->use() == Use::kPlatformConnection) {
-        nodeb = directededge->endnode();
-      } else {
-        auto new_nodes = find_nodes(old_to_new, directededge->endnode());
-        if (current_level == 0) {
-          nodeb = new_nodes.highway_node;
-        } else if (current_level == 1) {
-          nodeb = new_nodes.arterial_node;
+      // Copy the data version
+      tilebuilder.header_builder().set_dataset_id(tile->header()->dataset_id());
+
+      // Copy node information and set the node lat,lon offsets within the new tile
+      NodeInfo baseni = *(tile->node(base_node.id()));
+      tilebuilder.nodes().push_back(baseni);
+      const auto& admin = tile->admininfo(baseni.admin_index());
+      NodeInfo& node = tilebuilder.nodes().back();
+      node.set_latlng(base_ll, baseni.latlng(tile->header()->base_ll()));
+      node.set_edge_index(tilebuilder.directededges().size());
+      node.set_timezone(baseni.timezone());
+      node.set_admin_index(tilebuilder.AddAdmin(admin.country_text(), admin.state_text(),
+                                                admin.country_iso(), admin.state_iso()));
+
+      // Update node LL based on tile base
+      // Density at this node
+      uint32_t density1 = baseni.density();
+
+      // Current edge count
+      size_t edge_count = tilebuilder.directededges().size();
+
+      // Iterate through directed edges of the base node to get remaining
+      // directed edges (based on classification/importance cutoff)
+      GraphId base_edge_id(base_node.tileid(), base_node.level(), baseni.edge_index());
+      for (uint32_t i = 0; i < baseni.edge_count(); i++, ++base_edge_id) {
+        // Check if the directed edge should exist on this level
+        const DirectedEdge* directededge = tile->directededge(base_edge_id);
+        if (!include_edge(directededge, base_node, current_level)) {
+          continue;
+        }
+
+        // Copy the directed edge information
+        DirectedEdge newedge = *directededge;
+
+        // Set the end node for this edge. Transit connection edges
+        // remain connected to the same node on the transit level.
+        // Need to set nodeb for use in AddEdgeInfo
+        uint32_t density2 = 32;
+        GraphId nodeb;
+        if (directededge->use() == Use::kTransitConnection ||
+            directededge->use() == Use::kEgressConnection ||
+            directededge->use() == Use::kPlatformConnection) {
+          nodeb = directededge->endnode();
         } else {
-          nodeb = new_nodes.local_node;
+          auto new_nodes = find_nodes(old_to_new, directededge->endnode());
+          if (current_level == 0) {
+            nodeb = new_nodes.highway_node;
+          } else if (current_level == 1) {
+            nodeb = new_nodes.arterial_node;
+          } else {
+            nodeb = new_nodes.local_node;
+          }
+          density2 = new_nodes.density;
         }
-        density2 = new_nodes.density;
-      }
-      if (!nodeb.Is_Valid()) {
-        LOG_ERROR("Invalid end node - not found in old_to_new map");
-      }
-      newedge.set_endnode(nodeb);
+        if (!nodeb.Is_Valid()) {
+          LOG_ERROR("Invalid end node - not found in old_to_new map");
+        }
+        newedge.set_endnode(nodeb);
 
-      // Set the edge density  to the average of the relative density at the
-      // end nodes.
-      uint32_t edge_density = (density2 == 32) ? density1 : (density1 + density2) / 2;
-      newedge.set_density(edge_density);
+        // Set the edge density  to the average of the relative density at the
+        // end nodes.
+        uint32_t edge_density = (density2 == 32) ? density1 : (density1 + density2) / 2;
+        newedge.set_density(edge_density);
 
-      // Set opposing edge indexes to 0 (gets set in graph validator).
-      newedge.set_opp_index(0);
+        // Set opposing edge indexes to 0 (gets set in graph validator).
+        newedge.set_opp_index(0);
 
-      // Get signs from the base directed edge
-      if (directededge->sign()) {
-        std::vector<SignInfo> signs = tile->GetSigns(base_edge_id.id());
-        if (signs.size() == 0) {
-          LOG_ERROR("Base edge should have signs, but none found");
+        // Get signs from the base directed edge
+        if (directededge->sign()) {
+          std::vector<SignInfo> signs = tile->GetSigns(base_edge_id.id());
+          if (signs.size() == 0) {
+            LOG_ERROR("Base edge should have signs, but none found");
+          }
+          tilebuilder.AddSigns(tilebuilder.directededges().size(), signs);
         }
-        tilebuilder->AddSigns(tilebuilder->directededges().size(), signs);
-      }
-
-      // Get turn lanes from the base directed edge
-      if (directededge->turnlanes()) {
-        uint32_t offset = tile->turnlanes_offset(base_edge_id.id());
-        tilebuilder->AddTurnLanes(tilebuilder->directededges().size(), tile->GetName(offset));
-      }
 
-      // Get access restrictions from the base directed edge. Add these to
-      // the list of access restrictions in the new tile. Update the
-      // edge index in the restriction to be the current directed edge Id
-      if (directededge->access_restriction()) {
-        auto restrictions = tile->GetAccessRestrictions(base_edge_id.id(), kAllAccess);
-        for (const auto& res : restrictions) {
-          tilebuilder->AddAccessRestriction(AccessRestriction(tilebuilder->directededges().size(),
-                                                              res.type(), res.modes(), res.value()));
+        // Get turn lanes from the base directed edge
+        if (directededge->turnlanes()) {
+          uint32_t offset = tile->turnlanes_offset(base_edge_id.id());
+          tilebuilder.AddTurnLanes(tilebuilder.directededges().size(), tile->GetName(offset));
         }
-      }
 
-      // Copy lane connectivity
-      if (directededge->laneconnectivity()) {
-        auto laneconnectivity = tile->GetLaneConnectivity(base_edge_id.id());
-        if (laneconnectivity.size() == 0) {
-          LOG_ERROR("Base edge should have lane connectivity, but none found");
+        // Get access restrictions from the base directed edge. Add these to
+        // the list of access restrictions in the new tile. Update the
+        // edge index in the restriction to be the current directed edge Id
+        if (directededge->access_restriction()) {
+          auto restrictions = tile->GetAccessRestrictions(base_edge_id.id(), kAllAccess);
+          for (const auto& res : restrictions) {
+            tilebuilder.AddAccessRestriction(AccessRestriction(tilebuilder.directededges().size(),
+                                                               res.type(), res.modes(),
+                                                               res.value()));
+          }
         }
-        for (auto& lc : laneconnectivity) {
-          lc.set_to(tilebuilder->directededges().size());
+
+        // Copy lane connectivity
+        if (directededge->laneconnectivity()) {
+          auto laneconnectivity = tile->GetLaneConnectivity(base_edge_id.id());
+          if (laneconnectivity.size() == 0) {
+            LOG_ERROR("Base edge should have lane connectivity, but none found");
+          }
+          for (auto& lc : laneconnectivity) {
+            lc.set_to(tilebuilder.directededges().size());
+          }
+          tilebuilder.AddLaneConnectivity(laneconnectivity);
         }
-        tilebuilder->AddLaneConnectivity(laneconnectivity);
-      }
 
-      // Do we need to force adding edgeinfo (opposing edge could have diff names)?
-      // If end node is in the same tile and there is no opposing edge with matching
-      // edge_info_offset).
-      uint32_t idx = directededge->edgeinfo_offset();
-      bool diff_names = directededge->endnode().tileid() == base_edge_id.tileid() &&
-                        !OpposingEdgeInfoMatches(tile, directededge);
-
-      // Get edge info, shape, and names from the old tile and add to the
-      // new. Cannot use edge info offset since edges in arterial and
-      // highway hierarchy can cross base tiles! Use a hash based on the
-      // encoded shape plus way Id.
-      auto edgeinfo = tile->edgeinfo(idx);
-      std::string encoded_shape = edgeinfo.encoded_shape();
-      uint32_t w = hasher(encoded_shape + std::to_string(edgeinfo.wayid()));
-      uint32_t edge_info_offset =
-          tilebuilder->AddEdgeInfo(w, nodea, nodeb, edgeinfo.wayid(), edgeinfo.mean_elevation(),
-                                   edgeinfo.bike_network(), edgeinfo.speed_limit(), encoded_shape,
-                                   tile->GetNames(idx), tile->GetNames(idx, true),
-                                   tile->GetTypes(idx), added, diff_names);
-      newedge.set_edgeinfo_offset(edge_info_offset);
-
-      // Add directed edge
-      tilebuilder->directededges().emplace_back(std::move(newedge));
-    }
+        // Do we need to force adding edgeinfo (opposing edge could have diff names)?
+        // If end node is in the same tile and there is no opposing edge with matching
+        // edge_info_offset).
+        uint32_t idx = directededge->edgeinfo_offset();
+        bool diff_names = directededge->endnode().tileid() == base_edge_id.tileid() &&
+                          !OpposingEdgeInfoMatches(tile, directededge);
+
+        // Get edge info, shape, and names from the old tile and add to the
+        // new. Cannot use edge info offset since edges in arterial and
+        // highway hierarchy can cross base tiles! Use a hash based on the
+        // encoded shape plus way Id.
+        auto edgeinfo = tile->edgeinfo(idx);
+        std::string encoded_shape = edgeinfo.encoded_shape();
+        uint32_t w = hasher(encoded_shape + std::to_string(edgeinfo.wayid()));
+        uint32_t edge_info_offset =
+            tilebuilder.AddEdgeInfo(w, nodea, nodeb, edgeinfo.wayid(), edgeinfo.mean_elevation(),
+                                    edgeinfo.bike_network(), edgeinfo.speed_limit(), encoded_shape,
+                                    tile->GetNames(idx), tile->GetNames(idx, true),
+                                    tile->GetTypes(idx), added, diff_names);
+        newedge.set_edgeinfo_offset(edge_info_offset);
+
+        // Add directed edge
+        tilebuilder.directededges().emplace_back(std::move(newedge));
+      }
 
-    // Add node transitions
-    uint32_t index = tilebuilder->transitions().size();
-    auto new_nodes = find_nodes(old_to_new, base_node);
-    if (current_level == 0) {
-      AddDownwardTransition(new_nodes.arterial_node, tilebuilder);
-      AddDownwardTransition(new_nodes.local_node, tilebuilder);
-    } else if (current_level == 1) {
-      AddUpwardTransition(new_nodes.highway_node, tilebuilder);
-      AddDownwardTransition(new_nodes.local_node, tilebuilder);
-    }
-    if (current_level == 2) {
-      AddUpwardTransition(new_nodes.highway_node, tilebuilder);
-      AddUpwardTransition(new_nodes.arterial_node, tilebuilder);
-    }
+      // Add node transitions
+      uint32_t index = tilebuilder.transitions().size();
+      auto new_nodes = find_nodes(old_to_new, base_node);
+      if (current_level == 0) {
+        AddDownwardTransition(new_nodes.arterial_node, &tilebuilder);
+        AddDownwardTransition(new_nodes.local_node, &tilebuilder);
+      } else if (current_level == 1) {
+        AddUpwardTransition(new_nodes.highway_node, &tilebuilder);
+        AddDownwardTransition(new_nodes.local_node, &tilebuilder);
+      }
+      if (current_level == 2) {
+        AddUpwardTransition(new_nodes.highway_node, &tilebuilder);
+        AddUpwardTransition(new_nodes.arterial_node, &tilebuilder);
+      }
 
-    // Set the node transition count and index
-    uint32_t count = tilebuilder->transitions().size() - index;
-    if (count > 0) {
-      node.set_transition_count(count);
-      node.set_transition_index(index);
-    }
+      // Set the node transition count and index
+      uint32_t count = tilebuilder.transitions().size() - index;
+      if (count > 0) {
+        node.set_transition_count(count);
+        node.set_transition_index(index);
+      }
 
-    // Set the edge count for the new node
-    node.set_edge_count(tilebuilder->directededges().size() - edge_count);
+      // Set the edge count for the new node
+      node.set_edge_count(tilebuilder.directededges().size() - edge_count);
 
-    // Get named signs from the base node
-    if (baseni.named_intersection()) {
-      std::vector<SignInfo> signs = tile->GetSigns(base_node.id(), true);
-      if (signs.size() == 0) {
-        LOG_ERROR("Base node should have signs, but none found");
+      // Get named signs from the base node
+      if (baseni.named_intersection()) {
+        std::vector<SignInfo> signs = tile->GetSigns(base_node.id(), true);
+        if (signs.size() == 0) {
+          LOG_ERROR("Base node should have signs, but none found");
+        }
+        node.set_named_intersection(true);
+        tilebuilder.AddSigns(tilebuilder.nodes().size() - 1, signs);
       }
-      node.set_named_intersection(true);
-      tilebuilder->AddSigns(tilebuilder->nodes().size() - 1, signs);
     }
-  }
 
-  // Delete the tile builder
-  if (tilebuilder != nullptr) {
-    tilebuilder->StoreTileData();
-    delete tilebuilder;
+    // Store the new tile
+    tilebuilder.StoreTileData();
+
+    // Check if we need to clear the base/local tile cache
+    if (reader.OverCommitted()) {
+      reader.Trim();
+    }
   }
 }
 
@@ -579,9 +580,6 @@ void HierarchyBuilder::Build(const boost::property_tree::ptree& pt,
                              const std::string& new_to_old_file,
                              const std::string& old_to_new_file) {
 
-  // TODO: thread this. Might be more possible now that we don't create
-  // shortcuts in the HierarchyBuilder
-
   // Construct GraphReader
   LOG_INFO("HierarchyBuilder");
   GraphReader reader(pt.get_child("mjolnir"));
@@ -592,9 +590,54 @@ void HierarchyBuilder::Build(const boost::property_tree::ptree& pt,
   // Sort the sequences
   SortSequences(new_to_old_file, old_to_new_file);
 
-  // Iterate through the hierarchy (from highway down to local) and build
-  // new tiles
-  FormTilesInNewLevel(reader, new_to_old_file, old_to_new_file);
+  // Split the new nodes into the tiles they belong to. The tiles on the highway and arterial
+  // levels are formed first since they read the base tiles that the new local tiles replace
+  tile_ranges_t upper_tiles, local_tiles;
+  {
+    auto local_level = TileHierarchy::levels().back().level;
+    sequence<std::pair<GraphId, GraphId>> new_to_old(new_to_old_file, false);
+    GraphId tile_id;
+    size_t begin = 0, end = 0;
+    for (auto new_node = new_to_old.begin(); new_node != new_to_old.end(); ++new_node, ++end) {
+      GraphId nodea = (*new_node).first;
+      if (nodea.Tile_Base() != tile_id) {
+        if (end > begin) {
+          (tile_id.level() == local_level ? local_tiles : upper_tiles)
+              .emplace(tile_id, std::make_pair(begin, end));
+        }
+        tile_id = nodea.Tile_Base();
+        begin = end;
+      }
+    }
+    if (end > begin) {
+      (tile_id.level() == local_level ? local_tiles : upper_tiles)
+        .emplace(tile_id, std::make_pair(begin, end));
+    }
+  }
+
+  // Iterate through the hierarchy (from highway down to local) and build new tiles. The more new
+  // nodes a tile has the more work it is
+  unsigned int concurrency =
+      std::max(static_cast<unsigned int>(1),
+               pt.get<unsigned int>("mjolnir.concurrency", std::thread::hardware_concurrency()));
+  for (const auto* tile_ranges : {&upper_tiles, &local_tiles}) {
+    TileScheduler::tile_costs_t costs;
+    for (const auto& tile : *tile_ranges) {
+      costs.emplace_back(tile.first, tile.second.second - tile.second.first);
+    }
+    TileScheduler scheduler(std::move(costs), concurrency);
+    std::vector<std::shared_ptr<std::thread>> threads(scheduler.concurrency());
+    for (unsigned int i = 0; i < threads.size(); ++i) {
+      threads[i].reset(new std::thread(FormTilesInNewLevel, std::cref(pt),
+                                       std::cref(new_to_old_file), std::cref(old_to_new_file),
+                                       std::cref(*tile_ranges), std::ref(scheduler), i));
+    }
+    for (auto& thread : threads) {
+      thread->join();
+    }
+    scheduler.LogUtilization(tile_ranges == &upper_tiles ? "Formed highway and arterial"
+                                                          : "Formed local");
+  }
 
   // Remove any base tiles that no longer have any data (nodes and edges
   // only exist on arterial and highway levels)
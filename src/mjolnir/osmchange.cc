@@ -0,0 +1,311 @@
+#include "mjolnir/osmchange.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "baldr/compression_utils.h"
+#include "baldr/graphreader.h"
+#include "baldr/graphtile.h"
+#include "baldr/tilehierarchy.h"
+#include "midgard/logging.h"
+#include "mjolnir/tilescheduler.h"
+
+using namespace valhalla::baldr;
+using namespace valhalla::midgard;
+using namespace valhalla::mjolnir;
+
+namespace {
+
+// Turns the text of a change file into a change. The text is fed in pieces of any size and is cut
+// into the markup between each '>'. Writers escape '>' in attribute values so that is all it takes
+// to find the elements of the flat structure of a change file
+class change_scanner_t {
+public:
+  explicit change_scanner_t(OSMChange& change) : change_(change) {
+  }
+
+  void feed(const char* text, size_t size) {
+    const char* end = text + size;
+    while (text < end) {
+      const char* close = static_cast<const char*>(std::memchr(text, '>', end - text));
+      if (close == nullptr) {
+        markup_.append(text, end);
+        return;
+      }
+      markup_.append(text, close);
+      element();
+      markup_.clear();
+      text = close + 1;
+    }
+  }
+
+  bool found_root() const {
+    return found_root_;
+  }
+
+private:
+  // Handles the markup of one start, end or empty element tag
+  void element() {
+    auto start = markup_.find('<');
+    if (start == std::string::npos || start + 1 == markup_.size()) {
+      return;
+    }
+    ++start;
+    // end tags only matter for leaving a relation
+    if (markup_[start] == '/') {
+      if (markup_.compare(start + 1, 8, "relation") == 0) {
+        in_relation_ = false;
+      }
+      return;
+    }
+    // the xml declaration, comments and the like
+    if (markup_[start] == '?' || markup_[start] == '!') {
+      return;
+    }
+
+    auto name_end = markup_.find_first_of(" \t\r\n/", start);
+    if (name_end == std::string::npos) {
+      name_end = markup_.size();
+    }
+    const auto name = markup_.substr(start, name_end - start);
+    const bool empty = markup_.back() == '/';
+    if (name == "node") {
+      const auto lat = attribute("lat", name_end), lon = attribute("lon", name_end);
+      if (!lat.empty() && !lon.empty()) {
+        change_.points.emplace_back(std::stod(lon), std::stod(lat));
+      }
+    } else if (name == "way") {
+      change_.way_ids.insert(std::stoull(attribute("id", name_end)));
+    } else if (name == "relation") {
+      in_relation_ = !empty;
+    } else if (name == "member") {
+      if (in_relation_ && attribute("type", name_end) == "way") {
+        change_.way_ids.insert(std::stoull(attribute("ref", name_end)));
+      }
+    } else if (name == "osmChange") {
+      found_root_ = true;
+    }
+  }
+
+  // The value of an attribute of the current element or an empty string if it does not have it
+  std::string attribute(const char* key, size_t pos) const {
+    const size_t key_size = std::strlen(key);
+    while ((pos = markup_.find(key, pos)) != std::string::npos) {
+      // it has to be the whole name of the attribute
+      const bool starts = pos > 0 && std::isspace(static_cast<unsigned char>(markup_[pos - 1]));
+      pos += key_size;
+      auto equals = markup_.find_first_not_of(" \t\r\n", pos);
+      if (!starts || equals == std::string::npos || markup_[equals] != '=') {
+        continue;
+      }
+      auto quote = markup_.find_first_of("\"'", equals + 1);
+      if (quote == std::string::npos) {
+        break;
+      }
+      auto end = markup_.find(markup_[quote], quote + 1);
+      if (end == std::string::npos) {
+        break;
+      }
+      return markup_.substr(quote + 1, end - quote - 1);
+    }
+    return "";
+  }
+
+  OSMChange& change_;
+  std::string markup_;
+  bool in_relation_ = false;
+  bool found_root_ = false;
+};
+
+// What a thread found in the tiles it scanned
+struct scan_result_t {
+  // Tiles with an edge of a changed way
+  std::unordered_set<GraphId> touched;
+  // For each scanned tile the other tiles its edges end in
+  std::unordered_map<GraphId, std::unordered_set<GraphId>> neighbors;
+};
+
+// Scans the tiles the scheduler hands out for edges of the changed ways and where the edges end
+void scan_tiles(const boost::property_tree::ptree& pt,
+                const std::unordered_set<uint64_t>& way_ids,
+                TileScheduler& scheduler,
+                const unsigned int worker,
+                std::promise<scan_result_t>& result) {
+  GraphReader reader(pt);
+  scan_result_t scanned;
+  GraphId tile_id;
+  while (scheduler.Next(worker, tile_id)) {
+    graph_tile_ptr tile = reader.GetGraphTile(tile_id);
+    if (!tile) {
+      continue;
+    }
+    auto& neighbors = scanned.neighbors[tile_id];
+    bool touched = false;
+    for (uint32_t i = 0; i < tile->header()->directededgecount(); ++i) {
+      const DirectedEdge* edge = tile->directededge(i);
+      if (edge->endnode().Tile_Base() != tile_id) {
+        neighbors.insert(edge->endnode().Tile_Base());
+      }
+      // both directions of an edge share the edge info so look at it once
+      if (!touched && edge->forward() &&
+          way_ids.count(tile->edgeinfo(edge->edgeinfo_offset()).wayid())) {
+        touched = true;
+      }
+    }
+    if (touched) {
+      scanned.touched.insert(tile_id);
+    }
+
+    if (reader.OverCommitted()) {
+      reader.Trim();
+    }
+  }
+  result.set_value(std::move(scanned));
+}
+
+} // namespace
+
+namespace valhalla {
+namespace mjolnir {
+
+OSMChange OSMChange::Read(const std::string& file_name) {
+  std::ifstream file(file_name, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open " + file_name);
+  }
+
+  OSMChange change;
+  change_scanner_t scanner(change);
+  std::vector<char> in(1024 * 1024), out(4 * 1024 * 1024);
+  file.read(in.data(), 2);
+  const bool gzipped = file.gcount() == 2 && static_cast<unsigned char>(in[0]) == 0x1f &&
+                       static_cast<unsigned char>(in[1]) == 0x8b;
+  if (!gzipped) {
+    scanner.feed(in.data(), file.gcount());
+    while (file.read(in.data(), in.size()) || file.gcount() > 0) {
+      scanner.feed(in.data(), file.gcount());
+    }
+  } else {
+    // for reading the compressed file a buffer at a time
+    bool first = true;
+    auto src_func = [&file, &in, &first](z_stream& s) {
+      if (first) {
+        file.read(in.data() + 2, in.size() - 2);
+        s.avail_in = static_cast<unsigned int>(file.gcount() + 2);
+        first = false;
+      } else {
+        file.read(in.data(), in.size());
+        s.avail_in = static_cast<unsigned int>(file.gcount());
+      }
+      s.next_in = reinterpret_cast<Byte*>(in.data());
+    };
+
+    // the inflated text is scanned every time the buffer fills up
+    bool started = false;
+    auto dst_func = [&scanner, &out, &started](z_stream& s) -> int {
+      if (started) {
+        scanner.feed(out.data(), out.size() - s.avail_out);
+      }
+      started = true;
+      s.next_out = reinterpret_cast<Byte*>(out.data());
+      s.avail_out = static_cast<unsigned int>(out.size());
+      return Z_NO_FLUSH;
+    };
+
+    if (!baldr::inflate(src_func, dst_func)) {
+      throw std::runtime_error("Could not inflate " + file_name);
+    }
+  }
+
+  if (!scanner.found_root()) {
+    throw std::runtime_error(file_name + " is not an OSM change file");
+  }
+  LOG_INFO("Read " + std::to_string(change.points.size()) + " nodes and " +
+           std::to_string(change.way_ids.size()) + " ways from " + file_name);
+  return change;
+}
+
+std::unordered_set<GraphId> OSMChange::AffectedTiles(const boost::property_tree::ptree& pt) const {
+  // Only read the tiles in the tile directory
+  auto config = pt.get_child("mjolnir");
+  config.erase("tile_extract");
+  config.erase("tile_url");
+  config.erase("traffic_extract");
+
+  // The tiles of the most detailed level that the changed nodes are in
+  const auto local_level = TileHierarchy::levels().back().level;
+  std::unordered_set<GraphId> changed;
+  for (const auto& point : points) {
+    auto tile_id = TileHierarchy::GetGraphId(point, local_level);
+    if (tile_id.Is_Valid()) {
+      changed.insert(tile_id);
+    }
+  }
+
+  // Look through every tile for the edges of the changed ways and where edges end
+  unsigned int concurrency =
+      std::max(static_cast<unsigned int>(1),
+               pt.get<unsigned int>("mjolnir.concurrency", std::thread::hardware_concurrency()));
+  GraphReader reader(config);
+  TileScheduler scheduler(TileScheduler::FileSizes(reader.tile_dir(),
+                                                   reader.GetTileSet(local_level)),
+                          concurrency);
+  std::vector<std::shared_ptr<std::thread>> threads(scheduler.concurrency());
+  std::list<std::promise<scan_result_t>> results;
+  for (unsigned int i = 0; i < threads.size(); ++i) {
+    results.emplace_back();
+    threads[i].reset(new std::thread(scan_tiles, std::cref(config), std::cref(way_ids),
+                                     std::ref(scheduler), i, std::ref(results.back())));
+  }
+  for (auto& thread : threads) {
+    thread->join();
+  }
+  scheduler.LogUtilization("Scanned for changes");
+  std::unordered_map<GraphId, std::unordered_set<GraphId>> neighbors;
+  for (auto& result : results) {
+    auto scanned = result.get_future().get();
+    changed.insert(scanned.touched.begin(), scanned.touched.end());
+    for (auto& tile : scanned.neighbors) {
+      neighbors.emplace(tile.first, std::move(tile.second));
+    }
+  }
+
+  // Tiles whose edges end in a changed tile refer to its nodes by their ids, which can change
+  std::unordered_set<GraphId> affected(changed);
+  for (const auto& tile : neighbors) {
+    for (const auto& neighbor : tile.second) {
+      if (changed.count(neighbor)) {
+        affected.insert(tile.first);
+        break;
+      }
+    }
+  }
+
+  // The tiles of the other levels are formed from the tiles of the most detailed level they cover
+  std::unordered_set<GraphId> upper;
+  for (const auto& tile_id : affected) {
+    auto center = TileHierarchy::GetGraphIdBoundingBox(tile_id).Center();
+    for (const auto& level : TileHierarchy::levels()) {
+      if (level.level != local_level) {
+        upper.insert(TileHierarchy::GetGraphId(center, level.level));
+      }
+    }
+  }
+  affected.insert(upper.begin(), upper.end());
+
+  LOG_INFO(std::to_string(changed.size()) + " tiles hold changes, " +
+           std::to_string(affected.size()) + " tiles are affected by them");
+  return affected;
+}
+
+} // namespace mjolnir
+} // namespace valhalla
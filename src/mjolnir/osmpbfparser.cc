@@ -27,7 +27,13 @@
 
 // This is largely based off of: https://github.com/CanalTP/libosmpbfreader
 // there have been some minor changes for our own purposes but its largely the same
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
 #ifdef _MSC_VER
 #include <winsock2.h> // ntohl
 #else
@@ -81,9 +87,8 @@ BlobHeader read_header(char* buffer, std::ifstream& file, bool& finished) {
   return result;
 }
 
-int32_t read_blob(char* buffer, char* unpack_buffer, std::ifstream& file, const BlobHeader& header) {
-  Blob blob;
-
+// read the bytes of the blob that goes with the header, returns their size
+int32_t read_blob_bytes(char* buffer, std::ifstream& file, const BlobHeader& header) {
   // is the size of the following blob sane
   int32_t sz = header.datasize();
   if (sz > MAX_UNCOMPRESSED_BLOB_SIZE) {
@@ -94,6 +99,12 @@ int32_t read_blob(char* buffer, char* unpack_buffer, std::ifstream& file, const
   if (!file.read(buffer, sz)) {
     throw std::runtime_error("unable to read blob from file");
   }
+  return sz;
+}
+
+// inflate the bytes of a blob into the unpack buffer, returns the unpacked size
+int32_t unpack_blob(const char* buffer, int32_t sz, char* unpack_buffer) {
+  Blob blob;
 
   // turn it into a protobuf object
   if (!blob.ParseFromArray(buffer, sz)) {
@@ -107,7 +118,7 @@ int32_t read_blob(char* buffer, char* unpack_buffer, std::ifstream& file, const
     if (sz != blob.raw_size()) {
       LOG_WARN("blob reports wrong raw_size: " + std::to_string(blob.raw_size()) + " bytes");
     }
-    memcpy(unpack_buffer, buffer, sz);
+    memcpy(unpack_buffer, blob.raw().data(), sz);
     return sz;
   } // if the blob was zlib compressed
   else if (blob.has_zlib_data()) {
@@ -139,6 +150,11 @@ int32_t read_blob(char* buffer, char* unpack_buffer, std::ifstream& file, const
   throw std::runtime_error("Unsupported blob data format");
 }
 
+int32_t read_blob(char* buffer, char* unpack_buffer, std::ifstream& file, const BlobHeader& header) {
+  int32_t sz = read_blob_bytes(buffer, file, header);
+  return unpack_blob(buffer, sz, unpack_buffer);
+}
+
 template <class T> OSMPBF::Tags get_tags(const T& object, const OSMPBF::PrimitiveBlock& primblock) {
   OSMPBF::Tags result(object.keys_size());
   for (int i = 0; i < object.keys_size(); ++i) {
@@ -151,10 +167,12 @@ template <class T> OSMPBF::Tags get_tags(const T& object, const OSMPBF::Primitiv
   return result;
 }
 
+// the callback is either a Callback or a recorder_t, which takes ownership of what is passed to it
+template <class callback_t>
 void parse_primitive_block(char* unpack_buffer,
                            int32_t sz,
                            const Interest interest,
-                           Callback& callback) {
+                           callback_t& callback) {
   // turn the blob bytes into a protobuf object
   PrimitiveBlock primblock;
   if (!primblock.ParseFromArray(unpack_buffer, sz)) {
@@ -203,7 +221,7 @@ void parse_primitive_block(char* unpack_buffer,
             tags[key_string] = val_string;
           }
           ++current_kv;
-          callback.node_callback(id, lon, lat, tags);
+          callback.node_callback(id, lon, lat, std::move(tags));
         }
         if (dense_nodes.has_denseinfo() && (interest & CHANGESETS) == CHANGESETS) {
           uint64_t changeset = 0;
@@ -227,7 +245,7 @@ void parse_primitive_block(char* unpack_buffer,
             nodes.push_back(node);
           }
         }
-        callback.way_callback(way.id(), get_tags<Way>(way, primblock), nodes);
+        callback.way_callback(way.id(), get_tags<Way>(way, primblock), std::move(nodes));
         if (way.has_info() && way.info().has_changeset() && (interest & CHANGESETS) == CHANGESETS) {
           callback.changeset_callback(way.info().changeset());
         }
@@ -245,7 +263,8 @@ void parse_primitive_block(char* unpack_buffer,
           members.emplace_back(relation.types(l), member,
                                primblock.stringtable().s(relation.roles_sid(l)));
         }
-        callback.relation_callback(relation.id(), get_tags<Relation>(relation, primblock), members);
+        callback.relation_callback(relation.id(), get_tags<Relation>(relation, primblock),
+                                   std::move(members));
         if (relation.has_info() && relation.info().has_changeset() &&
             (interest & CHANGESETS) == CHANGESETS) {
           callback.changeset_callback(relation.info().changeset());
@@ -272,51 +291,279 @@ void parse_header_block(char* unpack_buffer, int32_t sz) {
   // TODO: do something with replication information?
 }
 
-} // namespace
+// Keeps the callbacks of a primitive block, decoded on a worker thread, so that they can be
+// replayed on the parsing thread in the same order as the serial parser would have made them. The
+// tags are transformed on the worker thread too if there is a transform
+class recorder_t {
+public:
+  explicit recorder_t(TagTransform* transform) : transform_(transform) {
+  }
 
-// extend the protobuf osmpbf namespace
-namespace OSMPBF {
+  void node_callback(const uint64_t osmid, const double lng, const double lat, Tags&& tags) {
+    order_.push_back(NODES);
+    nodes_.push_back({osmid, lng, lat, std::move(tags)});
+    transform(NODES, nodes_.back());
+  }
+  void way_callback(const uint64_t osmid, Tags&& tags, std::vector<uint64_t>&& nodes) {
+    order_.push_back(WAYS);
+    ways_.push_back({osmid, std::move(tags), std::move(nodes)});
+    transform(WAYS, ways_.back());
+  }
+  void relation_callback(const uint64_t osmid, Tags&& tags, std::vector<Member>&& members) {
+    order_.push_back(RELATIONS);
+    relations_.push_back({osmid, std::move(tags), std::move(members)});
+    transform(RELATIONS, relations_.back());
+  }
+  void changeset_callback(const uint64_t changeset_id) {
+    order_.push_back(CHANGESETS);
+    changesets_.push_back(changeset_id);
+  }
 
-Member::Member(const Relation::MemberType type, const uint64_t id, const std::string& role)
-    : member_type(type), member_id(id), role(role) {
-}
+  // make the recorded callbacks on another callback
+  void replay(Callback& callback) const {
+    auto node = nodes_.cbegin();
+    auto way = ways_.cbegin();
+    auto relation = relations_.cbegin();
+    auto changeset = changesets_.cbegin();
+    for (const auto interest : order_) {
+      switch (interest) {
+        case NODES:
+          callback.node_callback(node->osmid, node->lng, node->lat, node->tags,
+                                 node->transformed ? &node->results : nullptr);
+          ++node;
+          break;
+        case WAYS:
+          callback.way_callback(way->osmid, way->tags, way->nodes,
+                                way->transformed ? &way->results : nullptr);
+          ++way;
+          break;
+        case RELATIONS:
+          callback.relation_callback(relation->osmid, relation->tags, relation->members,
+                                     relation->transformed ? &relation->results : nullptr);
+          ++relation;
+          break;
+        default:
+          callback.changeset_callback(*changeset);
+          ++changeset;
+          break;
+      }
+    }
+  }
 
-Member::Member(Member&& other)
-    : member_type(other.member_type), member_id(other.member_id), role(std::move(other.role)) {
-}
+private:
+  struct node_t {
+    uint64_t osmid;
+    double lng;
+    double lat;
+    Tags tags;
+    bool transformed;
+    Tags results;
+  };
+  struct way_t {
+    uint64_t osmid;
+    Tags tags;
+    std::vector<uint64_t> nodes;
+    bool transformed;
+    Tags results;
+  };
+  struct relation_t {
+    uint64_t osmid;
+    Tags tags;
+    std::vector<Member> members;
+    bool transformed;
+    Tags results;
+  };
+
+  template <class object_t> void transform(const Interest type, object_t& object) {
+    object.transformed =
+        transform_ && (*transform_)(type, object.osmid, object.tags, object.results);
+  }
+
+  TagTransform* transform_;
+  std::vector<Interest> order_;
+  std::vector<node_t> nodes_;
+  std::vector<way_t> ways_;
+  std::vector<relation_t> relations_;
+  std::vector<uint64_t> changesets_;
+};
+
+// Runs the inflating, decoding and transforming of blobs on a fixed set of threads
+class decoder_pool_t {
+public:
+  using task_t = std::packaged_task<std::unique_ptr<recorder_t>(char*, TagTransform*)>;
+
+  // every thread gets a transform of its own from the callback, they are made here so that the
+  // callback does not have to make them thread safely
+  decoder_pool_t(unsigned int threads, Callback& callback) {
+    for (unsigned int i = 0; i < threads; ++i) {
+      transforms_.push_back(callback.tag_transform());
+    }
+    for (unsigned int i = 0; i < threads; ++i) {
+      threads_.emplace_back([this, i]() { work(transforms_[i].get()); });
+    }
+  }
 
-void Parser::parse(std::ifstream& file, const Interest interest, Callback& callback) {
-  char* buffer = new char[MAX_UNCOMPRESSED_BLOB_SIZE];
-  char* unpack_buffer = new char[MAX_UNCOMPRESSED_BLOB_SIZE];
+  ~decoder_pool_t() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+    }
+    condition_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
 
-  // start from the top
-  file.clear();
-  file.seekg(0, std::ios::beg);
+  std::future<std::unique_ptr<recorder_t>> submit(task_t task) {
+    auto future = task.get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    condition_.notify_one();
+    return future;
+  }
+
+private:
+  void work(TagTransform* transform) {
+    // every thread keeps its own buffer to inflate into
+    std::unique_ptr<char[]> unpack_buffer(new char[MAX_UNCOMPRESSED_BLOB_SIZE]);
+    while (true) {
+      task_t task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this]() { return done_ || !tasks_.empty(); });
+        if (tasks_.empty()) {
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task(unpack_buffer.get(), transform);
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<task_t> tasks_;
+  std::vector<std::unique_ptr<TagTransform>> transforms_;
+  std::vector<std::thread> threads_;
+  bool done_ = false;
+};
+
+void parse_serial(std::ifstream& file, const Interest interest, Callback& callback) {
+  std::unique_ptr<char[]> buffer(new char[MAX_UNCOMPRESSED_BLOB_SIZE]);
+  std::unique_ptr<char[]> unpack_buffer(new char[MAX_UNCOMPRESSED_BLOB_SIZE]);
 
   // while there is more to read
   while (!file.eof()) {
     // grab the blob header
     bool finished = false;
-    BlobHeader header = read_header(buffer, file, finished);
+    BlobHeader header = read_header(buffer.get(), file, finished);
     // if we didnt hit the end
     if (!finished) {
       // grab the blob that goes with the blob header
-      int32_t sz = read_blob(buffer, unpack_buffer, file, header);
+      int32_t sz = read_blob(buffer.get(), unpack_buffer.get(), file, header);
       // if its data parse it
       if (header.type() == "OSMData") {
-        parse_primitive_block(unpack_buffer, sz, interest, callback);
+        parse_primitive_block(unpack_buffer.get(), sz, interest, callback);
         // if its something other than a header
       } else if (header.type() == "OSMHeader") {
-        parse_header_block(unpack_buffer, sz);
+        parse_header_block(unpack_buffer.get(), sz);
       } else {
         LOG_WARN("Unknown blob type: " + header.type());
       }
     }
   }
+}
+
+void parse_parallel(std::ifstream& file,
+                    const Interest interest,
+                    Callback& callback,
+                    const unsigned int threads) {
+  std::unique_ptr<char[]> buffer(new char[MAX_BLOB_HEADER_SIZE]);
+
+  // the blobs are read in order on this thread, inflated and decoded on the pool and their
+  // callbacks are made here in the order they were read. a few blobs per thread are kept in
+  // flight so the pool never waits on the reading or the callbacks
+  const size_t max_in_flight = threads * 4;
+  std::deque<std::future<std::unique_ptr<recorder_t>>> in_flight;
+  decoder_pool_t pool(threads, callback);
+  while (!file.eof()) {
+    // wait for the oldest blob when enough are in flight
+    if (in_flight.size() >= max_in_flight) {
+      in_flight.front().get()->replay(callback);
+      in_flight.pop_front();
+    }
+
+    // grab the blob header
+    bool finished = false;
+    BlobHeader header = read_header(buffer.get(), file, finished);
+    if (finished) {
+      break;
+    }
+    const int32_t datasize = header.datasize();
+    if (datasize > MAX_UNCOMPRESSED_BLOB_SIZE || datasize < 0) {
+      throw std::runtime_error("blob-size is bigger than allowed");
+    }
+    std::string bytes(datasize, '\0');
+    if (!file.read(&bytes[0], datasize)) {
+      throw std::runtime_error("unable to read blob from file");
+    }
+
+    // hand it to the pool
+    std::string type = header.type();
+    in_flight.push_back(
+        pool.submit(decoder_pool_t::task_t([bytes = std::move(bytes), type = std::move(type),
+                                            interest](char* unpack_buffer,
+                                                      TagTransform* transform) {
+          std::unique_ptr<recorder_t> recorder(new recorder_t(transform));
+          int32_t sz = unpack_blob(bytes.data(), bytes.size(), unpack_buffer);
+          // if its data parse it
+          if (type == "OSMData") {
+            parse_primitive_block(unpack_buffer, sz, interest, *recorder);
+            // if its something other than a header
+          } else if (type == "OSMHeader") {
+            parse_header_block(unpack_buffer, sz);
+          } else {
+            LOG_WARN("Unknown blob type: " + type);
+          }
+          return recorder;
+        })));
+  }
+
+  // make the callbacks of whatever is left
+  for (auto& decoded : in_flight) {
+    decoded.get()->replay(callback);
+  }
+}
+
+} // namespace
+
+// extend the protobuf osmpbf namespace
+namespace OSMPBF {
+
+Member::Member(const Relation::MemberType type, const uint64_t id, const std::string& role)
+    : member_type(type), member_id(id), role(role) {
+}
+
+Member::Member(Member&& other)
+    : member_type(other.member_type), member_id(other.member_id), role(std::move(other.role)) {
+}
 
-  // done with protobuf and buffers
-  delete[] buffer;
-  delete[] unpack_buffer;
+void Parser::parse(std::ifstream& file,
+                   const Interest interest,
+                   Callback& callback,
+                   const unsigned int threads) {
+  // start from the top
+  file.clear();
+  file.seekg(0, std::ios::beg);
+
+  if (threads > 1) {
+    parse_parallel(file, interest, callback, threads);
+  } else {
+    parse_serial(file, interest, callback);
+  }
 }
 
 void Parser::free() {
@@ -49,6 +49,57 @@ int get_number(const std::string& tag, const std::string& value) { // NOLINT
   return num;
 }
 
+// Ways thrown away for being closed features are only known to be so with their nodes
+bool maybe_closed_feature(const OSMPBF::Tags& tags) {
+  for (const auto& tag : tags) {
+    if (tag.first == "building" || tag.first == "landuse" || tag.first == "leisure" ||
+        tag.first == "natural") {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Runs the Lua tag transform on a decoder thread with a Lua state of its own. Which nodes are kept
+// depends on the ways seen before them, so they are left to the callback unless every node with
+// tags is transformed anyway. Ways that may be closed features are left to the callback too
+struct lua_transform_t : public OSMPBF::TagTransform {
+  lua_transform_t(const std::string& lua, const bool nodes) : lua_(lua), nodes_(nodes) {
+  }
+
+  bool operator()(const OSMPBF::Interest type,
+                  const uint64_t osmid,
+                  const OSMPBF::Tags& tags,
+                  OSMPBF::Tags& transformed) override {
+    // the callbacks have the results of no tags already
+    if (tags.empty()) {
+      return false;
+    }
+    switch (type) {
+      case OSMPBF::NODES:
+        if (!nodes_) {
+          return false;
+        }
+        transformed = lua_.Transform(OSMType::kNode, osmid, tags);
+        return true;
+      case OSMPBF::WAYS:
+        if (maybe_closed_feature(tags)) {
+          return false;
+        }
+        transformed = lua_.Transform(OSMType::kWay, osmid, tags);
+        return true;
+      case OSMPBF::RELATIONS:
+        transformed = lua_.Transform(OSMType::kRelation, osmid, tags);
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  LuaTagTransform lua_;
+  bool nodes_;
+};
+
 // Construct PBFGraphParser based on properties file and input PBF extract
 struct graph_callback : public OSMPBF::Callback {
 public:
@@ -58,7 +109,7 @@ public:
   }
 
   graph_callback(const boost::property_tree::ptree& pt, OSMData& osmdata)
-      : osmdata_(osmdata), lua_(get_lua(pt)) {
+      : lua_code_(get_lua(pt)), lua_(lua_code_), osmdata_(osmdata) {
     current_way_node_index_ = last_node_ = last_way_ = last_relation_ = 0;
 
     highway_cutoff_rc_ = RoadClass::kPrimary;
@@ -799,10 +850,24 @@ public:
     return std::string(lua_graph_lua, lua_graph_lua + lua_graph_lua_len);
   }
 
+  // Every decoder thread runs the Lua transform with a state of its own
+  virtual std::unique_ptr<OSMPBF::TagTransform> tag_transform() override {
+    const bool nodes = bss_nodes_ != nullptr;
+    return std::unique_ptr<OSMPBF::TagTransform>(new lua_transform_t(lua_code_, nodes));
+  }
+
   virtual void node_callback(const uint64_t osmid,
                              const double lng,
                              const double lat,
                              const OSMPBF::Tags& tags) override {
+    node_callback(osmid, lng, lat, tags, nullptr);
+  }
+
+  virtual void node_callback(const uint64_t osmid,
+                             const double lng,
+                             const double lat,
+                             const OSMPBF::Tags& tags,
+                             const OSMPBF::Tags* transformed) override {
     // unsorted extracts are just plain nasty, so they can bugger off!
     if (osmid < last_node_) {
       throw std::runtime_error("Detected unsorted input data");
@@ -814,7 +879,7 @@ public:
     if (bss_nodes_) {
       // Get tags - do't bother with Lua callout if the taglist is empty
       if (tags.size() > 0) {
-        results = lua_.Transform(OSMType::kNode, osmid, tags);
+        results = transformed ? *transformed : lua_.Transform(OSMType::kNode, osmid, tags);
       } else {
         results = empty_node_results_;
       }
@@ -860,7 +925,9 @@ public:
     // Get tags if not already available.  Don't bother calling Lua if there
     // are no OSM tags to process.
     if (tags.size() > 0) {
-      results = results ? results : lua_.Transform(OSMType::kNode, osmid, tags);
+      results = results      ? results
+                : transformed ? *transformed
+                              : lua_.Transform(OSMType::kNode, osmid, tags);
     } else {
       results = results ? results : empty_node_results_;
     }
@@ -1024,6 +1091,13 @@ public:
   virtual void way_callback(const uint64_t osmid,
                             const OSMPBF::Tags& tags,
                             const std::vector<uint64_t>& nodes) override {
+    way_callback(osmid, tags, nodes, nullptr);
+  }
+
+  virtual void way_callback(const uint64_t osmid,
+                            const OSMPBF::Tags& tags,
+                            const std::vector<uint64_t>& nodes,
+                            const OSMPBF::Tags* transformed) override {
     osmid_ = osmid;
 
     // unsorted extracts are just plain nasty, so they can bugger off!
@@ -1040,20 +1114,15 @@ public:
 
     // Throw away closed features with following tags: building, landuse,
     // leisure, natural. See: http://wiki.openstreetmap.org/wiki/Key:area
-    if (nodes[0] == nodes[nodes.size() - 1]) {
-      for (const auto& tag : tags) {
-        if (tag.first == "building" || tag.first == "landuse" || tag.first == "leisure" ||
-            tag.first == "natural") {
-          // LOG_INFO("Loop wayid " + std::to_string(osmid) + " Discard?");
-          return;
-        }
-      }
+    if (nodes[0] == nodes[nodes.size() - 1] && maybe_closed_feature(tags)) {
+      return;
     }
 
     // Transform tags. If no results that means the way does not have tags
     // suitable for use in routing.
-    Tags results =
-        tags.size() == 0 ? empty_way_results_ : lua_.Transform(OSMType::kWay, osmid_, tags);
+    Tags results = tags.size() == 0 ? empty_way_results_
+                   : transformed    ? *transformed
+                                    : lua_.Transform(OSMType::kWay, osmid_, tags);
     if (results.size() == 0) {
       return;
     }
@@ -1528,6 +1597,13 @@ public:
   virtual void relation_callback(const uint64_t osmid,
                                  const OSMPBF::Tags& tags,
                                  const std::vector<OSMPBF::Member>& members) override {
+    relation_callback(osmid, tags, members, nullptr);
+  }
+
+  virtual void relation_callback(const uint64_t osmid,
+                                 const OSMPBF::Tags& tags,
+                                 const std::vector<OSMPBF::Member>& members,
+                                 const OSMPBF::Tags* transformed) override {
     // unsorted extracts are just plain nasty, so they can bugger off!
     if (osmid < last_relation_) {
       throw std::runtime_error("Detected unsorted input data");
@@ -1535,8 +1611,9 @@ public:
     last_relation_ = osmid;
 
     // Get tags
-    Tags results =
-        tags.empty() ? empty_relation_results_ : lua_.Transform(OSMType::kRelation, osmid, tags);
+    Tags results = tags.empty()  ? empty_relation_results_
+                   : transformed ? *transformed
+                                 : lua_.Transform(OSMType::kRelation, osmid, tags);
     if (results.size() == 0) {
       return;
     }
@@ -2010,7 +2087,8 @@ public:
   // Road class assignment needs to be set to the highway cutoff for ferries and auto trains.
   RoadClass highway_cutoff_rc_;
 
-  // Lua Tag Transformation class
+  // Lua Tag Transformation class, the decoder threads make their own from the same code
+  std::string lua_code_;
   LuaTagTransform lua_;
 
   // Pointer to all the OSM data (for use by callbacks)
@@ -2051,9 +2129,8 @@ OSMData PBFGraphParser::ParseWays(const boost::property_tree::ptree& pt,
                                   const std::string& ways_file,
                                   const std::string& way_nodes_file,
                                   const std::string& access_file) {
-  // TODO: option 1: each one threads makes an osmdata and we splice them together at the end
-  // option 2: synchronize around adding things to a single osmdata. will have to test to see
-  // which is the least expensive (memory and speed). leaning towards option 2
+  // The blobs are inflated and decoded on this many threads. The callbacks stay on this thread and
+  // in file order because they depend on the order of the ids and append to sequences
   unsigned int threads =
       std::max(static_cast<unsigned int>(1),
                pt.get<unsigned int>("concurrency", std::thread::hardware_concurrency()));
@@ -2086,7 +2163,7 @@ OSMData PBFGraphParser::ParseWays(const boost::property_tree::ptree& pt,
     OSMPBF::Parser::parse(file_handle,
                           static_cast<OSMPBF::Interest>(OSMPBF::Interest::WAYS |
                                                         OSMPBF::Interest::CHANGESETS),
-                          callback);
+                          callback, threads);
   }
 
   LOG_INFO("Finished with " + std::to_string(osmdata.osm_way_count) + " routable ways containing " +
@@ -2112,9 +2189,8 @@ void PBFGraphParser::ParseRelations(const boost::property_tree::ptree& pt,
                                     const std::string& complex_restriction_from_file,
                                     const std::string& complex_restriction_to_file,
                                     OSMData& osmdata) {
-  // TODO: option 1: each one threads makes an osmdata and we splice them together at the end
-  // option 2: synchronize around adding things to a single osmdata. will have to test to see
-  // which is the least expensive (memory and speed). leaning towards option 2
+  // The blobs are inflated and decoded on this many threads. The callbacks stay on this thread and
+  // in file order because they depend on the order of the ids and append to sequences
   unsigned int threads =
       std::max(static_cast<unsigned int>(1),
                pt.get<unsigned int>("concurrency", std::thread::hardware_concurrency()));
@@ -2150,7 +2226,7 @@ void PBFGraphParser::ParseRelations(const boost::property_tree::ptree& pt,
     OSMPBF::Parser::parse(file_handle,
                           static_cast<OSMPBF::Interest>(OSMPBF::Interest::RELATIONS |
                                                         OSMPBF::Interest::CHANGESETS),
-                          callback);
+                          callback, threads);
   }
   LOG_INFO("Finished with " + std::to_string(osmdata.restrictions.size()) + " simple restrictions");
   LOG_INFO("Finished with " + std::to_string(osmdata.lane_connectivity_map.size()) +
@@ -2181,9 +2257,8 @@ void PBFGraphParser::ParseNodes(const boost::property_tree::ptree& pt,
                                 const std::string& way_nodes_file,
                                 const std::string& bss_nodes_file,
                                 OSMData& osmdata) {
-  // TODO: option 1: each one threads makes an osmdata and we splice them together at the end
-  // option 2: synchronize around adding things to a single osmdata. will have to test to see
-  // which is the least expensive (memory and speed). leaning towards option 2
+  // The blobs are inflated and decoded on this many threads. The callbacks stay on this thread and
+  // in file order because they depend on the order of the ids and append to sequences
   unsigned int threads =
       std::max(static_cast<unsigned int>(1),
                pt.get<unsigned int>("concurrency", std::thread::hardware_concurrency()));
@@ -2216,7 +2291,7 @@ void PBFGraphParser::ParseNodes(const boost::property_tree::ptree& pt,
       callback.reset(nullptr, nullptr, nullptr, nullptr, nullptr,
                      new sequence<OSMNode>(bss_nodes_file, true));
       OSMPBF::Parser::parse(file_handle, static_cast<OSMPBF::Interest>(OSMPBF::Interest::NODES),
-                            callback);
+                            callback, threads);
     }
   }
   callback.reset(nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
@@ -2245,7 +2320,7 @@ void PBFGraphParser::ParseNodes(const boost::property_tree::ptree& pt,
     OSMPBF::Parser::parse(file_handle,
                           static_cast<OSMPBF::Interest>(OSMPBF::Interest::NODES |
                                                         OSMPBF::Interest::CHANGESETS),
-                          callback);
+                          callback, threads);
   }
   uint64_t max_osm_id = callback.last_node_;
   callback.reset(nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
@@ -2253,17 +2328,20 @@ void PBFGraphParser::ParseNodes(const boost::property_tree::ptree& pt,
            " nodes contained in routable ways");
 
   // we need to sort the refs so that we easily iterate over them for building edges
-  // so we line them first by way index then by shape index of the node
+  // so we line them first by way index then by shape index of the node. no two are
+  // equal so sorting runs of them on all the threads and merging them gives the same order
   LOG_INFO("Sorting osm way node references by way index and node shape index...");
   {
     sequence<OSMWayNode> way_nodes(way_nodes_file, false);
-    way_nodes.sort([](const OSMWayNode& a, const OSMWayNode& b) {
-      if (a.way_index == b.way_index) {
-        // TODO: if its equal we have screwed something up, should we check and throw here?
-        return a.way_shape_node_index < b.way_shape_node_index;
-      }
-      return a.way_index < b.way_index;
-    });
+    way_nodes.external_sort(
+        [](const OSMWayNode& a, const OSMWayNode& b) {
+          if (a.way_index == b.way_index) {
+            // TODO: if its equal we have screwed something up, should we check and throw here?
+            return a.way_shape_node_index < b.way_shape_node_index;
+          }
+          return a.way_index < b.way_index;
+        },
+        1024 * 1024 * 512 / sizeof(OSMWayNode), threads);
   }
 
   // Some OSM extracts do not have changeset Ids. For these set the max changeset Id
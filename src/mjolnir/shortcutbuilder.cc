@@ -1,14 +1,20 @@
 #include "mjolnir/shortcutbuilder.h"
 #include "mjolnir/graphtilebuilder.h"
+#include "mjolnir/tilescheduler.h"
 
+#include <algorithm>
 #include <boost/format.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <cstdio>
+#include <future>
 #include <iostream>
+#include <list>
 #include <map>
 #include <ostream>
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -17,6 +23,7 @@
 #include "baldr/graphreader.h"
 #include "baldr/graphtile.h"
 #include "baldr/tilehierarchy.h"
+#include "filesystem.h"
 #include "midgard/encoded.h"
 #include "midgard/logging.h"
 #include "midgard/pointll.h"
@@ -577,24 +584,29 @@ uint32_t AddShortcutEdges(GraphReader& reader,
 }
 
 // Form shortcuts for tiles in this level.
-uint32_t FormShortcuts(GraphReader& reader, const TileLevel& level) {
-  // Iterate through the tiles at this level (TODO - can we mark the tiles
-  // the tiles that shortcuts end within?)
-  reader.Clear();
+// Form the shortcuts of the tiles the scheduler hands out. The new tiles are stored under the
+// staging directory so that every thread keeps reading the tiles of the level as they were before
+void FormShortcuts(const boost::property_tree::ptree& pt,
+                   const std::string& staging_dir,
+                   TileScheduler& scheduler,
+                   const unsigned int worker,
+                   std::promise<uint32_t>& result) {
+  GraphReader reader(pt.get_child("mjolnir"));
   bool added = false;
   uint32_t shortcut_count = 0;
-  uint32_t ntiles = level.tiles.TileCount();
-  uint32_t tile_level = (uint32_t)level.level;
   graph_tile_ptr tile;
-  for (uint32_t tileid = 0; tileid < ntiles; tileid++) {
-    // Get the graph tile. Skip if no tile exists (common case)
-    tile = reader.GetGraphTile(GraphId(tileid, tile_level, 0));
+  GraphId new_tile;
+  while (scheduler.Next(worker, new_tile)) {
+
+    // Get the graph tile. Skip if no tile exists
+    tile = reader.GetGraphTile(new_tile);
     if (!tile) {
       continue;
     }
+    uint32_t tileid = new_tile.tileid();
+    uint32_t tile_level = new_tile.level();
 
     // Create GraphTileBuilder for the new tile
-    GraphId new_tile(tileid, tile_level, 0);
     GraphTileBuilder tilebuilder(reader.tile_dir(), new_tile, false);
 
     // Since the old tile is not serialized we must copy any data that is not
@@ -717,7 +729,7 @@ uint32_t FormShortcuts(GraphReader& reader, const TileLevel& level) {
     }
 
     // Store the new tile
-    tilebuilder.StoreTileData();
+    tilebuilder.StoreTileData(staging_dir);
     LOG_DEBUG((boost::format("ShortcutBuilder created tile %1%: %2% bytes") % tile %
                tilebuilder.header_builder().end_offset())
                   .str());
@@ -727,7 +739,7 @@ uint32_t FormShortcuts(GraphReader& reader, const TileLevel& level) {
       reader.Trim();
     }
   }
-  return shortcut_count;
+  result.set_value(shortcut_count);
 }
 
 } // namespace
@@ -739,21 +751,57 @@ namespace mjolnir {
 // only connect to 2 edges on the hierarchy level, and have compatible
 // attributes. Shortcut edges are inserted before regular edges.
 void ShortcutBuilder::Build(const boost::property_tree::ptree& pt) {
-
-  // TODO: thread this. would need to make sure we dont make shortcuts
-  // across tile boundaries so that we are only messing with one tile
-  // in one thread at a time
-
-  // Get GraphReader
+  // Shortcuts can cross tile boundaries so the tiles of a level are formed in parallel from the
+  // tiles of the level as they were before. The new tiles are stored next to the tile directory
+  // and only moved in place once every tile of the level is done, so the tiles are the same no
+  // matter how many threads are used
+  unsigned int concurrency =
+      std::max(static_cast<unsigned int>(1),
+               pt.get<unsigned int>("mjolnir.concurrency", std::thread::hardware_concurrency()));
   GraphReader reader(pt.get_child("mjolnir"));
+  std::string tile_dir = reader.tile_dir();
+  while (tile_dir.size() > 1 && tile_dir.back() == filesystem::path::preferred_separator) {
+    tile_dir.pop_back();
+  }
+  std::string staging_dir = tile_dir + ".shortcuts";
 
   auto tile_level = TileHierarchy::levels().rbegin();
   tile_level++;
   for (; tile_level != TileHierarchy::levels().rend(); ++tile_level) {
     // Create shortcuts on this level
     LOG_INFO("Creating shortcuts on level " + std::to_string(tile_level->level));
-    uint32_t count = FormShortcuts(reader, *tile_level);
-    LOG_INFO("Finished with " + std::to_string(count) + " shortcuts");
+    auto tiles = reader.GetTileSet(tile_level->level);
+    TileScheduler scheduler(TileScheduler::FileSizes(tile_dir, tiles), concurrency);
+    filesystem::remove_all(staging_dir);
+
+    // Spawn the threads and wait for them to finish
+    std::vector<std::shared_ptr<std::thread>> threads(scheduler.concurrency());
+    std::list<std::promise<uint32_t>> results;
+    for (unsigned int i = 0; i < threads.size(); ++i) {
+      results.emplace_back();
+      threads[i].reset(new std::thread(FormShortcuts, std::cref(pt), std::cref(staging_dir),
+                                       std::ref(scheduler), i, std::ref(results.back())));
+    }
+    for (auto& thread : threads) {
+      thread->join();
+    }
+    uint32_t count = 0;
+    for (auto& result : results) {
+      count += result.get_future().get();
+    }
+
+    // Move the new tiles in place
+    for (const auto& tile_id : tiles) {
+      std::string suffix = std::string(1, filesystem::path::preferred_separator) +
+                           GraphTile::FileSuffix(tile_id);
+      if (std::rename((staging_dir + suffix).c_str(), (tile_dir + suffix).c_str()) != 0) {
+        throw std::runtime_error("Could not move " + staging_dir + suffix + " to " + tile_dir +
+                                 suffix);
+      }
+    }
+    filesystem::remove_all(staging_dir);
+    reader.Clear();
+    scheduler.LogUtilization("Created " + std::to_string(count) + " shortcuts in");
   }
 }
 
@@ -0,0 +1,79 @@
+#include "mjolnir/spatialindexbuilder.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "baldr/graphconstants.h"
+#include "baldr/graphid.h"
+#include "baldr/graphtile.h"
+#include "baldr/tilehierarchy.h"
+#include "midgard/logging.h"
+
+using namespace valhalla::baldr;
+using namespace valhalla::mjolnir;
+
+namespace valhalla {
+namespace mjolnir {
+
+void SpatialIndexBuilder::Build(const boost::property_tree::ptree& pt) {
+  auto file_name = pt.get<std::string>("mjolnir.spatial_index_file", "");
+  if (file_name.empty()) {
+    LOG_INFO("Skipping spatial index");
+    return;
+  }
+
+  GraphReader reader(pt.get_child("mjolnir"));
+  Build(reader, file_name);
+}
+
+void SpatialIndexBuilder::Build(GraphReader& reader, const std::string& file_name) {
+  LOG_INFO("Building spatial index");
+
+  // Bins only exist on the most detailed level, visit its tiles in the order of their ids
+  auto tile_set = reader.GetTileSet(TileHierarchy::levels().back().level);
+  std::vector<GraphId> tile_ids(tile_set.begin(), tile_set.end());
+  std::sort(tile_ids.begin(), tile_ids.end(),
+            [](const GraphId& a, const GraphId& b) { return a.tile_value() < b.tile_value(); });
+
+  std::vector<SpatialIndex::tile_t> tiles;
+  std::vector<SpatialIndex::box_t> boxes;
+  tiles.reserve(tile_ids.size());
+  uint64_t dataset_id = 0;
+  for (const auto& tile_id : tile_ids) {
+    graph_tile_ptr tile = reader.GetGraphTile(tile_id);
+    if (!tile) {
+      continue;
+    }
+
+    // The bins are contiguous so going through them in order gives each edge the box at its offset
+    dataset_id = tile->header()->dataset_id();
+    SpatialIndex::tile_t indexed{tile_id.tile_value(), 0, boxes.size(),
+                                 SpatialIndex::Checksum(*tile)};
+    for (size_t bin = 0; bin < kBinCount; ++bin) {
+      for (auto edge_id : tile->GetBin(bin)) {
+        graph_tile_ptr edge_tile = tile;
+        if (!reader.GetGraphTile(edge_id, edge_tile)) {
+          // Searches pass over edges they can't get at so any box will do
+          boxes.push_back(SpatialIndex::Box({}));
+          continue;
+        }
+        const auto* edge = edge_tile->directededge(edge_id);
+        boxes.push_back(SpatialIndex::Box(edge_tile->edgeinfo(edge->edgeinfo_offset()).shape()));
+      }
+    }
+    indexed.box_count = boxes.size() - indexed.first_box;
+    tiles.push_back(indexed);
+
+    // Keep the memory in check on large extracts
+    if (reader.OverCommitted()) {
+      reader.Trim();
+    }
+  }
+
+  SpatialIndex::Save(file_name, dataset_id, tiles, boxes);
+  LOG_INFO("Finished spatial index with " + std::to_string(boxes.size()) + " edges in " +
+           std::to_string(tiles.size()) + " tiles");
+}
+
+} // namespace mjolnir
+} // namespace valhalla
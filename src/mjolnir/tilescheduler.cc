@@ -0,0 +1,100 @@
+#include "mjolnir/tilescheduler.h"
+
+#include <algorithm>
+
+#include <sys/stat.h>
+
+#include "baldr/graphtile.h"
+#include "filesystem.h"
+#include "midgard/logging.h"
+
+using namespace valhalla::baldr;
+
+namespace valhalla {
+namespace mjolnir {
+
+TileScheduler::TileScheduler(tile_costs_t tiles, unsigned int concurrency)
+    : tile_count_(tiles.size()), start_(clock::now()), stolen_(0) {
+  // Most expensive first. Ties go by id so the tiles are always dealt the same way
+  std::sort(tiles.begin(), tiles.end(), [](const tile_costs_t::value_type& a,
+                                           const tile_costs_t::value_type& b) {
+    return a.second == b.second ? a.first.value < b.first.value : a.second > b.second;
+  });
+
+  // Deal them out so each worker gets about the same work
+  size_t count = std::max<size_t>(1, std::min<size_t>(concurrency, tiles.size()));
+  for (size_t i = 0; i < count; ++i) {
+    workers_.emplace_back(new worker_t);
+  }
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    workers_[i % count]->tiles.push_back(tiles[i].first);
+  }
+}
+
+bool TileScheduler::Next(unsigned int worker, GraphId& tile_id) {
+  auto& self = *workers_[worker];
+  auto now = clock::now();
+  if (self.working) {
+    self.busy += now - self.started;
+  }
+
+  // Work on our own tiles, most expensive first
+  bool found = false;
+  {
+    std::lock_guard<std::mutex> lock(self.lock);
+    if (!self.tiles.empty()) {
+      tile_id = self.tiles.front();
+      self.tiles.pop_front();
+      found = true;
+    }
+  }
+
+  // Take the cheapest tile another worker has not got to yet. Queues only ever shrink so once
+  // they are all empty there is nothing left to do
+  for (size_t i = 1; !found && i < workers_.size(); ++i) {
+    auto& victim = *workers_[(worker + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.lock);
+    if (!victim.tiles.empty()) {
+      tile_id = victim.tiles.back();
+      victim.tiles.pop_back();
+      ++stolen_;
+      found = true;
+    }
+  }
+
+  self.working = found;
+  if (found) {
+    self.started = clock::now();
+  } else {
+    self.finished = clock::now();
+  }
+  return found;
+}
+
+void TileScheduler::LogUtilization(const std::string& stage) const {
+  clock::duration busy{}, elapsed{};
+  for (const auto& worker : workers_) {
+    busy += worker->busy;
+    elapsed = std::max(elapsed, worker->finished - start_);
+  }
+  auto secs = std::chrono::duration_cast<std::chrono::duration<double>>(elapsed).count();
+  auto utilization = secs > 0 ? std::chrono::duration_cast<std::chrono::duration<double>>(busy)
+                                        .count() /
+                                    (secs * workers_.size())
+                              : 1.0;
+  LOG_INFO(stage + " " + std::to_string(tile_count_) + " tiles on " +
+           std::to_string(workers_.size()) + " threads took " +
+           std::to_string(static_cast<uint32_t>(secs)) + " secs, the threads were busy " +
+           std::to_string(static_cast<uint32_t>(utilization * 100 + .5)) + "% of the time and " +
+           std::to_string(stolen_.load()) + " tiles were stolen");
+}
+
+uint64_t TileScheduler::FileSize(const std::string& tile_dir, const GraphId& tile_id) {
+  struct stat s;
+  auto file_name =
+      tile_dir + filesystem::path::preferred_separator + GraphTile::FileSuffix(tile_id.Tile_Base());
+  return stat(file_name.c_str(), &s) == 0 ? static_cast<uint64_t>(s.st_size) : 0;
+}
+
+} // namespace mjolnir
+} // namespace valhalla
@@ -1,5 +1,6 @@
 #include "mjolnir/util.h"
 
+#include "baldr/tile_extract.h"
 #include "baldr/tilehierarchy.h"
 #include "filesystem.h"
 #include "midgard/aabb2.h"
@@ -7,22 +8,34 @@
 #include "midgard/point2.h"
 #include "midgard/polyline2.h"
 #include "mjolnir/bssbuilder.h"
+#include "mjolnir/chbuilder.h"
 #include "mjolnir/elevationbuilder.h"
 #include "mjolnir/graphbuilder.h"
 #include "mjolnir/graphenhancer.h"
 #include "mjolnir/graphfilter.h"
 #include "mjolnir/graphvalidator.h"
 #include "mjolnir/hierarchybuilder.h"
+#include "mjolnir/osmchange.h"
 #include "mjolnir/osmpbfparser.h"
 #include "mjolnir/pbfgraphparser.h"
 #include "mjolnir/restrictionbuilder.h"
 #include "mjolnir/shortcutbuilder.h"
+#include "mjolnir/spatialindexbuilder.h"
 #include "mjolnir/transitbuilder.h"
 
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
 using namespace valhalla::midgard;
 
 namespace {
@@ -42,6 +55,42 @@ const std::string old_to_new_file = "old_nodes_to_new_nodes.bin";
 const std::string intersections_file = "intersections.bin";
 const std::string shapes_file = "shapes.bin";
 
+#ifndef _WIN32
+// Where a symlink points to, as seen from where the link is, or nothing if it is not a symlink
+std::string link_target(const std::string& link) {
+  struct stat s;
+  if (lstat(link.c_str(), &s) != 0 || !S_ISLNK(s.st_mode)) {
+    return "";
+  }
+  std::vector<char> target(s.st_size + 1);
+  auto size = readlink(link.c_str(), target.data(), target.size());
+  if (size <= 0 || static_cast<size_t>(size) >= target.size()) {
+    return "";
+  }
+  std::string path(target.data(), size);
+  auto parent = filesystem::path(link).parent_path().string();
+  return path.front() == filesystem::path::preferred_separator || parent.empty()
+             ? path
+             : parent + filesystem::path::preferred_separator + path;
+}
+
+// Moves a path that is configured under the tile directory to the same place under another one
+bool move_under(boost::property_tree::ptree& config,
+                const std::string& key,
+                const std::string& from,
+                const std::string& to) {
+  auto path = config.get<std::string>(key, "");
+  if (path.empty()) {
+    return true;
+  }
+  if (path.compare(0, from.size() + 1, from + filesystem::path::preferred_separator) != 0) {
+    return false;
+  }
+  config.put(key, to + path.substr(from.size()));
+  return true;
+}
+#endif
+
 } // namespace
 
 namespace valhalla {
@@ -381,6 +430,36 @@ bool build_tile_set(const boost::property_tree::ptree& original_config,
     GraphValidator::Validate(config);
   }
 
+  // Build contraction hierarchy overlays for the matrix if an overlay dir was configured.
+  if (start_stage <= BuildStage::kOverlay && BuildStage::kOverlay <= end_stage) {
+    CHBuilder::Build(config);
+  }
+
+  // Build the spatial index for loki's location search if a file for it was configured.
+  if (start_stage <= BuildStage::kSpatialIndex && BuildStage::kSpatialIndex <= end_stage) {
+    SpatialIndexBuilder::Build(config);
+  }
+
+  // Write the tiles to an indexed extract at mjolnir.tile_extract if that was asked for.
+  if (start_stage <= BuildStage::kExtract && BuildStage::kExtract <= end_stage) {
+    auto tile_extract = original_config.get<std::string>("mjolnir.tile_extract", "");
+    if (original_config.get<bool>("mjolnir.build_tile_extract", false) && !tile_extract.empty()) {
+      LOG_INFO("Writing tile extract " + tile_extract);
+      auto start = std::chrono::high_resolution_clock::now();
+      try {
+        auto count = baldr::TileExtract::Save(tile_extract, tile_dir);
+        auto secs = std::chrono::duration_cast<std::chrono::seconds>(
+                        std::chrono::high_resolution_clock::now() - start)
+                        .count();
+        LOG_INFO("Wrote " + std::to_string(count) + " tiles to " + tile_extract + " took " +
+                 std::to_string(secs) + " secs");
+      } catch (const std::exception& e) {
+        LOG_ERROR(e.what());
+        return false;
+      }
+    }
+  }
+
   // Cleanup bin files
   if (start_stage <= BuildStage::kCleanup && BuildStage::kCleanup <= end_stage) {
     LOG_INFO("Cleaning up temporary *.bin files within " + tile_dir);
@@ -400,5 +479,100 @@ bool build_tile_set(const boost::property_tree::ptree& original_config,
   return true;
 }
 
+bool swap_tile_set(const boost::property_tree::ptree& original_config,
+                   const std::vector<std::string>& input_files,
+                   const std::string& change_file) {
+#ifdef _WIN32
+  LOG_ERROR("Swapping in a new tileset needs symlinks, which are not supported on this platform");
+  return false;
+#else
+  std::string tile_dir = original_config.get<std::string>("mjolnir.tile_dir");
+  while (tile_dir.size() > 1 && tile_dir.back() == filesystem::path::preferred_separator) {
+    tile_dir.pop_back();
+  }
+  const auto live_dir = link_target(tile_dir);
+  if (live_dir.empty() || !filesystem::is_directory(tile_dir)) {
+    LOG_ERROR(tile_dir + " must be a symlink to the directory with the live tiles, so that the "
+                         "new tiles can be swapped in at once");
+    return false;
+  }
+
+  // A change file only tells whether to rebuild at all, the tiles are always rebuilt together
+  if (!change_file.empty()) {
+    try {
+      if (OSMChange::Read(change_file).AffectedTiles(original_config).empty()) {
+        LOG_INFO("The changes do not affect any tiles in " + tile_dir + ", nothing to rebuild");
+        return true;
+      }
+    } catch (const std::exception& e) {
+      LOG_ERROR(e.what());
+      return false;
+    }
+  }
+
+  // The ids of the nodes and edges are handed out over the whole graph by the early stages and the
+  // hierarchy is formed from all of it, so the whole tileset is rebuilt next to the live one. The
+  // overlays and the spatial index are made from the tiles, so they go with them
+  std::string new_dir;
+  for (auto stamp = std::time(nullptr); new_dir.empty() || new_dir == live_dir; ++stamp) {
+    new_dir = tile_dir + "." + std::to_string(stamp);
+  }
+  if (filesystem::exists(new_dir)) {
+    filesystem::remove_all(new_dir);
+  }
+  auto config = original_config;
+  config.put("mjolnir.tile_dir", new_dir);
+  config.put("mjolnir.build_tile_extract", false);
+  for (const auto& key : {"mjolnir.ch_overlay_dir", "mjolnir.spatial_index_file"}) {
+    if (!move_under(config, key, tile_dir, new_dir)) {
+      LOG_ERROR(std::string(key) + " must be under " + tile_dir + " to be swapped with the tiles");
+      return false;
+    }
+  }
+  if (!build_tile_set(config, input_files, BuildStage::kInitialize, BuildStage::kCleanup)) {
+    return false;
+  }
+
+  // Point the tile directory at the new tiles with a single rename of a link to them
+  const auto new_link = tile_dir + ".link";
+  std::remove(new_link.c_str());
+  if (symlink(filesystem::path(new_dir).filename().c_str(), new_link.c_str()) != 0 ||
+      std::rename(new_link.c_str(), tile_dir.c_str()) != 0) {
+    LOG_ERROR("Could not point " + tile_dir + " at " + new_dir);
+    std::remove(new_link.c_str());
+    return false;
+  }
+  LOG_INFO("Swapped the tiles in " + new_dir + " in for the ones in " + live_dir);
+
+  // Readers that were made before the swap keep reading the tiles that were live then, so those
+  // are kept until the next swap. Only the tilesets before them are removed
+  auto parent = filesystem::path(tile_dir).parent_path().string();
+  const auto prefix = filesystem::path(tile_dir).filename().string() + ".";
+  for (filesystem::directory_iterator i(parent.empty() ? "." : parent), end; i != end; ++i) {
+    const auto name = i->path().filename().string();
+    if (!i->is_directory() || name.compare(0, prefix.size(), prefix) != 0 ||
+        name.size() == prefix.size() ||
+        name.find_first_not_of("0123456789", prefix.size()) != std::string::npos) {
+      continue;
+    }
+    const auto dir = parent.empty() ? name : parent + filesystem::path::preferred_separator + name;
+    if (dir != new_dir && dir != live_dir) {
+      LOG_INFO("Removing the old tileset " + dir);
+      filesystem::remove_all(dir);
+    }
+  }
+
+  // The extract is made from the tiles that are live now
+  if (!build_tile_set(original_config, input_files, BuildStage::kExtract, BuildStage::kExtract)) {
+    return false;
+  }
+  if (original_config.get_optional<std::string>("mjolnir.tile_extract") &&
+      !original_config.get<bool>("mjolnir.build_tile_extract", false)) {
+    LOG_WARN("The tile extract needs to be rebuilt from the new tiles in " + tile_dir);
+  }
+  return true;
+#endif
+}
+
 } // namespace mjolnir
 } // namespace valhalla
@@ -33,6 +33,7 @@ int main(int argc, char** argv) {
   std::string inline_config;
   std::string start_stage_str = "initialize";
   std::string end_stage_str = "cleanup";
+  std::string change_file;
   std::vector<std::string> input_files;
   bpo::options_description options(
       "valhalla_build_tiles " VALHALLA_VERSION "\n\n"
@@ -51,7 +52,12 @@ int main(int argc, char** argv) {
       "Starting stage of the build pipeline")("end,e",
                                               boost::program_options::value<std::string>(
                                                   &end_stage_str),
-                                              "End stage of the build pipeline")
+                                              "End stage of the build pipeline")(
+      "swap", "Build the whole tileset next to the one mjolnir.tile_dir links to and swap the link "
+              "to the new one when it is done. This is not faster than a build from scratch.")(
+      "changes,u", boost::program_options::value<std::string>(&change_file),
+      "With --swap, the OSM change file (.osc or .osc.gz) that was applied to the input files. "
+      "Nothing is built if it does not affect the live tiles.")
 
       // positional arguments
       ("input_files",
@@ -104,6 +110,19 @@ int main(int argc, char** argv) {
     valhalla::midgard::logging::Configure(logging_config);
   }
 
+  // Build a new tileset next to the live one and swap it in
+  if (vm.count("changes") && !vm.count("swap")) {
+    std::cerr << "--changes only works with --swap\n\n" << options << "\n\n";
+    return EXIT_FAILURE;
+  }
+  if (vm.count("swap")) {
+    if (input_files.empty()) {
+      std::cerr << "Input file is required\n\n" << options << "\n\n";
+      return EXIT_FAILURE;
+    }
+    return swap_tile_set(pt, input_files, change_file) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
   // Convert stage strings to BuildStage
   BuildStage start_stage = string_to_buildstage(start_stage_str);
   if (start_stage == BuildStage::kInvalid) {
@@ -113,6 +113,8 @@ bool Options_Action_Enum_Parse(const std::string& action, Options::Action* a) {
       {"transit_available", Options::transit_available},
       {"expansion", Options::expansion},
       {"centroid", Options::centroid},
+      {"trace_attributes_batch", Options::trace_attributes_batch},
+      {"online_match", Options::online_match},
   };
   auto i = actions.find(action);
   if (i == actions.cend())
@@ -135,6 +137,8 @@ const std::string& Options_Action_Enum_Name(const Options::Action action) {
       {Options::transit_available, "transit_available"},
       {Options::expansion, "expansion"},
       {Options::centroid, "centroid"},
+      {Options::trace_attributes_batch, "trace_attributes_batch"},
+      {Options::online_match, "online_match"},
   };
   auto i = actions.find(action);
   return i == actions.cend() ? empty : i->second;
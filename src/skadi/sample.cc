@@ -3,8 +3,11 @@
 #include <cmath>
 #include <cstddef>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <limits>
 #include <list>
+#include <mutex>
 #include <regex>
 #include <stdexcept>
 #include <string>
@@ -80,8 +83,102 @@ uint64_t file_size(const std::string& file_name) {
 namespace valhalla {
 namespace skadi {
 
-::valhalla::skadi::sample::sample(const std::string& data_source)
-    : mapped_cache(TILE_COUNT), unzipped_cache(-1, std::vector<int16_t>()), data_source(data_source) {
+/**
+ * Thread safe LRU of inflated tiles bounded by the memory they take. A tile that is being inflated
+ * is in the cache already so that other threads wanting it wait for it rather than inflating it
+ * again themselves.
+ */
+class sample::unzipped_cache_t {
+public:
+  using tile_t = std::shared_ptr<const std::vector<int16_t>>;
+
+  explicit unzipped_cache_t(size_t max_size) : max_size_(max_size), size_(0), next_id_(0) {
+  }
+
+  // The cache shared by all the samplers of the process, it goes away along with the last of them
+  static std::shared_ptr<unzipped_cache_t> get_instance(size_t max_size) {
+    static std::mutex mutex;
+    static std::weak_ptr<unzipped_cache_t> instance;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cache = instance.lock();
+    if (cache) {
+      cache->reserve(max_size);
+    } else {
+      cache = std::make_shared<unzipped_cache_t>(max_size);
+      instance = cache;
+    }
+    return cache;
+  }
+
+  // Grows the memory budget if it is smaller than the one asked for
+  void reserve(size_t max_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_size_ = std::max(max_size_, max_size);
+  }
+
+  // Gets the tile from the cache or inflates it, returns nullptr if it couldn't be inflated
+  tile_t get(const std::string& key, const std::function<tile_t()>& inflate) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto found = entries_.find(key);
+    if (found != entries_.end()) {
+      lru_.splice(lru_.begin(), lru_, found->second.position);
+      auto tile = found->second.tile;
+      lock.unlock();
+      return tile.get();
+    }
+
+    // Let everyone know we are on it
+    std::promise<tile_t> promise;
+    const uint64_t id = next_id_++;
+    lru_.push_front(key);
+    entries_.emplace(key, entry_t{promise.get_future().share(), lru_.begin(), id, 0});
+    lock.unlock();
+
+    auto tile = inflate();
+    promise.set_value(tile);
+
+    // Account for it unless it was evicted while we were at it
+    lock.lock();
+    found = entries_.find(key);
+    if (found != entries_.end() && found->second.id == id) {
+      if (!tile) {
+        erase(found);
+      } else {
+        found->second.size = tile->size() * sizeof(int16_t);
+        size_ += found->second.size;
+      }
+    }
+    while (size_ > max_size_ && lru_.size() > 1) {
+      erase(entries_.find(lru_.back()));
+    }
+    return tile;
+  }
+
+protected:
+  struct entry_t {
+    std::shared_future<tile_t> tile;
+    std::list<std::string>::iterator position;
+    uint64_t id;
+    size_t size;
+  };
+
+  void erase(std::unordered_map<std::string, entry_t>::iterator entry) {
+    size_ -= entry->second.size;
+    lru_.erase(entry->second.position);
+    entries_.erase(entry);
+  }
+
+  std::mutex mutex_;
+  size_t max_size_;
+  size_t size_;
+  uint64_t next_id_;
+  std::list<std::string> lru_;
+  std::unordered_map<std::string, entry_t> entries_;
+};
+
+::valhalla::skadi::sample::sample(const std::string& data_source, size_t cache_size)
+    : mapped_cache(TILE_COUNT), mapped_ready(new std::atomic<bool>[TILE_COUNT]()),
+      unzipped_cache(unzipped_cache_t::get_instance(cache_size)), data_source(data_source) {
   // messy but needed
   while (this->data_source.size() &&
          this->data_source.back() == filesystem::path::preferred_separator) {
@@ -102,76 +199,85 @@ namespace skadi {
       }
       mapped_cache[index].first = format;
       mapped_cache[index].second.map(f, size, POSIX_MADV_SEQUENTIAL);
+      mapped_ready[index].store(true, std::memory_order_release);
     }
   }
 }
 
-const int16_t* sample::source(uint16_t index) const {
+std::shared_ptr<const int16_t> sample::source(uint16_t index) const {
   // bail if its out of bounds
   if (index >= TILE_COUNT) {
     return nullptr;
   }
 
-  // if we dont have anything maybe its lazy loaded
+  // if we dont have anything maybe its lazy loaded. samplers are shared between threads so only one
+  // of them at a time gets to look for it and map it
   auto& mapped = mapped_cache[index];
-  if (mapped.second.get() == nullptr) {
-    auto f = data_source + get_hgt_file_name(index);
-    auto size = file_size(f);
-    if (size != HGT_BYTES) {
-      return nullptr;
+  if (!mapped_ready[index].load(std::memory_order_acquire)) {
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (mapped.second.get() == nullptr) {
+      auto f = data_source + get_hgt_file_name(index);
+      auto size = file_size(f);
+      if (size != HGT_BYTES) {
+        return nullptr;
+      }
+      mapped.first = format_t::RAW;
+      mapped.second.map(f, size, POSIX_MADV_SEQUENTIAL);
     }
-    mapped.first = format_t::RAW;
-    mapped.second.map(f, size, POSIX_MADV_SEQUENTIAL);
+    mapped_ready[index].store(true, std::memory_order_release);
   }
 
-  // we have it raw or we dont
+  // we have it raw or we dont, the memory map lives as long as we do so nobody has to own it
   if (mapped.first == format_t::RAW) {
-    return static_cast<const int16_t*>(static_cast<const void*>(mapped.second.get()));
-  }
-
-  // if we have it already unzipped
-  if (unzipped_cache.first == index) {
-    return unzipped_cache.second.data();
+    const auto* raw = static_cast<const int16_t*>(static_cast<const void*>(mapped.second.get()));
+    return std::shared_ptr<const int16_t>(std::shared_ptr<const int16_t>(), raw);
   }
 
-  // for setting where to read compressed data from
-  auto src_func = [&mapped](z_stream& s) -> void {
-    s.next_in = static_cast<Byte*>(static_cast<void*>(mapped.second.get()));
-    s.avail_in = static_cast<unsigned int>(mapped.second.size());
-  };
-
-  // for setting where to write the uncompressed data to
-  auto dst_func = [this](z_stream& s) -> int {
-    unzipped_cache.second.resize(HGT_PIXELS);
-    s.next_out = static_cast<Byte*>(static_cast<void*>(unzipped_cache.second.data()));
-    s.avail_out = HGT_BYTES;
-    return Z_FINISH; // we know the output will hold all the input
+  // we have to unzip it unless someone already did
+  auto inflate = [&mapped]() -> unzipped_cache_t::tile_t {
+    auto unzipped = std::make_shared<std::vector<int16_t>>();
+
+    // for setting where to read compressed data from
+    auto src_func = [&mapped](z_stream& s) -> void {
+      s.next_in = static_cast<Byte*>(static_cast<void*>(mapped.second.get()));
+      s.avail_in = static_cast<unsigned int>(mapped.second.size());
+    };
+
+    // for setting where to write the uncompressed data to
+    auto dst_func = [&unzipped](z_stream& s) -> int {
+      unzipped->resize(HGT_PIXELS);
+      s.next_out = static_cast<Byte*>(static_cast<void*>(unzipped->data()));
+      s.avail_out = HGT_BYTES;
+      return Z_FINISH; // we know the output will hold all the input
+    };
+
+    if (!baldr::inflate(src_func, dst_func)) {
+      LOG_WARN("Corrupt compressed elevation data");
+      return nullptr;
+    }
+    return unzipped;
   };
 
-  // we have to unzip it
-  if (!baldr::inflate(src_func, dst_func)) {
-    LOG_WARN("Corrupt compressed elevation data");
-    unzipped_cache.first = -1;
+  auto unzipped = unzipped_cache->get(data_source + get_hgt_file_name(index), inflate);
+  if (!unzipped) {
     return nullptr;
   }
-
-  // update the simple cache
-  // TODO: LRU
-  unzipped_cache.first = index;
-  return unzipped_cache.second.data();
+  return std::shared_ptr<const int16_t>(unzipped, unzipped->data());
 }
 
 template <class coord_t> double sample::get(const coord_t& coord) const {
-  // check the cache and load
-  auto lon = std::floor(coord.first);
-  auto lat = std::floor(coord.second);
-  auto index = static_cast<uint16_t>(lat + 90) * 360 + static_cast<uint16_t>(lon + 180);
-
   // get the proper source of the data
-  const auto* t = source(index);
+  auto t = source(get_tile_index(coord));
+  return interpolate(coord, t.get());
+}
+
+template <class coord_t> double sample::interpolate(const coord_t& coord, const int16_t* t) {
   if (t == nullptr) {
     return NO_DATA_VALUE;
   }
+  auto lon = std::floor(coord.first);
+  auto lat = std::floor(coord.second);
 
   // figure out what row and column we need from the array of data
   // NOTE: data is arranged from upper left to bottom right, so y is flipped
@@ -237,8 +343,18 @@ template <class coord_t> double sample::get(const coord_t& coord) const {
 template <class coords_t> std::vector<double> sample::get_all(const coords_t& coords) const {
   std::vector<double> values;
   values.reserve(coords.size());
+
+  // consecutive postings are nearly always in the same tile so we only go get the data of a tile
+  // again when we cross into another one
+  auto index = std::numeric_limits<uint16_t>::max();
+  std::shared_ptr<const int16_t> t;
   for (const auto& coord : coords) {
-    values.emplace_back(get(coord));
+    auto coord_index = get_tile_index(coord);
+    if (coord_index != index) {
+      index = coord_index;
+      t = source(index);
+    }
+    values.emplace_back(interpolate(coord, t.get()));
   }
   return values;
 }
@@ -300,6 +416,12 @@ template std::vector<double>
 sample::get_all<std::list<midgard::Point2>>(const std::list<midgard::Point2>&) const;
 template std::vector<double>
 sample::get_all<std::vector<midgard::Point2>>(const std::vector<midgard::Point2>&) const;
+template double sample::interpolate<std::pair<double, double>>(const std::pair<double, double>&,
+                                                               const int16_t*);
+template double sample::interpolate<std::pair<float, float>>(const std::pair<float, float>&,
+                                                             const int16_t*);
+template double sample::interpolate<midgard::PointLL>(const midgard::PointLL&, const int16_t*);
+template double sample::interpolate<midgard::Point2>(const midgard::Point2&, const int16_t*);
 template uint16_t
 sample::get_tile_index<std::pair<double, double>>(const std::pair<double, double>& coord);
 template uint16_t
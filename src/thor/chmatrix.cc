@@ -0,0 +1,235 @@
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <unordered_set>
+#include <vector>
+
+#include "thor/chmatrix.h"
+
+using namespace valhalla::baldr;
+using namespace valhalla::sif;
+
+namespace {
+
+bool equals(const valhalla::LatLng& a, const valhalla::LatLng& b) {
+  return a.has_lat() == b.has_lat() && a.has_lng() == b.has_lng() &&
+         (!a.has_lat() || a.lat() == b.lat()) && (!a.has_lng() || a.lng() == b.lng());
+}
+
+} // namespace
+
+namespace valhalla {
+namespace thor {
+
+CHMatrix::CHMatrix(std::shared_ptr<const CHOverlay> overlay) : overlay_(std::move(overlay)) {
+}
+
+bool CHMatrix::Covers(const google::protobuf::RepeatedPtrField<valhalla::Location>& locations,
+                      GraphReader& graphreader) const {
+  for (const auto& location : locations) {
+    for (const auto& edge : location.path_edges()) {
+      GraphId edgeid(edge.graph_id());
+      graph_tile_ptr tile = graphreader.GetGraphTile(edgeid);
+      if (!tile || tile->header()->dataset_id() != overlay_->dataset_id()) {
+        return false;
+      }
+      const DirectedEdge* directededge = tile->directededge(edgeid);
+      if (directededge->destonly() ||
+          overlay_->node_index(directededge->endnode()) == CHOverlay::kInvalidNode ||
+          overlay_->node_index(graphreader.edge_startnode(edgeid)) == CHOverlay::kInvalidNode) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+std::vector<TimeDistance>
+CHMatrix::SourceToTarget(const google::protobuf::RepeatedPtrField<valhalla::Location>& source_list,
+                         const google::protobuf::RepeatedPtrField<valhalla::Location>& target_list,
+                         GraphReader& graphreader,
+                         const mode_costing_t& mode_costing,
+                         const TravelMode mode,
+                         const float max_matrix_distance) {
+  const auto& costing = mode_costing[static_cast<uint32_t>(mode)];
+  const uint32_t source_count = source_list.size();
+  const uint32_t target_count = target_list.size();
+
+  // Keeps the cheapest label per seed node
+  auto add_seed = [](search_space_t& seeds, const uint32_t node, const label_t& label) {
+    auto inserted = seeds.emplace(node, label);
+    if (!inserted.second && label.cost < inserted.first->second.cost) {
+      inserted.first->second = label;
+    }
+  };
+
+  // The sources start at the end nodes of their edges with the remainder of the edge. As in
+  // CostMatrix the distance of the candidate from the input is added to its cost
+  std::vector<search_space_t> source_seeds(source_count);
+  for (uint32_t i = 0; i < source_count; ++i) {
+    for (const auto& edge : source_list.Get(i).path_edges()) {
+      if (edge.end_node()) {
+        continue;
+      }
+      GraphId edgeid(edge.graph_id());
+      graph_tile_ptr tile = graphreader.GetGraphTile(edgeid);
+      const DirectedEdge* directededge = tile->directededge(edgeid);
+      uint32_t node = overlay_->node_index(directededge->endnode());
+      if (node == CHOverlay::kInvalidNode) {
+        continue;
+      }
+      float remainder = 1.0f - edge.percent_along();
+      Cost cost = costing->EdgeCost(directededge, tile) * remainder;
+      cost.cost += edge.distance();
+      add_seed(source_seeds[i], node, {cost.cost, cost.secs, directededge->length() * remainder});
+    }
+  }
+
+  // The targets start at the start nodes of their edges with the part of the edge before them
+  std::vector<search_space_t> target_seeds(target_count);
+  for (uint32_t j = 0; j < target_count; ++j) {
+    for (const auto& edge : target_list.Get(j).path_edges()) {
+      if (edge.begin_node()) {
+        continue;
+      }
+      GraphId edgeid(edge.graph_id());
+      graph_tile_ptr tile = graphreader.GetGraphTile(edgeid);
+      const DirectedEdge* directededge = tile->directededge(edgeid);
+      uint32_t node = overlay_->node_index(graphreader.edge_startnode(edgeid));
+      if (node == CHOverlay::kInvalidNode) {
+        continue;
+      }
+      float along = edge.percent_along();
+      Cost cost = costing->EdgeCost(directededge, tile) * along;
+      cost.cost += edge.distance();
+      add_seed(target_seeds[j], node, {cost.cost, cost.secs, directededge->length() * along});
+    }
+  }
+
+  // Start out with the trivial answers: same location or along the same edge
+  std::vector<label_t> best(source_count * target_count, {kMaxCost, kMaxCost, kMaxCost});
+  for (uint32_t i = 0; i < source_count; ++i) {
+    for (uint32_t j = 0; j < target_count; ++j) {
+      auto& connection = best[i * target_count + j];
+      if (equals(source_list.Get(i).ll(), target_list.Get(j).ll())) {
+        connection = {0.f, 0.f, 0.f};
+        continue;
+      }
+      for (const auto& source_edge : source_list.Get(i).path_edges()) {
+        for (const auto& target_edge : target_list.Get(j).path_edges()) {
+          if (source_edge.graph_id() != target_edge.graph_id() ||
+              source_edge.percent_along() > target_edge.percent_along()) {
+            continue;
+          }
+          GraphId edgeid(source_edge.graph_id());
+          graph_tile_ptr tile = graphreader.GetGraphTile(edgeid);
+          const DirectedEdge* directededge = tile->directededge(edgeid);
+          float along = target_edge.percent_along() - source_edge.percent_along();
+          Cost cost = costing->EdgeCost(directededge, tile) * along;
+          cost.cost += source_edge.distance() + target_edge.distance();
+          if (cost.cost < connection.cost) {
+            connection = {cost.cost, cost.secs, directededge->length() * along};
+          }
+        }
+      }
+    }
+  }
+
+  // Each target leaves its costs in the buckets of the nodes its search settled
+  std::unordered_map<uint32_t, std::vector<bucket_entry_t>> buckets;
+  search_space_t settled;
+  for (uint32_t j = 0; j < target_count; ++j) {
+    Search(target_seeds[j], false, max_matrix_distance, settled);
+    for (const auto& node : settled) {
+      buckets[node.first].push_back({j, node.second});
+    }
+  }
+
+  // Each source meets the targets in the buckets of the nodes its search settled
+  for (uint32_t i = 0; i < source_count; ++i) {
+    Search(source_seeds[i], true, max_matrix_distance, settled);
+    auto* row = best.data() + i * target_count;
+    for (const auto& node : settled) {
+      auto bucket = buckets.find(node.first);
+      if (bucket == buckets.cend()) {
+        continue;
+      }
+      for (const auto& entry : bucket->second) {
+        float cost = node.second.cost + entry.label.cost;
+        if (cost < row[entry.target].cost) {
+          row[entry.target] = {cost, node.second.secs + entry.label.secs,
+                               node.second.length + entry.label.length};
+        }
+      }
+    }
+  }
+
+  // Form the time, distance matrix, like CostMatrix pairs beyond the limit are not found
+  std::vector<TimeDistance> td;
+  td.reserve(best.size());
+  for (const auto& connection : best) {
+    if (connection.length > max_matrix_distance) {
+      td.emplace_back(kMaxCost, kMaxCost);
+    } else {
+      td.emplace_back(std::round(connection.secs), std::round(connection.length));
+    }
+  }
+  return td;
+}
+
+void CHMatrix::Search(const search_space_t& seeds,
+                      const bool forward,
+                      const float max_length,
+                      search_space_t& settled) const {
+  using entry_t = std::pair<float, uint32_t>;
+  std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> queue;
+  search_space_t reached(seeds);
+  for (const auto& seed : seeds) {
+    queue.emplace(seed.second.cost, seed.first);
+  }
+
+  settled.clear();
+  std::unordered_set<uint32_t> done;
+  while (!queue.empty()) {
+    auto node = queue.top().second;
+    queue.pop();
+    if (!done.insert(node).second) {
+      continue;
+    }
+    const auto label = reached[node];
+    // Both halves of a path are at most as long as the whole of it
+    if (label.length > max_length) {
+      continue;
+    }
+
+    // Stall on demand: if a higher ranked node already reached reaches this one cheaper than we
+    // did, the search got here on a path that isn't the shortest so there is no point going on
+    bool stalled = false;
+    for (const auto& arc : forward ? overlay_->down(node) : overlay_->up(node)) {
+      auto higher = reached.find(arc.node);
+      if (higher != reached.cend() && higher->second.cost + arc.cost < label.cost) {
+        stalled = true;
+        break;
+      }
+    }
+    if (stalled) {
+      continue;
+    }
+    settled.emplace(node, label);
+
+    for (const auto& arc : forward ? overlay_->up(node) : overlay_->down(node)) {
+      label_t next{label.cost + arc.cost, label.secs + arc.secs, label.length + arc.length};
+      auto inserted = reached.emplace(arc.node, next);
+      if (!inserted.second) {
+        if (next.cost >= inserted.first->second.cost) {
+          continue;
+        }
+        inserted.first->second = next;
+      }
+      queue.emplace(next.cost, arc.node);
+    }
+  }
+}
+
+} // namespace thor
+} // namespace valhalla
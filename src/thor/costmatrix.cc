@@ -1,5 +1,11 @@
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "midgard/logging.h"
@@ -15,6 +21,9 @@ namespace {
 
 constexpr uint32_t kMaxMatrixIterations = 2000000;
 
+// Below this many searches per iteration waking up the threads costs more than it saves
+constexpr uint32_t kMinParallelSearches = 8;
+
 // Find a threshold to continue the search - should be based on
 // the max edge cost in the adjacency set?
 int GetThreshold(const TravelMode mode, const int n) {
@@ -33,10 +42,128 @@ namespace thor {
 
 class CostMatrix::TargetMap : public robin_hood::unordered_map<uint64_t, std::vector<uint32_t>> {};
 
+/**
+ * Threads that run one iteration of many searches at a time. Each thread has
+ * its own graph reader and takes the next search that nobody has started yet
+ * until there are none left, the calling thread joins in with its reader.
+ */
+class CostMatrix::WorkerPool {
+public:
+  using task_t = std::function<void(const uint32_t, GraphReader&)>;
+
+  WorkerPool(const boost::property_tree::ptree& config, const uint32_t thread_count)
+      : task_(nullptr), count_(0), next_(0), generation_(0), busy_(0), done_(false) {
+    for (uint32_t i = 0; i < thread_count; ++i) {
+      readers_.emplace_back(new GraphReader(config));
+    }
+    for (uint32_t i = 0; i < thread_count; ++i) {
+      threads_.emplace_back(&WorkerPool::work, this, i);
+    }
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+    }
+    start_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  size_t size() const {
+    return threads_.size();
+  }
+
+  // Runs the task for every index in [0, count) and waits for all of them to finish
+  void run(const uint32_t count, GraphReader& reader, const task_t& task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = &task;
+      count_ = count;
+      next_ = 0;
+      busy_ = threads_.size();
+      error_ = nullptr;
+      ++generation_;
+    }
+    start_.notify_all();
+    drain(reader);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this]() { return busy_ == 0; });
+    task_ = nullptr;
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+
+  // Lets the readers of the threads give back memory if they are over their limits
+  void trim() {
+    for (auto& reader : readers_) {
+      if (reader->OverCommitted()) {
+        reader->Trim();
+      }
+    }
+  }
+
+protected:
+  void drain(GraphReader& reader) {
+    try {
+      for (uint32_t i = next_++; i < count_; i = next_++) {
+        (*task_)(i, reader);
+      }
+    } catch (...) {
+      // stop handing out work and keep the first error for the caller
+      next_ = count_;
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!error_) {
+        error_ = std::current_exception();
+      }
+    }
+  }
+
+  void work(const uint32_t index) {
+    uint64_t generation = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [this, generation]() { return done_ || generation_ != generation; });
+        if (done_) {
+          return;
+        }
+        generation = generation_;
+      }
+      drain(*readers_[index]);
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--busy_ == 0) {
+        finished_.notify_one();
+      }
+    }
+  }
+
+  std::vector<std::unique_ptr<GraphReader>> readers_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable finished_;
+  const task_t* task_;
+  uint32_t count_;
+  std::atomic<uint32_t> next_;
+  uint64_t generation_;
+  size_t busy_;
+  bool done_;
+  std::exception_ptr error_;
+};
+
 // Constructor with cost threshold.
-CostMatrix::CostMatrix()
+CostMatrix::CostMatrix(const boost::property_tree::ptree& config)
     : mode_(TravelMode::kDrive), access_mode_(kAutoAccess), source_count_(0), remaining_sources_(0),
       target_count_(0), remaining_targets_(0), current_cost_threshold_(0), targets_{new TargetMap} {
+  const auto thread_count = config.get<uint32_t>("thor.costmatrix_threads", 0);
+  if (thread_count > 0) {
+    pool_.reset(new WorkerPool(config.get_child("mjolnir"), thread_count));
+  }
 }
 
 CostMatrix::~CostMatrix() {
@@ -82,6 +209,16 @@ void CostMatrix::Clear() {
   target_hierarchy_limits_.clear();
   source_status_.clear();
   target_status_.clear();
+
+  // Clear the effects of the searches on each other
+  target_reached_.clear();
+  source_connections_.clear();
+  source_exhausted_.clear();
+  target_exhausted_.clear();
+
+  if (pool_) {
+    pool_->trim();
+  }
 }
 
 // Form a time distance matrix from the set of source locations
@@ -112,34 +249,45 @@ std::vector<TimeDistance> CostMatrix::SourceToTarget(
 
   // Perform backward search from all target locations. Perform forward
   // search from all source locations. Connections between the 2 search
-  // spaces is checked during the forward search.
+  // spaces is checked during the forward search. Within each of the 2 steps
+  // the searches only change their own state, so they can run in parallel.
   int n = 0;
+  const WorkerPool::task_t backward = [this](const uint32_t i, GraphReader& reader) {
+    if (target_status_[i].threshold > 0) {
+      target_status_[i].threshold--;
+      BackwardSearch(i, reader);
+    }
+  };
+  const WorkerPool::task_t forward = [this, &n](const uint32_t i, GraphReader& reader) {
+    if (source_status_[i].threshold > 0) {
+      source_status_[i].threshold--;
+      ForwardSearch(i, n, reader);
+    }
+  };
   while (true) {
     // Iterate all target locations in a backwards search
-    for (uint32_t i = 0; i < target_count_; i++) {
-      if (target_status_[i].threshold > 0) {
-        target_status_[i].threshold--;
-        BackwardSearch(i, graphreader);
-        if (target_status_[i].threshold == 0) {
-          target_status_[i].threshold = -1;
-          if (remaining_targets_ > 0) {
-            remaining_targets_--;
-          }
-        }
+    if (pool_ && remaining_targets_ >= kMinParallelSearches) {
+      pool_->run(target_count_, graphreader, backward);
+      for (uint32_t i = 0; i < target_count_; i++) {
+        FinishBackwardSearch(i);
+      }
+    } else {
+      for (uint32_t i = 0; i < target_count_; i++) {
+        backward(i, graphreader);
+        FinishBackwardSearch(i);
       }
     }
 
     // Iterate all source locations in a forward search
-    for (uint32_t i = 0; i < source_count_; i++) {
-      if (source_status_[i].threshold > 0) {
-        source_status_[i].threshold--;
-        ForwardSearch(i, n, graphreader);
-        if (source_status_[i].threshold == 0) {
-          source_status_[i].threshold = -1;
-          if (remaining_sources_ > 0) {
-            remaining_sources_--;
-          }
-        }
+    if (pool_ && remaining_sources_ >= kMinParallelSearches) {
+      pool_->run(source_count_, graphreader, forward);
+      for (uint32_t i = 0; i < source_count_; i++) {
+        FinishForwardSearch(i);
+      }
+    } else {
+      for (uint32_t i = 0; i < source_count_; i++) {
+        forward(i, graphreader);
+        FinishForwardSearch(i);
       }
     }
 
@@ -225,9 +373,7 @@ void CostMatrix::ForwardSearch(const uint32_t index, const uint32_t n, GraphRead
   if (pred_idx == kInvalidLabel) {
     // Forward search is exhausted - mark this and update so we don't
     // extend searches more than we need to
-    for (uint32_t target = 0; target < target_count_; target++) {
-      UpdateStatus(index, target);
-    }
+    source_exhausted_[index] = true;
     source_status_[index].threshold = 0;
     return;
   }
@@ -423,7 +569,8 @@ void CostMatrix::CheckForwardConnections(const uint32_t source,
 
         // Update status and update threshold if this is the last location
         // to find for this source or target
-        UpdateStatus(source, target);
+        source_connections_[source].emplace_back(target, source_edgelabel_[source].size() +
+                                                             target_edgelabel_[target].size());
       } else {
         float oppcost = (predidx == kInvalidLabel) ? 0 : edgelabels[predidx].cost().cost;
         float c = pred.cost().cost + oppcost + opp_el.transition_cost().cost;
@@ -445,7 +592,8 @@ void CostMatrix::CheckForwardConnections(const uint32_t source,
 
           // Update status and update threshold if this is the last location
           // to find for this source or target
-          UpdateStatus(source, target);
+          source_connections_[source].emplace_back(target, source_edgelabel_[source].size() +
+                                                               target_edgelabel_[target].size());
         }
       }
     }
@@ -453,7 +601,9 @@ void CostMatrix::CheckForwardConnections(const uint32_t source,
 }
 
 // Update status when a connection is found.
-void CostMatrix::UpdateStatus(const uint32_t source, const uint32_t target) {
+void CostMatrix::UpdateStatus(const uint32_t source,
+                              const uint32_t target,
+                              const uint32_t label_count) {
   // Remove the target from the source status
   auto& s = source_status_[source].remaining_locations;
   auto it = s.find(target);
@@ -462,8 +612,7 @@ void CostMatrix::UpdateStatus(const uint32_t source, const uint32_t target) {
     if (s.empty() && source_status_[source].threshold > 0) {
       // At least 1 connection has been found to each target for this source.
       // Set a threshold to continue search for a limited number of times.
-      source_status_[source].threshold =
-          GetThreshold(mode_, source_edgelabel_[source].size() + target_edgelabel_[target].size());
+      source_status_[source].threshold = GetThreshold(mode_, label_count);
     }
   }
 
@@ -475,8 +624,54 @@ void CostMatrix::UpdateStatus(const uint32_t source, const uint32_t target) {
     if (t.empty() && target_status_[target].threshold > 0) {
       // At least 1 connection has been found to each source for this target.
       // Set a threshold to continue search for a limited number of times.
-      target_status_[target].threshold =
-          GetThreshold(mode_, source_edgelabel_[source].size() + target_edgelabel_[target].size());
+      target_status_[target].threshold = GetThreshold(mode_, label_count);
+    }
+  }
+}
+
+// Apply the effects of an iteration of the reverse search of a target
+void CostMatrix::FinishBackwardSearch(const uint32_t index) {
+  // Let the forward searches know which edges this target has reached
+  for (const auto& edgeid : target_reached_[index]) {
+    (*targets_)[edgeid].push_back(index);
+  }
+  target_reached_[index].clear();
+
+  if (target_exhausted_[index]) {
+    target_exhausted_[index] = false;
+    for (uint32_t source = 0; source < source_count_; source++) {
+      UpdateStatus(source, index,
+                   source_edgelabel_[source].size() + target_edgelabel_[index].size());
+    }
+  }
+
+  if (target_status_[index].threshold == 0) {
+    target_status_[index].threshold = -1;
+    if (remaining_targets_ > 0) {
+      remaining_targets_--;
+    }
+  }
+}
+
+// Apply the effects of an iteration of the forward search of a source
+void CostMatrix::FinishForwardSearch(const uint32_t index) {
+  for (const auto& connection : source_connections_[index]) {
+    UpdateStatus(index, connection.first, connection.second);
+  }
+  source_connections_[index].clear();
+
+  if (source_exhausted_[index]) {
+    source_exhausted_[index] = false;
+    for (uint32_t target = 0; target < target_count_; target++) {
+      UpdateStatus(index, target,
+                   source_edgelabel_[index].size() + target_edgelabel_[target].size());
+    }
+  }
+
+  if (source_status_[index].threshold == 0) {
+    source_status_[index].threshold = -1;
+    if (remaining_sources_ > 0) {
+      remaining_sources_--;
     }
   }
 }
@@ -490,9 +685,7 @@ void CostMatrix::BackwardSearch(const uint32_t index, GraphReader& graphreader)
   if (pred_idx == kInvalidLabel) {
     // Backward search is exhausted - mark this and update so we don't
     // extend searches more than we need to
-    for (uint32_t source = 0; source < source_count_; source++) {
-      UpdateStatus(source, index);
-    }
+    target_exhausted_[index] = true;
     target_status_[index].threshold = 0;
     return;
   }
@@ -601,7 +794,7 @@ void CostMatrix::BackwardSearch(const uint32_t index, GraphReader& graphreader)
       adj->add(idx);
 
       // Add to the list of targets that have reached this edge
-      (*targets_)[edgeid].push_back(index);
+      target_reached_[index].push_back(edgeid);
     }
 
     // Handle transitions - expand from the end node of the transition
@@ -655,6 +848,8 @@ void CostMatrix::SetSources(GraphReader& graphreader,
   source_edgestatus_.resize(source_count_);
   source_adjacency_.resize(source_count_);
   source_hierarchy_limits_.resize(source_count_);
+  source_connections_.resize(source_count_);
+  source_exhausted_.resize(source_count_, false);
 
   // Go through each source location
   uint32_t index = 0;
@@ -728,6 +923,8 @@ void CostMatrix::SetTargets(baldr::GraphReader& graphreader,
   target_edgestatus_.resize(targets.size());
   target_adjacency_.resize(targets.size());
   target_hierarchy_limits_.resize(targets.size());
+  target_reached_.resize(targets.size());
+  target_exhausted_.resize(targets.size(), false);
 
   // Go through each target location
   uint32_t index = 0;
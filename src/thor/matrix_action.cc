@@ -1,6 +1,7 @@
 #include "sif/autocost.h"
 #include "sif/bicyclecost.h"
 #include "sif/pedestriancost.h"
+#include "thor/chmatrix.h"
 #include "thor/costmatrix.h"
 #include "thor/timedistancebssmatrix.h"
 #include "thor/timedistancematrix.h"
@@ -17,8 +18,25 @@ using namespace valhalla::thor;
 namespace {
 
 constexpr double kMilePerMeter = 0.000621371;
+
+// Whether every source is within the limit of every target as the crow flies
+bool within_distance(const google::protobuf::RepeatedPtrField<valhalla::Location>& sources,
+                     const google::protobuf::RepeatedPtrField<valhalla::Location>& targets,
+                     const float max_matrix_distance) {
+  for (const auto& source : sources) {
+    PointLL source_ll(source.ll().lng(), source.ll().lat());
+    for (const auto& target : targets) {
+      PointLL target_ll(target.ll().lng(), target.ll().lat());
+      if (source_ll.Distance(target_ll) > max_matrix_distance) {
+        return false;
+      }
+    }
+  }
+  return true;
 }
 
+} // namespace
+
 namespace valhalla {
 namespace thor {
 
@@ -42,14 +60,13 @@ std::string thor_worker_t::matrix(Api& request) {
   // do the real work
   std::vector<TimeDistance> time_distances;
   auto costmatrix = [&]() {
-    thor::CostMatrix matrix;
-    return matrix.SourceToTarget(options.sources(), options.targets(), *reader, mode_costing, mode,
-                                 max_matrix_distance.find(costing)->second);
+    return cost_matrix.SourceToTarget(options.sources(), options.targets(), *reader, mode_costing,
+                                      mode, max_matrix_distance.find(costing)->second);
   };
   auto timedistancematrix = [&]() {
-    thor::TimeDistanceMatrix matrix;
-    return matrix.SourceToTarget(options.sources(), options.targets(), *reader, mode_costing, mode,
-                                 max_matrix_distance.find(costing)->second);
+    return time_distance_matrix.SourceToTarget(options.sources(), options.targets(), *reader,
+                                               mode_costing, mode,
+                                               max_matrix_distance.find(costing)->second);
   };
   if (costing == "bikeshare") {
     thor::TimeDistanceBSSMatrix matrix;
@@ -58,6 +75,22 @@ std::string thor_worker_t::matrix(Api& request) {
                               max_matrix_distance.find(costing)->second);
     return tyr::serializeMatrix(request, time_distances, distance_scale);
   }
+  // The contraction hierarchy overlays ignore turn costs and restrictions so they are only used if
+  // the request asks for them, and only hold for the default options of their costing
+  auto ch_matrix = ch_matrices.find(costing);
+  if (options.ch_overlay() && source_to_target_algorithm == SELECT_OPTIMAL &&
+      ch_matrix != ch_matrices.end() &&
+      options.costing_options(options.costing()).SerializeAsString() == ch_matrix->second.second &&
+      within_distance(options.sources(), options.targets(),
+                      max_matrix_distance.find(costing)->second) &&
+      ch_matrix->second.first.Covers(options.sources(), *reader) &&
+      ch_matrix->second.first.Covers(options.targets(), *reader)) {
+    time_distances = ch_matrix->second.first.SourceToTarget(options.sources(), options.targets(),
+                                                            *reader, mode_costing, mode,
+                                                            max_matrix_distance.find(costing)
+                                                                ->second);
+    return tyr::serializeMatrix(request, time_distances, distance_scale);
+  }
   switch (source_to_target_algorithm) {
     case SELECT_OPTIMAL:
       // TODO - Do further performance testing to pick the best algorithm for the job
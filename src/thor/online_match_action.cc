@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "meili/map_matcher.h"
+#include "meili/map_matcher_factory.h"
+#include "meili/match_result.h"
+#include "thor/worker.h"
+#include "tyr/serializers.h"
+
+using namespace valhalla;
+using namespace valhalla::baldr;
+using namespace valhalla::thor;
+
+namespace {
+
+// A trace that is matched a few points at a time. Its graph reader shares the tile cache of the
+// process and its matcher shares the candidate grids of the other sessions, so that any worker of
+// the process can continue it without the session holding tiles of its own
+struct online_session_t {
+  online_session_t(const boost::property_tree::ptree& config,
+                   const meili::MapMatcherFactory& shared,
+                   const Options& options)
+      : factory(config), matched_points(0), edges(0), memory(0) {
+    factory.ShareCaches(shared);
+    matcher.reset(factory.Create(options));
+  }
+
+  std::mutex mutex;
+  meili::MapMatcherFactory factory;
+  std::unique_ptr<meili::MapMatcher> matcher;
+  // How many matched points and edges were given back so far
+  size_t matched_points;
+  size_t edges;
+  // What became final in a request that failed afterwards, it is given back with the next one
+  std::vector<meili::MatchResult> results;
+  std::vector<meili::EdgeSegment> segments;
+  // Only touched while holding the lock of the sessions
+  std::chrono::steady_clock::time_point last_used;
+  size_t memory;
+};
+
+std::string random_hex(const size_t length) {
+  static std::mt19937_64 generator{std::random_device{}()};
+  static const char hex[] = "0123456789abcdef";
+  std::string id;
+  while (id.size() < length) {
+    auto bits = generator();
+    for (int j = 0; j < 16 && id.size() < length; ++j, bits >>= 4) {
+      id.push_back(hex[bits & 0xf]);
+    }
+  }
+  return id;
+}
+
+/*
+ * The sessions of all the workers of the process. A thread drops the sessions nobody asked about
+ * for too long, whether or not more requests come. Session ids start with an id of the process so
+ * that a request for a session of another process is told apart from one for an expired session
+ */
+class online_sessions_t {
+public:
+  online_sessions_t(const boost::property_tree::ptree& config, const std::chrono::seconds timeout)
+      : process(random_hex(8)), shared(config), memory(0), timeout_(timeout), done_(false),
+        reaper_(&online_sessions_t::reap, this) {
+  }
+
+  ~online_sessions_t() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      done_ = true;
+    }
+    wake_.notify_one();
+    reaper_.join();
+  }
+
+  // Forget a session, the caller holds the lock
+  std::shared_ptr<online_session_t>
+  erase(std::unordered_map<std::string, std::shared_ptr<online_session_t>>::iterator it) {
+    auto session = std::move(it->second);
+    memory -= session->memory;
+    sessions.erase(it);
+    return session;
+  }
+
+  const std::string process;
+  // Lends its candidate grids to the sessions, the matchers of the sessions keep them in bounds
+  meili::MapMatcherFactory shared;
+  std::mutex mutex;
+  std::unordered_map<std::string, std::shared_ptr<online_session_t>> sessions;
+  // What the windows of the sessions took after their last request
+  size_t memory;
+
+protected:
+  void reap() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!done_) {
+      wake_.wait_for(lock, std::min<std::chrono::steady_clock::duration>(timeout_,
+                                                                         std::chrono::seconds(1)));
+      // the sessions are destroyed after letting go of the lock
+      std::vector<std::shared_ptr<online_session_t>> expired;
+      const auto now = std::chrono::steady_clock::now();
+      for (auto it = sessions.begin(); it != sessions.end();) {
+        if (now - it->second->last_used > timeout_) {
+          expired.push_back(erase(it++));
+        } else {
+          ++it;
+        }
+      }
+      lock.unlock();
+      expired.clear();
+      lock.lock();
+    }
+  }
+
+  const std::chrono::steady_clock::duration timeout_;
+  bool done_;
+  std::condition_variable wake_;
+  std::thread reaper_;
+};
+
+// The first worker to get a request makes the sessions with its config, all of them share a config
+online_sessions_t& online_sessions(const boost::property_tree::ptree& config,
+                                   const std::chrono::seconds timeout) {
+  static online_sessions_t sessions(config, timeout);
+  return sessions;
+}
+
+// Append the results of a commit to the results of the request
+void append(meili::MatchResults&& committed,
+            std::vector<meili::MatchResult>& results,
+            std::vector<meili::EdgeSegment>& segments) {
+  const int offset = results.size();
+  for (auto& segment : committed.segments) {
+    if (segment.first_match_idx >= 0) {
+      segment.first_match_idx += offset;
+    }
+    if (segment.last_match_idx >= 0) {
+      segment.last_match_idx += offset;
+    }
+    segments.push_back(segment);
+  }
+  results.insert(results.end(), committed.results.begin(), committed.results.end());
+}
+
+} // namespace
+
+namespace valhalla {
+namespace thor {
+
+/*
+ * The online_match action matches a trace that is still being recorded. Each request continues
+ * the session named by its session_id, or starts one, with the points of its shape and gives back
+ * the matches that became final with them. Asking to finish gives back the rest and ends the
+ * session. When a request fails partway the points before the one it failed at stay in the
+ * session, and the matches they made final are given back with the next request. Sessions keep
+ * the options they were started with and are dropped once they are idle for
+ * thor.online_session_timeout seconds. The sessions live in the process that started them, so
+ * when several processes serve requests those of a session have to be routed to the same one, for
+ * example by its session_id.
+ */
+std::string thor_worker_t::online_match(Api& request) {
+  // time this whole method and save that statistic
+  auto _ = measure_scope_time(request, "thor_worker_t::online_match");
+  auto& options = *request.mutable_options();
+
+  // Start a new session, the graph reader is made outside of the lock because it may take a while
+  auto& registry = online_sessions(online_config, online_session_timeout);
+  std::shared_ptr<online_session_t> session;
+  if (!options.has_session_id()) {
+    try {
+      session = std::make_shared<online_session_t>(online_config, registry.shared, options);
+    } catch (const std::invalid_argument& ex) { throw std::runtime_error(std::string(ex.what())); }
+  }
+
+  // Register this session or find it
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (session) {
+      if (registry.sessions.size() >= max_online_sessions) {
+        throw valhalla_exception_t{447, " (" + std::to_string(max_online_sessions) + ")"};
+      }
+      if (registry.memory >= max_online_session_memory) {
+        throw valhalla_exception_t{447, " (" + std::to_string(registry.memory >> 20) + " MB)"};
+      }
+      auto id = registry.process + random_hex(24);
+      while (registry.sessions.find(id) != registry.sessions.end()) {
+        id = registry.process + random_hex(24);
+      }
+      options.set_session_id(id);
+      registry.sessions.emplace(id, session);
+    } else {
+      const auto found = registry.sessions.find(options.session_id());
+      if (found == registry.sessions.end()) {
+        // requests for a session have to be routed to the process that started it
+        if (options.session_id().compare(0, registry.process.size(), registry.process) != 0) {
+          throw valhalla_exception_t{446, std::string(" (started by another process)")};
+        }
+        throw valhalla_exception_t{446};
+      }
+      session = found->second;
+    }
+    session->last_used = std::chrono::steady_clock::now();
+  }
+
+  // A session only takes one request at a time
+  std::lock_guard<std::mutex> lock(session->mutex);
+  auto& matcher = *session->matcher;
+  matcher.set_interrupt(interrupt);
+  const auto& config = matcher.config();
+  std::vector<meili::MatchResult> results;
+  std::vector<meili::EdgeSegment> segments;
+  results.swap(session->results);
+  segments.swap(session->segments);
+  try {
+    for (const auto& pt : options.shape()) {
+      meili::Measurement measurement{{pt.ll().lng(), pt.ll().lat()},
+                                     pt.has_accuracy() ? pt.accuracy()
+                                                       : config.emission_cost.gps_accuracy_meters,
+                                     pt.has_radius() ? pt.radius()
+                                                     : config.candidate_search.search_radius_meters,
+                                     pt.time(),
+                                     PathLocation::fromPBF(pt.type())};
+      append(matcher.OnlineMatch(measurement), results, segments);
+    }
+    if (options.finish()) {
+      append(matcher.FinishOnlineMatch(), results, segments);
+    }
+  } catch (...) {
+    // the points before the one that failed are in the window, so is what they made final
+    matcher.set_interrupt(nullptr);
+    session->results = std::move(results);
+    session->segments = std::move(segments);
+    throw;
+  }
+  matcher.set_interrupt(nullptr);
+
+  // Keep the shared caches in bounds and account for what the window of the session holds on to
+  session->factory.ClearFullCache();
+  {
+    std::lock_guard<std::mutex> sessions_lock(registry.mutex);
+    const auto found = registry.sessions.find(options.session_id());
+    if (found != registry.sessions.end() && found->second == session) {
+      if (options.finish()) {
+        registry.erase(found);
+      } else {
+        registry.memory -= session->memory;
+        session->memory = matcher.state_container().memory();
+        registry.memory += session->memory;
+      }
+    }
+  }
+
+  // Point the matches at the edges they are on, counting from the start of the session
+  size_t segment = 0;
+  for (auto& result : results) {
+    if (!result.edgeid.Is_Valid()) {
+      continue;
+    }
+    auto s = segment;
+    while (s < segments.size() && segments[s].edgeid != result.edgeid) {
+      ++s;
+    }
+    if (s < segments.size()) {
+      segment = s;
+      result.edge_index = session->edges + s;
+    }
+  }
+
+  auto json = tyr::serializeOnlineMatch(request, results, segments, session->matched_points,
+                                        session->edges);
+  session->matched_points += results.size();
+  session->edges += segments.size();
+  return json;
+}
+
+} // namespace thor
+} // namespace valhalla
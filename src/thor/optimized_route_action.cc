@@ -27,10 +27,9 @@ void thor_worker_t::optimized_route(Api& request) {
   auto& options = *request.mutable_options();
 
   // Use CostMatrix to find costs from each location to every other location
-  CostMatrix costmatrix;
   std::vector<thor::TimeDistance> td =
-      costmatrix.SourceToTarget(options.sources(), options.targets(), *reader, mode_costing, mode,
-                                max_matrix_distance.find(costing)->second);
+      cost_matrix.SourceToTarget(options.sources(), options.targets(), *reader, mode_costing, mode,
+                                 max_matrix_distance.find(costing)->second);
 
   // Return an error if any locations are totally unreachable
   const auto& correlated =
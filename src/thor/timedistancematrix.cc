@@ -22,13 +22,28 @@ static bool IsTrivial(const uint64_t& edgeid,
   }
   return false;
 }
+
+// Gets the cost of an edge from the cache of the batch if there is one, the
+// cost is only evaluated the first time one of the searches needs it.
+template <typename cost_function_t>
+inline Cost GetEdgeCost(Cost* cached, const cost_function_t& edge_cost) {
+  if (cached == nullptr) {
+    return edge_cost();
+  }
+  if (cached->cost < 0.0f) {
+    *cached = edge_cost();
+  }
+  return *cached;
+}
 } // namespace
 namespace valhalla {
 namespace thor {
 
 // Constructor with cost threshold.
-TimeDistanceMatrix::TimeDistanceMatrix()
-    : mode_(TravelMode::kDrive), settled_count_(0), current_cost_threshold_(0) {
+TimeDistanceMatrix::TimeDistanceMatrix(const boost::property_tree::ptree& config)
+    : mode_(TravelMode::kDrive), settled_count_(0), current_cost_threshold_(0),
+      batch_size_(std::max(config.get<uint32_t>("thor.timedistancematrix_batch_size", 1), 1u)),
+      edge_costs_(nullptr) {
 }
 
 float TimeDistanceMatrix::GetCostThreshold(const float max_matrix_distance) const {
@@ -61,6 +76,9 @@ void TimeDistanceMatrix::Clear() {
 
   // Clear the edge status flags
   edgestatus_.clear();
+
+  // Clear the edge costs shared by the batches
+  edge_cost_cache_.clear();
 }
 
 // Expand from a node in the forward direction
@@ -83,6 +101,7 @@ void TimeDistanceMatrix::ExpandForward(GraphReader& graphreader,
   // Expand from end node.
   GraphId edgeid(node.tileid(), node.level(), nodeinfo->edge_index());
   EdgeStatusInfo* es = edgestatus_.GetPtr(edgeid, tile);
+  Cost* edge_costs = edge_costs_ ? edge_costs_->GetPtr(edgeid, tile) : nullptr;
   const DirectedEdge* directededge = tile->directededge(nodeinfo->edge_index());
   for (uint32_t i = 0; i < nodeinfo->edge_count(); i++, directededge++, ++edgeid, ++es) {
     // Skip shortcut edges
@@ -102,7 +121,9 @@ void TimeDistanceMatrix::ExpandForward(GraphReader& graphreader,
 
     // Get cost and update distance
     auto transition_cost = costing_->TransitionCost(directededge, nodeinfo, pred);
-    Cost newcost = pred.cost() + costing_->EdgeCost(directededge, tile) + transition_cost;
+    Cost edge_cost = GetEdgeCost(edge_costs ? edge_costs + i : nullptr,
+                                 [&]() { return costing_->EdgeCost(directededge, tile); });
+    Cost newcost = pred.cost() + edge_cost + transition_cost;
     uint32_t distance = pred.path_distance() + directededge->length();
 
     // Check if edge is temporarily labeled and this path has less cost. If
@@ -144,6 +165,23 @@ TimeDistanceMatrix::OneToMany(const valhalla::Location& origin,
                               const sif::mode_costing_t& mode_costing,
                               const TravelMode mode,
                               const float max_matrix_distance) {
+  InitializeSearch(origin, mode_costing, mode, max_matrix_distance);
+
+  // Initialize the origin and destination locations
+  SetOriginOneToMany(graphreader, origin);
+  SetDestinations(graphreader, locations);
+
+  // Find shortest path
+  while (!ExpandNext(origin, locations, graphreader, true)) {
+  }
+  return FormTimeDistanceMatrix();
+}
+
+// Set the mode, costing and cost threshold and reset the search state
+void TimeDistanceMatrix::InitializeSearch(const valhalla::Location& origin,
+                                          const sif::mode_costing_t& mode_costing,
+                                          const TravelMode mode,
+                                          const float max_matrix_distance) {
   // Set the mode and costing
   mode_ = mode;
   costing_ = mode_costing[static_cast<uint32_t>(mode_)];
@@ -156,54 +194,58 @@ TimeDistanceMatrix::OneToMany(const valhalla::Location& origin,
   uint32_t bucketsize = costing_->UnitSize();
   adjacencylist_.reuse(0.0f, current_cost_threshold_, bucketsize, &edgelabels_);
   edgestatus_.clear();
-
-  // Initialize the origin and destination locations
   settled_count_ = 0;
-  SetOriginOneToMany(graphreader, origin);
-  SetDestinations(graphreader, locations);
+}
 
-  // Find shortest path
-  graph_tile_ptr tile;
-  while (true) {
-    // Get next element from adjacency list. Check that it is valid. An
-    // invalid label indicates there are no edges that can be expanded.
-    uint32_t predindex = adjacencylist_.pop();
-    if (predindex == kInvalidLabel) {
-      // Can not expand any further...
-      return FormTimeDistanceMatrix();
-    }
-
-    // Remove label from adjacency list, mark it as permanently labeled.
-    // Copy the EdgeLabel for use in costing
-    EdgeLabel pred = edgelabels_[predindex];
-
-    // Mark the edge as permanently labeled. Do not do this for an origin
-    // edge. Otherwise loops/around the block cases will not work
-    if (!pred.origin()) {
-      edgestatus_.Update(pred.edgeid(), EdgeSet::kPermanent);
-    }
-
-    // Identify any destinations on this edge
-    auto destedge = dest_edges_.find(pred.edgeid());
-    if (destedge != dest_edges_.end()) {
-      // Update any destinations along this edge. Return if all destinations
-      // have been settled.
-      tile = graphreader.GetGraphTile(pred.edgeid());
-      const DirectedEdge* edge = tile->directededge(pred.edgeid());
-      if (UpdateDestinations(origin, locations, destedge->second, edge, tile, pred)) {
-        return FormTimeDistanceMatrix();
-      }
-    }
+// Settle the next edge of the search and expand from it. Returns true once
+// the search is done.
+bool TimeDistanceMatrix::ExpandNext(
+    const valhalla::Location& origin,
+    const google::protobuf::RepeatedPtrField<valhalla::Location>& locations,
+    GraphReader& graphreader,
+    const bool forward) {
+  // Get next element from adjacency list. Check that it is valid. An
+  // invalid label indicates there are no edges that can be expanded.
+  uint32_t predindex = adjacencylist_.pop();
+  if (predindex == kInvalidLabel) {
+    // Can not expand any further...
+    return true;
+  }
+
+  // Remove label from adjacency list, mark it as permanently labeled.
+  // Copy the EdgeLabel for use in costing
+  EdgeLabel pred = edgelabels_[predindex];
 
-    // Terminate when we are beyond the cost threshold
-    if (pred.cost().cost > current_cost_threshold_) {
-      return FormTimeDistanceMatrix();
+  // Mark the edge as permanently labeled. Do not do this for an origin
+  // edge. Otherwise loops/around the block cases will not work
+  if (!pred.origin()) {
+    edgestatus_.Update(pred.edgeid(), EdgeSet::kPermanent);
+  }
+
+  // Identify any destinations on this edge
+  auto destedge = dest_edges_.find(pred.edgeid());
+  if (destedge != dest_edges_.end()) {
+    // Update any destinations along this edge. Return if all destinations
+    // have been settled.
+    graph_tile_ptr tile = graphreader.GetGraphTile(pred.edgeid());
+    const DirectedEdge* edge = tile->directededge(pred.edgeid());
+    if (UpdateDestinations(origin, locations, destedge->second, edge, tile, pred)) {
+      return true;
     }
+  }
 
-    // Expand forward from the end node of the predecessor edge.
+  // Terminate when we are beyond the cost threshold
+  if (pred.cost().cost > current_cost_threshold_) {
+    return true;
+  }
+
+  // Expand from the end node of the predecessor edge.
+  if (forward) {
     ExpandForward(graphreader, pred.endnode(), pred, predindex, false);
+  } else {
+    ExpandReverse(graphreader, pred.endnode(), pred, predindex, false);
   }
-  return {}; // Should never get here
+  return false;
 }
 
 // Expand from the node along the reverse search path.
@@ -231,9 +273,11 @@ void TimeDistanceMatrix::ExpandReverse(GraphReader& graphreader,
     }
   }
 
-  // Expand from end node.
+  // Expand from end node. The costs are cached by the edge we expand along
+  // even though they are the costs of the opposing edges.
   GraphId edgeid(node.tileid(), node.level(), nodeinfo->edge_index());
   EdgeStatusInfo* es = edgestatus_.GetPtr(edgeid, tile);
+  Cost* edge_costs = edge_costs_ ? edge_costs_->GetPtr(edgeid, tile) : nullptr;
   const DirectedEdge* directededge = tile->directededge(nodeinfo->edge_index());
   for (uint32_t i = 0, n = nodeinfo->edge_count(); i < n; i++, directededge++, ++edgeid, ++es) {
     // Skip shortcut edges and edges permanently labeled (best
@@ -261,7 +305,9 @@ void TimeDistanceMatrix::ExpandReverse(GraphReader& graphreader,
     // Get cost. Use the opposing edge for EdgeCost.
     auto transition_cost = costing_->TransitionCostReverse(directededge->localedgeidx(), nodeinfo,
                                                            opp_edge, opp_pred_edge);
-    Cost newcost = pred.cost() + costing_->EdgeCost(opp_edge, t2) + transition_cost;
+    Cost edge_cost = GetEdgeCost(edge_costs ? edge_costs + i : nullptr,
+                                 [&]() { return costing_->EdgeCost(opp_edge, t2); });
+    Cost newcost = pred.cost() + edge_cost + transition_cost;
     uint32_t distance = pred.path_distance() + directededge->length();
 
     // Check if edge is temporarily labeled and this path has less cost. If
@@ -303,66 +349,16 @@ TimeDistanceMatrix::ManyToOne(const valhalla::Location& dest,
                               const sif::mode_costing_t& mode_costing,
                               const TravelMode mode,
                               const float max_matrix_distance) {
-  // Set the mode and costing
-  mode_ = mode;
-  costing_ = mode_costing[static_cast<uint32_t>(mode_)];
-  current_cost_threshold_ = GetCostThreshold(max_matrix_distance);
-
-  // Construct adjacency list, edge status, and done set. Set bucket size and
-  // cost range based on DynamicCost. Initialize A* heuristic with 0 cost
-  // factor (needed for setting the origin).
-  astarheuristic_.Init({dest.ll().lng(), dest.ll().lat()}, 0.0f);
-  uint32_t bucketsize = costing_->UnitSize();
-  adjacencylist_.reuse(0.0f, current_cost_threshold_, bucketsize, &edgelabels_);
-  edgestatus_.clear();
+  InitializeSearch(dest, mode_costing, mode, max_matrix_distance);
 
   // Initialize the origin and destination locations
-  settled_count_ = 0;
   SetOriginManyToOne(graphreader, dest);
   SetDestinationsManyToOne(graphreader, locations);
 
   // Find shortest path
-  graph_tile_ptr tile;
-  while (true) {
-    // Get next element from adjacency list. Check that it is valid. An
-    // invalid label indicates there are no edges that can be expanded.
-    uint32_t predindex = adjacencylist_.pop();
-    if (predindex == kInvalidLabel) {
-      // Can not expand any further...
-      return FormTimeDistanceMatrix();
-    }
-
-    // Remove label from adjacency list, mark it as permanently labeled.
-    // Copy the EdgeLabel for use in costing
-    EdgeLabel pred = edgelabels_[predindex];
-
-    // Mark the edge as permanently labeled. Do not do this for an origin
-    // edge (this will allow loops/around the block cases)
-    if (!pred.origin()) {
-      edgestatus_.Update(pred.edgeid(), EdgeSet::kPermanent);
-    }
-
-    // Identify any destinations on this edge
-    auto destedge = dest_edges_.find(pred.edgeid());
-    if (destedge != dest_edges_.end()) {
-      // Update any destinations along this edge. Return if all destinations
-      // have been settled.
-      tile = graphreader.GetGraphTile(pred.edgeid());
-      const DirectedEdge* edge = tile->directededge(pred.edgeid());
-      if (UpdateDestinations(dest, locations, destedge->second, edge, tile, pred)) {
-        return FormTimeDistanceMatrix();
-      }
-    }
-
-    // Terminate when we are beyond the cost threshold
-    if (pred.cost().cost > current_cost_threshold_) {
-      return FormTimeDistanceMatrix();
-    }
-
-    // Expand forward from the end node of the predecessor edge.
-    ExpandReverse(graphreader, pred.endnode(), pred, predindex, false);
+  while (!ExpandNext(dest, locations, graphreader, false)) {
   }
-  return {}; // Should never get here
+  return FormTimeDistanceMatrix();
 }
 
 // Many to one time and distance cost matrix. Computes time and distance
@@ -383,9 +379,17 @@ std::vector<TimeDistance> TimeDistanceMatrix::SourceToTarget(
     const sif::mode_costing_t& mode_costing,
     const sif::TravelMode mode,
     const float max_matrix_distance) {
+  // Run batches of one to many (or many to one) searches
+  const bool forward = source_location_list.size() <= target_location_list.size();
+  const auto& origins = forward ? source_location_list : target_location_list;
+  if (batch_size_ > 1 && origins.size() > 1) {
+    return SourceToTargetBatched(origins, forward ? target_location_list : source_location_list,
+                                 graphreader, mode_costing, mode, max_matrix_distance, forward);
+  }
+
   // Run a series of one to many calls and concatenate the results.
   std::vector<TimeDistance> many_to_many;
-  if (source_location_list.size() <= target_location_list.size()) {
+  if (forward) {
     for (const auto& origin : source_location_list) {
       std::vector<TimeDistance> td = OneToMany(origin, target_location_list, graphreader,
                                                mode_costing, mode, max_matrix_distance);
@@ -403,6 +407,73 @@ std::vector<TimeDistance> TimeDistanceMatrix::SourceToTarget(
   return many_to_many;
 }
 
+// Run the searches from the origins in batches that advance in lockstep
+std::vector<TimeDistance> TimeDistanceMatrix::SourceToTargetBatched(
+    const google::protobuf::RepeatedPtrField<valhalla::Location>& origins,
+    const google::protobuf::RepeatedPtrField<valhalla::Location>& locations,
+    baldr::GraphReader& graphreader,
+    const sif::mode_costing_t& mode_costing,
+    const sif::TravelMode mode,
+    const float max_matrix_distance,
+    const bool forward) {
+  // The destinations are the same for every search so set them up once
+  Clear();
+  mode_ = mode;
+  costing_ = mode_costing[static_cast<uint32_t>(mode_)];
+  if (forward) {
+    SetDestinations(graphreader, locations);
+  } else {
+    SetDestinationsManyToOne(graphreader, locations);
+  }
+
+  std::vector<std::vector<TimeDistance>> results(origins.size());
+  std::vector<bool> done;
+  for (int first = 0; first < origins.size(); first += batch_size_) {
+    // Start a search from each origin of the batch
+    const uint32_t count = std::min<uint32_t>(batch_size_, origins.size() - first);
+    while (batch_.size() < count) {
+      batch_.emplace_back(new TimeDistanceMatrix());
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+      auto& search = *batch_[i];
+      const auto& origin = origins.Get(first + i);
+      search.edge_costs_ = &edge_cost_cache_;
+      search.destinations_ = destinations_;
+      search.dest_edges_ = dest_edges_;
+      search.InitializeSearch(origin, mode_costing, mode, max_matrix_distance);
+      if (forward) {
+        search.SetOriginOneToMany(graphreader, origin);
+      } else {
+        search.SetOriginManyToOne(graphreader, origin);
+      }
+    }
+
+    // Settle an edge of each search in turn until they are all done, so
+    // they share the edge costs and tiles while those are fresh
+    done.assign(count, false);
+    for (uint32_t remaining = count; remaining > 0;) {
+      for (uint32_t i = 0; i < count; ++i) {
+        if (done[i] || !batch_[i]->ExpandNext(origins.Get(first + i), locations, graphreader,
+                                              forward)) {
+          continue;
+        }
+        results[first + i] = batch_[i]->FormTimeDistanceMatrix();
+        batch_[i]->Clear();
+        done[i] = true;
+        --remaining;
+      }
+    }
+  }
+
+  // Concatenate the results in the order of the origins
+  std::vector<TimeDistance> many_to_many;
+  for (const auto& td : results) {
+    many_to_many.insert(many_to_many.end(), td.begin(), td.end());
+  }
+  Clear();
+  return many_to_many;
+}
+
 // Add edges at the origin to the adjacency list
 void TimeDistanceMatrix::SetOriginOneToMany(GraphReader& graphreader,
                                             const valhalla::Location& origin) {
@@ -1,6 +1,10 @@
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <exception>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -8,6 +12,7 @@
 #include "baldr/graphconstants.h"
 #include "baldr/json.h"
 #include "meili/match_result.h"
+#include "meili/transition_cache.h"
 #include "midgard/constants.h"
 #include "midgard/logging.h"
 #include "midgard/util.h"
@@ -112,5 +117,164 @@ std::string thor_worker_t::trace_attributes(Api& request) {
   return tyr::serializeTraceAttributes(request, controller, map_match_results);
 }
 
+thor_worker_t::batch_pool_t::batch_pool_t(const boost::property_tree::ptree& config,
+                                          const uint32_t thread_count)
+    : task_(nullptr), count_(0), next_(0), generation_(0), busy_(0), done_(false) {
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    workers_.emplace_back(new thor_worker_t(config));
+  }
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back(&batch_pool_t::work, this, i);
+  }
+}
+
+thor_worker_t::batch_pool_t::~batch_pool_t() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+  }
+  start_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void thor_worker_t::batch_pool_t::run(const int count, thor_worker_t& worker, const task_t& task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    count_ = count;
+    next_ = 0;
+    busy_ = threads_.size();
+    error_ = nullptr;
+    ++generation_;
+  }
+  start_.notify_all();
+  drain(worker);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_.wait(lock, [this]() { return busy_ == 0; });
+  task_ = nullptr;
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+void thor_worker_t::batch_pool_t::drain(thor_worker_t& worker) {
+  try {
+    for (int i = next_++; i < count_; i = next_++) {
+      (*task_)(i, worker);
+    }
+  } catch (...) {
+    // stop handing out work and keep the first error for the caller
+    next_ = count_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) {
+      error_ = std::current_exception();
+    }
+  }
+}
+
+void thor_worker_t::batch_pool_t::work(const size_t index) {
+  uint64_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [this, generation]() { return done_ || generation_ != generation; });
+      if (done_) {
+        return;
+      }
+      generation = generation_;
+    }
+    drain(*workers_[index]);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--busy_ == 0) {
+      finished_.notify_one();
+    }
+  }
+}
+
+/*
+ * The trace_attributes_batch action matches many traces with the same options at once. The traces
+ * are spread over the request thread and the thor.trace_batch_threads threads of the worker's pool,
+ * which are started with the first batch and kept for the next ones. Their matchers share the
+ * candidate grids and the routes between candidates, so roads that several traces cover are only
+ * indexed and routed once. A trace that fails gets its error in place of its attributes.
+ */
+std::string thor_worker_t::trace_attributes_batch(Api& request) {
+  // time this whole method and save that statistic
+  auto _ = measure_scope_time(request, "thor_worker_t::trace_attributes_batch");
+
+  // Each trace is matched as a trace_attributes request with the options of the batch
+  Options trace_options(request.options());
+  trace_options.clear_traces();
+  trace_options.clear_jsonp();
+  trace_options.set_action(Options::trace_attributes);
+  trace_options.set_format(Options::json);
+  const auto& traces = request.options().traces();
+
+  if (!batch_pool) {
+    batch_pool.reset(new batch_pool_t(batch_config, batch_threads));
+  }
+  matcher_factory.set_transition_cache(
+      std::make_shared<meili::TransitionCache>(transition_cache_size));
+  for (auto& worker : batch_pool->workers()) {
+    worker->matcher_factory.ShareCaches(matcher_factory);
+  }
+
+  std::vector<std::string> results(traces.size());
+  const batch_pool_t::task_t match = [&](const int i, thor_worker_t& worker) {
+    // only the request thread has an interrupt
+    if (worker.interrupt) {
+      (*worker.interrupt)();
+    }
+    Api trace_request;
+    auto& options = *trace_request.mutable_options();
+    options.CopyFrom(trace_options);
+    options.mutable_shape()->CopyFrom(traces.Get(i).shape());
+    options.mutable_locations()->CopyFrom(traces.Get(i).locations());
+    try {
+      if (traces.Get(i).has_error_code()) {
+        throw valhalla_exception_t{traces.Get(i).error_code(),
+                                   traces.Get(i).has_error_detail()
+                                       ? boost::make_optional(traces.Get(i).error_detail())
+                                       : boost::none};
+      }
+      results[i] = worker.trace_attributes(trace_request);
+    } catch (const valhalla_exception_t& e) { results[i] = jsonify_error(e, trace_request); }
+    worker.trace.clear();
+  };
+  std::exception_ptr error;
+  try {
+    batch_pool->run(traces.size(), *this, match);
+  } catch (...) { error = std::current_exception(); }
+
+  // The routes are only good for the options of this batch
+  matcher_factory.set_transition_cache(nullptr);
+  matcher.reset();
+  for (auto& worker : batch_pool->workers()) {
+    worker->matcher_factory.set_transition_cache(nullptr);
+    worker->cleanup();
+    worker->matcher.reset();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  size_t size = 0;
+  for (const auto& result : results) {
+    size += result.size() + 1;
+  }
+  std::string json;
+  json.reserve(size + sizeof("{\"trace_attributes\":[]}"));
+  json += "{\"trace_attributes\":[";
+  for (size_t i = 0; i < results.size(); ++i) {
+    json += i ? "," : "";
+    json += results[i];
+  }
+  json += "]}";
+  return json;
+}
+
 } // namespace thor
 } // namespace valhalla
@@ -1,14 +1,18 @@
 #include <cstdint>
 #include <functional>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "baldr/rapidjson_utils.h"
+#include "filesystem.h"
 #include "midgard/constants.h"
 #include "midgard/logging.h"
 #include "midgard/util.h"
+#include "proto_conversions.h"
 #include "thor/isochrone.h"
 #include "thor/worker.h"
 #include "tyr/actor.h"
@@ -35,6 +39,12 @@ constexpr float kDefaultMaxTimeDependentDistance = 500000.0f; // 500 km
 // It's used to prevent memory from infinite growth.
 constexpr uint32_t kMaxReservedLabelsCount = 1000000;
 
+// How long an online map matching session may be idle before it is dropped, how many there can be
+// at once and how much memory their windows may take before no more are started
+constexpr uint32_t kDefaultOnlineSessionTimeout = 300; // 5 minutes
+constexpr size_t kDefaultMaxOnlineSessions = 1000;
+constexpr size_t kDefaultMaxOnlineSessionMemory = 1024; // MB
+
 // Maximum edge score - base this on costing type.
 // Large values can cause very bad performance. Setting this back
 // to 2 hours for bike and pedestrian and 12 hours for driving routes.
@@ -62,6 +72,18 @@ std::string serialize_to_pbf(Api& request) {
   return buf;
 };
 
+// Loads a contraction hierarchy overlay, sharing it with the other workers of the process
+std::shared_ptr<const CHOverlay> load_ch_overlay(const std::string& file_name) {
+  static std::mutex overlays_mutex;
+  static std::unordered_map<std::string, std::shared_ptr<const CHOverlay>> overlays;
+  std::lock_guard<std::mutex> lock(overlays_mutex);
+  auto& overlay = overlays[file_name];
+  if (!overlay) {
+    overlay = CHOverlay::Load(file_name);
+  }
+  return overlay;
+}
+
 } // namespace
 
 namespace valhalla {
@@ -78,6 +100,7 @@ thor_worker_t::thor_worker_t(const boost::property_tree::ptree& config,
           config.get<uint32_t>("thor.max_reserved_labels_count", kMaxReservedLabelsCount)),
       timedep_reverse(
           config.get<uint32_t>("thor.max_reserved_labels_count", kMaxReservedLabelsCount)),
+      cost_matrix(config), time_distance_matrix(config),
       isochrone_gen(config.get<uint32_t>("thor.max_reserved_labels_count", kMaxReservedLabelsCount)),
       matcher_factory(config, graph_reader), reader(graph_reader), controller{} {
   // If we weren't provided with a graph reader make our own
@@ -109,6 +132,66 @@ thor_worker_t::thor_worker_t(const boost::property_tree::ptree& config,
 
   max_timedep_distance =
       config.get<float>("service_limits.max_timedep_distance", kDefaultMaxTimeDependentDistance);
+
+  // The workers of the additional threads a batch of traces is matched with don't have threads of
+  // their own and leave the matrices to the request thread
+  batch_threads = config.get<uint32_t>("thor.trace_batch_threads", 0);
+  transition_cache_size =
+      config.get<size_t>("meili.transition_cache_size", meili::kDefaultTransitionCacheSize);
+  if (batch_threads > 0) {
+    batch_config = config;
+    batch_config.put("thor.trace_batch_threads", 0);
+    batch_config.put("thor.costmatrix_threads", 0);
+    if (auto mjolnir = batch_config.get_child_optional("mjolnir")) {
+      mjolnir->erase("ch_overlay_dir");
+    }
+  }
+
+  // Online map matching sessions make their own graph readers from the config, all of them over the
+  // one tile cache of the process
+  online_config = config;
+  if (!online_config.get<bool>("mjolnir.use_concurrent_mem_cache", false)) {
+    online_config.put("mjolnir.global_synchronized_cache", true);
+  }
+  online_session_timeout = std::chrono::seconds(
+      config.get<uint32_t>("thor.online_session_timeout", kDefaultOnlineSessionTimeout));
+  max_online_sessions = config.get<size_t>("thor.max_online_sessions", kDefaultMaxOnlineSessions);
+  max_online_session_memory =
+      config.get<size_t>("thor.max_online_session_memory", kDefaultMaxOnlineSessionMemory) << 20;
+
+  // Load the contraction hierarchy overlays the matrix can use for the default costing options
+  auto ch_overlay_dir = config.get<std::string>("mjolnir.ch_overlay_dir", "");
+  if (!ch_overlay_dir.empty()) {
+    std::vector<std::string> costings{"auto", "truck"};
+    if (auto configured = config.get_child_optional("mjolnir.ch_overlay_costings")) {
+      costings.clear();
+      for (const auto& costing : *configured) {
+        costings.push_back(costing.second.get_value<std::string>());
+      }
+    }
+    for (const auto& costing_str : costings) {
+      Costing costing;
+      auto file_name = CHOverlay::FileName(ch_overlay_dir, costing_str);
+      if (!Costing_Enum_Parse(costing_str, &costing) || !filesystem::exists(file_name)) {
+        continue;
+      }
+      // An overlay built from another tileset would route over the wrong graph
+      auto overlay = load_ch_overlay(file_name);
+      auto tile = overlay->tiles().empty()
+                      ? nullptr
+                      : reader->GetGraphTile(GraphId(overlay->tiles().front().tile_id));
+      if (!tile || tile->header()->dataset_id() != overlay->dataset_id()) {
+        LOG_WARN("Ignoring contraction hierarchy overlay " + file_name +
+                 " which was not built from the tiles in use");
+        continue;
+      }
+      const rapidjson::Document doc;
+      CostingOptions default_options;
+      sif::ParseCostingOptions(doc, "/costing_options/" + costing_str, &default_options, costing);
+      ch_matrices.emplace(costing_str,
+                          std::make_pair(CHMatrix(overlay), default_options.SerializeAsString()));
+    }
+  }
 }
 
 thor_worker_t::~thor_worker_t() {
@@ -164,6 +247,12 @@ thor_worker_t::work(const std::list<zmq::message_t>& job,
       case Options::trace_attributes:
         result = to_response(trace_attributes(request), info, request);
         break;
+      case Options::trace_attributes_batch:
+        result = to_response(trace_attributes_batch(request), info, request);
+        break;
+      case Options::online_match:
+        result = to_response(online_match(request), info, request);
+        break;
       case Options::expansion: {
         result = to_response(expansion(request), info, request);
         break;
@@ -334,6 +423,8 @@ void thor_worker_t::cleanup() {
   timedep_reverse.Clear();
   multi_modal_astar.Clear();
   bss_astar.Clear();
+  cost_matrix.Clear();
+  time_distance_matrix.Clear();
   trace.clear();
   isochrone_gen.Clear();
   centroid_gen.Clear();
@@ -53,23 +53,11 @@ void actor_t::cleanup() {
 
 std::string
 actor_t::route(const std::string& request_str, const std::function<void()>* interrupt, Api* api) {
-  // set the interrupts
-  pimpl->set_interrupts(interrupt);
   // parse the request
   Api request;
   ParseApi(request_str, Options::route, request);
-  // check the request and locate the locations in the graph
-  pimpl->loki_worker.route(request);
-  // route between the locations in the graph to find the best path
-  pimpl->thor_worker.route(request);
-  // get some directions back from them
-  pimpl->odin_worker.narrate(request);
-  // serialize them out to json string
-  auto bytes = tyr::serializeDirections(request);
-  // if they want you do to do the cleanup automatically
-  if (auto_cleanup) {
-    cleanup();
-  }
+  // do the work
+  auto bytes = act(request, interrupt);
   // give the caller a copy
   if (api) {
     api->Swap(&request);
@@ -79,66 +67,40 @@ actor_t::route(const std::string& request_str, const std::function<void()>* inte
 
 std::string
 actor_t::locate(const std::string& request_str, const std::function<void()>* interrupt, Api* api) {
-  // set the interrupts
-  pimpl->set_interrupts(interrupt);
   // parse the request
   Api request;
   ParseApi(request_str, Options::locate, request);
-  // check the request and locate the locations in the graph
-  auto json = pimpl->loki_worker.locate(request);
-  // if they want you do to do the cleanup automatically
-  if (auto_cleanup) {
-    cleanup();
-  }
+  // do the work
+  auto bytes = act(request, interrupt);
   // give the caller a copy
   if (api) {
     api->Swap(&request);
   }
-  return json;
+  return bytes;
 }
 
 std::string
 actor_t::matrix(const std::string& request_str, const std::function<void()>* interrupt, Api* api) {
-  // set the interrupts
-  pimpl->set_interrupts(interrupt);
   // parse the request
   Api request;
   ParseApi(request_str, Options::sources_to_targets, request);
-  // check the request and locate the locations in the graph
-  pimpl->loki_worker.matrix(request);
-  // compute the matrix
-  auto json = pimpl->thor_worker.matrix(request);
-  // if they want you do to do the cleanup automatically
-  if (auto_cleanup) {
-    cleanup();
-  }
+  // do the work
+  auto bytes = act(request, interrupt);
   // give the caller a copy
   if (api) {
     api->Swap(&request);
   }
-  return json;
+  return bytes;
 }
 
 std::string actor_t::optimized_route(const std::string& request_str,
                                      const std::function<void()>* interrupt,
                                      Api* api) {
-  // set the interrupts
-  pimpl->set_interrupts(interrupt);
   // parse the request
   Api request;
   ParseApi(request_str, Options::optimized_route, request);
-  // check the request and locate the locations in the graph
-  pimpl->loki_worker.matrix(request);
-  // compute compute all pairs and then the shortest path through them all
-  pimpl->thor_worker.optimized_route(request);
-  // get some directions back from them
-  pimpl->odin_worker.narrate(request);
-  // serialize them out to json string
-  auto bytes = tyr::serializeDirections(request);
-  // if they want you do to do the cleanup automatically
-  if (auto_cleanup) {
-    cleanup();
-  }
+  // do the work
+  auto bytes = act(request, interrupt);
   // give the caller a copy
   if (api) {
     api->Swap(&request);
@@ -146,48 +108,29 @@ std::string actor_t::optimized_route(const std::string& request_str,
   return bytes;
 }
 
-std::string
-actor_t::isochrone(const std::string& request_str, const std::function<void()>* interrupt, Api* api) {
-  // set the interrupts
-  pimpl->set_interrupts(interrupt);
+std::string actor_t::isochrone(const std::string& request_str,
+                               const std::function<void()>* interrupt,
+                               Api* api) {
   // parse the request
   Api request;
   ParseApi(request_str, Options::isochrone, request);
-  // check the request and locate the locations in the graph
-  pimpl->loki_worker.isochrones(request);
-  // compute the isochrones
-  auto json = pimpl->thor_worker.isochrones(request);
-  // if they want you do to do the cleanup automatically
-  if (auto_cleanup) {
-    cleanup();
-  }
+  // do the work
+  auto bytes = act(request, interrupt);
   // give the caller a copy
   if (api) {
     api->Swap(&request);
   }
-  return json;
+  return bytes;
 }
 
 std::string actor_t::trace_route(const std::string& request_str,
                                  const std::function<void()>* interrupt,
                                  Api* api) {
-  // set the interrupts
-  pimpl->set_interrupts(interrupt);
   // parse the request
   Api request;
   ParseApi(request_str, Options::trace_route, request);
-  // check the request and locate the locations in the graph
-  pimpl->loki_worker.trace(request);
-  // route between the locations in the graph to find the best path
-  pimpl->thor_worker.trace_route(request);
-  // get some directions back from them
-  pimpl->odin_worker.narrate(request);
-  // serialize them out to json string
-  auto bytes = tyr::serializeDirections(request);
-  // if they want you do to do the cleanup automatically
-  if (auto_cleanup) {
-    cleanup();
-  }
+  // do the work
+  auto bytes = act(request, interrupt);
   // give the caller a copy
   if (api) {
     api->Swap(&request);
@@ -198,108 +141,100 @@ std::string actor_t::trace_route(const std::string& request_str,
 std::string actor_t::trace_attributes(const std::string& request_str,
                                       const std::function<void()>* interrupt,
                                       Api* api) {
-  // set the interrupts
-  pimpl->set_interrupts(interrupt);
   // parse the request
   Api request;
   ParseApi(request_str, Options::trace_attributes, request);
-  // check the request and locate the locations in the graph
-  pimpl->loki_worker.trace(request);
-  // get the path and turn it into attribution along it
-  auto json = pimpl->thor_worker.trace_attributes(request);
-  // if they want you do to do the cleanup automatically
-  if (auto_cleanup) {
-    cleanup();
+  // do the work
+  auto bytes = act(request, interrupt);
+  // give the caller a copy
+  if (api) {
+    api->Swap(&request);
+  }
+  return bytes;
+}
+
+std::string actor_t::trace_attributes_batch(const std::string& request_str,
+                                            const std::function<void()>* interrupt,
+                                            Api* api) {
+  // parse the request
+  Api request;
+  ParseApi(request_str, Options::trace_attributes_batch, request);
+  // do the work
+  auto bytes = act(request, interrupt);
+  // give the caller a copy
+  if (api) {
+    api->Swap(&request);
   }
+  return bytes;
+}
+
+std::string actor_t::online_match(const std::string& request_str,
+                                  const std::function<void()>* interrupt,
+                                  Api* api) {
+  // parse the request
+  Api request;
+  ParseApi(request_str, Options::online_match, request);
+  // do the work
+  auto bytes = act(request, interrupt);
   // give the caller a copy
   if (api) {
     api->Swap(&request);
   }
-  return json;
+  return bytes;
 }
 
 std::string
 actor_t::height(const std::string& request_str, const std::function<void()>* interrupt, Api* api) {
-  // set the interrupts
-  pimpl->set_interrupts(interrupt);
   // parse the request
   Api request;
   ParseApi(request_str, Options::height, request);
-  // get the height at each point
-  auto json = pimpl->loki_worker.height(request);
-  // if they want you do to do the cleanup automatically
-  if (auto_cleanup) {
-    cleanup();
-  }
+  // do the work
+  auto bytes = act(request, interrupt);
   // give the caller a copy
   if (api) {
     api->Swap(&request);
   }
-  return json;
+  return bytes;
 }
 
 std::string actor_t::transit_available(const std::string& request_str,
                                        const std::function<void()>* interrupt,
                                        Api* api) {
-  // set the interrupts
-  pimpl->set_interrupts(interrupt);
   // parse the request
   Api request;
   ParseApi(request_str, Options::transit_available, request);
-  // check the request and locate the locations in the graph
-  auto json = pimpl->loki_worker.transit_available(request);
-  // if they want you do to do the cleanup automatically
-  if (auto_cleanup) {
-    cleanup();
-  }
+  // do the work
+  auto bytes = act(request, interrupt);
   // give the caller a copy
   if (api) {
     api->Swap(&request);
   }
-  return json;
+  return bytes;
 }
 
-std::string
-actor_t::expansion(const std::string& request_str, const std::function<void()>* interrupt, Api* api) {
-  // set the interrupts
-  pimpl->set_interrupts(interrupt);
+std::string actor_t::expansion(const std::string& request_str,
+                               const std::function<void()>* interrupt,
+                               Api* api) {
   // parse the request
   Api request;
   ParseApi(request_str, Options::expansion, request);
-  // check the request and locate the locations in the graph
-  pimpl->loki_worker.route(request);
-  // route between the locations in the graph to find the best path
-  auto json = pimpl->thor_worker.expansion(request);
-  // if they want you do to do the cleanup automatically
-  if (auto_cleanup) {
-    cleanup();
-  }
+  // do the work
+  auto bytes = act(request, interrupt);
   // give the caller a copy
   if (api) {
     api->Swap(&request);
   }
-  return json;
+  return bytes;
 }
 
-std::string
-actor_t::centroid(const std::string& request_str, const std::function<void()>* interrupt, Api* api) {
-  // set the interrupts
-  pimpl->set_interrupts(interrupt);
+std::string actor_t::centroid(const std::string& request_str,
+                              const std::function<void()>* interrupt,
+                              Api* api) {
   // parse the request
   Api request;
   ParseApi(request_str, Options::centroid, request);
-  // check the request and locate the locations in the graph
-  pimpl->loki_worker.route(request);
-  // route between the locations in the graph to find the best path
-  pimpl->thor_worker.centroid(request);
-  // get some directions back from them
-  pimpl->odin_worker.narrate(request);
-  // serialize them out to json string
-  auto bytes = tyr::serializeDirections(request);
-  // if they want you do to do the cleanup automatically
-  if (auto_cleanup) {
-    cleanup();
-  }
+  // do the work
+  auto bytes = act(request, interrupt);
   // give the caller a copy
   if (api) {
     api->Swap(&request);
@@ -307,5 +242,109 @@ actor_t::centroid(const std::string& request_str, const std::function<void()>* i
   return bytes;
 }
 
+std::string actor_t::act(Api& request, const std::function<void()>* interrupt) {
+  // set the interrupts
+  pimpl->set_interrupts(interrupt);
+  std::string bytes;
+  switch (request.options().action()) {
+    case Options::route:
+      // check the request and locate the locations in the graph
+      pimpl->loki_worker.route(request);
+      // route between the locations in the graph to find the best path
+      pimpl->thor_worker.route(request);
+      // get some directions back from them
+      pimpl->odin_worker.narrate(request);
+      // serialize them out to json string
+      bytes = tyr::serializeDirections(request);
+      break;
+    case Options::locate:
+      // check the request and locate the locations in the graph
+      bytes = pimpl->loki_worker.locate(request);
+      break;
+    case Options::sources_to_targets:
+      // check the request and locate the locations in the graph
+      pimpl->loki_worker.matrix(request);
+      // compute the matrix
+      bytes = pimpl->thor_worker.matrix(request);
+      break;
+    case Options::optimized_route:
+      // check the request and locate the locations in the graph
+      pimpl->loki_worker.matrix(request);
+      // compute compute all pairs and then the shortest path through them all
+      pimpl->thor_worker.optimized_route(request);
+      // get some directions back from them
+      pimpl->odin_worker.narrate(request);
+      // serialize them out to json string
+      bytes = tyr::serializeDirections(request);
+      break;
+    case Options::isochrone:
+      // check the request and locate the locations in the graph
+      pimpl->loki_worker.isochrones(request);
+      // compute the isochrones
+      bytes = pimpl->thor_worker.isochrones(request);
+      break;
+    case Options::trace_route:
+      // check the request and locate the locations in the graph
+      pimpl->loki_worker.trace(request);
+      // route between the locations in the graph to find the best path
+      pimpl->thor_worker.trace_route(request);
+      // get some directions back from them
+      pimpl->odin_worker.narrate(request);
+      // serialize them out to json string
+      bytes = tyr::serializeDirections(request);
+      break;
+    case Options::trace_attributes:
+      // check the request and locate the locations in the graph
+      pimpl->loki_worker.trace(request);
+      // get the path and turn it into attribution along it
+      bytes = pimpl->thor_worker.trace_attributes(request);
+      break;
+    case Options::trace_attributes_batch:
+      // check the traces and locate their ends in the graph
+      pimpl->loki_worker.trace_batch(request);
+      // match all of the traces and turn each path into attribution along it
+      bytes = pimpl->thor_worker.trace_attributes_batch(request);
+      break;
+    case Options::online_match:
+      // check the options and the points
+      pimpl->loki_worker.online_match(request);
+      // push the points through the session and turn what became final into attribution
+      bytes = pimpl->thor_worker.online_match(request);
+      break;
+    case Options::height:
+      // get the height at each point
+      bytes = pimpl->loki_worker.height(request);
+      break;
+    case Options::transit_available:
+      // check the request and locate the locations in the graph
+      bytes = pimpl->loki_worker.transit_available(request);
+      break;
+    case Options::expansion:
+      // check the request and locate the locations in the graph
+      pimpl->loki_worker.route(request);
+      // route between the locations in the graph to find the best path
+      bytes = pimpl->thor_worker.expansion(request);
+      break;
+    case Options::centroid:
+      // check the request and locate the locations in the graph
+      pimpl->loki_worker.route(request);
+      // route between the locations in the graph to find the best path
+      pimpl->thor_worker.centroid(request);
+      // get some directions back from them
+      pimpl->odin_worker.narrate(request);
+      // serialize them out to json string
+      bytes = tyr::serializeDirections(request);
+      break;
+    default:
+      // apparently you wanted something that we figured we'd support but havent written yet
+      throw valhalla_exception_t{107};
+  }
+  // if they want you do to do the cleanup automatically
+  if (auto_cleanup) {
+    cleanup();
+  }
+  return bytes;
+}
+
 } // namespace tyr
 } // namespace valhalla
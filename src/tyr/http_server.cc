@@ -0,0 +1,715 @@
+#include "tyr/http_server.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "midgard/logging.h"
+#include "proto_conversions.h"
+#include "tyr/actor.h"
+#include "worker.h"
+
+namespace {
+
+using namespace valhalla;
+
+constexpr size_t kReadSize = 65536;
+constexpr size_t kMaxHeaderSize = 65536;
+// Stop answering pipelined requests of a connection that doesn't read its responses
+constexpr size_t kMaxPendingOutput = 4194304; // 4MB
+// Stop reading from a connection once this many of the largest requests are waiting on it
+constexpr size_t kMaxPendingRequests = 2;
+// How often the connections are checked for timeouts
+constexpr int kSweepMillis = 1000;
+
+using std::chrono::steady_clock;
+
+const char* const kJsonMime = "application/json;charset=utf-8";
+const char* const kJsMime = "application/javascript;charset=utf-8";
+const char* const kGpxMime = "application/gpx+xml;charset=utf-8";
+
+// One request cut out of the bytes received on a connection
+struct request_t {
+  std::string method;
+  std::string path;
+  query_t query;
+  std::string body;
+  bool keep_alive;
+  bool expect_continue;
+};
+
+// What came of looking for a request in the bytes received so far
+enum class parsed_t { kIncomplete, kComplete, kBad, kTooLarge, kUnsupported };
+
+int hex_value(const char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// Undoes the percent encoding of urls, in query strings a + is a space
+std::string url_decode(const char* begin, const char* end, const bool query) {
+  std::string decoded;
+  decoded.reserve(end - begin);
+  for (const char* c = begin; c < end; ++c) {
+    int high, low;
+    if (*c == '%' && end - c > 2 && (high = hex_value(c[1])) >= 0 && (low = hex_value(c[2])) >= 0) {
+      decoded.push_back(static_cast<char>(high * 16 + low));
+      c += 2;
+    } else if (*c == '+' && query) {
+      decoded.push_back(' ');
+    } else {
+      decoded.push_back(*c);
+    }
+  }
+  return decoded;
+}
+
+void parse_query(const char* begin, const char* end, query_t& query) {
+  while (begin < end) {
+    const char* amp = std::find(begin, end, '&');
+    const char* eq = std::find(begin, amp, '=');
+    auto& values = query[url_decode(begin, eq, true)];
+    values.push_back(eq < amp ? url_decode(eq + 1, amp, true) : std::string());
+    begin = amp + 1;
+  }
+}
+
+bool iequals(const std::string& a, const char* b) {
+  return a.size() == std::strlen(b) &&
+         std::equal(a.begin(), a.end(), b, [](const char x, const char y) {
+           return std::tolower(static_cast<unsigned char>(x)) ==
+                  std::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+/**
+ * Looks for a whole request at the start of the buffer
+ * @param buffer            bytes received on the connection not yet answered
+ * @param max_request_size  largest request we accept
+ * @param request           gets the request when a whole one was there
+ * @param size              gets the bytes the request takes up in the buffer, when there is one,
+ *                          or the size of its headers when only those are there yet
+ */
+parsed_t parse_request(const std::string& buffer,
+                       const size_t max_request_size,
+                       request_t& request,
+                       size_t& size) {
+  // wait for all of the headers
+  auto headers_end = buffer.find("\r\n\r\n");
+  if (headers_end == std::string::npos) {
+    return buffer.size() > kMaxHeaderSize ? parsed_t::kTooLarge : parsed_t::kIncomplete;
+  }
+  const char* data = buffer.data();
+  const char* end = data + headers_end + 2;
+
+  // request line: method target version
+  const char* line_end = std::search(data, end, "\r\n", "\r\n" + 2);
+  const char* method_end = std::find(data, line_end, ' ');
+  const char* target_end = std::find(method_end + 1, line_end, ' ');
+  if (method_end == line_end || target_end == line_end || method_end == data) {
+    return parsed_t::kBad;
+  }
+  const std::string version(target_end + 1, line_end);
+  if (version != "HTTP/1.1" && version != "HTTP/1.0") {
+    return parsed_t::kBad;
+  }
+  request.method.assign(data, method_end);
+  const char* question = std::find(method_end + 1, target_end, '?');
+  request.path = url_decode(method_end + 1, question, false);
+  request.query.clear();
+  if (question < target_end) {
+    parse_query(question + 1, target_end, request.query);
+  }
+
+  // headers, the ones we care about anyway
+  request.keep_alive = version == "HTTP/1.1";
+  request.expect_continue = false;
+  size_t content_length = 0;
+  for (const char* line = line_end + 2; line < end;) {
+    line_end = std::search(line, end, "\r\n", "\r\n" + 2);
+    const char* colon = std::find(line, line_end, ':');
+    if (colon == line_end) {
+      return parsed_t::kBad;
+    }
+    const std::string name(line, colon);
+    const char* value = colon + 1;
+    while (value < line_end && (*value == ' ' || *value == '\t')) {
+      ++value;
+    }
+    const char* value_end = line_end;
+    while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) {
+      --value_end;
+    }
+    const std::string header_value(value, value_end);
+    if (iequals(name, "content-length")) {
+      if (header_value.empty() ||
+          header_value.find_first_not_of("0123456789") != std::string::npos ||
+          header_value.size() > 18) {
+        return parsed_t::kBad;
+      }
+      content_length = std::stoull(header_value);
+    } else if (iequals(name, "transfer-encoding")) {
+      return parsed_t::kUnsupported;
+    } else if (iequals(name, "connection")) {
+      if (iequals(header_value, "close")) {
+        request.keep_alive = false;
+      } else if (iequals(header_value, "keep-alive")) {
+        request.keep_alive = true;
+      }
+    } else if (iequals(name, "expect")) {
+      request.expect_continue = iequals(header_value, "100-continue");
+    }
+    line = line_end + 2;
+  }
+
+  // and then the body
+  size = headers_end + 4;
+  if (size + content_length > max_request_size) {
+    return parsed_t::kTooLarge;
+  }
+  if (buffer.size() < size + content_length) {
+    return parsed_t::kIncomplete;
+  }
+  request.body.assign(buffer, size, content_length);
+  size += content_length;
+  return parsed_t::kComplete;
+}
+
+void append_response(std::string& out,
+                     const unsigned code,
+                     const std::string& message,
+                     const std::string& body,
+                     const char* content_type,
+                     const bool attachment,
+                     const bool keep_alive) {
+  out.append("HTTP/1.1 ").append(std::to_string(code)).append(" ").append(message);
+  out.append("\r\nAccess-Control-Allow-Origin: *\r\nContent-type: ").append(content_type);
+  if (attachment) {
+    out.append("\r\nContent-Disposition: attachment; filename=route.gpx");
+  }
+  out.append("\r\nContent-Length: ").append(std::to_string(body.size()));
+  out.append(keep_alive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+  out.append(body);
+}
+
+#ifdef __linux__
+
+// The state of a connection between reads and writes
+struct connection_t {
+  std::string in;         // received bytes not answered yet
+  std::string out;        // response bytes not sent yet
+  size_t written = 0;     // how much of out was sent already
+  uint32_t events = 0;    // what we asked epoll to tell us about the socket
+  bool close = false;     // whether to hang up once out is sent
+  bool continued = false; // whether the request at the front of in got a 100 Continue
+  bool partial = false;   // whether in ends with a request we only got part of
+  // when bytes last went either way
+  steady_clock::time_point active;
+  // when the first bytes of the request at the front of in came
+  steady_clock::time_point receiving;
+};
+
+/**
+ * Runs the event loop of one of the worker threads of the server
+ */
+class worker_t {
+public:
+  worker_t(const boost::property_tree::ptree& config,
+           const int listener,
+           const int stop_fd,
+           const size_t max_request_size,
+           const std::chrono::seconds idle_timeout,
+           const std::chrono::seconds read_timeout,
+           const std::atomic<bool>& stopped)
+      : actor_(config, true), listener_(listener), stop_fd_(stop_fd),
+        max_request_size_(max_request_size), max_pending_input_(max_request_size *
+                                                                kMaxPendingRequests),
+        idle_timeout_(idle_timeout), read_timeout_(read_timeout), stopped_(stopped),
+        epoll_fd_(epoll_create1(0)) {
+    if (epoll_fd_ < 0) {
+      throw std::runtime_error("Could not create epoll instance: " + std::string(strerror(errno)));
+    }
+    watch(listener_, EPOLLIN);
+    watch(stop_fd_, EPOLLIN);
+
+    // the actions we answer
+    Options::Action action;
+    for (const auto& kv : config.get_child("loki.actions")) {
+      auto path = kv.second.get_value<std::string>();
+      if (Options_Action_Enum_Parse(path, &action)) {
+        actions_.insert(action);
+        action_str_.append("'/" + path + "' ");
+      }
+    }
+  }
+
+  ~worker_t() {
+    for (const auto& connection : connections_) {
+      ::close(connection.first);
+    }
+    ::close(epoll_fd_);
+  }
+
+  void work() {
+    epoll_event events[64];
+    auto swept = steady_clock::now();
+    while (!stopped_) {
+      int count = epoll_wait(epoll_fd_, events, 64, kSweepMillis);
+      if (count < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::runtime_error("Could not wait on sockets: " + std::string(strerror(errno)));
+      }
+      for (int i = 0; i < count; ++i) {
+        const int fd = events[i].data.fd;
+        if (fd == stop_fd_) {
+          continue;
+        } else if (fd == listener_) {
+          accept_connections();
+        } else {
+          on_event(fd, events[i].events);
+        }
+      }
+      auto now = steady_clock::now();
+      if (now - swept >= std::chrono::milliseconds(kSweepMillis)) {
+        sweep(now);
+        swept = now;
+      }
+    }
+  }
+
+protected:
+  void watch(const int fd, const uint32_t events) {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+  }
+
+  void accept_connections() {
+    while (true) {
+      int fd = accept4(listener_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+        // EAGAIN means someone else got it or there are no more
+        return;
+      }
+      int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      auto& connection = connections_[fd];
+      connection.active = steady_clock::now();
+      connection.events = EPOLLIN | EPOLLRDHUP;
+      watch(fd, connection.events);
+    }
+  }
+
+  // Hangs up on connections that sat idle or didn't send a whole request or read their responses
+  // in time. Those that are in the middle of sending a request are told so with a 408
+  void sweep(const steady_clock::time_point now) {
+    std::vector<int> expired;
+    for (auto& kv : connections_) {
+      auto& connection = kv.second;
+      if (connection.partial && connection.out.empty() && !connection.close &&
+          now - connection.receiving > read_timeout_) {
+        append_response(connection.out, 408, "Request Timeout", "", kJsonMime, false, false);
+        connection.in.clear();
+        connection.partial = false;
+        connection.close = true;
+        if (!flush(kv.first, connection)) {
+          expired.push_back(kv.first);
+        }
+      } else if (now - connection.active > idle_timeout_) {
+        expired.push_back(kv.first);
+      }
+    }
+    for (auto fd : expired) {
+      hang_up(fd);
+    }
+  }
+
+  void hang_up(const int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections_.erase(fd);
+  }
+
+  void on_event(const int fd, const uint32_t events) {
+    auto found = connections_.find(fd);
+    if (found == connections_.end()) {
+      return;
+    }
+    auto& connection = found->second;
+    if (events & EPOLLERR) {
+      hang_up(fd);
+      return;
+    }
+
+    // take everything there is to read, the peer may have sent its last request and hung up. we
+    // stop reading once enough requests are waiting for their turn
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+      char buffer[kReadSize];
+      while (!connection.close && connection.in.size() < max_pending_input_) {
+        auto received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+          if (connection.in.empty()) {
+            connection.receiving = steady_clock::now();
+          }
+          connection.in.append(buffer, received);
+          connection.active = steady_clock::now();
+        } else if (received == 0) {
+          connection.close = true;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          break;
+        } else if (errno != EINTR) {
+          hang_up(fd);
+          return;
+        }
+      }
+    }
+
+    answer(connection);
+    if (!flush(fd, connection)) {
+      hang_up(fd);
+    }
+  }
+
+  // Answers all the whole requests received so far
+  void answer(connection_t& connection) {
+    request_t request;
+    size_t size = 0;
+    while (connection.out.size() - connection.written < kMaxPendingOutput) {
+      auto parsed = parse_request(connection.in, max_request_size_, request, size);
+      connection.partial = parsed == parsed_t::kIncomplete && !connection.in.empty();
+      if (parsed == parsed_t::kIncomplete) {
+        // tell the client to go ahead with the body if it is waiting for us to
+        if (size > 0 && request.expect_continue && !connection.continued) {
+          connection.out.append("HTTP/1.1 100 Continue\r\n\r\n");
+          connection.continued = true;
+        }
+        // the peer hung up in the middle of a request so there is no one to answer
+        if (connection.close) {
+          connection.in.clear();
+        }
+        return;
+      }
+
+      // we can't make sense of what comes next so answer and hang up
+      if (parsed != parsed_t::kComplete) {
+        unsigned code = parsed == parsed_t::kBad ? 400 : parsed == parsed_t::kTooLarge ? 413 : 501;
+        std::string message = parsed == parsed_t::kBad
+                                  ? "Bad Request"
+                                  : parsed == parsed_t::kTooLarge ? "Payload Too Large"
+                                                                  : "Not Implemented";
+        append_response(connection.out, code, message, "", kJsonMime, false, false);
+        connection.in.clear();
+        connection.partial = false;
+        connection.close = true;
+        return;
+      }
+
+      connection.in.erase(0, size);
+      connection.continued = false;
+      connection.receiving = steady_clock::now();
+      size = 0;
+      const bool keep_alive = request.keep_alive && !connection.close;
+      answer(request, keep_alive, connection.out);
+      if (!keep_alive) {
+        connection.in.clear();
+        connection.partial = false;
+        connection.close = true;
+        return;
+      }
+    }
+  }
+
+  // Runs the request through the actor and writes out the response
+  void answer(const request_t& request, const bool keep_alive, std::string& out) {
+    Api api;
+    try {
+      // block all but get and post
+      if (request.method != "GET" && request.method != "POST") {
+        throw valhalla_exception_t{101};
+      }
+      ParseApi(request.path, request.query, request.body, api);
+      const auto& options = api.options();
+
+      // check there is a valid action
+      if (!options.has_action() || actions_.find(options.action()) == actions_.cend()) {
+        throw valhalla_exception_t{106, action_str_};
+      }
+
+      auto body = actor_.act(api);
+
+      // wrap it up in the jsonp callback if need be
+      const bool narrated =
+          options.action() == Options::route || options.action() == Options::optimized_route ||
+          options.action() == Options::trace_route || options.action() == Options::centroid;
+      const bool as_gpx = narrated && options.format() == Options::gpx;
+      if (options.has_jsonp()) {
+        body = options.jsonp() + "(" + body + ")";
+      }
+      append_response(out, 200, "OK", body,
+                      options.has_jsonp() ? kJsMime : as_gpx ? kGpxMime : kJsonMime, as_gpx,
+                      keep_alive);
+      return;
+    } catch (const valhalla_exception_t& e) {
+      LOG_WARN(std::to_string(e.http_code) + "::" + std::string(e.what()));
+      error(e, api, keep_alive, out);
+    } catch (const std::exception& e) {
+      LOG_ERROR("400::" + std::string(e.what()));
+      error({599, std::string(e.what())}, api, keep_alive, out);
+    }
+    actor_.cleanup();
+  }
+
+  void error(const valhalla_exception_t& e,
+             const Api& api,
+             const bool keep_alive,
+             std::string& out) {
+    append_response(out, e.http_code, e.http_message, jsonify_error(e, api),
+                    api.options().has_jsonp() ? kJsMime : kJsonMime, false, keep_alive);
+  }
+
+  // Sends as much of the responses as the socket takes, false if the connection is done for
+  bool flush(const int fd, connection_t& connection) {
+    while (connection.written < connection.out.size()) {
+      auto sent = send(fd, connection.out.data() + connection.written,
+                       connection.out.size() - connection.written, MSG_NOSIGNAL);
+      if (sent > 0) {
+        connection.written += sent;
+        connection.active = steady_clock::now();
+      } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        break;
+      } else if (sent < 0 && errno == EINTR) {
+        continue;
+      } else {
+        return false;
+      }
+    }
+
+    // everything went out
+    if (connection.written == connection.out.size()) {
+      connection.out.clear();
+      connection.written = 0;
+      if (connection.close) {
+        return false;
+      }
+      // there may be pipelined requests we held off on while the output piled up
+      if (!connection.in.empty()) {
+        auto before = connection.out.size();
+        answer(connection);
+        if (connection.out.size() > before) {
+          return flush(fd, connection);
+        }
+      }
+    }
+
+    // only ask to hear about the socket being writable while we have something to write and about
+    // it being readable while we aren't holding off on the requests we already have
+    const bool writing = !connection.out.empty();
+    const bool reading = !connection.close && connection.in.size() < max_pending_input_ &&
+                         connection.out.size() - connection.written < kMaxPendingOutput;
+    const uint32_t events = (reading ? static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP) : 0) |
+                            (writing ? static_cast<uint32_t>(EPOLLOUT) : 0);
+    if (events != connection.events) {
+      epoll_event event{};
+      event.events = events;
+      event.data.fd = fd;
+      epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+      connection.events = events;
+    }
+    return true;
+  }
+
+  tyr::actor_t actor_;
+  std::unordered_set<Options::Action> actions_;
+  std::string action_str_;
+  const int listener_;
+  const int stop_fd_;
+  const size_t max_request_size_;
+  const size_t max_pending_input_;
+  const std::chrono::seconds idle_timeout_;
+  const std::chrono::seconds read_timeout_;
+  const std::atomic<bool>& stopped_;
+  const int epoll_fd_;
+  std::unordered_map<int, connection_t> connections_;
+};
+
+// Makes a non blocking socket listening at the address, more than one can listen at it at once
+int listen_at(const std::string& host, const uint16_t port) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  addrinfo* addresses = nullptr;
+  auto port_str = std::to_string(port);
+  const char* node = host == "*" ? nullptr : host.c_str();
+  if (getaddrinfo(node, port_str.c_str(), &hints, &addresses) != 0) {
+    throw std::runtime_error("Could not resolve " + host);
+  }
+
+  int fd = -1;
+  for (auto* address = addresses; address && fd < 0; address = address->ai_next) {
+    fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                address->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    if (bind(fd, address->ai_addr, address->ai_addrlen) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0) {
+    throw std::runtime_error("Could not listen at " + host + ":" + port_str + ": " +
+                             strerror(errno));
+  }
+  return fd;
+}
+
+#endif
+
+} // namespace
+
+namespace valhalla {
+namespace tyr {
+
+#ifdef __linux__
+
+http_server_t::http_server_t(const boost::property_tree::ptree& config,
+                             const std::string& listen,
+                             size_t worker_count,
+                             size_t max_request_size)
+    : config_(config), max_request_size_(max_request_size),
+      idle_timeout_(config.get<uint32_t>("httpd.service.idle_timeout", kDefaultIdleTimeout)),
+      read_timeout_(config.get<uint32_t>("httpd.service.read_timeout", kDefaultReadTimeout)),
+      stop_fd_(-1), port_(0), stopped_(false) {
+  // tcp://host:port
+  auto colon = listen.rfind(':');
+  if (listen.find("tcp://") != 0 || colon < 6) {
+    throw std::runtime_error("Listen on tcp://host:port, not " + listen);
+  }
+  auto host = listen.substr(6, colon - 6);
+  if (host.size() > 1 && host.front() == '[' && host.back() == ']') {
+    host = host.substr(1, host.size() - 2);
+  }
+  port_ = static_cast<uint16_t>(std::stoul(listen.substr(colon + 1)));
+
+  // every worker gets its own socket so the kernel can balance the connections between them. we
+  // might have been given port 0 in which case the others have to go where the first one went
+  worker_count = std::max<size_t>(worker_count, 1);
+  listeners_.push_back(listen_at(host, port_));
+  sockaddr_storage address{};
+  socklen_t length = sizeof(address);
+  getsockname(listeners_.front(), reinterpret_cast<sockaddr*>(&address), &length);
+  port_ = ntohs(address.ss_family == AF_INET6
+                    ? reinterpret_cast<sockaddr_in6*>(&address)->sin6_port
+                    : reinterpret_cast<sockaddr_in*>(&address)->sin_port);
+  while (listeners_.size() < worker_count) {
+    listeners_.push_back(listen_at(host, port_));
+  }
+
+  // all the workers listen to this to know when to stop
+  stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+http_server_t::~http_server_t() {
+  for (auto fd : listeners_) {
+    ::close(fd);
+  }
+  if (stop_fd_ >= 0) {
+    ::close(stop_fd_);
+  }
+}
+
+void http_server_t::serve() {
+  // a worker that dies would leave its socket bound with nobody accepting the connections the
+  // kernel still hands it, so the others are stopped as well and serve fails
+  std::exception_ptr failure;
+  std::mutex failure_lock;
+  std::vector<std::thread> threads;
+  for (auto listener : listeners_) {
+    threads.emplace_back([this, listener, &failure, &failure_lock]() {
+      try {
+        worker_t(config_, listener, stop_fd_, max_request_size_, idle_timeout_, read_timeout_,
+                 stopped_)
+            .work();
+      } catch (const std::exception& e) {
+        LOG_ERROR(e.what());
+        {
+          std::lock_guard<std::mutex> lock(failure_lock);
+          if (!failure) {
+            failure = std::current_exception();
+          }
+        }
+        stop();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+void http_server_t::stop() {
+  stopped_ = true;
+  uint64_t one = 1;
+  if (write(stop_fd_, &one, sizeof(one)) < 0) {
+    LOG_ERROR("Could not wake up the workers: " + std::string(strerror(errno)));
+  }
+}
+
+#else
+
+http_server_t::http_server_t(const boost::property_tree::ptree& config,
+                             const std::string&,
+                             size_t,
+                             size_t max_request_size)
+    : config_(config), max_request_size_(max_request_size), idle_timeout_(kDefaultIdleTimeout),
+      read_timeout_(kDefaultReadTimeout), stop_fd_(-1), port_(0), stopped_(false) {
+  throw std::runtime_error("The in process http server is only available on linux");
+}
+
+http_server_t::~http_server_t() {
+}
+
+void http_server_t::serve() {
+}
+
+void http_server_t::stop() {
+}
+
+#endif
+
+} // namespace tyr
+} // namespace valhalla
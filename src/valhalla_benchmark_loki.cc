@@ -1,6 +1,7 @@
 #include "config.h"
 
 #include "baldr/rapidjson_utils.h"
+#include "baldr/spatial_index.h"
 #include "filesystem.h"
 #include "loki/search.h"
 #include "midgard/logging.h"
@@ -31,6 +32,8 @@ size_t batch = 1;
 bool extrema = false;
 size_t isolated = 0;
 size_t radius = 0;
+bool use_spatial_index = true;
+std::shared_ptr<const valhalla::baldr::SpatialIndex> spatial_index;
 std::string costing_str;
 std::vector<std::string> input_files;
 
@@ -107,7 +110,10 @@ int ParseArguments(int argc, char* argv[]) {
       "network")("radius,r", boost::program_options::value<size_t>(&radius),
                  "How many meters to search away from the input location")(
       "costing", boost::program_options::value<std::string>(&costing_str),
-      "Which costing model to use.")
+      "Which costing model to use.")(
+      "spatial-index,s", boost::program_options::value<bool>(&use_spatial_index),
+      "Whether to use the spatial index in mjolnir.spatial_index_file if it was built, to compare "
+      "searches with and without it")
       // positional arguments
       ("input_files",
        boost::program_options::value<std::vector<std::string>>(&input_files)->multitoken());
@@ -177,7 +183,7 @@ void work(const boost::property_tree::ptree& config, std::promise<results_t>& pr
       auto start = std::chrono::high_resolution_clock::now();
       try {
         // TODO: actually save the result
-        auto result = valhalla::loki::Search(job, reader, costing);
+        auto result = valhalla::loki::Search(job, reader, costing, spatial_index);
         auto end = std::chrono::high_resolution_clock::now();
         (*r) = result_t{std::chrono::duration_cast<std::chrono::milliseconds>(end - start), true, job,
                         cached};
@@ -228,6 +234,20 @@ int main(int argc, char** argv) {
     valhalla::midgard::logging::Configure(logging_config);
   }
 
+  // load the spatial index once for all the threads
+  auto spatial_index_file = pt.get<std::string>("mjolnir.spatial_index_file", "");
+  if (use_spatial_index && !spatial_index_file.empty() && filesystem::exists(spatial_index_file)) {
+    spatial_index = valhalla::baldr::SpatialIndex::Load(spatial_index_file);
+    valhalla::baldr::GraphReader reader(pt.get_child("mjolnir"));
+    if (spatial_index->Matches(reader)) {
+      LOG_INFO("Using the spatial index " + spatial_index_file);
+    } else {
+      LOG_WARN("Not using the spatial index " + spatial_index_file +
+               ", it was built from other tiles");
+      spatial_index.reset();
+    }
+  }
+
   // fill up the queue with work
   job_t job;
   for (const auto& file : input_files) {
@@ -26,20 +26,14 @@ using namespace prime_server;
 #include "odin/worker.h"
 #include "thor/worker.h"
 #include "tyr/actor.h"
+#include "tyr/http_server.h"
 
 int main(int argc, char** argv) {
-#ifdef HAVE_HTTP
   if (argc < 2 || argc > 4) {
     LOG_ERROR("Usage: " + std::string(argv[0]) + " config/file.json [concurrency]");
     LOG_ERROR("Usage: " + std::string(argv[0]) + " config/file.json action json_request");
     return 1;
   }
-#else
-  if (argc < 4) {
-    LOG_ERROR("Usage: " + std::string(argv[0]) + " config/file.json action json_request");
-    return 1;
-  }
-#endif
 
   // config file
   // TODO: validate the config
@@ -105,6 +99,12 @@ int main(int argc, char** argv) {
         case valhalla::Options::trace_attributes:
           std::cout << actor.trace_attributes(request_str, nullptr, &request) << std::endl;
           break;
+        case valhalla::Options::trace_attributes_batch:
+          std::cout << actor.trace_attributes_batch(request_str, nullptr, &request) << std::endl;
+          break;
+        case valhalla::Options::online_match:
+          std::cout << actor.online_match(request_str, nullptr, &request) << std::endl;
+          break;
         case valhalla::Options::height:
           std::cout << actor.height(request_str, nullptr, &request) << std::endl;
           break;
@@ -137,6 +137,35 @@ int main(int argc, char** argv) {
     return 0;
   }
 
+  // configure logging
+  boost::optional<boost::property_tree::ptree&> logging_subtree =
+      config.get_child_optional("tyr.logging");
+  if (logging_subtree) {
+    auto logging_config =
+        valhalla::midgard::ToMap<const boost::property_tree::ptree&,
+                                 std::unordered_map<std::string, std::string>>(logging_subtree.get());
+    valhalla::midgard::logging::Configure(logging_config);
+  }
+
+  // number of workers to use at each stage
+  auto worker_concurrency = std::thread::hardware_concurrency();
+  if (argc > 2) {
+    worker_concurrency = std::stoul(argv[2]);
+  }
+
+  // answer the requests from start to finish on the worker threads, no proxies in between
+  if (config.get<bool>("httpd.service.in_process", false)) {
+    try {
+      valhalla::tyr::http_server_t server(config, config.get<std::string>("httpd.service.listen"),
+                                          worker_concurrency);
+      server.serve();
+    } catch (const std::exception& e) {
+      LOG_ERROR(e.what());
+      return EXIT_FAILURE;
+    }
+    return 0;
+  }
+
 #ifdef HAVE_HTTP
   // grab the endpoints
   std::string listen = config.get<std::string>("httpd.service.listen");
@@ -157,22 +186,6 @@ int main(int argc, char** argv) {
     }
   }
 
-  // configure logging
-  boost::optional<boost::property_tree::ptree&> logging_subtree =
-      config.get_child_optional("tyr.logging");
-  if (logging_subtree) {
-    auto logging_config =
-        valhalla::midgard::ToMap<const boost::property_tree::ptree&,
-                                 std::unordered_map<std::string, std::string>>(logging_subtree.get());
-    valhalla::midgard::logging::Configure(logging_config);
-  }
-
-  // number of workers to use at each stage
-  auto worker_concurrency = std::thread::hardware_concurrency();
-  if (argc > 2) {
-    worker_concurrency = std::stoul(argv[2]);
-  }
-
   // setup the cluster within this process
   zmq::context_t context;
   std::thread server_thread =
@@ -213,6 +226,9 @@ int main(int argc, char** argv) {
 
   // wait forever (or for interrupt)
   server_thread.join();
+#else
+  LOG_ERROR("Built without prime_server, set httpd.service.in_process to serve requests");
+  return EXIT_FAILURE;
 #endif
 
   return 0;
@@ -0,0 +1,332 @@
+#include "config.h"
+
+#include "baldr/graphreader.h"
+#include "baldr/pathlocation.h"
+#include "baldr/rapidjson_utils.h"
+#include "baldr/spatial_index.h"
+#include "baldr/tilehierarchy.h"
+#include "filesystem.h"
+#include "loki/search.h"
+#include "midgard/logging.h"
+#include "midgard/pointll.h"
+#include "sif/costfactory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <cstdint>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <list>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bpo = boost::program_options;
+using namespace valhalla;
+
+namespace {
+
+filesystem::path config_file_path;
+std::string input_file;
+std::string output_file;
+size_t threads =
+    std::max(static_cast<size_t>(std::thread::hardware_concurrency()), static_cast<size_t>(1));
+size_t batch = 256;
+size_t reach = 0;
+size_t radius = 0;
+std::string costing_str = "auto";
+
+// What is written for each input point, in the order of the input
+#pragma pack(push, 1)
+struct snapped_t {
+  uint64_t edge_id;    // the closest edge or an invalid id if nothing was found
+  float percent_along; // where along the edge the point snapped to
+  float distance;      // how far away from the input point it is in meters
+  double lng;          // the point the input snapped to
+  double lat;
+};
+#pragma pack(pop)
+static_assert(sizeof(snapped_t) == 32, "The output records are 32 bytes");
+
+int ParseArguments(int argc, char* argv[]) {
+  bpo::options_description options(
+      "valhalla_snap " VALHALLA_VERSION "\n"
+      "\n"
+      " Usage: valhalla_snap [options]\n"
+      "\n"
+      "valhalla_snap snaps a large number of points to the closest edges of the tiled route data "
+      "using every core. The input is a binary file with the longitudes of all the points as "
+      "little endian doubles followed by their latitudes. The output has a 32 byte record for "
+      "every input point in the same order: the edge id (uint64, all bits set if nothing was "
+      "found), the percent along the edge (float), the distance in meters (float) and the "
+      "longitude and latitude of the snapped point (doubles)."
+      "\n"
+      "\n");
+
+  options.add_options()("help,h", "Print this help message.")(
+      "version,v", "Print the version of this software.")(
+      "config,c", bpo::value<filesystem::path>(&config_file_path),
+      "Path to the json configuration file.")("input,i", bpo::value<std::string>(&input_file),
+                                              "The points to snap.")(
+      "output,o", bpo::value<std::string>(&output_file), "Where to write the snapped points.")(
+      "threads,t", bpo::value<size_t>(&threads), "Concurrency to use.")(
+      "batch,b", bpo::value<size_t>(&batch),
+      "Number of points, sorted by the bin they are in, searched together.")(
+      "reach,r", bpo::value<size_t>(&reach),
+      "How many edges need to be reachable before considering it as connected to the larger "
+      "network.")("radius", bpo::value<size_t>(&radius),
+                  "How many meters around the point to consider all the edges.")(
+      "costing", bpo::value<std::string>(&costing_str), "Which costing model to use.");
+
+  bpo::variables_map vm;
+  try {
+    bpo::store(bpo::command_line_parser(argc, argv).options(options).run(), vm);
+    bpo::notify(vm);
+  } catch (std::exception& e) {
+    std::cerr << "Unable to parse command line options because: " << e.what() << "\n"
+              << "This is a bug, please report it at " PACKAGE_BUGREPORT << "\n";
+    return 1;
+  }
+
+  if (vm.count("help")) {
+    std::cout << options << "\n";
+    return -1;
+  }
+
+  if (vm.count("version")) {
+    std::cout << "valhalla_snap " << VALHALLA_VERSION << "\n";
+    return -1;
+  }
+
+  for (const auto& arg : std::vector<std::string>{"config", "input", "output"}) {
+    if (vm.count(arg) == 0) {
+      std::cerr << "The <" << arg << "> argument was not provided, but is mandatory\n\n";
+      std::cerr << options << "\n";
+      return 1;
+    }
+  }
+
+  batch = std::max(batch, static_cast<size_t>(1));
+  threads = std::max(threads, static_cast<size_t>(1));
+  return 0;
+}
+
+std::vector<midgard::PointLL> read_points(const std::string& file_name) {
+  std::ifstream file(file_name, std::ios::in | std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open " + file_name);
+  }
+  const size_t size = file.tellg();
+  if (size % (2 * sizeof(double))) {
+    throw std::runtime_error(file_name + " does not hold pairs of doubles");
+  }
+  const size_t count = size / (2 * sizeof(double));
+  std::vector<double> columns(2 * count);
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(columns.data()), size);
+  if (!file) {
+    throw std::runtime_error("Could not read " + file_name);
+  }
+
+  std::vector<midgard::PointLL> points;
+  points.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    points.emplace_back(columns[i], columns[count + i]);
+  }
+  return points;
+}
+
+// The order to snap the points in so that the points of a batch share tiles and bins
+std::vector<uint32_t> bin_order(const std::vector<midgard::PointLL>& points) {
+  const auto& tiles = baldr::TileHierarchy::levels().back().tiles;
+  std::vector<uint64_t> keys(points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    const auto tile_id = tiles.TileId(points[i]);
+    uint64_t bin = 0;
+    if (tile_id >= 0) {
+      const auto base = tiles.Base(tile_id);
+      const auto column = std::min<uint64_t>((points[i].lng() - base.lng()) /
+                                                 tiles.SubdivisionSize(),
+                                             baldr::kBinsDim - 1);
+      const auto row = std::min<uint64_t>((points[i].lat() - base.lat()) / tiles.SubdivisionSize(),
+                                          baldr::kBinsDim - 1);
+      bin = row * baldr::kBinsDim + column;
+    }
+    keys[i] = (static_cast<uint64_t>(static_cast<uint32_t>(tile_id)) << 8) | bin;
+  }
+  std::vector<uint32_t> order(points.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+  return order;
+}
+
+sif::cost_ptr_t create_costing() {
+  Options options;
+  for (int i = 0; i < Costing_MAX; ++i) {
+    options.add_costing_options();
+  }
+  Costing costing;
+  if (!Costing_Enum_Parse(costing_str, &costing)) {
+    throw std::runtime_error("Unknown costing " + costing_str);
+  }
+  options.set_costing(costing);
+  return sif::CostFactory{}.Create(options);
+}
+
+// Snaps batches of points until there are none left
+void snap(const boost::property_tree::ptree& config,
+          const std::shared_ptr<const baldr::SpatialIndex>& spatial_index,
+          const std::vector<midgard::PointLL>& points,
+          const std::vector<uint32_t>& order,
+          std::atomic<size_t>& next_batch,
+          std::vector<snapped_t>& snapped) {
+  baldr::GraphReader reader(config.get_child("mjolnir"));
+  auto costing = create_costing();
+  std::vector<baldr::Location> locations;
+  size_t b;
+  while ((b = next_batch.fetch_add(1)) * batch < order.size()) {
+    const auto begin = order.begin() + b * batch;
+    const auto end = order.begin() + std::min((b + 1) * batch, order.size());
+    locations.clear();
+    for (auto i = begin; i != end; ++i) {
+      locations.emplace_back(points[*i], baldr::Location::StopType::BREAK, reach, reach, radius);
+    }
+
+    // each point gets the closest of the edges it found
+    const auto results = loki::Search(locations, reader, costing, spatial_index);
+    for (auto i = begin; i != end; ++i) {
+      auto& result = snapped[*i];
+      result = {baldr::kInvalidGraphId, 0.f, 0.f, 0., 0.};
+      const auto found = results.find(locations[i - begin]);
+      if (found == results.cend()) {
+        continue;
+      }
+      const auto& edges = found->second.edges;
+      const auto closest = std::min_element(edges.begin(), edges.end(),
+                                            [](const baldr::PathLocation::PathEdge& a,
+                                               const baldr::PathLocation::PathEdge& b) {
+                                              return a.distance < b.distance;
+                                            });
+      if (closest != edges.end()) {
+        result = {closest->id.value, static_cast<float>(closest->percent_along),
+                  static_cast<float>(closest->distance), closest->projected.lng(),
+                  closest->projected.lat()};
+      }
+    }
+
+    if (reader.OverCommitted()) {
+      reader.Trim();
+    }
+  }
+}
+
+// Snaps on a thread of the pool and hands what went wrong to the main thread
+void work(const boost::property_tree::ptree& config,
+          const std::shared_ptr<const baldr::SpatialIndex>& spatial_index,
+          const std::vector<midgard::PointLL>& points,
+          const std::vector<uint32_t>& order,
+          std::atomic<size_t>& next_batch,
+          std::vector<snapped_t>& snapped,
+          std::promise<void>& result) {
+  try {
+    snap(config, spatial_index, points, order, next_batch, snapped);
+  } // Whatever happens in Vegas..
+  catch (std::exception& e) {
+    // ..gets sent back to the main thread, the other threads are left no batches to take
+    next_batch = order.size();
+    result.set_exception(std::current_exception());
+    return;
+  }
+  result.set_value();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  int ret = ParseArguments(argc, argv);
+  if (ret > 0) {
+    return EXIT_FAILURE;
+  }
+  if (ret < 0) {
+    return EXIT_SUCCESS;
+  }
+
+  boost::property_tree::ptree config;
+  rapidjson::read_json(config_file_path.string(), config);
+
+  // configure logging
+  auto logging_subtree = config.get_child_optional("loki.logging");
+  if (logging_subtree) {
+    auto logging_config = midgard::ToMap<const boost::property_tree::ptree&,
+                                         std::unordered_map<std::string, std::string>>(
+        logging_subtree.get());
+    midgard::logging::Configure(logging_config);
+  }
+
+  // a costing we don't know is an error of the arguments, not of the threads
+  try {
+    create_costing();
+  } catch (const std::exception& e) {
+    LOG_ERROR(e.what());
+    return EXIT_FAILURE;
+  }
+
+  // load the spatial index once for all the threads
+  std::shared_ptr<const baldr::SpatialIndex> spatial_index;
+  auto spatial_index_file = config.get<std::string>("mjolnir.spatial_index_file", "");
+  if (!spatial_index_file.empty() && filesystem::exists(spatial_index_file)) {
+    spatial_index = baldr::SpatialIndex::Load(spatial_index_file);
+    baldr::GraphReader reader(config.get_child("mjolnir"));
+    if (!spatial_index->Matches(reader)) {
+      LOG_WARN("Not using the spatial index " + spatial_index_file +
+               ", it was built from other tiles");
+      spatial_index.reset();
+    }
+  }
+
+  const auto points = read_points(input_file);
+  const auto order = bin_order(points);
+  LOG_INFO("Snapping " + std::to_string(points.size()) + " points with " +
+           std::to_string(threads) + " threads");
+
+  // snap them all
+  std::vector<snapped_t> snapped(points.size());
+  std::atomic<size_t> next_batch(0);
+  std::list<std::thread> pool;
+  std::vector<std::promise<void>> results(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    pool.emplace_back(work, std::cref(config), std::cref(spatial_index), std::cref(points),
+                      std::cref(order), std::ref(next_batch), std::ref(snapped),
+                      std::ref(results[i]));
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  for (auto& result : results) {
+    try {
+      result.get_future().get();
+    } catch (const std::exception& e) {
+      LOG_ERROR("Could not snap the points: " + std::string(e.what()));
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::ofstream file(output_file, std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write(reinterpret_cast<const char*>(snapped.data()), snapped.size() * sizeof(snapped_t));
+  file.close();
+  if (file.fail()) {
+    LOG_ERROR("Could not write " + output_file);
+    return EXIT_FAILURE;
+  }
+
+  const auto found = std::count_if(snapped.begin(), snapped.end(), [](const snapped_t& s) {
+    return s.edge_id != baldr::kInvalidGraphId;
+  });
+  LOG_INFO("Snapped " + std::to_string(found) + " of " + std::to_string(points.size()) + " points");
+  return EXIT_SUCCESS;
+}
@@ -90,7 +90,7 @@ const std::unordered_map<unsigned, std::string> HTTP_STATUS_CODES{
 const std::unordered_map<unsigned, unsigned> ERROR_TO_STATUS{
     {100, 400}, {101, 405}, {106, 404}, {107, 501},
 
-    {110, 400}, {111, 400}, {112, 400}, {113, 400}, {114, 400},
+    {110, 400}, {111, 400}, {112, 400}, {113, 400}, {114, 400}, {115, 400},
 
     {120, 400}, {121, 400}, {122, 400}, {123, 400}, {124, 400}, {125, 400}, {126, 400}, {127, 400},
 
@@ -130,6 +130,7 @@ const std::unordered_map<unsigned, unsigned> ERROR_TO_STATUS{
     {430, 400},
 
     {440, 400}, {441, 400}, {442, 400}, {443, 400}, {444, 400}, {445, 400},
+    {446, 404}, {447, 503},
 
     {499, 400},
 
@@ -149,6 +150,7 @@ const std::unordered_map<unsigned, std::string> OSRM_ERRORS_CODES{
     {112, R"({"code":"InvalidOptions","message":"Options are invalid."})"},
     {113, R"({"code":"InvalidOptions","message":"Options are invalid."})"},
     {114, R"({"code":"InvalidOptions","message":"Options are invalid."})"},
+    {115, R"({"code":"InvalidOptions","message":"Options are invalid."})"},
 
     {120, R"({"code":"InvalidOptions","message":"Options are invalid."})"},
     {121, R"({"code":"InvalidOptions","message":"Options are invalid."})"},
@@ -276,6 +278,8 @@ const std::unordered_map<unsigned, std::string> OSRM_ERRORS_CODES{
     {444,
      R"({"code":"NoSegment","message":"One of the supplied input coordinates could not snap to street segment."})"},
     {445, R"({"code":"InvalidUrl","message":"URL string is invalid."})"},
+    {446, R"({"code":"InvalidOptions","message":"Options are invalid."})"},
+    {447, R"({"code":"InvalidOptions","message":"Options are invalid."})"},
 
     {499, R"({"code":"InvalidUrl","message":"URL string is invalid."})"},
 
@@ -371,7 +375,8 @@ void parse_locations(const rapidjson::Document& doc,
 
         // trace attributes does not support legs or breaks at discontinuities
         auto stop_type_json = rapidjson::get_optional<std::string>(r_loc, "/type");
-        if (options.action() == Options::trace_attributes) {
+        if (options.action() == Options::trace_attributes ||
+            options.action() == Options::trace_attributes_batch) {
           location->set_type(valhalla::Location::kVia);
         } // other actions let you specify whatever type of stop you want
         else if (stop_type_json) {
@@ -595,6 +600,47 @@ void parse_contours(const rapidjson::Document& doc,
   }
 }
 
+void parse_shape(const rapidjson::Document& doc,
+                 Options& options,
+                 const boost::optional<bool>& ignore_closures) {
+  auto encoded_polyline = rapidjson::get_optional<std::string>(doc, "/encoded_polyline");
+  if (encoded_polyline) {
+    options.set_encoded_polyline(*encoded_polyline);
+
+    // Set the precision to use when decoding the polyline. For height actions (only)
+    // either polyline6 (default) or polyline5 are supported. All other actions only
+    // support polyline6 inputs at this time.
+    double precision = 1e-6;
+    if (options.action() == Options::height) {
+      precision = options.shape_format() == valhalla::polyline5 ? 1e-5 : 1e-6;
+    }
+
+    auto decoded = midgard::decode<std::vector<midgard::PointLL>>(*encoded_polyline, precision);
+    for (const auto& ll : decoded) {
+      auto* sll = options.mutable_shape()->Add();
+      sll->mutable_ll()->set_lat(ll.lat());
+      sll->mutable_ll()->set_lng(ll.lng());
+      // set type to via by default
+      sll->set_type(valhalla::Location::kVia);
+    }
+    // first and last always get type break
+    if (options.shape_size()) {
+      options.mutable_shape(0)->set_type(valhalla::Location::kBreak);
+      options.mutable_shape(options.shape_size() - 1)->set_type(valhalla::Location::kBreak);
+    }
+    // add the date time
+    add_date_to_locations(options, *options.mutable_shape());
+  } // fall back from encoded polyline to array of locations
+  else {
+    parse_locations(doc, options, "shape", 134, ignore_closures);
+
+    // if no shape then try 'trace'
+    if (options.shape().size() == 0) {
+      parse_locations(doc, options, "trace", 135, ignore_closures);
+    }
+  }
+}
+
 void from_json(rapidjson::Document& doc, Options& options) {
   // TODO: stop doing this after a sufficient amount of time has passed
   // move anything nested in deprecated directions_options up to the top level
@@ -719,6 +765,22 @@ void from_json(rapidjson::Document& doc, Options& options) {
     options.set_linear_references(*linear_references);
   }
 
+  // which online map matching session the shape continues and whether it ends with it
+  auto session_id = rapidjson::get_optional<std::string>(doc, "/session_id");
+  if (session_id) {
+    options.set_session_id(*session_id);
+  }
+  auto finish = rapidjson::get_optional<bool>(doc, "/finish");
+  if (finish) {
+    options.set_finish(*finish);
+  }
+
+  // whether the matrix may trade turn costs and restrictions for the speed of an overlay
+  auto ch_overlay = rapidjson::get_optional<bool>(doc, "/ch_overlay");
+  if (ch_overlay) {
+    options.set_ch_overlay(*ch_overlay);
+  }
+
   // costing defaults to none which is only valid for locate
   auto costing_str = rapidjson::get<std::string>(doc, "/costing", "none");
 
@@ -756,42 +818,22 @@ void from_json(rapidjson::Document& doc, Options& options) {
                              ? rapidjson::get_optional<bool>(doc, ss.str().c_str())
                              : boost::none;
 
-  // parse map matching location input and encoded_polyline for height actions
-  auto encoded_polyline = rapidjson::get_optional<std::string>(doc, "/encoded_polyline");
-  if (encoded_polyline) {
-    options.set_encoded_polyline(*encoded_polyline);
-
-    // Set the precision to use when decoding the polyline. For height actions (only)
-    // either polyline6 (default) or polyline5 are supported. All other actions only
-    // support polyline6 inputs at this time.
-    double precision = 1e-6;
-    if (options.action() == Options::height) {
-      precision = options.shape_format() == valhalla::polyline5 ? 1e-5 : 1e-6;
-    }
-
-    auto decoded = midgard::decode<std::vector<midgard::PointLL>>(*encoded_polyline, precision);
-    for (const auto& ll : decoded) {
-      auto* sll = options.mutable_shape()->Add();
-      sll->mutable_ll()->set_lat(ll.lat());
-      sll->mutable_ll()->set_lng(ll.lng());
-      // set type to via by default
-      sll->set_type(valhalla::Location::kVia);
-    }
-    // first and last always get type break
-    if (options.shape_size()) {
-      options.mutable_shape(0)->set_type(valhalla::Location::kBreak);
-      options.mutable_shape(options.shape_size() - 1)->set_type(valhalla::Location::kBreak);
-    }
-    // add the date time
-    add_date_to_locations(options, *options.mutable_shape());
-  } // fall back from encoded polyline to array of locations
-  else {
-    parse_locations(doc, options, "shape", 134, ignore_closures);
-
-    // if no shape then try 'trace'
-    if (options.shape().size() == 0) {
-      parse_locations(doc, options, "trace", 135, ignore_closures);
+  // parse map matching location input and encoded_polyline for height actions, a batch of traces
+  // has its own shape or encoded_polyline per trace
+  if (options.action() == Options::trace_attributes_batch) {
+    auto traces = rapidjson::get_optional<rapidjson::Value::ConstArray>(doc, "/traces");
+    if (traces) {
+      for (const auto& trace : *traces) {
+        rapidjson::Document trace_doc;
+        trace_doc.CopyFrom(trace, trace_doc.GetAllocator());
+        parse_shape(trace_doc, options, ignore_closures);
+        options.add_traces()->mutable_shape()->Swap(options.mutable_shape());
+        options.clear_encoded_polyline();
+        options.clear_trace();
+      }
     }
+  } else {
+    parse_shape(doc, options, ignore_closures);
   }
 
   // Begin time for timestamps when entered given durations/delta times (defaults to 0)
@@ -803,7 +845,7 @@ void from_json(rapidjson::Document& doc, Options& options) {
 
   // Use durations (per shape point pair) to set time
   auto durations = rapidjson::get_optional<rapidjson::Value::ConstArray>(doc, "/durations");
-  if (durations) {
+  if (durations && options.action() != Options::trace_attributes_batch) {
     // Make sure durations is sized appropriately
     if (options.shape_size() > 0 && durations->Size() != (unsigned int)options.shape_size() - 1) {
       throw valhalla_exception_t{136};
@@ -831,12 +873,19 @@ void from_json(rapidjson::Document& doc, Options& options) {
   // Throw an error if use_timestamps is set to true but there are no timestamps in the
   // trace (or no durations present)
   if (options.use_timestamps()) {
-    bool has_time = false;
-    for (const auto& s : options.shape()) {
-      if (s.has_time()) {
-        has_time = true;
-        break;
+    auto timed = [](const google::protobuf::RepeatedPtrField<valhalla::Location>& shape) {
+      for (const auto& s : shape) {
+        if (s.has_time()) {
+          return true;
+        }
       }
+      return false;
+    };
+    // every trace of a batch needs its own
+    bool has_time =
+        options.action() != Options::trace_attributes_batch ? timed(options.shape()) : true;
+    for (const auto& trace : options.traces()) {
+      has_time = has_time && timed(trace.shape());
     }
     if (!has_time) {
       throw valhalla_exception_t{159};
@@ -1072,24 +1121,21 @@ std::string jsonify_error(const valhalla_exception_t& exception, const Api& requ
   return body.str();
 }
 
-#ifdef HAVE_HTTP
-void ParseApi(const http_request_t& request, valhalla::Api& api) {
+void ParseApi(const std::string& path,
+              const query_t& query,
+              const std::string& body,
+              valhalla::Api& api) {
   api.Clear();
 
-  // block all but get and post
-  if (request.method != method_t::POST && request.method != method_t::GET) {
-    throw valhalla_exception_t{101};
-  };
-
   rapidjson::Document document;
   auto& allocator = document.GetAllocator();
   // parse the input
-  const auto& json = request.query.find("json");
-  if (json != request.query.end() && json->second.size() && json->second.front().size()) {
+  const auto& json = query.find("json");
+  if (json != query.end() && json->second.size() && json->second.front().size()) {
     document.Parse(json->second.front().c_str());
     // no json parameter, check the body
-  } else if (!request.body.empty()) {
-    document.Parse(request.body.c_str());
+  } else if (!body.empty()) {
+    document.Parse(body.c_str());
     // no json at all
   } else {
     document.SetObject();
@@ -1100,7 +1146,7 @@ void ParseApi(const http_request_t& request, valhalla::Api& api) {
   };
 
   // throw the query params into the rapidjson doc
-  for (const auto& kv : request.query) {
+  for (const auto& kv : query) {
     // skip json or empty entries
     if (kv.first == "json" || kv.first.empty() || kv.second.empty() || kv.second.front().empty()) {
       continue;
@@ -1124,7 +1170,7 @@ void ParseApi(const http_request_t& request, valhalla::Api& api) {
 
   // set the action
   Options::Action action;
-  if (!request.path.empty() && Options_Action_Enum_Parse(request.path.substr(1), &action)) {
+  if (!path.empty() && Options_Action_Enum_Parse(path.substr(1), &action)) {
     options.set_action(action);
   }
 
@@ -1132,6 +1178,18 @@ void ParseApi(const http_request_t& request, valhalla::Api& api) {
   from_json(document, options);
 }
 
+#ifdef HAVE_HTTP
+void ParseApi(const http_request_t& request, valhalla::Api& api) {
+  api.Clear();
+
+  // block all but get and post
+  if (request.method != method_t::POST && request.method != method_t::GET) {
+    throw valhalla_exception_t{101};
+  };
+
+  ParseApi(request.path, request.query, request.body, api);
+}
+
 const headers_t::value_type CORS{"Access-Control-Allow-Origin", "*"};
 const headers_t::value_type ATTACHMENT{"Content-Disposition", "attachment; filename=route.gpx"};
 
@@ -66,6 +66,97 @@ TEST(EdgeStatus, TestStatus) {
   TryGet(edgestatus, GraphId(555, 3, 1), EdgeSet::kUnreachedOrReset);
 }
 
+TEST(EdgeStatus, TestReuseAfterClear) {
+  EdgeStatus edgestatus;
+
+  // Dummy tiles of different sizes so the pooled arrays have to grow
+  GraphTileHeader small_header;
+  small_header.set_directededgecount(10);
+  test_tile* small_tt = new test_tile;
+  small_tt->header_ = &small_header;
+  graph_tile_ptr small_tile = small_tt;
+
+  GraphTileHeader big_header;
+  big_header.set_directededgecount(1000);
+  test_tile* big_tt = new test_tile;
+  big_tt->header_ = &big_header;
+  graph_tile_ptr big_tile = big_tt;
+
+  // Same tile on several levels and paths and tiles on different pages of the table
+  edgestatus.Set(GraphId(555, 0, 5), EdgeSet::kPermanent, 1, small_tile);
+  edgestatus.Set(GraphId(555, 2, 5), EdgeSet::kTemporary, 2, small_tile);
+  edgestatus.Set(GraphId(555, 2, 5), EdgeSet::kPermanent, 3, small_tile, 7);
+  edgestatus.Set(GraphId(1000000, 2, 9), EdgeSet::kTemporary, 4, small_tile);
+  EXPECT_EQ(edgestatus.Get(GraphId(555, 0, 5)).index(), 1u);
+  EXPECT_EQ(edgestatus.Get(GraphId(555, 2, 5)).index(), 2u);
+  EXPECT_EQ(edgestatus.Get(GraphId(555, 2, 5), 7).index(), 3u);
+  EXPECT_EQ(edgestatus.Get(GraphId(1000000, 2, 9)).index(), 4u);
+  TryGet(edgestatus, GraphId(555, 1, 5), EdgeSet::kUnreachedOrReset);
+  TryGet(edgestatus, GraphId(556, 2, 5), EdgeSet::kUnreachedOrReset);
+  EXPECT_EQ(edgestatus.Get(GraphId(555, 2, 5), 6).set(), EdgeSet::kUnreachedOrReset);
+
+  // Updating an edge whose tile was never set is an error
+  edgestatus.Update(GraphId(555, 2, 5), EdgeSet::kPermanent);
+  TryGet(edgestatus, GraphId(555, 2, 5), EdgeSet::kPermanent);
+  EXPECT_THROW(edgestatus.Update(GraphId(556, 2, 5), EdgeSet::kPermanent), std::runtime_error);
+
+  // After clearing the pooled arrays are reused and must come back unreached
+  edgestatus.clear();
+  EXPECT_THROW(edgestatus.Update(GraphId(555, 2, 5), EdgeSet::kPermanent), std::runtime_error);
+  edgestatus.Set(GraphId(777, 2, 999), EdgeSet::kTemporary, 5, big_tile);
+  edgestatus.Set(GraphId(778, 2, 0), EdgeSet::kTemporary, 6, small_tile);
+  EXPECT_EQ(edgestatus.Get(GraphId(777, 2, 999)).index(), 5u);
+  TryGet(edgestatus, GraphId(777, 2, 5), EdgeSet::kUnreachedOrReset);
+  TryGet(edgestatus, GraphId(778, 2, 5), EdgeSet::kUnreachedOrReset);
+  TryGet(edgestatus, GraphId(555, 0, 5), EdgeSet::kUnreachedOrReset);
+  TryGet(edgestatus, GraphId(555, 2, 5), EdgeSet::kUnreachedOrReset);
+  EXPECT_EQ(edgestatus.Get(GraphId(555, 2, 5), 7).set(), EdgeSet::kUnreachedOrReset);
+
+  // Pointers stay valid while other tiles get added
+  EdgeStatusInfo* ptr = edgestatus.GetPtr(GraphId(777, 2, 0), big_tile);
+  for (uint32_t i = 0; i < 300; ++i) {
+    edgestatus.Set(GraphId(i * 100, 1, 0), EdgeSet::kTemporary, i, small_tile);
+  }
+  EXPECT_EQ(ptr, edgestatus.GetPtr(GraphId(777, 2, 0), big_tile));
+  EXPECT_EQ(ptr[999].index(), 5u);
+}
+
+TEST(EdgeStatus, TestPoolIsCappedAndKept) {
+  EdgeStatus edgestatus;
+
+  GraphTileHeader small_header;
+  small_header.set_directededgecount(10);
+  test_tile* small_tt = new test_tile;
+  small_tt->header_ = &small_header;
+  graph_tile_ptr small_tile = small_tt;
+
+  GraphTileHeader huge_header;
+  huge_header.set_directededgecount(2000000);
+  test_tile* huge_tt = new test_tile;
+  huge_tt->header_ = &huge_header;
+  graph_tile_ptr huge_tile = huge_tt;
+
+  // A huge search only leaves up to the cap in the pool
+  for (uint32_t i = 0; i < 3; ++i) {
+    edgestatus.Set(GraphId(i, 2, 0), EdgeSet::kTemporary, i, huge_tile);
+  }
+  EXPECT_EQ(edgestatus.capacity(), 6000000u);
+  edgestatus.clear();
+  EXPECT_LE(edgestatus.capacity(), EdgeStatus::kMaxPooledStatuses);
+  EXPECT_GT(edgestatus.capacity(), 0u);
+
+  // The pool survives a small search and clearing it over and over, which is what the algorithms
+  // do since they clear both when they are done and when they start
+  const auto pooled = edgestatus.capacity();
+  edgestatus.Set(GraphId(0, 2, 0), EdgeSet::kTemporary, 0, small_tile);
+  edgestatus.clear();
+  EXPECT_EQ(edgestatus.capacity(), pooled);
+  edgestatus.clear();
+  edgestatus.clear();
+  EXPECT_EQ(edgestatus.capacity(), pooled);
+  TryGet(edgestatus, GraphId(0, 2, 0), EdgeSet::kUnreachedOrReset);
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -6,12 +6,15 @@
 #include "mjolnir/bssbuilder.h"
 #include "mjolnir/graphbuilder.h"
 #include "mjolnir/osmnode.h"
+#include "mjolnir/osmpbfparser.h"
 #include "mjolnir/pbfgraphparser.h"
 #include "test.h"
 
 #include <boost/property_tree/ptree.hpp>
 #include <cstdint>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
 
 #include "baldr/directededge.h"
 #include "baldr/graphconstants.h"
@@ -790,6 +793,56 @@ TEST(GraphParser, TestImportBssNode) {
   filesystem::remove(bss_nodes_file);
 }
 
+// Writes down every callback so that parses can be compared
+struct recording_callback : public OSMPBF::Callback {
+  void node_callback(const uint64_t osmid,
+                     const double lng,
+                     const double lat,
+                     const OSMPBF::Tags& tags) override {
+    std::ostringstream ss;
+    ss << std::setprecision(17) << "n" << osmid << " " << lng << " " << lat << " " << tags.size();
+    calls.push_back(ss.str());
+  }
+  void way_callback(const uint64_t osmid,
+                    const OSMPBF::Tags& tags,
+                    const std::vector<uint64_t>& nodes) override {
+    calls.push_back("w" + std::to_string(osmid) + " " + std::to_string(tags.size()) + " " +
+                    std::to_string(nodes.size()) + " " + std::to_string(nodes.back()));
+  }
+  void relation_callback(const uint64_t osmid,
+                         const OSMPBF::Tags& tags,
+                         const std::vector<OSMPBF::Member>& members) override {
+    calls.push_back("r" + std::to_string(osmid) + " " + std::to_string(tags.size()) + " " +
+                    std::to_string(members.size()));
+    for (const auto& member : members) {
+      calls.back() += " " + std::to_string(member.member_id) + member.role;
+    }
+  }
+  void changeset_callback(const uint64_t changeset_id) override {
+    calls.push_back("c" + std::to_string(changeset_id));
+  }
+  std::vector<std::string> calls;
+};
+
+TEST(GraphParser, TestParallelParse) {
+  // decoding the blobs on several threads must not change the callbacks nor their order
+  std::ifstream file(VALHALLA_SOURCE_DIR "test/data/liechtenstein-latest.osm.pbf",
+                     std::ios::binary);
+  ASSERT_TRUE(file.is_open());
+  auto interest = static_cast<OSMPBF::Interest>(OSMPBF::Interest::NODES | OSMPBF::Interest::WAYS |
+                                                OSMPBF::Interest::RELATIONS |
+                                                OSMPBF::Interest::CHANGESETS);
+  recording_callback serial;
+  OSMPBF::Parser::parse(file, interest, serial);
+  ASSERT_FALSE(serial.calls.empty());
+  for (unsigned int threads : {2, 5}) {
+    recording_callback parallel;
+    OSMPBF::Parser::parse(file, interest, parallel, threads);
+    ASSERT_EQ(parallel.calls.size(), serial.calls.size());
+    EXPECT_TRUE(parallel.calls == serial.calls) << threads << " threads changed the callbacks";
+  }
+}
+
 } // namespace
 
 class GraphParserEnv : public ::testing::Environment {
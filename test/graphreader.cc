@@ -6,6 +6,7 @@
 #include "filesystem.h"
 
 #include <fcntl.h>
+#include <thread>
 
 #include "test.h"
 
@@ -876,6 +877,149 @@ TEST(CacheLruSoft, TrimOnExactlyFullCache) {
   CheckGraphTile(cache.Get(tile2_id), tile2_id, tile2_size);
 }
 
+TEST(ConcurrentCache, PutGetClear) {
+  ConcurrentTileCache cache(4000, 4);
+
+  GraphId id1(100, 2, 0);
+  auto tile1 = cache.Put(id1, new TestGraphTile(id1, 123), 123);
+  EXPECT_EQ(cache.Get(id1), tile1);
+  CheckGraphTile(tile1, id1, 123);
+
+  GraphId id2(300, 1, 0);
+  auto tile2 = cache.Put(id2, new TestGraphTile(id2, 200), 200);
+  EXPECT_EQ(cache.Get(id2), tile2);
+  CheckGraphTile(tile2, id2, 200);
+
+  // a racing put of the same tile hands back the one that is already cached
+  auto again = cache.Put(id1, new TestGraphTile(id1, 123), 123);
+  EXPECT_EQ(again, tile1);
+
+  EXPECT_TRUE(cache.Contains(id1));
+  EXPECT_TRUE(cache.Contains(id2));
+  EXPECT_FALSE(cache.Contains({101, 2, 0}));
+  EXPECT_EQ(cache.Get({101, 2, 0}), nullptr);
+  EXPECT_FALSE(cache.OverCommitted());
+
+  cache.Clear();
+  EXPECT_FALSE(cache.Contains(id1));
+  EXPECT_FALSE(cache.Contains(id2));
+  EXPECT_EQ(cache.Get(id1), nullptr);
+  EXPECT_EQ(cache.Get(id2), nullptr);
+
+  // tiles handed out before the clear are still alive
+  CheckGraphTile(tile1, id1, 123);
+  CheckGraphTile(tile2, id2, 200);
+}
+
+TEST(ConcurrentCache, EvictionStaysBounded) {
+  ConcurrentTileCache cache(1000, 1);
+
+  std::vector<GraphId> ids;
+  for (uint32_t i = 0; i < 4; ++i) {
+    ids.emplace_back(i, 2, 0);
+    cache.Put(ids.back(), new TestGraphTile(ids.back(), 300), 300);
+    EXPECT_FALSE(cache.OverCommitted());
+  }
+  // only 3 of them fit and the first one was the oldest
+  EXPECT_FALSE(cache.Contains(ids[0]));
+  EXPECT_TRUE(cache.Contains(ids[1]));
+  EXPECT_TRUE(cache.Contains(ids[2]));
+  EXPECT_TRUE(cache.Contains(ids[3]));
+
+  // using a tile gives it a second chance so the next eviction skips it
+  CheckGraphTile(cache.Get(ids[1]), ids[1], 300);
+  GraphId id4(4, 2, 0);
+  cache.Put(id4, new TestGraphTile(id4, 300), 300);
+  EXPECT_TRUE(cache.Contains(ids[1]));
+  EXPECT_FALSE(cache.Contains(ids[2]));
+  EXPECT_TRUE(cache.Contains(ids[3]));
+  EXPECT_TRUE(cache.Contains(id4));
+  EXPECT_FALSE(cache.OverCommitted());
+
+  cache.Trim();
+  EXPECT_FALSE(cache.OverCommitted());
+  EXPECT_TRUE(cache.Contains(id4));
+}
+
+#ifdef ENABLE_THREAD_SAFE_TILE_REF_COUNT
+TEST(ConcurrentCache, ManyThreads) {
+  ConcurrentTileCache cache(50 * 100, 8);
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < 8; ++t) {
+    threads.emplace_back([&cache, t]() {
+      for (uint32_t i = 0; i < 10000; ++i) {
+        GraphId id((i * 7 + t) % 200, 2, 0);
+        auto tile = cache.Get(id);
+        if (!tile) {
+          tile = cache.Put(id, new TestGraphTile(id, 100), 100);
+        }
+        ASSERT_EQ(tile->header()->graphid(), id);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_FALSE(cache.OverCommitted());
+}
+
+TEST(TilePrefetcher, PrefetchedTilesAreHits) {
+  boost::property_tree::ptree pt;
+  pt.put("tile_dir", "test/data/utrecht_tiles");
+  pt.put("use_concurrent_mem_cache", true);
+  pt.put("prefetch_threads", 2);
+  GraphReader reader(pt);
+
+  // queue the tiles under utrecht at all levels and wait for them to be loaded
+  const valhalla::midgard::PointLL utrecht{5.1079374, 52.0887174};
+  reader.Prefetch(utrecht);
+  for (int i = 0; i < 100 && reader.GetPrefetchStats().loaded < TileHierarchy::levels().size();
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  auto stats = reader.GetPrefetchStats();
+  EXPECT_EQ(stats.requested, TileHierarchy::levels().size());
+  EXPECT_EQ(stats.loaded, TileHierarchy::levels().size());
+
+  // now the search finds them in the cache
+  for (const auto& level : TileHierarchy::levels()) {
+    EXPECT_NE(reader.GetGraphTile(utrecht, level.level), nullptr);
+  }
+  stats = reader.GetPrefetchStats();
+  EXPECT_EQ(stats.hits, TileHierarchy::levels().size());
+  EXPECT_EQ(stats.late, 0u);
+  EXPECT_EQ(stats.misses, 0u);
+}
+
+TEST(TilePrefetcher, MissingTilesAreNotRequestedAgain) {
+  boost::property_tree::ptree pt;
+  pt.put("tile_dir", "test/data/utrecht_tiles");
+  pt.put("use_concurrent_mem_cache", true);
+  pt.put("prefetch_threads", 2);
+  GraphReader reader(pt);
+  auto before = reader.GetPrefetchStats();
+
+  // there are no tiles in the middle of the atlantic
+  const valhalla::midgard::PointLL ocean{-30.5, 30.5};
+  reader.Prefetch(ocean);
+  for (int i = 0; i < 100 && reader.GetPrefetchStats().missing - before.missing <
+                                 TileHierarchy::levels().size();
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  auto stats = reader.GetPrefetchStats();
+  EXPECT_EQ(stats.missing - before.missing, TileHierarchy::levels().size());
+
+  // asking again or missing them in a search does not queue them or their neighbors
+  reader.Prefetch(ocean);
+  for (const auto& level : TileHierarchy::levels()) {
+    EXPECT_EQ(reader.GetGraphTile(ocean, level.level), nullptr);
+  }
+  EXPECT_EQ(reader.GetPrefetchStats().requested, stats.requested);
+}
+#endif
+
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -0,0 +1,179 @@
+#include "test.h"
+
+#include "tyr/http_server.h"
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace valhalla;
+
+namespace {
+
+const auto conf = test::make_config("test/data/utrecht_tiles",
+                                    {{"httpd.service.idle_timeout", "2"},
+                                     {"httpd.service.read_timeout", "1"}});
+
+// A locate request with its json in the query string
+const std::string locate =
+    "GET /locate?json=%7B%22locations%22%3A%5B%7B%22lat%22%3A52.09110%2C%22lon%22%3A5.09806%7D"
+    "%5D%2C%22costing%22%3A%22auto%22%7D";
+
+// Sends the requests all at once and reads until the server hangs up
+std::string exchange(const uint16_t port, const std::string& requests, const bool hang_up = false) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    close(fd);
+    return "";
+  }
+  send(fd, requests.data(), requests.size(), MSG_NOSIGNAL);
+  if (hang_up) {
+    shutdown(fd, SHUT_WR);
+  }
+  std::string responses;
+  char buffer[4096];
+  ssize_t received;
+  while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+    responses.append(buffer, received);
+  }
+  close(fd);
+  return responses;
+}
+
+// Splits the responses into their status lines and bodies
+std::vector<std::pair<std::string, std::string>> split(const std::string& responses) {
+  std::vector<std::pair<std::string, std::string>> split;
+  size_t pos = 0;
+  while (pos < responses.size()) {
+    auto status_end = responses.find("\r\n", pos);
+    auto headers_end = responses.find("\r\n\r\n", pos);
+    auto length = responses.find("Content-Length: ", pos);
+    if (status_end == std::string::npos || headers_end == std::string::npos ||
+        length > headers_end) {
+      break;
+    }
+    auto body_size = std::stoul(responses.substr(length + 16));
+    split.emplace_back(responses.substr(pos, status_end - pos),
+                       responses.substr(headers_end + 4, body_size));
+    pos = headers_end + 4 + body_size;
+  }
+  return split;
+}
+
+class HttpServer : public ::testing::Test {
+protected:
+  void SetUp() override {
+    server.reset(new tyr::http_server_t(conf, "tcp://127.0.0.1:0", 2));
+    thread = std::thread([this]() { server->serve(); });
+  }
+
+  void TearDown() override {
+    server->stop();
+    thread.join();
+  }
+
+  std::unique_ptr<tyr::http_server_t> server;
+  std::thread thread;
+};
+
+TEST_F(HttpServer, pipelined) {
+  const std::string route = R"({"locations":[{"lat":52.09110,"lon":5.09806},
+    {"lat":52.09098,"lon":5.09679}],"costing":"auto"})";
+  const std::string requests =
+      locate + " HTTP/1.1\r\nHost: localhost\r\n\r\n" + "POST /route HTTP/1.1\r\nContent-Length: " +
+      std::to_string(route.size()) + "\r\n\r\n" + route +
+      "POST /route HTTP/1.1\r\nContent-Length: 5\r\n\r\n{bad}"
+      "GET /bogus HTTP/1.1\r\n\r\n" +
+      locate + " HTTP/1.1\r\nConnection: close\r\n\r\n";
+
+  auto responses = split(exchange(server->port(), requests));
+  ASSERT_EQ(responses.size(), 5);
+
+  // they come back in the order they were asked
+  EXPECT_EQ(responses[0].first, "HTTP/1.1 200 OK");
+  auto candidates = test::json_to_pt(responses[0].second);
+  EXPECT_FALSE(candidates.front().second.get_child("edges").empty());
+
+  EXPECT_EQ(responses[1].first, "HTTP/1.1 200 OK");
+  auto directions = test::json_to_pt(responses[1].second);
+  EXPECT_GT(directions.get<float>("trip.summary.length"), 0.f);
+
+  EXPECT_EQ(responses[2].first, "HTTP/1.1 400 Bad Request");
+  EXPECT_EQ(test::json_to_pt(responses[2].second).get<int>("error_code"), 100);
+
+  EXPECT_EQ(responses[3].first, "HTTP/1.1 404 Not Found");
+  EXPECT_EQ(test::json_to_pt(responses[3].second).get<int>("error_code"), 106);
+
+  EXPECT_EQ(responses[4].first, "HTTP/1.1 200 OK");
+}
+
+TEST_F(HttpServer, malformed) {
+  auto responses = split(exchange(server->port(), "nonsense\r\n\r\n"));
+  ASSERT_EQ(responses.size(), 1);
+  EXPECT_EQ(responses[0].first, "HTTP/1.1 400 Bad Request");
+
+  responses = split(
+      exchange(server->port(), "POST /route HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"));
+  ASSERT_EQ(responses.size(), 1);
+  EXPECT_EQ(responses[0].first, "HTTP/1.1 501 Not Implemented");
+
+  responses = split(exchange(server->port(), "POST /route HTTP/1.1\r\nContent-Length: " +
+                                                 std::to_string(tyr::kDefaultMaxRequestSize) +
+                                                 "\r\n\r\n"));
+  ASSERT_EQ(responses.size(), 1);
+  EXPECT_EQ(responses[0].first, "HTTP/1.1 413 Payload Too Large");
+}
+
+TEST_F(HttpServer, hang_up) {
+  // the last request is still answered when the client stops sending
+  auto responses =
+      split(exchange(server->port(), locate + " HTTP/1.1\r\n\r\n" + locate + " HTTP/1.1\r\n\r\n",
+                     true));
+  ASSERT_EQ(responses.size(), 2);
+  EXPECT_EQ(responses[1].first, "HTTP/1.1 200 OK");
+
+  // http 1.0 closes after every request unless asked otherwise
+  responses = split(exchange(server->port(), locate + " HTTP/1.0\r\n\r\n"));
+  ASSERT_EQ(responses.size(), 1);
+  EXPECT_EQ(responses[0].first, "HTTP/1.1 200 OK");
+}
+
+TEST_F(HttpServer, timeouts) {
+  // a client that starts a request but never finishes it is told so
+  auto start = std::chrono::steady_clock::now();
+  auto responses =
+      split(exchange(server->port(), "POST /route HTTP/1.1\r\nContent-Length: 10\r\n"));
+  ASSERT_EQ(responses.size(), 1);
+  EXPECT_EQ(responses[0].first, "HTTP/1.1 408 Request Timeout");
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+
+  // a kept alive connection is hung up on once it sits idle
+  start = std::chrono::steady_clock::now();
+  responses = split(exchange(server->port(), locate + " HTTP/1.1\r\n\r\n"));
+  ASSERT_EQ(responses.size(), 1);
+  EXPECT_EQ(responses[0].first, "HTTP/1.1 200 OK");
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+}
+
+TEST(HttpServerFailure, worker_fails) {
+  // workers that cannot start take the whole server down instead of leaving their sockets bound
+  auto config = conf;
+  config.get_child("loki.actions").push_back({"", boost::property_tree::ptree("bogus")});
+  tyr::http_server_t server(config, "tcp://127.0.0.1:0", 2);
+  EXPECT_THROW(server.serve(), std::runtime_error);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
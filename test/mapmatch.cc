@@ -6,6 +6,8 @@
 
 #include "baldr/json.h"
 #include "loki/worker.h"
+#include "meili/map_matcher_factory.h"
+#include "meili/transition_cache.h"
 #include "midgard/distanceapproximator.h"
 #include "midgard/encoded.h"
 #include "midgard/logging.h"
@@ -1463,6 +1465,376 @@ TEST(Mapmatch, openlr_parameter_falsy_native_api) {
     EXPECT_THROW(response.get_child("trip.linear_references"), std::runtime_error);
   }
 }
+
+TEST(Mapmatch, trace_attributes_batch) {
+  // match the traces on additional threads too, some of them twice so that routes are shared
+  const auto batch_conf = test::make_config("test/data/utrecht_tiles",
+                                            {
+                                                {"meili.default.max_search_radius", "200"},
+                                                {"meili.default.search_radius", "15.0"},
+                                                {"meili.default.turn_penalty_factor", "200"},
+                                                {"thor.trace_batch_threads", "2"},
+                                            });
+  const std::vector<std::string> shapes = {
+      R"([{"lat":52.0930211,"lon":5.0865867},{"lat":52.0938563,"lon":5.08531221}])",
+      R"([{"lat":52.0938563,"lon":5.08531221},{"lat":52.0930211,"lon":5.0865867}])",
+      R"([{"lat":52.09110,"lon":5.09806},{"lat":52.09098,"lon":5.09679}])",
+      R"([{"lat":52.0930211,"lon":5.0865867},{"lat":52.0938563,"lon":5.08531221}])",
+      R"([{"lat":52.09110,"lon":5.09806}])",
+  };
+  std::string traces;
+  for (const auto& shape : shapes) {
+    traces += (traces.empty() ? "" : ",") + std::string(R"({"shape":)") + shape + "}";
+  }
+  tyr::actor_t actor(batch_conf, true);
+  auto batch = test::json_to_pt(actor.trace_attributes_batch(
+      R"({"costing":"auto","shape_match":"map_snap","traces":[)" + traces + "]}"));
+  const auto& results = batch.get_child("trace_attributes");
+  ASSERT_EQ(results.size(), shapes.size());
+
+  // every trace matches like it does on its own
+  auto result = results.begin();
+  for (const auto& shape : shapes) {
+    const auto request = R"({"costing":"auto","shape_match":"map_snap","shape":)" + shape + "}";
+    boost::property_tree::ptree single;
+    try {
+      single = test::json_to_pt(actor.trace_attributes(request));
+    } catch (const valhalla_exception_t& e) {
+      // a trace that fails does so on its own without failing the batch
+      EXPECT_EQ(e.code, 123);
+      EXPECT_EQ(result->second.get<unsigned>("error_code"), e.code);
+      ++result;
+      continue;
+    }
+    std::vector<uint64_t> expected, actual;
+    for (const auto& edge : single.get_child("edges")) {
+      expected.push_back(edge.second.get<uint64_t>("way_id"));
+    }
+    for (const auto& edge : result->second.get_child("edges")) {
+      actual.push_back(edge.second.get<uint64_t>("way_id"));
+    }
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(expected, actual);
+    ++result;
+  }
+
+  // the batch itself has to have traces
+  try {
+    actor.trace_attributes_batch(R"({"costing":"auto","traces":[]})");
+    FAIL() << "Expected an empty batch to be rejected";
+  } catch (const valhalla_exception_t& e) { EXPECT_EQ(e.code, 115); }
+}
+
+TEST(Mapmatch, trace_attributes_batch_overlapping) {
+  // traces along parts of the same route, some of them moved a few meters off it, so that their
+  // points are near each other on the same edges without being the same
+  const auto batch_conf = test::make_config("test/data/utrecht_tiles",
+                                            {
+                                                {"meili.default.max_search_radius", "200"},
+                                                {"meili.default.search_radius", "15.0"},
+                                                {"meili.default.turn_penalty_factor", "200"},
+                                                {"thor.trace_batch_threads", "3"},
+                                            });
+  tyr::actor_t actor(batch_conf, true);
+  auto route = test::json_to_pt(actor.route(R"({"costing":"auto","locations":[
+      {"lat":52.096672,"lon":5.110825},{"lat":52.081371,"lon":5.125671}]})"));
+  auto shape = midgard::decode<std::vector<PointLL>>(
+      route.get_child("trip.legs").front().second.get<std::string>("shape"));
+  shape = midgard::resample_spherical_polyline(shape, 25);
+  ASSERT_GT(shape.size(), 40);
+  std::vector<std::string> shapes;
+  for (size_t start = 0; start + 20 <= shape.size() && shapes.size() < 12; start += 5) {
+    std::vector<PointLL> points(shape.begin() + start, shape.begin() + start + 20);
+    for (auto& point : points) {
+      point.first += (shapes.size() % 3) * 0.00002;
+      point.second -= (shapes.size() % 4) * 0.00001;
+    }
+    shapes.push_back(to_locations(points, std::vector<float>(points.size(), 5.f)));
+  }
+  std::string traces;
+  for (const auto& shape : shapes) {
+    traces += (traces.empty() ? "" : ",") + std::string(R"({"shape":)") + shape + "}";
+  }
+  auto batch = test::json_to_pt(actor.trace_attributes_batch(
+      R"({"costing":"auto","shape_match":"map_snap","traces":[)" + traces + "]}"));
+  const auto& results = batch.get_child("trace_attributes");
+  ASSERT_EQ(results.size(), shapes.size());
+
+  // every trace matches exactly like it does on its own, whichever thread routed what first
+  auto result = results.begin();
+  for (const auto& shape : shapes) {
+    const auto single = test::json_to_pt(actor.trace_attributes(
+        R"({"costing":"auto","shape_match":"map_snap","shape":)" + shape + "}"));
+    EXPECT_FALSE(single.get_child("edges").empty());
+    EXPECT_TRUE(single.get_child("edges") == result->second.get_child("edges"));
+    EXPECT_TRUE(single.get_child("matched_points") == result->second.get_child("matched_points"));
+    ++result;
+  }
+}
+
+TEST(Mapmatch, column_routes) {
+  // candidates every 25 meters along a route
+  tyr::actor_t actor(conf, true);
+  auto route = test::json_to_pt(actor.route(R"({"costing":"auto","locations":[
+      {"lat":52.096672,"lon":5.110825},{"lat":52.081371,"lon":5.125671}]})"));
+  auto shape = midgard::decode<std::vector<PointLL>>(
+      route.get_child("trip.legs").front().second.get<std::string>("shape"));
+  shape = midgard::resample_spherical_polyline(shape, 25);
+  Api request;
+  ParseApi(R"({"costing":"auto"})", Options::trace_attributes, request);
+  meili::MapMatcherFactory factory(conf);
+  std::unique_ptr<meili::MapMatcher> matcher(factory.Create(request.options()));
+  const auto radius = matcher->config().candidate_search.search_radius_meters;
+  const auto costing = matcher->costing();
+  float turn_costs[181] = {0.f};
+  for (int i = 0; i <= 180; ++i) {
+    turn_costs[i] = 100.f * std::exp(-i / 45.f);
+  }
+
+  // routing from all the candidates of a column at once finds exactly what routing from each does
+  size_t compared = 0;
+  for (size_t i = 0; i + 1 < shape.size() && i < 20; ++i) {
+    const auto origins = matcher->candidatequery().Query(shape[i], baldr::Location::StopType::BREAK,
+                                                         radius * radius, costing);
+    const auto destinations =
+        matcher->candidatequery().Query(shape[i + 1], baldr::Location::StopType::BREAK,
+                                        radius * radius, costing);
+    const midgard::DistanceApproximator<PointLL> approximator(shape[i + 1]);
+    const std::vector<const meili::Label*> edgelabels(origins.size(), nullptr);
+    const auto routes =
+        meili::find_shortest_paths(matcher->graphreader(), origins, edgelabels, destinations,
+                                   approximator, radius, costing, turn_costs, 1000.f, -1.f);
+    ASSERT_EQ(routes.size(), origins.size());
+    for (size_t o = 0; o < origins.size(); ++o) {
+      std::vector<baldr::PathLocation> locations{origins[o]};
+      locations.insert(locations.end(), destinations.begin(), destinations.end());
+      auto labelset = std::make_shared<meili::LabelSet>(1000.f);
+      const auto results =
+          meili::find_shortest_path(matcher->graphreader(), locations, 0, labelset, approximator,
+                                    radius, costing, nullptr, turn_costs, 1000.f, -1.f);
+      ASSERT_EQ(routes[o].results.size(), results.size());
+      for (const auto& result : results) {
+        const auto found = routes[o].results.find(result.first);
+        ASSERT_NE(found, routes[o].results.end());
+        meili::RoutePathIterator expected(labelset.get(), result.second), end(labelset.get());
+        meili::RoutePathIterator actual(routes[o].labelset.get(), found->second),
+            actual_end(routes[o].labelset.get());
+        for (; expected != end && actual != actual_end; ++expected, ++actual) {
+          EXPECT_EQ(actual->edgeid(), expected->edgeid());
+          EXPECT_EQ(actual->cost().cost, expected->cost().cost);
+          EXPECT_EQ(actual->turn_cost(), expected->turn_cost());
+        }
+        EXPECT_TRUE(expected == end && actual == actual_end) << "paths differ in length";
+        ++compared;
+      }
+    }
+  }
+  EXPECT_GT(compared, 20);
+}
+
+TEST(Mapmatch, transition_cache) {
+  // a route from 0.2 along edge a over its end node to 0.5 along edge b
+  const baldr::GraphId a(1, 0, 0), b(1, 0, 1), c(1, 0, 2);
+  const auto mode = static_cast<sif::TravelMode>(0);
+  baldr::DirectedEdge de;
+  meili::ColumnRoute route{{}, std::make_shared<meili::LabelSet>(1000.f)};
+  route.labelset->put(0, mode, nullptr);
+  route.labelset->put(baldr::GraphId(1, 0, 9), a, 0.2f, 1.f, {80.f, 8.f}, 0.f, 0.f, 0, &de, mode,
+                      -1);
+  route.labelset->put(1, b, 0.f, 0.5f, {130.f, 13.f}, 0.f, 0.f, 1, &de, mode, -1);
+  route.results = {{0, 0}, {1, 2}};
+  auto location = [](const baldr::GraphId& edge, const double percent) {
+    baldr::PathLocation location(baldr::Location({5.1, 52.1}));
+    location.edges.emplace_back(edge, percent, PointLL{5.1, 52.1}, 0);
+    return location;
+  };
+  auto transition = [&](const Costing costing, const meili::Label* edgelabel,
+                        const baldr::PathLocation& origin,
+                        const baldr::PathLocation& destination, const float max_distance) {
+    return meili::TransitionCache::Transition(costing, edgelabel, origin, {destination},
+                                              {5.1, 52.1}, 15.f, max_distance, -1.f);
+  };
+  meili::TransitionCache cache;
+  cache.Insert(transition(Costing::auto_, nullptr, location(a, 0.2), location(b, 0.5), 1000.f),
+               route);
+  EXPECT_EQ(cache.size(), 1);
+
+  // the very same transition gets the route back
+  const auto found =
+      cache.Find(transition(Costing::auto_, nullptr, location(a, 0.2), location(b, 0.5), 1000.f));
+  ASSERT_NE(found, nullptr);
+  EXPECT_EQ(found->results, route.results);
+  EXPECT_EQ(found->labelset, route.labelset);
+
+  // but not from elsewhere along the same edges, the best route there may be another one
+  EXPECT_EQ(
+      cache.Find(transition(Costing::auto_, nullptr, location(a, 0.6), location(b, 0.5), 1000.f)),
+      nullptr);
+  EXPECT_EQ(
+      cache.Find(transition(Costing::auto_, nullptr, location(a, 0.2), location(b, 0.8), 1000.f)),
+      nullptr);
+
+  // nor with another costing, other edges, other limits or another label leading into the origin
+  EXPECT_EQ(cache.Find(transition(Costing::pedestrian, nullptr, location(a, 0.2), location(b, 0.5),
+                                  1000.f)),
+            nullptr);
+  EXPECT_EQ(
+      cache.Find(transition(Costing::auto_, nullptr, location(a, 0.2), location(c, 0.5), 1000.f)),
+      nullptr);
+  EXPECT_EQ(
+      cache.Find(transition(Costing::auto_, nullptr, location(a, 0.2), location(b, 0.5), 900.f)),
+      nullptr);
+  const auto& edgelabel = route.labelset->label(1);
+  EXPECT_EQ(cache.Find(transition(Costing::auto_, &edgelabel, location(a, 0.2), location(b, 0.5),
+                                  1000.f)),
+            nullptr);
+
+  // the cache starts over when it is full
+  meili::TransitionCache small(1);
+  small.Insert(transition(Costing::auto_, nullptr, location(a, 0.2), location(b, 0.5), 1000.f),
+               route);
+  small.Insert(transition(Costing::auto_, nullptr, location(a, 0.2), location(c, 0.5), 1000.f),
+               route);
+  EXPECT_EQ(small.size(), 1);
+}
+
+TEST(Mapmatch, online_match) {
+  // a trace with a timed point every 25 meters along a route
+  tyr::actor_t actor(conf, true);
+  auto route = test::json_to_pt(actor.route(R"({"costing":"auto","locations":[
+      {"lat":52.096672,"lon":5.110825},{"lat":52.081371,"lon":5.125671}]})"));
+  auto shape = midgard::decode<std::vector<PointLL>>(
+      route.get_child("trip.legs").front().second.get<std::string>("shape"));
+  shape = midgard::resample_spherical_polyline(shape, 25);
+  const std::vector<float> accuracies(shape.size(), 5.f);
+  Api request;
+  ParseApi(R"({"costing":"auto","shape_match":"map_snap","shape":)" +
+               to_locations(shape, accuracies, 5) + "}",
+           Options::trace_attributes, request);
+  meili::MapMatcherFactory factory(conf);
+  std::unique_ptr<meili::MapMatcher> matcher(factory.Create(request.options()));
+  std::vector<meili::Measurement> measurements;
+  for (const auto& pt : request.options().shape()) {
+    measurements.emplace_back(PointLL{pt.ll().lng(), pt.ll().lat()}, pt.accuracy(),
+                              matcher->config().candidate_search.search_radius_meters, pt.time());
+  }
+  auto add_edges = [](const std::vector<meili::EdgeSegment>& segments,
+                      std::vector<uint64_t>& edges) {
+    for (const auto& segment : segments) {
+      if (edges.empty() || edges.back() != segment.edgeid) {
+        edges.push_back(segment.edgeid);
+      }
+    }
+  };
+  std::vector<uint64_t> offline_edges;
+  add_edges(matcher->OfflineMatch(measurements).front().segments, offline_edges);
+
+  // push the points one at a time
+  std::vector<meili::MatchResult> results;
+  std::vector<uint64_t> online_edges;
+  size_t window = 0;
+  for (const auto& measurement : measurements) {
+    auto committed = matcher->OnlineMatch(measurement);
+    results.insert(results.end(), committed.results.begin(), committed.results.end());
+    add_edges(committed.segments, online_edges);
+    window = std::max<size_t>(window, matcher->state_container().size());
+  }
+  auto committed = matcher->FinishOnlineMatch();
+  results.insert(results.end(), committed.results.begin(), committed.results.end());
+  add_edges(committed.segments, online_edges);
+  EXPECT_EQ(matcher->state_container().size(), 0);
+
+  // every point comes back once and in order while the matcher only ever holds a window of them
+  ASSERT_EQ(results.size(), measurements.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_EQ(results[i].epoch_time, measurements[i].epoch_time());
+  }
+  EXPECT_LE(window, matcher->config().routing.max_online_lag);
+  EXPECT_LT(window, measurements.size());
+
+  // and the path is the one matching the whole trace at once finds
+  EXPECT_FALSE(offline_edges.empty());
+  EXPECT_EQ(online_edges, offline_edges);
+
+  // the service does the same a few points at a time, the session remembers the options
+  std::string session;
+  size_t matched_points = 0;
+  for (size_t i = 0; i < shape.size(); i += 10) {
+    const std::vector<PointLL> points(shape.begin() + i,
+                                      shape.begin() + std::min(i + 10, shape.size()));
+    const auto locations = to_locations(points, accuracies, 5, 8 * 60 * 60 + i * 5);
+    const bool finish = i + 10 >= shape.size();
+    auto response = test::json_to_pt(actor.online_match(
+        session.empty()
+            ? R"({"costing":"auto","shape":)" + locations + "}"
+            : R"({"session_id":")" + session + R"(","finish":)" + (finish ? "true" : "false") +
+                  R"(,"shape":)" + locations + "}"));
+    if (session.empty()) {
+      session = response.get<std::string>("session_id");
+      EXPECT_FALSE(session.empty());
+    }
+    EXPECT_EQ(response.get<std::string>("session_id"), session);
+    EXPECT_EQ(response.get<size_t>("first_matched_point_index"), matched_points);
+    matched_points += response.get_child("matched_points").size();
+  }
+  EXPECT_EQ(matched_points, shape.size());
+
+  // a finished session is gone
+  try {
+    actor.online_match(R"({"session_id":")" + session + R"(","finish":true})");
+    FAIL() << "Expected the finished session to be gone";
+  } catch (const valhalla_exception_t& e) { EXPECT_EQ(e.code, 446); }
+
+  // and one another process started is told apart
+  try {
+    actor.online_match(R"({"session_id":"another","finish":true})");
+    FAIL() << "Expected the session of another process to be unknown";
+  } catch (const valhalla_exception_t& e) {
+    EXPECT_EQ(e.code, 446);
+    EXPECT_NE(std::string(e.what()).find("another process"), std::string::npos);
+  }
+}
+
+TEST(Mapmatch, online_match_failure) {
+  // a trace with a point every 25 meters, farther apart than points are interpolated
+  tyr::actor_t actor(conf, true);
+  auto route = test::json_to_pt(actor.route(R"({"costing":"auto","locations":[
+      {"lat":52.096672,"lon":5.110825},{"lat":52.081371,"lon":5.125671}]})"));
+  auto shape = midgard::decode<std::vector<PointLL>>(
+      route.get_child("trip.legs").front().second.get<std::string>("shape"));
+  shape = midgard::resample_spherical_polyline(shape, 25);
+  ASSERT_GT(shape.size(), 60);
+  const std::vector<float> accuracies(shape.size(), 5.f);
+  auto locations = [&](const size_t begin, const size_t end) {
+    const std::vector<PointLL> points(shape.begin() + begin, shape.begin() + end);
+    return to_locations(points, accuracies, 5, 8 * 60 * 60 + begin * 5);
+  };
+  auto response = test::json_to_pt(
+      actor.online_match(R"({"costing":"auto","shape":)" + locations(0, 30) + "}"));
+  const auto session = response.get<std::string>("session_id");
+  size_t matched_points = response.get_child("matched_points").size();
+
+  // a request that is interrupted at its 26th point keeps the 25 before it in the session
+  size_t appended = 0;
+  const std::function<void()> interrupt = [&appended]() {
+    if (++appended > 25) {
+      throw std::runtime_error("interrupted");
+    }
+  };
+  EXPECT_THROW(actor.online_match(R"({"session_id":")" + session + R"(","shape":)" +
+                                      locations(30, 60) + "}",
+                                  &interrupt),
+               std::runtime_error);
+
+  // so the next request goes on from the point it failed at and nothing that became final is lost
+  response = test::json_to_pt(actor.online_match(R"({"session_id":")" + session +
+                                                 R"(","finish":true,"shape":)" +
+                                                 locations(55, shape.size()) + "}"));
+  EXPECT_EQ(response.get<size_t>("first_matched_point_index"), matched_points);
+  matched_points += response.get_child("matched_points").size();
+  EXPECT_EQ(matched_points, shape.size());
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
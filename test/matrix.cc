@@ -6,10 +6,13 @@
 
 #include "loki/worker.h"
 #include "midgard/logging.h"
+#include "mjolnir/chbuilder.h"
 #include "sif/dynamiccost.h"
+#include "thor/chmatrix.h"
 #include "thor/costmatrix.h"
 #include "thor/timedistancematrix.h"
 #include "thor/worker.h"
+#include "tyr/serializers.h"
 
 using namespace valhalla;
 using namespace valhalla::thor;
@@ -252,6 +255,201 @@ TEST(Matrix, test_matrix) {
   }
 }
 
+TEST(Matrix, test_matrix_threads) {
+  loki_worker_t loki_worker(config);
+
+  // Enough locations that the searches get expanded on the threads
+  std::string locations;
+  for (int i = 0; i < 12; ++i) {
+    locations += i ? "," : "";
+    locations += R"({"lat":)" + std::to_string(52.09 + i * 0.002) + R"(,"lon":)" +
+                 std::to_string(5.06 + (i * 7 % 12) * 0.004) + "}";
+  }
+  Api request;
+  ParseApi(R"({"sources":[)" + locations + R"(],"targets":[)" + locations +
+               R"(],"costing":"auto"})",
+           Options::sources_to_targets, request);
+  loki_worker.matrix(request);
+  adjust_scores(*request.mutable_options());
+
+  GraphReader reader(config.get_child("mjolnir"));
+
+  sif::mode_costing_t mode_costing;
+  mode_costing[0] = CreateSimpleCost(
+      request.options().costing_options(static_cast<int>(request.options().costing())));
+
+  CostMatrix serial_matrix;
+  auto expected =
+      serial_matrix.SourceToTarget(request.options().sources(), request.options().targets(),
+                                   reader, mode_costing, TravelMode::kDrive, 400000.0);
+
+  // The threaded expansion has to give the exact same answers, also when reused
+  auto threaded_config = config;
+  threaded_config.put("thor.costmatrix_threads", 3);
+  CostMatrix threaded_matrix(threaded_config);
+  for (int run = 0; run < 2; ++run) {
+    auto results =
+        threaded_matrix.SourceToTarget(request.options().sources(), request.options().targets(),
+                                       reader, mode_costing, TravelMode::kDrive, 400000.0);
+    ASSERT_EQ(results.size(), expected.size());
+    for (uint32_t i = 0; i < results.size(); ++i) {
+      EXPECT_EQ(results[i].dist, expected[i].dist) << "result " + std::to_string(i);
+      EXPECT_EQ(results[i].time, expected[i].time) << "result " + std::to_string(i);
+    }
+  }
+}
+
+TEST(Matrix, test_timedistancematrix_batched) {
+  loki_worker_t loki_worker(config);
+
+  Api request;
+  ParseApi(test_request, Options::sources_to_targets, request);
+  loki_worker.matrix(request);
+  adjust_scores(*request.mutable_options());
+
+  GraphReader reader(config.get_child("mjolnir"));
+
+  sif::mode_costing_t mode_costing;
+  mode_costing[0] = CreateSimpleCost(
+      request.options().costing_options(static_cast<int>(request.options().costing())));
+
+  // Batches that don't divide the sources evenly, forward and reverse, have to give the exact
+  // same answers as the searches one after the other
+  auto batched_config = config;
+  batched_config.put("thor.timedistancematrix_batch_size", 3);
+  TimeDistanceMatrix serial_matrix;
+  TimeDistanceMatrix batched_matrix(batched_config);
+  const auto& sources = request.options().sources();
+  const auto& targets = request.options().targets();
+  const google::protobuf::RepeatedPtrField<valhalla::Location>
+      fewer_targets(targets.begin(), targets.begin() + 2);
+  for (const auto* target_list : {&targets, &fewer_targets}) {
+    auto expected = serial_matrix.SourceToTarget(sources, *target_list, reader, mode_costing,
+                                                 TravelMode::kDrive, 400000.0);
+    auto results = batched_matrix.SourceToTarget(sources, *target_list, reader, mode_costing,
+                                                 TravelMode::kDrive, 400000.0);
+    ASSERT_EQ(results.size(), expected.size());
+    for (uint32_t i = 0; i < results.size(); ++i) {
+      EXPECT_EQ(results[i].dist, expected[i].dist) << "result " + std::to_string(i);
+      EXPECT_EQ(results[i].time, expected[i].time) << "result " + std::to_string(i);
+    }
+  }
+}
+
+TEST(Matrix, test_chmatrix) {
+  loki_worker_t loki_worker(config);
+
+  Api request;
+  ParseApi(test_request, Options::sources_to_targets, request);
+  loki_worker.matrix(request);
+  adjust_scores(*request.mutable_options());
+
+  GraphReader reader(config.get_child("mjolnir"));
+
+  sif::mode_costing_t mode_costing;
+  mode_costing[0] = CreateSimpleCost(
+      request.options().costing_options(static_cast<int>(request.options().costing())));
+
+  // Build the overlay and make sure it survives the trip through the file
+  auto built = mjolnir::CHBuilder::Contract(reader, mode_costing[0]);
+  const std::string file_name = CHOverlay::FileName("test/data/utrecht_ch", "auto");
+  built->Save(file_name);
+  auto overlay = CHOverlay::Load(file_name);
+  ASSERT_EQ(overlay->node_count(), built->node_count());
+  ASSERT_FALSE(overlay->tiles().empty());
+  EXPECT_EQ(overlay->dataset_id(),
+            reader.GetGraphTile(GraphId(overlay->tiles().front().tile_id))->header()->dataset_id());
+
+  CHMatrix ch_matrix(overlay);
+  const auto& sources = request.options().sources();
+  const auto& targets = request.options().targets();
+  ASSERT_TRUE(ch_matrix.Covers(sources, reader));
+  ASSERT_TRUE(ch_matrix.Covers(targets, reader));
+  auto results = ch_matrix.SourceToTarget(sources, targets, reader, mode_costing,
+                                          TravelMode::kDrive, 100000.f);
+
+  // The overlay has no turn costs, with this costing that means it finds the shortest paths which
+  // can only be a little shorter than the ones found with turn costs
+  ASSERT_EQ(results.size(), matrix_answers.size());
+  for (uint32_t i = 0; i < results.size(); ++i) {
+    const auto message = "result " + std::to_string(i);
+    EXPECT_LE(results[i].dist, matrix_answers[i].dist + kThreshold) << message;
+    EXPECT_GE(results[i].dist, matrix_answers[i].dist * 0.9) << message;
+    EXPECT_NEAR(results[i].time, results[i].dist, kThreshold) << message;
+  }
+
+  // Pairs further apart than the limit are not found
+  results = ch_matrix.SourceToTarget(sources, targets, reader, mode_costing, TravelMode::kDrive,
+                                     1000.f);
+  for (uint32_t i = 0; i < results.size(); ++i) {
+    if (matrix_answers[i].dist * 0.9 > 1000) {
+      EXPECT_EQ(results[i].time, kMaxCost) << "result " << i;
+    }
+  }
+
+  // An overlay built from other tiles is not used
+  CHMatrix stale_matrix(std::make_shared<CHOverlay>(
+      overlay->dataset_id() + 1, std::vector<CHOverlay::tile_t>(overlay->tiles()),
+      std::vector<uint32_t>{0}, std::vector<CHOverlay::arc_t>{}, std::vector<uint32_t>{0},
+      std::vector<CHOverlay::arc_t>{}));
+  EXPECT_FALSE(stale_matrix.Covers(sources, reader));
+}
+
+TEST(Matrix, test_matrix_serialized) {
+  loki_worker_t loki_worker(config);
+  Api request;
+  ParseApi(test_request, Options::sources_to_targets, request);
+  loki_worker.matrix(request);
+
+  // leave one of the pairs without a route
+  auto results = matrix_answers;
+  results[6].time = kMaxCost;
+
+  rapidjson::Document json;
+  json.Parse(serializeMatrix(request, results, kKmPerMeter));
+  ASSERT_FALSE(json.HasParseError());
+  ASSERT_EQ(json["sources_to_targets"].Size(), 4);
+  for (rapidjson::SizeType i = 0; i < 4; ++i) {
+    const auto& row = json["sources_to_targets"][i];
+    ASSERT_EQ(row.Size(), 4);
+    for (rapidjson::SizeType j = 0; j < 4; ++j) {
+      const auto& answer = results[i * 4 + j];
+      EXPECT_EQ(row[j]["from_index"].GetUint(), i);
+      EXPECT_EQ(row[j]["to_index"].GetUint(), j);
+      if (answer.time == kMaxCost) {
+        EXPECT_TRUE(row[j]["time"].IsNull());
+        EXPECT_TRUE(row[j]["distance"].IsNull());
+      } else {
+        EXPECT_EQ(row[j]["time"].GetUint(), answer.time);
+        EXPECT_NEAR(row[j]["distance"].GetDouble(), answer.dist * kKmPerMeter, 0.001);
+      }
+    }
+  }
+  EXPECT_EQ(json["sources"].Begin()->Size(), 4);
+  EXPECT_EQ(json["targets"].Begin()->Size(), 4);
+  EXPECT_STREQ(json["units"].GetString(), "kilometers");
+
+  // and the same for osrm
+  request.mutable_options()->set_format(Options::osrm);
+  json.Parse(serializeMatrix(request, results, 1));
+  ASSERT_FALSE(json.HasParseError());
+  EXPECT_STREQ(json["code"].GetString(), "Ok");
+  EXPECT_EQ(json["sources"].Size(), 4);
+  EXPECT_EQ(json["destinations"].Size(), 4);
+  for (rapidjson::SizeType i = 0; i < 4; ++i) {
+    for (rapidjson::SizeType j = 0; j < 4; ++j) {
+      const auto& answer = results[i * 4 + j];
+      if (answer.time == kMaxCost) {
+        EXPECT_TRUE(json["durations"][i][j].IsNull());
+        EXPECT_TRUE(json["distances"][i][j].IsNull());
+      } else {
+        EXPECT_EQ(json["durations"][i][j].GetUint(), answer.time);
+        EXPECT_NEAR(json["distances"][i][j].GetDouble(), answer.dist, 0.001);
+      }
+    }
+  }
+}
+
 // TODO: it was commented before. Why?
 TEST(Matrix, DISABLED_test_matrix_osrm) {
   loki_worker_t loki_worker(config);
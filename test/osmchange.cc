@@ -0,0 +1,98 @@
+#include "mjolnir/osmchange.h"
+#include "baldr/compression_utils.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "test.h"
+
+using namespace valhalla::mjolnir;
+
+namespace {
+
+const std::string kChange = R"(<?xml version='1.0' encoding='UTF-8'?>
+<osmChange version="0.6" generator="test">
+  <create>
+    <node id="1" version="1" lat="40.2731" lon="-76.8867">
+      <tag k="name" v="a &gt; b"/>
+    </node>
+    <way id="10" version="1">
+      <nd ref="1"/>
+      <nd ref="2"/>
+      <tag k="highway" v="residential"/>
+    </way>
+  </create>
+  <modify>
+    <node id="2" version="3" lat='40.2741' lon='-76.8877'/>
+    <way id="11" version="2"><nd ref="2"/><nd ref="3"/></way>
+    <relation id="100" version="4">
+      <member type="way" ref="12" role="from"/>
+      <member type="node" ref="3" role="via"/>
+      <member type="way" ref="13" role="to"/>
+      <tag k="type" v="restriction"/>
+    </relation>
+  </modify>
+  <delete>
+    <node id="4" version="2"/>
+    <way id="14" version="5"/>
+    <relation id="101" version="1"/>
+    <member type="way" ref="15" role="outside a relation"/>
+  </delete>
+</osmChange>
+)";
+
+void write(const std::string& file_name, const std::string& contents) {
+  std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+  file << contents;
+}
+
+void expect_change(const OSMChange& change) {
+  ASSERT_EQ(change.points.size(), 2);
+  EXPECT_EQ(change.points[0], valhalla::midgard::PointLL(-76.8867, 40.2731));
+  EXPECT_EQ(change.points[1], valhalla::midgard::PointLL(-76.8877, 40.2741));
+  EXPECT_EQ(change.way_ids, (std::unordered_set<uint64_t>{10, 11, 12, 13, 14}));
+}
+
+TEST(OSMChange, Read) {
+  const std::string file_name = "test_osmchange.osc";
+  write(file_name, kChange);
+  expect_change(OSMChange::Read(file_name));
+  std::remove(file_name.c_str());
+}
+
+TEST(OSMChange, ReadGzipped) {
+  // replication diffs come gzipped
+  std::string deflated;
+  auto src_func = [](z_stream& s) -> int {
+    s.next_in = reinterpret_cast<Byte*>(const_cast<char*>(kChange.data()));
+    s.avail_in = static_cast<unsigned int>(kChange.size());
+    return Z_FINISH;
+  };
+  auto dst_func = [&deflated](z_stream& s) {
+    auto size = deflated.size();
+    if (s.total_out < size) {
+      deflated.resize(s.total_out);
+    } else {
+      deflated.resize(size + 16);
+      s.next_out = reinterpret_cast<Byte*>(&deflated[0] + size);
+      s.avail_out = 16;
+    }
+  };
+  ASSERT_TRUE(valhalla::baldr::deflate(src_func, dst_func));
+
+  const std::string file_name = "test_osmchange.osc.gz";
+  write(file_name, deflated);
+  expect_change(OSMChange::Read(file_name));
+  std::remove(file_name.c_str());
+}
+
+TEST(OSMChange, NotAChange) {
+  const std::string file_name = "test_osmchange.osm";
+  write(file_name, "<?xml version='1.0'?>\n<osm version=\"0.6\"></osm>\n");
+  EXPECT_THROW(OSMChange::Read(file_name), std::runtime_error);
+  std::remove(file_name.c_str());
+  EXPECT_THROW(OSMChange::Read(file_name), std::runtime_error);
+}
+
+} // namespace
@@ -254,6 +254,84 @@ TEST(PredictedSpeeds, test_compress_decompress_accuracy) {
   EXPECT_LE(max_diff, 2.f) << "Low decompression accuracy"; // <= 2 KPH
 }
 
+TEST(PredictedSpeeds, test_decompress_matches_dct) {
+  // large coefficients of both signs so that rounding in the vectorized sums would show
+  std::array<int16_t, kCoefficientCount> coefficients;
+  for (uint32_t i = 0; i < kCoefficientCount; ++i)
+    coefficients[i] = static_cast<int16_t>(((i * 7919) % 4001) - 2000);
+
+  for (uint32_t bucket = 0; bucket < kBucketsPerWeek; ++bucket) {
+    // DCT-III in double precision straight from its definition
+    double expected = coefficients[0] / sqrt(2.0);
+    for (uint32_t c = 1; c < kCoefficientCount; ++c)
+      expected += coefficients[c] * cos(M_PI / kBucketsPerWeek * (bucket + 0.5) * c);
+    expected *= sqrt(2.0 / kBucketsPerWeek);
+
+    ASSERT_NEAR(decompress_speed_bucket(coefficients.data(), bucket), expected, 0.1)
+        << "Wrong speed in bucket " << bucket;
+  }
+}
+
+TEST(PredictedSpeeds, test_decompress_buckets) {
+  std::array<float, kBucketsPerWeek> speeds;
+  for (uint32_t i = 0; i < kBucketsPerWeek; ++i)
+    speeds[i] = roundf(40.f + 20.f * cos(i / 30.f));
+  auto coefficients = compress_speed_buckets(speeds.data());
+
+  // a whole week in one go
+  std::array<float, kBucketsPerWeek> week;
+  decompress_speed_buckets(coefficients.data(), 0, kBucketsPerWeek, week.data());
+  for (uint32_t i = 0; i < kBucketsPerWeek; ++i)
+    ASSERT_NEAR(week[i], decompress_speed_bucket(coefficients.data(), i), 0.01f);
+
+  // the last day of the week and on into the first one
+  std::array<float, 2 * kBucketsPerDay> days;
+  const uint32_t first = 6 * kBucketsPerDay;
+  decompress_speed_buckets(coefficients.data(), first, days.size(), days.data());
+  for (uint32_t i = 0; i < days.size(); ++i)
+    ASSERT_NEAR(days[i], week[(first + i) % kBucketsPerWeek], 0.01f);
+
+  // through PredictedSpeeds for an edge
+  uint32_t indexes[] = {0};
+  PredictedSpeeds pred_speeds;
+  pred_speeds.set_offset(indexes);
+  pred_speeds.set_profiles(coefficients.data());
+  std::array<float, kBucketsPerDay> day;
+  pred_speeds.speeds(0, kBucketsPerDay, day.size(), day.data());
+  for (uint32_t i = 0; i < day.size(); ++i)
+    ASSERT_NEAR(day[i], week[kBucketsPerDay + i], 0.01f);
+}
+
+TEST(PredictedSpeeds, test_speed_cache) {
+  // a few edges with different profiles
+  std::vector<int16_t> profiles;
+  uint32_t indexes[3];
+  for (uint32_t e = 0; e < 3; ++e) {
+    std::array<float, kBucketsPerWeek> speeds;
+    for (uint32_t i = 0; i < kBucketsPerWeek; ++i)
+      speeds[i] = roundf(30.f + 10.f * (e + 1) * sin(i / (10.f * (e + 1))));
+    auto coefficients = compress_speed_buckets(speeds.data());
+    indexes[e] = profiles.size();
+    profiles.insert(profiles.end(), coefficients.begin(), coefficients.end());
+  }
+
+  PredictedSpeeds uncached, cached;
+  for (auto* pred_speeds : {&uncached, &cached}) {
+    pred_speeds->set_offset(indexes);
+    pred_speeds->set_profiles(profiles.data());
+  }
+  // small enough that the edges and buckets fight over the entries
+  cached.enable_cache(64);
+
+  // twice so that the second pass hits whatever the first left in the cache
+  for (int pass = 0; pass < 2; ++pass) {
+    for (uint32_t secs = 0; secs < kSecondsPerWeek; secs += 1000) {
+      for (uint32_t e = 0; e < 3; ++e)
+        ASSERT_EQ(cached.speed(e, secs), uncached.speed(e, secs));
+    }
+  }
+}
+
 struct EncoderDecoderTest : public ::testing::Test {
   EncoderDecoderTest() {
     // fill in coefficients
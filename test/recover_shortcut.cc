@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "baldr/graphreader.h"
@@ -26,13 +27,13 @@ const auto conf = test::make_config("test/data/utrecht_tiles");
 
 // expose the constructor
 struct testable_recovery : public shortcut_recovery_t {
-  testable_recovery(GraphReader* reader) : shortcut_recovery_t(reader) {
+  testable_recovery(bool cache) : shortcut_recovery_t(cache) {
   }
 };
 
 void recover(bool cache) {
   GraphReader graphreader(conf.get_child("mjolnir"));
-  testable_recovery recovery{cache ? &graphreader : nullptr};
+  testable_recovery recovery{cache};
   size_t total = 0;
   size_t bad = 0;
 
@@ -131,6 +132,52 @@ TEST(RecoverShortcut, test_recover_shortcut_edges_cache) {
   recover(true);
 }
 
+TEST(RecoverShortcut, test_recover_shortcut_edges_cache_threads) {
+  // the shortcuts of every tile
+  std::vector<GraphId> shortcuts;
+  {
+    GraphReader graphreader(conf.get_child("mjolnir"));
+    for (const auto& level : TileHierarchy::levels()) {
+      if (level.level > 1)
+        continue;
+      for (const auto tileid : graphreader.GetTileSet(level.level)) {
+        auto tile = graphreader.GetGraphTile(tileid);
+        for (size_t j = 0; j < tile->header()->directededgecount(); ++j) {
+          if (tile->directededge(j)->is_shortcut()) {
+            shortcuts.push_back(tileid);
+            shortcuts.back().set_id(j);
+          }
+        }
+      }
+    }
+  }
+  ASSERT_FALSE(shortcuts.empty());
+
+  // threads filling the same cache all get the same edges for a shortcut, even when one of them
+  // filled it in while recovering the opposing shortcut
+  testable_recovery cached{true};
+  std::vector<std::thread> threads;
+  std::vector<std::vector<std::vector<GraphId>>> recovered(4);
+  for (size_t i = 0; i < recovered.size(); ++i) {
+    threads.emplace_back([&, i]() {
+      GraphReader graphreader(conf.get_child("mjolnir"));
+      recovered[i].resize(shortcuts.size());
+      for (size_t j = 0; j < shortcuts.size(); ++j) {
+        const size_t k = (j + i * shortcuts.size() / 4) % shortcuts.size();
+        recovered[i][k] = cached.get(shortcuts[k], graphreader);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (size_t i = 1; i < recovered.size(); ++i) {
+    for (size_t k = 0; k < shortcuts.size(); ++k) {
+      EXPECT_EQ(recovered[i][k], recovered[0][k]) << std::to_string(shortcuts[k]);
+    }
+  }
+}
+
 int main(int argc, char* argv[]) {
   // valhalla::midgard::logging::Configure({{"type", ""}});
   testing::InitGoogleTest(&argc, argv);
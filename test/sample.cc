@@ -2,12 +2,14 @@
 #include "pixels.h"
 
 #include "baldr/compression_utils.h"
+#include "filesystem.h"
 #include "midgard/sequence.h"
 #include "midgard/util.h"
 
 #include <cmath>
 #include <fstream>
 #include <list>
+#include <thread>
 
 #include "test.h"
 
@@ -15,6 +17,32 @@ using namespace valhalla;
 
 namespace {
 
+void write_gz(std::vector<int16_t>& tile, const std::string& file_name) {
+  // input for gzip
+  auto src_func = [&tile](z_stream& s) -> int {
+    s.next_in = static_cast<Byte*>(static_cast<void*>(tile.data()));
+    s.avail_in = static_cast<unsigned int>(tile.size() * sizeof(int16_t));
+    return Z_FINISH;
+  };
+
+  // output for gzip
+  std::vector<char> dst_buffer(13000, 0);
+  std::ofstream gzfile(file_name, std::ios::binary | std::ios::trunc);
+  auto dst_func = [&dst_buffer, &gzfile](z_stream& s) -> void {
+    // move these bytes to their final resting place
+    auto chunk = s.total_out - gzfile.tellp();
+    gzfile.write(static_cast<const char*>(static_cast<void*>(dst_buffer.data())), chunk);
+    // if more input is coming
+    if (s.avail_in > 0) {
+      s.next_out = static_cast<Byte*>(static_cast<void*>(dst_buffer.data()));
+      s.avail_out = dst_buffer.size();
+    }
+  };
+
+  // gzip it
+  EXPECT_TRUE(baldr::deflate(src_func, dst_func)) << "Can't write gzipped elevation tile";
+}
+
 TEST(Sample, no_data) {
   // check the no data value
   skadi::sample s("test/data/this_is_not_a_directory");
@@ -44,29 +72,8 @@ TEST(Sample, create_tile) {
   file.write(static_cast<const char*>(static_cast<void*>(tile.data())),
              sizeof(int16_t) * tile.size());
 
-  // input for gzip
-  auto src_func = [&tile](z_stream& s) -> int {
-    s.next_in = static_cast<Byte*>(static_cast<void*>(tile.data()));
-    s.avail_in = static_cast<unsigned int>(tile.size() * sizeof(decltype(tile)::value_type));
-    return Z_FINISH;
-  };
-
-  // output for gzip
-  std::vector<char> dst_buffer(13000, 0);
-  std::ofstream gzfile("test/data/samplegz/N40/N40W077.hgt.gz", std::ios::binary | std::ios::trunc);
-  auto dst_func = [&dst_buffer, &gzfile](z_stream& s) -> void {
-    // move these bytes to their final resting place
-    auto chunk = s.total_out - gzfile.tellp();
-    gzfile.write(static_cast<const char*>(static_cast<void*>(dst_buffer.data())), chunk);
-    // if more input is coming
-    if (s.avail_in > 0) {
-      s.next_out = static_cast<Byte*>(static_cast<void*>(dst_buffer.data()));
-      s.avail_out = dst_buffer.size();
-    }
-  };
-
   // gzip it
-  EXPECT_TRUE(baldr::deflate(src_func, dst_func)) << "Can't write gzipped elevation tile";
+  write_gz(tile, "test/data/samplegz/N40/N40W077.hgt.gz");
 }
 
 void _get(const std::string& location) {
@@ -164,6 +171,66 @@ TEST(Sample, lazy_load) {
   EXPECT_NEAR(490, s.get(std::make_pair(1 - 0.503915, 0.678783)), 1.0);
 }
 
+TEST(Sample, lazy_load_threads) {
+  // a sampler shared by threads that all want a tile that showed up after it was made
+  skadi::sample s("test/data/sample");
+  {
+    std::vector<int16_t> tile(3601 * 3601, ((200 & 0xFF) << 8) | ((200 >> 8) & 0xFF));
+    filesystem::create_directories("test/data/sample/N02");
+    std::ofstream file("test/data/sample/N02/N02E002.hgt", std::ios::binary | std::ios::trunc);
+    file.write(static_cast<const char*>(static_cast<void*>(tile.data())),
+               sizeof(int16_t) * tile.size());
+  }
+  std::vector<std::thread> threads;
+  std::vector<double> heights(8);
+  for (size_t i = 0; i < heights.size(); ++i) {
+    threads.emplace_back([&s, &heights, i]() { heights[i] = s.get(std::make_pair(2.5, 2.5)); });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  for (auto height : heights)
+    EXPECT_NEAR(200, height, 1.0);
+  filesystem::remove("test/data/sample/N02/N02E002.hgt");
+}
+
+TEST(Sample, lru) {
+  // a second gzipped tile next to the one of the other tests that is 100m everywhere
+  std::vector<int16_t> tile(3601 * 3601, ((100 & 0xFF) << 8) | ((100 >> 8) & 0xFF));
+  write_gz(tile, "test/data/samplegz/N41/N41W077.hgt.gz");
+
+  // zigzag between the two tiles with room for just one of them in memory
+  std::vector<std::pair<double, double>> postings;
+  for (int i = 0; i < 3; ++i) {
+    postings.emplace_back(-76.503915, 40.678783);
+    postings.emplace_back(-76.5, 41.5);
+  }
+  auto check = [&postings](const std::vector<double>& heights) {
+    ASSERT_EQ(heights.size(), postings.size());
+    for (size_t i = 0; i < heights.size(); i += 2) {
+      EXPECT_NEAR(490, heights[i], 1.0);
+      EXPECT_NEAR(100, heights[i + 1], 1.0);
+    }
+  };
+  skadi::sample s("test/data/samplegz", 0);
+  check(s.get_all(postings));
+  for (const auto& posting : postings)
+    EXPECT_EQ(s.get(posting), s.get_all(std::vector<std::pair<double, double>>{posting}).front());
+
+  // samplers on other threads share the cache, which grows to hold both tiles, and wait on each
+  // other when they want the same tile
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&check, &postings]() {
+      skadi::sample s("test/data/samplegz");
+      for (int j = 0; j < 5; ++j)
+        check(s.get_all(postings));
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  filesystem::remove("test/data/samplegz/N41/N41W077.hgt.gz");
+}
+
 TEST(Sample, hgt_file_name) {
   // A mix of coordinates in each hemisphere and indices above and below 32767
   // (There was a bug where the 16-bit index was converted to a signed value and would be invalid)
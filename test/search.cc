@@ -23,6 +23,7 @@ namespace vs = valhalla::sif;
 
 #include "mjolnir/directededgebuilder.h"
 #include "mjolnir/graphtilebuilder.h"
+#include "mjolnir/spatialindexbuilder.h"
 
 namespace {
 
@@ -455,6 +456,78 @@ TEST(Search, test_search_cutoff) {
   search(x, 2, 0);
 }
 
+TEST(Search, test_spatial_index) {
+  boost::property_tree::ptree conf;
+  conf.put("tile_dir", tile_dir);
+  valhalla::baldr::GraphReader reader(conf);
+  const auto file_name = tile_dir + "/spatial.idx";
+  valhalla::mjolnir::SpatialIndexBuilder::Build(reader, file_name);
+  const auto index = SpatialIndex::Load(file_name);
+  ASSERT_EQ(index->tile_count(), 1);
+
+  // every edge of every bin has a box around its shape
+  auto tile = reader.GetGraphTile(tile_id);
+  const auto* boxes = index->boxes(*tile);
+  ASSERT_NE(boxes, nullptr);
+  ASSERT_EQ(index->box_count(), tile->header()->bin_offset(kBinCount - 1).second);
+  for (size_t bin = 0; bin < kBinCount; ++bin) {
+    const auto* box = boxes + tile->header()->bin_offset(bin).first;
+    for (auto edge_id : tile->GetBin(bin)) {
+      const auto* edge = tile->directededge(edge_id);
+      for (const auto& p : tile->edgeinfo(edge->edgeinfo_offset()).shape()) {
+        EXPECT_TRUE(box->min_lng < p.lng() && p.lng() < box->max_lng);
+        EXPECT_TRUE(box->min_lat < p.lat() && p.lat() < box->max_lat);
+      }
+      ++box;
+    }
+  }
+
+  // the index only skips work, the results stay the same
+  const auto costing = create_costing();
+  std::vector<Location> locations;
+  for (const auto& ll : {a.second, b.second, c.second, d.second, PointLL{.1, .15}, PointLL{.05, .1},
+                         PointLL{.3, .3}, PointLL{-.05, .02}}) {
+    for (unsigned int reach : {0, 2, 5}) {
+      Location location(ll, Location::StopType::BREAK, reach, reach, 0);
+      locations.push_back(location);
+      location.radius_ = 5000;
+      locations.push_back(location);
+    }
+  }
+  for (const auto& batch : {std::vector<Location>{locations.front()}, locations}) {
+    const auto expected = Search(batch, reader, costing);
+    const auto results = Search(batch, reader, costing, index);
+    ASSERT_EQ(results.size(), expected.size());
+    for (const auto& result : results) {
+      const auto& edges = result.second.edges;
+      const auto& expected_edges = expected.at(result.first).edges;
+      ASSERT_EQ(edges.size(), expected_edges.size());
+      for (size_t i = 0; i < edges.size(); ++i) {
+        EXPECT_EQ(edges[i].id, expected_edges[i].id);
+        EXPECT_EQ(edges[i].percent_along, expected_edges[i].percent_along);
+        EXPECT_EQ(edges[i].distance, expected_edges[i].distance);
+      }
+    }
+  }
+
+  // an index of other tiles is refused as a whole and tile by tile
+  EXPECT_TRUE(index->Matches(reader));
+  const auto stale_name = tile_dir + "/stale.idx";
+  const std::vector<SpatialIndex::box_t> stale_boxes(boxes, boxes + index->box_count());
+  SpatialIndex::tile_t stale_tile{tile_id.tile_value(),
+                                  static_cast<uint32_t>(index->box_count()), 0,
+                                  SpatialIndex::Checksum(*tile)};
+  SpatialIndex::Save(stale_name, tile->header()->dataset_id() + 1, {stale_tile}, stale_boxes);
+  auto stale = SpatialIndex::Load(stale_name);
+  EXPECT_FALSE(stale->Matches(reader));
+  EXPECT_EQ(stale->boxes(*tile), nullptr);
+  ++stale_tile.checksum;
+  SpatialIndex::Save(stale_name, tile->header()->dataset_id(), {stale_tile}, stale_boxes);
+  stale = SpatialIndex::Load(stale_name);
+  EXPECT_FALSE(stale->Matches(reader));
+  EXPECT_EQ(stale->boxes(*tile), nullptr);
+}
+
 } // namespace
 
 // Setup and tearown will be called only once for the entire suite121
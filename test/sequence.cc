@@ -1,5 +1,8 @@
 #include "midgard/sequence.h"
+#include <algorithm>
 #include <cstdint>
+#include <random>
+#include <vector>
 
 #include "test.h"
 
@@ -70,6 +73,39 @@ TEST(Sequence, Iterator) {
   EXPECT_EQ(i.position(), 0) << "Pre-decrement operator wasn't right";
 }
 
+TEST(Sequence, ExternalSort) {
+  // lots of equal ids so that we can tell if the order of equal elements is kept
+  std::vector<osm_node> nodes;
+  std::mt19937 generator(7);
+  std::uniform_int_distribution<uint64_t> distribution(0, 300);
+  for (uint32_t i = 0; i < 10000; ++i) {
+    nodes.push_back({distribution(generator), 0.f, 0.f, i});
+  }
+  auto less_than = [](const osm_node& a, const osm_node& b) { return a.id < b.id; };
+  auto expected = nodes;
+  std::stable_sort(expected.begin(), expected.end(), less_than);
+
+  // one run, many runs on one thread, many runs on many threads and more threads than runs
+  for (const auto& buffer_and_threads : std::vector<std::pair<size_t, unsigned int>>{
+           {20000, 1}, {333, 1}, {1000, 4}, {4000, 7}}) {
+    {
+      sequence<osm_node> sequence("nodes.nd", true, 512);
+      for (const auto& node : nodes) {
+        sequence.push_back(node);
+      }
+      sequence.external_sort(less_than, buffer_and_threads.first, buffer_and_threads.second);
+    }
+    sequence<osm_node> sequence("nodes.nd", false, 512);
+    ASSERT_EQ(sequence.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      osm_node node = *sequence[i];
+      ASSERT_EQ(node.id, expected[i].id) << "Wrong order at " << i;
+      ASSERT_EQ(node.attributes, expected[i].attributes) << "Equal elements moved at " << i;
+    }
+  }
+  EXPECT_FALSE(filesystem::exists("nodes.nd.runs")) << "The runs should be cleaned up";
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
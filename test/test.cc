@@ -134,6 +134,8 @@ boost::property_tree::ptree make_config(const std::string& path_prefix,
           "isochrone",
           "trace_route",
           "trace_attributes",
+          "trace_attributes_batch",
+          "online_match",
           "transit_available",
           "expansion",
           "centroid"
@@ -351,7 +353,8 @@ boost::property_tree::ptree make_config(const std::string& path_prefix,
           "max_distance": 200000.0,
           "max_gps_accuracy": 100.0,
           "max_search_radius": 100.0,
-          "max_shape": 16000
+          "max_shape": 16000,
+          "max_traces": 5000
         },
         "transit": {
           "max_distance": 500000.0,
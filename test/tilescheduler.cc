@@ -0,0 +1,90 @@
+#include "mjolnir/tilescheduler.h"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "test.h"
+
+using namespace valhalla::baldr;
+using namespace valhalla::mjolnir;
+
+namespace {
+
+TileScheduler::tile_costs_t make_tiles(uint32_t count) {
+  TileScheduler::tile_costs_t tiles;
+  for (uint32_t i = 0; i < count; ++i) {
+    tiles.emplace_back(GraphId(i, 2, 0), (i * 7919) % 101);
+  }
+  return tiles;
+}
+
+TEST(TileScheduler, MostExpensiveFirst) {
+  auto tiles = make_tiles(50);
+  TileScheduler scheduler(tiles, 1);
+  EXPECT_EQ(scheduler.concurrency(), 1);
+  EXPECT_EQ(scheduler.size(), tiles.size());
+
+  std::unordered_map<GraphId, uint64_t> costs(tiles.begin(), tiles.end());
+  GraphId tile_id;
+  uint64_t last = std::numeric_limits<uint64_t>::max();
+  size_t count = 0;
+  while (scheduler.Next(0, tile_id)) {
+    EXPECT_LE(costs[tile_id], last);
+    last = costs[tile_id];
+    ++count;
+  }
+  EXPECT_EQ(count, tiles.size());
+  EXPECT_FALSE(scheduler.Next(0, tile_id));
+}
+
+TEST(TileScheduler, NoMoreWorkersThanTiles) {
+  EXPECT_EQ(TileScheduler(make_tiles(3), 8).concurrency(), 3);
+  TileScheduler empty({}, 8);
+  EXPECT_EQ(empty.concurrency(), 1);
+  GraphId tile_id;
+  EXPECT_FALSE(empty.Next(0, tile_id));
+}
+
+TEST(TileScheduler, Stealing) {
+  // a worker that never shows up still gets all of its tiles done by the other
+  auto tiles = make_tiles(20);
+  TileScheduler scheduler(tiles, 2);
+  std::vector<GraphId> done;
+  GraphId tile_id;
+  while (scheduler.Next(1, tile_id)) {
+    done.push_back(tile_id);
+  }
+  EXPECT_EQ(done.size(), tiles.size());
+  EXPECT_FALSE(scheduler.Next(0, tile_id));
+}
+
+TEST(TileScheduler, EveryTileOnce) {
+  auto tiles = make_tiles(10000);
+  TileScheduler scheduler(tiles, 8);
+  std::mutex lock;
+  std::unordered_map<GraphId, size_t> done;
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < scheduler.concurrency(); ++i) {
+    threads.emplace_back([&scheduler, &lock, &done, i]() {
+      GraphId tile_id;
+      while (scheduler.Next(i, tile_id)) {
+        std::lock_guard<std::mutex> l(lock);
+        ++done[tile_id];
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(done.size(), tiles.size());
+  for (const auto& tile : done) {
+    EXPECT_EQ(tile.second, 1);
+  }
+  scheduler.LogUtilization("Tested");
+}
+
+} // namespace
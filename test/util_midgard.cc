@@ -694,6 +694,52 @@ TEST(UtilMidgard, Base64) {
   }
 }
 
+TEST(UtilMidgard, TestProjectorBatch) {
+  // a batch has to find the same closest points as projecting each point on its own
+  std::mt19937 generator(17);
+  std::uniform_real_distribution<double> distribution(-0.01, 0.01);
+  std::vector<PointLL> points;
+  projector_batch_t batch;
+  for (size_t i = 0; i < 7; ++i) {
+    points.emplace_back(13.4 + distribution(generator), 52.5 + distribution(generator));
+    batch.add(projector_t(points.back()));
+  }
+  batch.reset(3, true);
+
+  std::vector<PointLL> shape;
+  for (size_t i = 0; i < 20; ++i) {
+    shape.emplace_back(13.4 + distribution(generator), 52.5 + distribution(generator));
+  }
+  shape.push_back(shape.back()); // zero length segment
+  for (size_t i = 1; i < shape.size(); ++i) {
+    batch(shape[i - 1], shape[i], i);
+  }
+
+  ASSERT_EQ(batch.size(), points.size());
+  EXPECT_EQ(batch.sq_distance(3), std::numeric_limits<double>::lowest());
+  for (size_t j = 0; j < points.size(); ++j) {
+    if (j == 3) {
+      continue;
+    }
+    projector_t projector(points[j]);
+    double sq_distance = std::numeric_limits<double>::max();
+    PointLL closest;
+    uint64_t index = 0;
+    for (size_t i = 1; i < shape.size(); ++i) {
+      auto point = projector(shape[i - 1], shape[i]);
+      auto d = projector.approx.DistanceSquared(point);
+      if (d < sq_distance) {
+        sq_distance = d;
+        closest = point;
+        index = i;
+      }
+    }
+    EXPECT_EQ(batch.sq_distance(j), sq_distance);
+    EXPECT_EQ(batch.closest(j), closest);
+    EXPECT_EQ(batch.closest_index(j), index);
+  }
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -1,12 +1,21 @@
+#include <cstdio>
 #include <fstream>
+#include <map>
 #include <sstream>
 #include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
 
 #include <boost/property_tree/ptree.hpp>
 
 #include "baldr/graphid.h"
+#include "baldr/graphreader.h"
 #include "baldr/rapidjson_utils.h"
+#include "baldr/tile_extract.h"
+#include "baldr/tilehierarchy.h"
 #include "filesystem.h"
+#include "mjolnir/osmchange.h"
 #include "mjolnir/util.h"
 
 #include "test.h"
@@ -92,6 +101,317 @@ TEST(UtilMjolnir, TileManifestLogToFile) {
   EXPECT_EQ(read.tileset[GraphId{5970554}], manifest.tileset[GraphId{5970554}]);
 }
 
+// Reads every file under a directory keyed by its path relative to the directory
+std::map<std::string, std::string> read_files(const std::string& dir) {
+  std::map<std::string, std::string> files;
+  for (filesystem::recursive_directory_iterator i(dir), end; i != end; ++i) {
+    if (i->is_regular_file()) {
+      std::ifstream file(i->path().string(), std::ios::binary);
+      std::stringstream contents;
+      contents << file.rdbuf();
+      files[i->path().string().substr(dir.size())] = contents.str();
+    }
+  }
+  return files;
+}
+
+// Writes the files read by read_files under another directory
+void write_files(const std::string& dir, const std::map<std::string, std::string>& files) {
+  for (const auto& file : files) {
+    filesystem::path path(dir + file.first);
+    filesystem::create_directories(path.parent_path());
+    std::ofstream(path.string(), std::ios::binary) << file.second;
+  }
+}
+
+// Only the tiles of a tile directory keyed by their path relative to the directory
+std::map<std::string, std::string> read_tiles(const std::string& dir) {
+  std::map<std::string, std::string> tiles;
+  for (const auto& file : read_files(dir)) {
+    if (file.first.size() > 4 && file.first.substr(file.first.size() - 4) == ".gph") {
+      tiles.insert(file);
+    }
+  }
+  return tiles;
+}
+
+// Expects both sets of tiles to hold the same tiles with the same bytes
+void expect_same_tiles(const std::map<std::string, std::string>& a,
+                       const std::map<std::string, std::string>& b) {
+  ASSERT_FALSE(a.empty());
+  ASSERT_EQ(a.size(), b.size());
+  for (const auto& tile : a) {
+    auto other = b.find(tile.first);
+    ASSERT_NE(other, b.end()) << tile.first;
+    EXPECT_TRUE(tile.second == other->second) << tile.first << " differs";
+  }
+}
+
+// The hierarchy and shortcut stages make the same tiles no matter how many threads they use
+TEST(UtilMjolnir, HierarchyAndShortcutsConcurrency) {
+  const std::string base_dir("test/data/util_mjolnir_concurrency_tiles");
+  ptree config;
+  config.put("mjolnir.tile_dir", base_dir);
+  config.put("mjolnir.concurrency", 1);
+  ASSERT_TRUE(build_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"},
+                             mjolnir::BuildStage::kInitialize, mjolnir::BuildStage::kBss));
+  const auto base_files = read_files(base_dir);
+
+  std::vector<std::map<std::string, std::string>> tiles;
+  for (unsigned int concurrency : {1, 3}) {
+    // start each from a copy of the tiles before the hierarchy stage
+    const std::string tile_dir = base_dir + "_" + std::to_string(concurrency);
+    write_files(tile_dir, base_files);
+    config.put("mjolnir.tile_dir", tile_dir);
+    config.put("mjolnir.concurrency", concurrency);
+    ASSERT_TRUE(build_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"},
+                               mjolnir::BuildStage::kHierarchy, mjolnir::BuildStage::kShortcuts));
+    tiles.push_back(read_tiles(tile_dir));
+    EXPECT_TRUE(filesystem::remove_all(tile_dir));
+  }
+  EXPECT_TRUE(filesystem::remove_all(base_dir));
+  expect_same_tiles(tiles.front(), tiles.back());
+}
+
+// The enhancer threads only see the tiles as they were before the stage so they make the same
+// tiles no matter how many threads there are or which tiles they got to first
+TEST(UtilMjolnir, EnhanceConcurrency) {
+  const std::string base_dir("test/data/util_mjolnir_enhance_tiles");
+  ptree config;
+  config.put("mjolnir.tile_dir", base_dir);
+  config.put("mjolnir.concurrency", 1);
+  ASSERT_TRUE(build_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"},
+                             mjolnir::BuildStage::kInitialize, mjolnir::BuildStage::kBuild));
+  const auto base_files = read_files(base_dir);
+
+  std::vector<std::map<std::string, std::string>> tiles;
+  for (unsigned int concurrency : {1, 4}) {
+    // start each from a copy of the tiles and the parsed data before the enhance stage
+    const std::string tile_dir = base_dir + "_" + std::to_string(concurrency);
+    write_files(tile_dir, base_files);
+    config.put("mjolnir.tile_dir", tile_dir);
+    config.put("mjolnir.concurrency", concurrency);
+    ASSERT_TRUE(build_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"},
+                               mjolnir::BuildStage::kEnhance, mjolnir::BuildStage::kEnhance));
+    EXPECT_FALSE(filesystem::exists(tile_dir + ".enhance"));
+    tiles.push_back(read_tiles(tile_dir));
+    EXPECT_TRUE(filesystem::remove_all(tile_dir));
+  }
+  EXPECT_TRUE(filesystem::remove_all(base_dir));
+
+  // the tiles were enhanced in place
+  size_t enhanced = 0;
+  for (const auto& tile : tiles.front()) {
+    auto base = base_files.find(tile.first);
+    ASSERT_NE(base, base_files.end()) << tile.first;
+    enhanced += tile.second != base->second;
+  }
+  EXPECT_GT(enhanced, 0);
+  expect_same_tiles(tiles.front(), tiles.back());
+}
+
+// The filter stage makes the same tiles no matter how many threads it uses
+TEST(UtilMjolnir, FilterConcurrency) {
+  const std::string base_dir("test/data/util_mjolnir_filter_tiles");
+  ptree config;
+  config.put("mjolnir.tile_dir", base_dir);
+  config.put("mjolnir.concurrency", 1);
+  config.put("mjolnir.include_pedestrian", false);
+  ASSERT_TRUE(build_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"},
+                             mjolnir::BuildStage::kInitialize, mjolnir::BuildStage::kEnhance));
+  const auto base_files = read_files(base_dir);
+
+  std::vector<std::map<std::string, std::string>> tiles;
+  for (unsigned int concurrency : {1, 3}) {
+    // start each from a copy of the tiles before the filter stage
+    const std::string tile_dir = base_dir + "_" + std::to_string(concurrency);
+    write_files(tile_dir, base_files);
+    config.put("mjolnir.tile_dir", tile_dir);
+    config.put("mjolnir.concurrency", concurrency);
+    ASSERT_TRUE(build_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"},
+                               mjolnir::BuildStage::kFilter, mjolnir::BuildStage::kFilter));
+    tiles.push_back(read_tiles(tile_dir));
+    EXPECT_TRUE(filesystem::remove_all(tile_dir));
+  }
+  EXPECT_TRUE(filesystem::remove_all(base_dir));
+
+  // something was filtered and the threads filtered it the same way
+  size_t filtered = 0, unfiltered = 0;
+  for (const auto& tile : tiles.front()) {
+    auto base = base_files.find(tile.first);
+    ASSERT_NE(base, base_files.end()) << tile.first;
+    filtered += tile.second.size();
+    unfiltered += base->second.size();
+  }
+  EXPECT_LT(filtered, unfiltered);
+  expect_same_tiles(tiles.front(), tiles.back());
+}
+
+// Swapping the tiles for a change finds the tiles it affects and swaps a rebuilt tileset in
+TEST(UtilMjolnir, SwapTileSet) {
+  // the live tiles are in a directory the tile directory links to
+  const std::string tile_dir("test/data/util_mjolnir_update_tiles");
+  const std::string live_dir(tile_dir + ".0");
+  ptree config;
+  config.put("mjolnir.tile_dir", live_dir);
+  config.put("mjolnir.concurrency", 2);
+  ASSERT_TRUE(build_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"},
+                             mjolnir::BuildStage::kInitialize, mjolnir::BuildStage::kValidate));
+  const auto tiles = read_tiles(live_dir);
+  const auto link_target = [&tile_dir]() {
+    char target[256] = {};
+    return readlink(tile_dir.c_str(), target, sizeof(target) - 1) > 0 ? std::string(target) : "";
+  };
+  std::remove(tile_dir.c_str());
+  ASSERT_EQ(symlink("util_mjolnir_update_tiles.0", tile_dir.c_str()), 0);
+  config.put("mjolnir.tile_dir", tile_dir);
+
+  // a change moving a node and touching the way of some edge far away from it
+  const auto local_level = baldr::TileHierarchy::levels().back().level;
+  GraphId way_tile;
+  uint64_t way_id = 0;
+  {
+    baldr::GraphReader reader(config.get_child("mjolnir"));
+    for (const auto& tile_id : reader.GetTileSet(local_level)) {
+      auto tile = reader.GetGraphTile(tile_id);
+      if (tile->header()->directededgecount() > 0) {
+        way_tile = tile_id;
+        way_id = tile->edgeinfo(tile->directededge(0)->edgeinfo_offset()).wayid();
+        break;
+      }
+    }
+  }
+  ASSERT_TRUE(way_tile.Is_Valid());
+  const PointLL point(-76.8867, 40.2731);
+  const std::string change_file("test/data/util_mjolnir_update.osc");
+  std::ofstream(change_file) << "<osmChange version=\"0.6\"><modify><node id=\"1\" lat=\""
+                             << point.lat() << "\" lon=\"" << point.lng()
+                             << "\"/><way id=\"" << way_id
+                             << "\"><nd ref=\"1\"/></way></modify></osmChange>\n";
+
+  const auto affected = mjolnir::OSMChange::Read(change_file).AffectedTiles(config);
+  EXPECT_TRUE(affected.count(way_tile));
+  for (const auto& level : baldr::TileHierarchy::levels()) {
+    EXPECT_TRUE(affected.count(baldr::TileHierarchy::GetGraphId(point, level.level)))
+        << "level " << std::to_string(level.level);
+  }
+
+  // nothing changed in the input so the new tiles are the same. A reader made before the swap
+  // keeps reading the old tiles, which are kept for it
+  baldr::GraphReader old_reader(config.get_child("mjolnir"));
+  EXPECT_EQ(old_reader.tile_dir(), live_dir);
+  ASSERT_TRUE(mjolnir::swap_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"},
+                                     change_file));
+  const auto new_target = link_target();
+  EXPECT_NE(new_target, "util_mjolnir_update_tiles.0");
+  EXPECT_FALSE(filesystem::exists(tile_dir + ".link"));
+  EXPECT_FALSE(filesystem::exists(tile_dir + "/ways.bin"));
+  expect_same_tiles(tiles, read_tiles(tile_dir));
+  EXPECT_TRUE(filesystem::exists(live_dir));
+  EXPECT_NE(old_reader.GetGraphTile(way_tile), nullptr);
+  EXPECT_EQ(baldr::GraphReader(config.get_child("mjolnir")).tile_dir(), "test/data/" + new_target);
+
+  // a change that touches no tiles leaves them alone
+  std::ofstream(change_file) << "<osmChange version=\"0.6\"></osmChange>\n";
+  ASSERT_TRUE(mjolnir::swap_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"},
+                                     change_file));
+  EXPECT_EQ(link_target(), new_target);
+
+  // the next swap removes the tileset before the one it replaces
+  ASSERT_TRUE(
+      mjolnir::swap_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"}));
+  const auto newer_target = link_target();
+  EXPECT_NE(newer_target, new_target);
+  EXPECT_FALSE(filesystem::exists(live_dir));
+  EXPECT_TRUE(filesystem::exists("test/data/" + new_target));
+  expect_same_tiles(tiles, read_tiles(tile_dir));
+
+  // a plain tile directory cannot be swapped at once
+  config.put("mjolnir.tile_dir", "test/data/" + newer_target);
+  EXPECT_FALSE(
+      mjolnir::swap_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"}));
+
+  EXPECT_TRUE(filesystem::remove(change_file));
+  EXPECT_TRUE(filesystem::remove_all("test/data/" + new_target));
+  EXPECT_TRUE(filesystem::remove_all("test/data/" + newer_target));
+  EXPECT_TRUE(filesystem::remove(tile_dir));
+}
+
+// The extract stage writes a tar whose first entry indexes the tiles in it, each of them on a page
+TEST(UtilMjolnir, TileExtract) {
+  const std::string tile_dir("test/data/util_mjolnir_extract_tiles");
+  const std::string tile_extract(tile_dir + ".tar");
+  ptree config;
+  config.put("mjolnir.tile_dir", tile_dir);
+  config.put("mjolnir.tile_extract", tile_extract);
+  config.put("mjolnir.concurrency", 2);
+  config.put("mjolnir.build_tile_extract", true);
+  ASSERT_TRUE(build_tile_set(config, {VALHALLA_SOURCE_DIR "test/data/harrisburg.osm.pbf"},
+                             mjolnir::BuildStage::kInitialize, mjolnir::BuildStage::kExtract));
+  EXPECT_FALSE(filesystem::exists(tile_extract + ".tmp"));
+  const auto tiles = read_tiles(tile_dir);
+
+  // the index is all that is read to find the tiles
+  {
+    tar archive(tile_extract, true, false);
+    ASSERT_EQ(archive.contents.size(), 1);
+    auto index = baldr::TileExtract::Index(archive);
+    ASSERT_EQ(static_cast<size_t>(index.second - index.first), tiles.size());
+    for (auto tile = index.first; tile != index.second; ++tile) {
+      if (tile != index.first) {
+        EXPECT_LT((tile - 1)->tile_id, tile->tile_id);
+      }
+      EXPECT_EQ(tile->offset % baldr::TileExtract::kAlignment, 0);
+      auto file = tiles.find(filesystem::path::preferred_separator +
+                             baldr::GraphTile::FileSuffix(GraphId(tile->tile_id)));
+      ASSERT_NE(file, tiles.end());
+      EXPECT_TRUE(file->second ==
+                  std::string(archive.mm.get() + tile->offset, static_cast<size_t>(tile->size)));
+    }
+  }
+
+  // it is still a tar to anything else, the padding between the tiles does not show up in it
+  {
+    tar archive(tile_extract);
+    EXPECT_EQ(archive.contents.size(), tiles.size() + 1);
+    EXPECT_TRUE(archive.contents.count(baldr::TileExtract::kIndexName));
+  }
+
+  // and the reader finds the same tiles in it as in the tile directory
+  ptree extract_config;
+  extract_config.put("tile_extract", tile_extract);
+  auto reader = test::make_clean_graphreader(extract_config);
+  EXPECT_EQ(reader->GetTileSet().size(), tiles.size());
+  for (const auto& tile_id : reader->GetTileSet()) {
+    auto tile = reader->GetGraphTile(tile_id);
+    ASSERT_NE(tile, nullptr);
+    auto file = tiles.find(filesystem::path::preferred_separator +
+                           baldr::GraphTile::FileSuffix(tile_id));
+    ASSERT_NE(file, tiles.end());
+    EXPECT_EQ(tile->header()->end_offset(), file->second.size());
+  }
+  EXPECT_FALSE(reader->DoesTileExist(GraphId(0, 2, 0)));
+  reader.reset();
+
+  // an index of another version is ignored and the tiles are found by going through the tar
+  {
+    std::fstream file(tile_extract, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(sizeof(tar::header_t) + 8);
+    file.put(2);
+  }
+  {
+    tar archive(tile_extract, true, false);
+    auto index = baldr::TileExtract::Index(archive);
+    EXPECT_EQ(index.first, index.second);
+  }
+  reader = test::make_clean_graphreader(extract_config);
+  EXPECT_EQ(reader->GetTileSet().size(), tiles.size());
+  reader.reset();
+
+  EXPECT_TRUE(filesystem::remove(tile_extract));
+  EXPECT_TRUE(filesystem::remove_all(tile_dir));
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
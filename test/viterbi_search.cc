@@ -536,6 +536,95 @@ TEST(ViterbiSearch, TestTopKSearch) {
   }
 }
 
+TEST(ViterbiSearch, TestConvergedState) {
+  // s00 -> s10 -> s20 is the best path to the third column but s11 may still lead to s21
+  const std::vector<Column> columns{
+      {{0, {{0, 1}, {1, 3}}}},
+      {{0, {{0, 1}, {1, 10}}}, {0, {{0, 5}, {1, 1}}}},
+      {{0, {}}, {0, {{0, 1}}}},
+      {{0, {}}},
+  };
+  ViterbiSearch vs;
+  vs.set_emission_cost_model(EmissionCostModel(columns));
+  vs.set_transition_cost_model(TransitionCostModel(columns));
+  std::vector<StateId> converged;
+  for (StateId::Time time = 0; time < columns.size(); ++time) {
+    for (uint32_t id = 0; id < columns[time].size(); ++id) {
+      vs.AddStateId(StateId(time, id));
+    }
+    vs.SearchWinner(time);
+    converged.push_back(vs.ConvergedState());
+  }
+  EXPECT_EQ(converged[0], StateId(0, 0));
+  EXPECT_EQ(converged[1], StateId(0, 0));
+  EXPECT_EQ(converged[2], StateId(0, 0));
+  // s20 is a dead end so everything goes through s11 and s21 in the end
+  EXPECT_EQ(converged[3], StateId(3, 0));
+  EXPECT_EQ(vs.Predecessor(StateId(3, 0)), StateId(2, 1));
+  EXPECT_EQ(vs.Predecessor(StateId(2, 1)), StateId(1, 1));
+
+  // whatever converged stays on the best path to the winners from then on
+  const auto& random =
+      generate_columns(std::uniform_int_distribution<int>(0, 50),
+                       std::uniform_int_distribution<int>(0, 100),
+                       generate_column_counts(200, std::uniform_int_distribution<size_t>(1, 5)));
+  ViterbiSearch rvs;
+  rvs.set_emission_cost_model(EmissionCostModel(random));
+  rvs.set_transition_cost_model(TransitionCostModel(random));
+  std::vector<std::pair<StateId, StateId::Time>> found;
+  for (StateId::Time time = 0; time < random.size(); ++time) {
+    for (uint32_t id = 0; id < random[time].size(); ++id) {
+      rvs.AddStateId(StateId(time, id));
+    }
+    rvs.SearchWinner(time);
+    const auto state = rvs.ConvergedState();
+    if (state.IsValid()) {
+      found.emplace_back(state, time);
+    }
+  }
+  EXPECT_FALSE(found.empty());
+  for (const auto& state_time : found) {
+    const auto& state = state_time.first;
+    for (auto time = state_time.second; time < random.size(); ++time) {
+      auto stateid = rvs.SearchWinner(time);
+      while (stateid.IsValid() && stateid.time() > state.time()) {
+        stateid = rvs.Predecessor(stateid);
+      }
+      EXPECT_EQ(stateid, state);
+    }
+  }
+}
+
+TEST(ViterbiSearch, TestStateIdMap) {
+  StateIdMap<int> map;
+  // Candidates count up from zero and the clones of the top-k search count down from the max id
+  const StateId low(3, 2), high(3, std::numeric_limits<StateId::Id>::max() - 2), other(3, 5);
+  EXPECT_TRUE(map.emplace(low, 1));
+  EXPECT_TRUE(map.emplace(high, 2));
+  EXPECT_FALSE(map.emplace(low, 3)) << "must not replace an existing value";
+  ASSERT_NE(map.find(low), nullptr);
+  EXPECT_EQ(*map.find(low), 1);
+  ASSERT_NE(map.find(high), nullptr);
+  EXPECT_EQ(*map.find(high), 2);
+  EXPECT_FALSE(map.contains(other));
+  EXPECT_FALSE(map.contains(StateId(2, 2)));
+  EXPECT_FALSE(map.contains(StateId(100, 0)));
+  EXPECT_FALSE(map.contains(StateId()));
+
+  EXPECT_TRUE(map.erase(low));
+  EXPECT_FALSE(map.erase(low));
+  EXPECT_FALSE(map.contains(low));
+  EXPECT_TRUE(map.contains(high));
+
+  // Nothing is left after clearing, also not in the columns that are reused
+  map.clear();
+  EXPECT_FALSE(map.contains(high));
+  EXPECT_TRUE(map.emplace(StateId(0, 0), 4));
+  EXPECT_FALSE(map.contains(high));
+  EXPECT_TRUE(map.emplace(high, 5));
+  EXPECT_EQ(*map.find(high), 5);
+}
+
 int main(int argc, char* argv[]) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <valhalla/baldr/graphid.h>
+#include <valhalla/midgard/util.h>
+
+namespace valhalla {
+namespace baldr {
+
+/**
+ * A contraction hierarchy built over the routing graph for one costing with its default options.
+ * Every node of the road network tiles (on every hierarchy level) is a node of the overlay. The
+ * nodes were contracted one at a time, their rank being the order of contraction, and searches
+ * only follow arcs towards higher ranked nodes. Arcs are the edges the costing allows, the
+ * transitions between levels or the shortcuts added while contracting.
+ *
+ * Turn costs and complex restrictions are not part of the overlay, so the costs it gives are those
+ * of the edges alone. The overlay is stamped with the dataset id of the tiles it was built from so
+ * it can be told apart from a rebuilt tileset.
+ */
+class CHOverlay {
+public:
+  // An arc between a node and a higher ranked one along with the totals of the edges it stands for
+  struct arc_t {
+    uint32_t node;   // the higher ranked node
+    float cost;      // cost of the arc according to the costing
+    float secs;      // time along the arc in seconds
+    uint32_t length; // length of the arc in meters
+  };
+
+  // The range of nodes of the overlay that belongs to a tile
+  struct tile_t {
+    uint32_t tile_id;    // tile_value() of the tile
+    uint32_t first_node; // index of the first node of the tile
+    uint32_t node_count; // number of nodes of the tile when the overlay was built
+  };
+
+  static constexpr uint32_t kInvalidNode = std::numeric_limits<uint32_t>::max();
+
+  /**
+   * Makes an overlay out of its parts, see the members
+   */
+  CHOverlay(const uint64_t dataset_id,
+            std::vector<tile_t>&& tiles,
+            std::vector<uint32_t>&& up_offsets,
+            std::vector<arc_t>&& up_arcs,
+            std::vector<uint32_t>&& down_offsets,
+            std::vector<arc_t>&& down_arcs);
+
+  /**
+   * Reads an overlay written by Save
+   * @param file_name  the file to read
+   * @return the overlay, throws if the file could not be read or is not an overlay
+   */
+  static std::shared_ptr<const CHOverlay> Load(const std::string& file_name);
+
+  /**
+   * Writes the overlay to a file
+   * @param file_name  the file to write
+   */
+  void Save(const std::string& file_name) const;
+
+  /**
+   * The overlay file for a costing
+   * @param dir      the directory the overlays are in
+   * @param costing  the name of the costing
+   * @return the path of the file
+   */
+  static std::string FileName(const std::string& dir, const std::string& costing);
+
+  /**
+   * @return the dataset id of the tiles the overlay was built from
+   */
+  uint64_t dataset_id() const {
+    return dataset_id_;
+  }
+
+  /**
+   * @return the node ranges of the tiles the overlay was built from
+   */
+  const std::vector<tile_t>& tiles() const {
+    return tiles_;
+  }
+
+  /**
+   * @param node  a node of the graph
+   * @return its index within the overlay or kInvalidNode if the overlay doesn't know the node
+   */
+  uint32_t node_index(const GraphId& node) const;
+
+  /**
+   * @return the number of nodes of the overlay
+   */
+  size_t node_count() const {
+    return up_offsets_.size() - 1;
+  }
+
+  /**
+   * @param node  index of a node
+   * @return the arcs leaving the node towards higher ranked nodes
+   */
+  midgard::iterable_t<const arc_t> up(const uint32_t node) const {
+    return {up_arcs_.data() + up_offsets_[node], up_arcs_.data() + up_offsets_[node + 1]};
+  }
+
+  /**
+   * @param node  index of a node
+   * @return the arcs reaching the node from higher ranked nodes, their node is where they start
+   */
+  midgard::iterable_t<const arc_t> down(const uint32_t node) const {
+    return {down_arcs_.data() + down_offsets_[node], down_arcs_.data() + down_offsets_[node + 1]};
+  }
+
+protected:
+  // Dataset id of the tiles the overlay was built from
+  uint64_t dataset_id_;
+
+  // Node ranges of the tiles and where to find a tile in there
+  std::vector<tile_t> tiles_;
+  std::unordered_map<uint32_t, uint32_t> tile_index_;
+
+  // Arcs towards higher ranked nodes, those of node i are in [offsets[i], offsets[i + 1])
+  std::vector<uint32_t> up_offsets_;
+  std::vector<arc_t> up_arcs_;
+
+  // Arcs from higher ranked nodes, indexed the same way
+  std::vector<uint32_t> down_offsets_;
+  std::vector<arc_t> down_arcs_;
+};
+
+} // namespace baldr
+} // namespace valhalla
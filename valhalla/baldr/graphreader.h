@@ -1,18 +1,22 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/property_tree/ptree.hpp>
 
 #include <valhalla/baldr/curler.h>
 #include <valhalla/baldr/graphid.h>
 #include <valhalla/baldr/graphtile.h>
+#include <valhalla/baldr/tile_extract.h>
 #include <valhalla/baldr/tilegetter.h>
+#include <valhalla/baldr/tile_prefetcher.h>
 #include <valhalla/baldr/tilehierarchy.h>
 
 #include <valhalla/midgard/aabb2.h>
@@ -409,6 +413,152 @@ private:
   std::mutex& mutex_ref_;
 };
 
+/**
+ * Tile cache meant to be shared by every thread of the process. Tiles live in a flat table
+ * indexed the same way as FlatTileCache and the table is split into shards by tile. Lookups
+ * never take a lock: a reader registers itself in the current epoch of the shard, loads the
+ * slot and takes its own reference to the tile. Writers are serialized per shard and only drop
+ * the cache's reference to a replaced tile once all readers of the previous epoch have left the
+ * shard. Each shard gets an equal part of the memory budget and evicts with the CLOCK (second
+ * chance) approximation of LRU so the cache stays bounded without any global bookkeeping.
+ * It is thread-safe but since tiles are shared between threads it should only be used when built
+ * with ENABLE_THREAD_SAFE_TILE_REF_COUNT.
+ */
+class ConcurrentTileCache : public TileCache {
+public:
+  static constexpr size_t kDefaultShardCount = 64;
+
+  /**
+   * Constructor.
+   * @param max_size     maximum size of the cache
+   * @param shard_count  number of independently locked partitions of the cache
+   */
+  ConcurrentTileCache(size_t max_size, size_t shard_count = kDefaultShardCount);
+
+  /**
+   * Destructor, releases the references the cache holds on its tiles.
+   */
+  ~ConcurrentTileCache();
+
+  /**
+   * Reserves enough cache to hold (max_cache_size / tile_size) items.
+   * @param tile_size appeoximate size of one tile
+   */
+  void Reserve(size_t tile_size) override;
+
+  /**
+   * Checks if tile exists in the cache.
+   * @param graphid  the graphid of the tile
+   * @return true if tile exists in the cache
+   */
+  bool Contains(const GraphId& graphid) const override;
+
+  /**
+   * Puts a copy of a tile of into the cache. If another thread already put the same tile
+   * the tile that is already cached is returned and the passed in one is discarded.
+   * @param graphid  the graphid of the tile
+   * @param tile the graph tile
+   * @param size size of the tile in memory
+   */
+  graph_tile_ptr Put(const GraphId& graphid, graph_tile_ptr tile, size_t size) override;
+
+  /**
+   * Get a pointer to a graph tile object given a GraphId.
+   * @param graphid  the graphid of the tile
+   * @return GraphTile* a pointer to the graph tile
+   */
+  graph_tile_ptr Get(const GraphId& graphid) const override;
+
+  /**
+   * Lets you know if the cache is too large.
+   * @return true if the cache is over committed with respect to the limit
+   */
+  bool OverCommitted() const override;
+
+  /**
+   * Clears the cache.
+   */
+  void Clear() override;
+
+  /**
+   *  Does its best to reduce the cache size to remove overcommitted state.
+   *  Evicts the least recently used tiles of every shard which is over its budget
+   */
+  void Trim() override;
+
+protected:
+  // A cached tile as seen by the eviction clock of its shard
+  struct Resident {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  struct Shard {
+    // Serializes Put/Clear/Trim within the shard, Get and Contains never take it
+    std::mutex mutex;
+    // Flipped by writers to start a new grace period
+    std::atomic<uint32_t> epoch;
+    // Number of readers currently inside the shard per epoch parity
+    mutable std::atomic<uint32_t> readers[2];
+    // Tiles of this shard in clock order and the position of the clock hand
+    std::vector<Resident> resident;
+    size_t hand;
+    // Bytes cached in this shard
+    size_t size;
+
+    Shard() : epoch(0), readers{{0}, {0}}, hand(0), size(0) {
+    }
+  };
+
+  inline uint32_t get_offset(const GraphId& graphid) const {
+    return graphid.level() < 4 ? index_offsets_[graphid.level()] + graphid.tileid() : slot_count_;
+  }
+
+  inline Shard& get_shard(uint32_t offset) const {
+    return *shards_[offset % shards_.size()];
+  }
+
+  /**
+   * Evicts tiles from the shard until required_size bytes fit in its budget. The cache's
+   * references to the evicted tiles are moved into evicted so that the caller can release them
+   * after the grace period. Must be called with the shard mutex held.
+   * @param shard          the shard to evict from
+   * @param required_size  bytes that should fit in the shard once done
+   * @param evicted        receives the evicted tiles
+   */
+  void Evict(Shard& shard, size_t required_size, std::vector<graph_tile_ptr>& evicted);
+
+  /**
+   * Waits until no reader that might have seen the previous contents of the shard is still
+   * reading from it. Must be called with the shard mutex held.
+   * @param shard  the shard whose readers we are waiting on
+   */
+  static void Synchronize(Shard& shard);
+
+  // One slot per possible tile, nullptr when the tile is not cached. The cache owns one
+  // reference on every tile that is stored in a slot
+  std::unique_ptr<std::atomic<const GraphTile*>[]> slots_;
+
+  // Second chance bits of the eviction clock, set on every successful Get
+  std::unique_ptr<std::atomic<bool>[]> referenced_;
+
+  // Number of slots
+  uint32_t slot_count_;
+
+  // Offsets in the slot list for where a level of tiles begins
+  std::array<uint32_t, 8> index_offsets_;
+
+  // Shards, separately allocated so that their counters don't share cache lines
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // The current cache size in bytes
+  std::atomic<size_t> cache_size_;
+
+  // The max cache size in bytes and the part of it a single shard may use
+  size_t max_cache_size_;
+  size_t max_shard_size_;
+};
+
 /**
  * Creates tile caches.
  */
@@ -459,6 +609,41 @@ public:
    */
   virtual graph_tile_ptr GetGraphTile(const GraphId& graphid);
 
+  /**
+   * Queues a tile to be loaded into the cache in the background. Does nothing unless tile
+   * prefetching is enabled (see tile_prefetcher_t).
+   * @param graphid  the graphid of the tile
+   */
+  void Prefetch(const GraphId& graphid) {
+    if (prefetcher_) {
+      prefetcher_->prefetch(graphid);
+    }
+  }
+
+  /**
+   * Queues the tiles containing a location at every level of the hierarchy to be loaded into
+   * the cache in the background. Does nothing unless tile prefetching is enabled.
+   * @param pointll  the lat,lng that the tiles cover
+   */
+  void Prefetch(const midgard::PointLL& pointll) {
+    if (prefetcher_) {
+      for (const auto& level : TileHierarchy::levels()) {
+        auto id = TileHierarchy::GetGraphId(pointll, level.level);
+        if (id.Is_Valid()) {
+          prefetcher_->prefetch(id);
+        }
+      }
+    }
+  }
+
+  /**
+   * Returns the counters of the tile prefetcher shared by the readers of this process
+   * @return the counters, all zero if prefetching is disabled
+   */
+  tile_prefetcher_t::stats_t GetPrefetchStats() const {
+    return prefetcher_ ? prefetcher_->stats() : tile_prefetcher_t::stats_t{};
+  }
+
   /**
    * Get a pointer to a graph tile object given a GraphId. This method also
    * supplies the current graph tile - so if the same tile is requested in
@@ -902,11 +1087,27 @@ public:
   IncidentResult GetIncidents(const GraphId& edge_id, graph_tile_ptr& tile);
 
 protected:
-  // (Tar) extract of tiles - the contents are empty if not being used
+  // (Tar) extract of tiles - there are no tiles if not being used
   struct tile_extract_t {
     tile_extract_t(const boost::property_tree::ptree& pt);
+    tile_extract_t(const tile_extract_t&) = delete;
+    tile_extract_t& operator=(const tile_extract_t&) = delete;
+
+    // Whether there are any tiles in the extract
+    bool empty() const {
+      return tiles_begin == tiles_end;
+    }
+
+    // Where the data of a tile is in the extract, a null pointer if the tile is not in there
     // TODO: dont remove constness, and actually make graphtile read only?
-    std::unordered_map<uint64_t, std::pair<char*, size_t>> tiles;
+    std::pair<char*, size_t> find(uint64_t tile_id) const;
+
+    // The tiles sorted by id, in place in the index of an extract written by the extract stage of
+    // valhalla_build_tiles or gathered from the tar headers of any other extract
+    const TileExtract::tile_t* tiles_begin = nullptr;
+    const TileExtract::tile_t* tiles_end = nullptr;
+    std::vector<TileExtract::tile_t> scanned_tiles;
+
     std::unordered_map<uint64_t, std::pair<char*, size_t>> traffic_tiles;
     std::shared_ptr<midgard::tar> archive;
     std::shared_ptr<midgard::tar> traffic_archive;
@@ -915,6 +1116,9 @@ protected:
   static std::shared_ptr<const GraphReader::tile_extract_t>
   get_extract_instance(const boost::property_tree::ptree& pt);
 
+  // Sets up the predicted speed cache of a tile that was just loaded, if configured to
+  void EnablePredictedSpeedCache(const graph_tile_ptr& tile) const;
+
   // Information about where the tiles are kept
   const std::string tile_dir_;
 
@@ -928,6 +1132,12 @@ protected:
 
   std::unique_ptr<TileCache> cache_;
 
+  // Size of the decoded predicted speed cache of each tile, 0 when disabled
+  const uint32_t predicted_speed_cache_size_;
+
+  // Loads tiles in the background, only when enabled
+  std::shared_ptr<tile_prefetcher_t> prefetcher_;
+
   bool enable_incidents_;
 };
 
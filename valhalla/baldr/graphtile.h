@@ -633,6 +633,30 @@ public:
     return (is_truck && (de->truck_speed() > 0)) ? std::min(de->truck_speed(), speed) : speed;
   }
 
+  /**
+   * Get the predicted speeds of an edge for a range of consecutive 5 minute buckets of the week,
+   * for example to cost the same edge at every time of a day at once.
+   * @param  de            Directed edge information, must have predicted speeds.
+   * @param  first_bucket  Bucket of the week to start at.
+   * @param  count         Number of buckets, wrapping around the end of the week.
+   * @param  speeds        Gets the speeds (KPH), must have room for count values.
+   */
+  void GetPredictedSpeeds(const DirectedEdge* de,
+                          const uint32_t first_bucket,
+                          const uint32_t count,
+                          float* speeds) const {
+    predictedspeeds_.speeds(de - directededges_, first_bucket, count, speeds);
+  }
+
+  /**
+   * Keep the predicted speeds decoded by GetSpeed in a cache of the given number of entries.
+   * Only call this before the tile is shared with other threads.
+   * @param  entries  Number of cached speeds, 0 disables the cache.
+   */
+  void EnablePredictedSpeedCache(const uint32_t entries) {
+    predictedspeeds_.enable_cache(entries);
+  }
+
   inline const volatile TrafficSpeed& trafficspeed(const DirectedEdge* de) const {
     auto directed_edge_index = std::distance(const_cast<const DirectedEdge*>(directededges_), de);
     return traffic_tile.trafficspeed(directed_edge_index);
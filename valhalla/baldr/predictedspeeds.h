@@ -2,6 +2,9 @@
 #define VALHALLA_BALDR_PREDICTEDSPEEDS_H_
 
 #include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
 #include <valhalla/midgard/util.h>
 
 namespace valhalla {
@@ -9,7 +12,8 @@ namespace baldr {
 
 constexpr uint32_t kSpeedBucketSizeMinutes = 5;
 constexpr uint32_t kSpeedBucketSizeSeconds = kSpeedBucketSizeMinutes * 60;
-constexpr uint32_t kBucketsPerWeek = (7 * 24 * 60) / kSpeedBucketSizeMinutes;
+constexpr uint32_t kBucketsPerDay = (24 * 60) / kSpeedBucketSizeMinutes;
+constexpr uint32_t kBucketsPerWeek = 7 * kBucketsPerDay;
 
 // Length of transformed speed buckets array.
 constexpr uint32_t kCoefficientCount = 200;
@@ -33,6 +37,19 @@ std::array<int16_t, kCoefficientCount> compress_speed_buckets(const float* speed
  */
 float decompress_speed_bucket(const int16_t* coefficients, uint32_t bucket_idx);
 
+/**
+ * Recover the speed values of a range of consecutive buckets at once. This is a lot cheaper than
+ * recovering them one by one as the coefficients are only converted once.
+ * @param coefficients  Transformed speed buckets (must be 200 values).
+ * @param first_bucket  Index of the first bucket we want to recover.
+ * @param count         Number of buckets to recover, wrapping around the end of the week.
+ * @param speeds        Gets the speed values (in KPH), must have room for count values.
+ */
+void decompress_speed_buckets(const int16_t* coefficients,
+                              uint32_t first_bucket,
+                              uint32_t count,
+                              float* speeds);
+
 /**
  * Pack transformed speed values into base64-encoded string.
  * @param coefficients  Array of transformed speed buckets (must be 200 values).
@@ -87,13 +104,60 @@ public:
     // to DirectedEdge::has_predicted_speed being false.
     const int16_t* coefficients = profiles_ + offset_[idx];
 
-    return decompress_speed_bucket(coefficients, seconds_of_week / kSpeedBucketSizeSeconds);
+    const uint32_t bucket = seconds_of_week / kSpeedBucketSizeSeconds;
+    if (!cache_) {
+      return decompress_speed_bucket(coefficients, bucket);
+    }
+
+    // Look for it in the cache and decode and remember it if it isn't there
+    const uint64_t key = (static_cast<uint64_t>(idx) << 11) | bucket;
+    auto& slot = cache_[static_cast<uint32_t>(key * 0x9E3779B1u) >> cache_shift_];
+    uint64_t entry = slot.load(std::memory_order_relaxed);
+    float speed;
+    if ((entry >> 32) == key) {
+      uint32_t bits = static_cast<uint32_t>(entry);
+      std::memcpy(&speed, &bits, sizeof(speed));
+      return speed;
+    }
+    speed = decompress_speed_bucket(coefficients, bucket);
+    uint32_t bits;
+    std::memcpy(&bits, &speed, sizeof(bits));
+    slot.store((key << 32) | bits, std::memory_order_relaxed);
+    return speed;
+  }
+
+  /**
+   * Get the speeds of a range of consecutive buckets for the edge.
+   * @param  idx           Directed edge index.
+   * @param  first_bucket  Index of the first bucket of the week.
+   * @param  count         Number of buckets, wrapping around the end of the week.
+   * @param  speeds        Gets the speeds, must have room for count values.
+   */
+  void speeds(const uint32_t idx,
+              const uint32_t first_bucket,
+              const uint32_t count,
+              float* speeds) const {
+    decompress_speed_buckets(profiles_ + offset_[idx], first_bucket, count, speeds);
   }
 
+  /**
+   * Keep the speeds decoded by speed() in a direct mapped cache so that edges that are costed over
+   * and over again at the same time of the week, like they are when many requests leave now, are
+   * only decoded once. Concurrent readers are fine but this must be called before the tile is
+   * shared between threads.
+   * @param  entries  Number of cached speeds, rounded up to a power of 2. 0 disables the cache.
+   */
+  void enable_cache(const uint32_t entries);
+
 protected:
   const uint32_t* offset_;  // Offset into the array of compressed speed profiles
                             // for each directed edge
   const int16_t* profiles_; // Compressed speed profiles
+
+  // Decoded speeds, each entry holds the edge index and bucket (the key) in its upper 32 bits and
+  // the speed in its lower 32 bits. Empty entries are all ones which no key can match
+  std::unique_ptr<std::atomic<uint64_t>[]> cache_;
+  uint32_t cache_shift_ = 32;
 };
 
 } // namespace baldr
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <valhalla/baldr/graphreader.h>
+#include <valhalla/baldr/graphtile.h>
+#include <valhalla/midgard/sequence.h>
+
+namespace valhalla {
+namespace baldr {
+
+/**
+ * The bounding boxes of the edges in the bins of the tiles of the most detailed hierarchy level,
+ * laid out per tile in the same order as the tile's edge bins. Searching for the edges near a
+ * location can skip the shape of any edge whose box is too far away to matter without decoding it.
+ *
+ * The file is a fixed size header followed by the tiles sorted by id and then the boxes, so it is
+ * memory mapped as is and shared by every process that loads it. The header has the dataset id of
+ * the tiles and each tile a checksum of the header of the tile it was built from, a tile that does
+ * not match is not searched with the index.
+ */
+class SpatialIndex {
+public:
+  // The box of an edge, rounded outwards so that it always contains the shape
+  struct box_t {
+    float min_lng;
+    float min_lat;
+    float max_lng;
+    float max_lat;
+  };
+
+  // The range of boxes that belongs to a tile
+  struct tile_t {
+    uint32_t tile_id;   // tile_value() of the tile
+    uint32_t box_count; // number of edges in the bins of the tile when the index was built
+    uint64_t first_box; // index of the box of the first edge of the first bin of the tile
+    uint64_t checksum;  // Checksum() of the tile when the index was built
+  };
+
+  /**
+   * Maps an index written by Save
+   * @param file_name  the file to map
+   * @return the index, throws if the file could not be read or is not a spatial index
+   */
+  static std::shared_ptr<const SpatialIndex> Load(const std::string& file_name);
+
+  /**
+   * Writes an index
+   * @param file_name   where to write it
+   * @param dataset_id  the dataset id of the tiles
+   * @param tiles       the tiles sorted by tile_id
+   * @param boxes       the boxes of the tiles
+   */
+  static void Save(const std::string& file_name,
+                   const uint64_t dataset_id,
+                   const std::vector<tile_t>& tiles,
+                   const std::vector<box_t>& boxes);
+
+  /**
+   * A checksum of the header of a tile, which has its dataset id, its size and the offsets of all
+   * its parts including the bins
+   * @param tile  the tile
+   * @return the checksum
+   */
+  static uint64_t Checksum(const GraphTile& tile);
+
+  /**
+   * The box of an edge which contains the given shape
+   * @param shape  the shape of the edge
+   * @return the box
+   */
+  static box_t Box(const std::vector<midgard::PointLL>& shape);
+
+  /**
+   * The boxes of the edges in the bins of a tile. The box of the i-th edge of bin b is at
+   * header()->bin_offset(b).first + i.
+   * @param tile  the tile
+   * @return the boxes or null if the tile is not in the index or changed since
+   */
+  const box_t* boxes(const GraphTile& tile) const;
+
+  /**
+   * Whether the index was built from the tiles of a reader, judging by the first tile of the index
+   * the reader has
+   * @param reader  the reader of the tiles
+   * @return false if the dataset id or the checksum of the tile differs
+   */
+  bool Matches(GraphReader& reader) const;
+
+  uint64_t dataset_id() const {
+    return dataset_id_;
+  }
+
+  size_t tile_count() const {
+    return tile_count_;
+  }
+
+  size_t box_count() const {
+    return box_count_;
+  }
+
+  SpatialIndex(const SpatialIndex&) = delete;
+  SpatialIndex& operator=(const SpatialIndex&) = delete;
+
+private:
+  SpatialIndex() = default;
+
+  midgard::mem_map<char> file_;
+  uint64_t dataset_id_ = 0;
+  const tile_t* tiles_ = nullptr;
+  size_t tile_count_ = 0;
+  const box_t* boxes_ = nullptr;
+  size_t box_count_ = 0;
+};
+
+} // namespace baldr
+} // namespace valhalla
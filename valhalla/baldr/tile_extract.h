@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <valhalla/midgard/sequence.h>
+
+namespace valhalla {
+namespace baldr {
+
+/**
+ * The layout of a tile extract that indexes itself. It is an ordinary tar of the tiles of a tile
+ * directory, so tar can still list and extract it, whose first entry is an index of the tiles
+ * sorted by id with where their data is in the tar. Finding a tile only takes mapping the tar and a
+ * binary search of the index, none of the other tar headers have to be read. The index starts with
+ * a header holding a magic number, a version, a byte order mark and the number of tiles, an index
+ * without a header this code understands is ignored.
+ *
+ * The data of every tile starts on a page boundary so that no two tiles share a page of the map.
+ * Padding is put in front of a tile as a pax extended header holding only a comment, which tar
+ * skips.
+ */
+class TileExtract {
+public:
+  // Where a tile is in the tar
+  struct tile_t {
+    uint64_t tile_id; // the id of the tile
+    uint64_t offset;  // from the start of the tar to the data of the tile
+    uint64_t size;    // of the data of the tile
+  };
+
+  // The name of the first entry of an indexed extract
+  static const std::string kIndexName;
+
+  // The data of every tile starts on a multiple of this
+  static constexpr uint64_t kAlignment = 4096;
+
+  /**
+   * Finds the index of a tar that was written by Save
+   * @param archive  the tar, which only needs its first entry to be found
+   * @return the tiles sorted by id or an empty range if the tar has no index this code can read
+   */
+  static std::pair<const tile_t*, const tile_t*> Index(const midgard::tar& archive);
+
+  /**
+   * Writes the tiles of a tile directory to an indexed extract
+   * @param file_name  where to write it, it replaces any file there at once when done
+   * @param tile_dir   the tile directory
+   * @return the number of tiles written, throws if the extract could not be written
+   */
+  static size_t Save(const std::string& file_name, const std::string& tile_dir);
+};
+
+} // namespace baldr
+} // namespace valhalla
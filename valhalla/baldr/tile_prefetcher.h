@@ -0,0 +1,146 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <valhalla/baldr/graphid.h>
+
+namespace valhalla {
+namespace baldr {
+
+class TileCache;
+
+/**
+ * Loads tiles into the process wide tile cache on a pool of background threads so that the
+ * searches find them already decompressed in memory instead of blocking on disk, the tar extract
+ * or the network. Every tile a search has to wait on, or uses for the first time after it was
+ * prefetched, queues its neighbors at the same level so the prefetching follows the search
+ * frontier. Requests for a tile are deduplicated until the tile has been loaded.
+ *
+ * The prefetched tiles only reach the searches through a cache they share with the background
+ * threads, so this is only used together with use_concurrent_mem_cache. One of the threads logs
+ * the counters every prefetch_stats_interval seconds while they change.
+ */
+class tile_prefetcher_t {
+public:
+  // Snapshot of the counters of the prefetcher
+  struct stats_t {
+    uint64_t requested; // tiles queued for prefetching
+    uint64_t dropped;   // requests dropped because the queue was full
+    uint64_t loaded;    // tiles the background threads put into the cache
+    uint64_t redundant; // tiles that were already in the cache when their turn came
+    uint64_t hits;      // first uses of a prefetched tile by a search
+    uint64_t late;      // searches that had to load a tile themselves while it was still queued
+    uint64_t misses;    // searches that had to load a tile that was never requested
+    uint64_t evicted;   // prefetched tiles that left the cache before a search used them
+    uint64_t missing;   // requested tiles that are not in the tileset, never requested again
+  };
+
+  /**
+   * Gets the prefetcher shared by all readers of the process, starting its threads on first use
+   * @param pt  the mjolnir config, prefetch_threads and prefetch_queue_size configure the pool
+   * @return the prefetcher or nullptr if prefetching is disabled
+   */
+  static std::shared_ptr<tile_prefetcher_t> get_instance(const boost::property_tree::ptree& pt);
+
+  /**
+   * Starts the background threads, each with its own reader over the shared cache
+   * @param pt  the mjolnir config
+   */
+  explicit tile_prefetcher_t(const boost::property_tree::ptree& pt);
+
+  /**
+   * Stops and joins the background threads, pending requests are discarded
+   */
+  ~tile_prefetcher_t();
+
+  /**
+   * Queues a tile to be loaded into the cache unless it's already queued or loaded
+   * @param tile_id  the tile to load
+   */
+  void prefetch(const GraphId& tile_id);
+
+  /**
+   * Queues the (up to 8) tiles around a tile at the same hierarchy level
+   * @param tile_id  the tile whose neighbors we want
+   */
+  void prefetch_neighbors(const GraphId& tile_id);
+
+  /**
+   * Lets the prefetcher know a search found the tile in the cache. If it was prefetched and this
+   * is the first use of it, it counts as a hit and its neighbors get queued
+   * @param tile_id  the tile that was used
+   */
+  void cache_hit(const GraphId& tile_id);
+
+  /**
+   * Lets the prefetcher know a search is about to load the tile itself, counting it as late if
+   * the tile was already queued, as evicted if it was prefetched but never used or as a miss
+   * otherwise. An evicted tile can be prefetched again. Unless the tile is known not to exist its
+   * neighbors get queued
+   * @param tile_id  the tile that is being loaded
+   */
+  void cache_miss(const GraphId& tile_id);
+
+  /**
+   * @return a snapshot of the counters
+   */
+  stats_t stats() const;
+
+  /**
+   * Logs a snapshot of the counters at info level
+   */
+  void log_stats() const;
+
+protected:
+  // Where a tile is in its prefetching life cycle
+  enum state_t : uint8_t { kIdle = 0, kQueued = 1, kPrefetched = 2, kMissing = 3 };
+
+  inline uint32_t get_offset(const GraphId& tile_id) const {
+    return tile_id.level() < 4 ? index_offsets_[tile_id.level()] + tile_id.tileid()
+                               : states_.size();
+  }
+
+  // Body of the background threads, the one that reports logs the counters now and then
+  void work(boost::property_tree::ptree pt, const bool report);
+
+  // Our view of the cache shared with the searches
+  std::unique_ptr<TileCache> cache_;
+
+  // Per tile state, indexed like FlatTileCache
+  std::vector<std::atomic<uint8_t>> states_;
+  std::array<uint32_t, 4> index_offsets_;
+
+  // The work queue
+  std::mutex mutex_;
+  std::condition_variable signal_;
+  std::deque<GraphId> queue_;
+  size_t max_queue_size_;
+  std::chrono::seconds stats_interval_;
+  bool done_;
+  std::vector<std::thread> threads_;
+
+  // Counters
+  std::atomic<uint64_t> requested_;
+  std::atomic<uint64_t> dropped_;
+  std::atomic<uint64_t> loaded_;
+  std::atomic<uint64_t> redundant_;
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> late_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> evicted_;
+  std::atomic<uint64_t> missing_;
+};
+
+} // namespace baldr
+} // namespace valhalla
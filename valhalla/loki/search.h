@@ -6,6 +6,7 @@
 #include <valhalla/baldr/graphreader.h>
 #include <valhalla/baldr/location.h>
 #include <valhalla/baldr/pathlocation.h>
+#include <valhalla/baldr/spatial_index.h>
 #include <valhalla/sif/dynamiccost.h>
 
 #include <functional>
@@ -22,13 +23,16 @@ namespace loki {
  * proper cache
  * @param edge_filter    a costing object by which we can determine which portions of the graph are
  *                       accessable and therefor potential candidates
+ * @param spatial_index  optional boxes of the edges in the bins which let the search skip the
+ *                       shapes of edges that are too far away, the results are the same without it
  * @return pathLocations the correlated data with in the tile that matches the inputs. If a
  * projection is not found, it will not have any entry in the returned value.
  */
 std::unordered_map<baldr::Location, baldr::PathLocation>
 Search(const std::vector<baldr::Location>& locations,
        baldr::GraphReader& reader,
-       const std::shared_ptr<sif::DynamicCost>& costing);
+       const std::shared_ptr<sif::DynamicCost>& costing,
+       const std::shared_ptr<const baldr::SpatialIndex>& spatial_index = nullptr);
 
 } // namespace loki
 } // namespace valhalla
@@ -11,6 +11,7 @@
 #include <valhalla/baldr/location.h>
 #include <valhalla/baldr/pathlocation.h>
 #include <valhalla/baldr/rapidjson_utils.h>
+#include <valhalla/baldr/spatial_index.h>
 #include <valhalla/midgard/pointll.h>
 #include <valhalla/proto/options.pb.h>
 #include <valhalla/sif/costfactory.h>
@@ -21,6 +22,9 @@
 namespace valhalla {
 namespace loki {
 
+// Default number of traces a batch of traces may have
+constexpr size_t kDefaultMaxTraces = 5000;
+
 #ifdef HAVE_HTTP
 void run_service(const boost::property_tree::ptree& config);
 #endif
@@ -41,6 +45,8 @@ public:
   void matrix(Api& request);
   void isochrones(Api& request);
   void trace(Api& request);
+  void trace_batch(Api& request);
+  void online_match(Api& request);
   std::string height(Api& request);
   std::string transit_available(Api& request);
 
@@ -59,6 +65,7 @@ protected:
   void init_matrix(Api& request);
   void init_isochrones(Api& request);
   void init_trace(Api& request);
+  void init_trace_shape(Api& request);
   std::vector<midgard::PointLL> init_height(Api& request);
   void init_transit_available(Api& request);
 
@@ -67,6 +74,7 @@ protected:
   sif::cost_ptr_t costing;
   std::shared_ptr<baldr::GraphReader> reader;
   std::shared_ptr<baldr::connectivity_map_t> connectivity_map;
+  std::shared_ptr<const baldr::SpatialIndex> spatial_index;
   std::unordered_set<Options::Action> actions;
   std::string action_str;
   std::unordered_map<std::string, size_t> max_locations;
@@ -91,6 +99,7 @@ protected:
   size_t max_contour_min;
   size_t max_contour_km;
   size_t max_trace_shape;
+  size_t max_traces;
   float max_gps_accuracy;
   float max_search_radius;
   unsigned int max_best_paths;
@@ -4,6 +4,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <memory>
+#include <mutex>
 #include <tuple>
 
 #include <boost/property_tree/ptree.hpp>
@@ -34,11 +36,46 @@ public:
                                                  const sif::cost_ptr_t& costing = nullptr) const = 0;
 };
 
-class CandidateGridQuery final : public CandidateQuery {
+/**
+ * The grids of the bins indexed for candidate searches. The cache can be shared by the candidate
+ * queries of several threads, each one indexes the bins it misses with its own graph reader.
+ */
+class CandidateGridCache {
 public:
   using grid_t = GridRangeQuery<baldr::GraphId, midgard::PointLL>;
 
-  CandidateGridQuery(baldr::GraphReader& reader, float cell_width, float cell_height);
+  /**
+   * Get the grid of a bin
+   * @param bin_id  the bin
+   * @return the grid or null if the bin was not indexed yet
+   */
+  std::shared_ptr<const grid_t> Find(const int32_t bin_id) const;
+
+  /**
+   * Add the grid of a bin. When another thread added the bin in the meantime its grid is kept
+   * @param bin_id  the bin
+   * @param grid    the grid of the bin
+   * @return the grid that is kept for the bin
+   */
+  std::shared_ptr<const grid_t> Insert(const int32_t bin_id, std::shared_ptr<const grid_t> grid);
+
+  size_t size() const;
+
+  void Clear();
+
+private:
+  mutable std::mutex mutex_;
+  std::unordered_map<int32_t, std::shared_ptr<const grid_t>> grids_;
+};
+
+class CandidateGridQuery final : public CandidateQuery {
+public:
+  using grid_t = CandidateGridCache::grid_t;
+
+  CandidateGridQuery(baldr::GraphReader& reader,
+                     float cell_width,
+                     float cell_height,
+                     const std::shared_ptr<CandidateGridCache>& grid_cache = {});
 
   ~CandidateGridQuery() override;
 
@@ -64,20 +101,24 @@ public:
                                            edgeids.end(), costing);
   }
 
-  std::unordered_map<baldr::GraphId, grid_t>::size_type size() const {
-    return grid_cache_.size();
+  size_t size() const {
+    return grid_cache_->size();
   }
 
   void Clear() {
-    grid_cache_.clear();
+    grid_cache_->Clear();
+  }
+
+  const std::shared_ptr<CandidateGridCache>& grid_cache() const {
+    return grid_cache_;
   }
 
 private:
   // Get a grid for a specified bin within a tile. Tile support for
   // graph tiles and bins is provided to go between bin Ids and tile Ids.
-  const grid_t* GetGrid(const int32_t bin_id,
-                        const midgard::Tiles<midgard::PointLL>& tiles,
-                        const midgard::Tiles<midgard::PointLL>& bins) const;
+  std::shared_ptr<const grid_t> GetGrid(const int32_t bin_id,
+                                        const midgard::Tiles<midgard::PointLL>& tiles,
+                                        const midgard::Tiles<midgard::PointLL>& bins) const;
 
   std::unordered_set<baldr::GraphId> RangeQuery(const midgard::AABB2<midgard::PointLL>& range) const;
 
@@ -86,8 +127,8 @@ private:
   float cell_width_;
   float cell_height_;
 
-  // Grid cache - cached per "bin" within a graph tile
-  mutable std::unordered_map<int32_t, grid_t> grid_cache_;
+  // Grid cache - cached per "bin" within a graph tile, possibly shared with other queries
+  std::shared_ptr<CandidateGridCache> grid_cache_;
 
   baldr::GraphReader& reader_;
 };
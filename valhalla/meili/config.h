@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 #include <boost/property_tree/ptree.hpp>
 
 namespace valhalla {
@@ -62,6 +64,8 @@ struct Config {
     float interpolation_distance_meters = 10.f;
     // define if 'interpolation_distance' option can be reassigned with user request
     bool is_interpolation_distance_customizable = false;
+    // how many measurements online matching may hold back before it commits to the best path
+    uint32_t max_online_lag = 20;
 
     void Read(const boost::property_tree::ptree& params);
   };
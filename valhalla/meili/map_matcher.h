@@ -69,6 +69,33 @@ public:
   std::vector<MatchResults> OfflineMatch(const std::vector<Measurement>& measurements,
                                          uint32_t k = 1);
 
+  /**
+   * Match a trace one measurement at a time. The matcher holds on to the measurements whose match
+   * can still change and gives back the others as soon as the best paths to all the newer states
+   * agree on them, or once more than max_online_lag measurements are held back, in which case it
+   * commits to the best path so far. Everything given back is forgotten so the matcher only ever
+   * holds a window of the trace. Each measurement is given back exactly once, in order, and the
+   * state ids of the results are relative to the window they were matched in
+   * @param measurement  the next measurement of the trace
+   * @return the matches that became final, usually none or a few
+   */
+  MatchResults OnlineMatch(const Measurement& measurement);
+
+  /**
+   * End the trace being matched online
+   * @return the matches of the measurements that were still held back
+   */
+  MatchResults FinishOnlineMatch();
+
+  /**
+   * Share the routes between states with other matchers through a cache
+   * @param cache    the cache, null to stop sharing
+   * @param costing  the costing the matcher was made for
+   */
+  void set_transition_cache(const std::shared_ptr<TransitionCache>& cache, const Costing costing) {
+    transition_cost_model_.set_cache(cache, costing);
+  }
+
   /**
    * Set a callback that will throw when the map-matching should be aborted
    * @param interrupt_callback  the function to periodically call to see if we should abort
@@ -84,6 +111,13 @@ private:
 
   StateId::Time AppendMeasurement(const Measurement& measurement, const float sq_max_search_radius);
 
+  StateId::Time AppendMeasurement(const Measurement& measurement,
+                                  const std::vector<baldr::PathLocation>& candidates);
+
+  MatchResults CommitOnline(StateId::Time time, const StateId& stateid, bool finish);
+
+  void ReanchorOnline(StateId::Time time, const StateId& anchor);
+
   void RemoveRedundancies(const std::vector<StateId>& result,
                           const std::vector<MatchResult>& results);
 
@@ -109,6 +143,12 @@ private:
   EmissionCostModel emission_cost_model_;
 
   TransitionCostModel transition_cost_model_;
+
+  // The measurements of the online window that are interpolated rather than matched
+  std::unordered_map<StateId::Time, std::vector<Measurement>> online_interpolated_;
+
+  // Whether the first column of the online window is the state committed to last
+  bool online_anchored_;
 };
 
 /**
@@ -14,6 +14,7 @@
 #include <valhalla/meili/candidate_search.h>
 #include <valhalla/meili/config.h>
 #include <valhalla/meili/map_matcher.h>
+#include <valhalla/meili/transition_cache.h>
 
 namespace valhalla {
 namespace meili {
@@ -43,6 +44,22 @@ public:
 
   Config MergeConfig(const Options& options) const;
 
+  /**
+   * Share the candidate grids with another factory, typically the factory of another thread. The
+   * transition cache of the other factory, if any, is shared as well
+   * @param other  the factory to share the caches of
+   */
+  void ShareCaches(const MapMatcherFactory& other);
+
+  /**
+   * Set the cache the matchers created from here on share the routes between their states through.
+   * Only matchers created from the same options may share a cache
+   * @param cache  the cache, null to stop sharing routes
+   */
+  void set_transition_cache(const std::shared_ptr<TransitionCache>& cache) {
+    transitioncache_ = cache;
+  }
+
   void ClearFullCache();
 
   void ClearCache();
@@ -59,6 +76,8 @@ private:
   sif::CostFactory cost_factory_;
 
   std::shared_ptr<CandidateGridQuery> candidatequery_;
+
+  std::shared_ptr<TransitionCache> transitioncache_;
 };
 
 } // namespace meili
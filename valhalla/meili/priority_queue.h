@@ -41,6 +41,10 @@ public:
     return heap_.empty();
   }
 
+  bool contains(const typename T::id_type& id) const {
+    return handlers_.find(id) != handlers_.end();
+  }
+
   void clear() {
     heap_.clear();
     handlers_.clear();
@@ -50,6 +54,15 @@ public:
     return heap_.size();
   }
 
+  // Iterate the labels in no particular order
+  typename Heap::const_iterator begin() const {
+    return heap_.begin();
+  }
+
+  typename Heap::const_iterator end() const {
+    return heap_.end();
+  }
+
 protected:
   Heap heap_;
 
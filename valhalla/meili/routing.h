@@ -4,6 +4,7 @@
 #include <cstdint>
 
 #include <algorithm>
+#include <memory>
 #include <stdexcept>
 #include <unordered_map>
 #include <vector>
@@ -252,6 +253,16 @@ public:
     queue_.clear();
   }
 
+  /**
+   * Get roughly how much memory the labels and their status take.
+   * @return  Returns the size in bytes.
+   */
+  size_t memory() const {
+    return labels_.capacity() * sizeof(Label) +
+           node_status_.size() * (sizeof(baldr::GraphId) + sizeof(Status) + 2 * sizeof(void*)) +
+           dest_status_.size() * (sizeof(uint16_t) + sizeof(Status) + 2 * sizeof(void*));
+  }
+
   /**
    * Clear the status maps.
    */
@@ -269,6 +280,77 @@ private:
 
 using labelset_ptr_t = std::shared_ptr<LabelSet>;
 
+/**
+ * The parts of expanding a node that do not depend on the path that reached it. Searches towards
+ * the same measurement with the same costing expand mostly the same nodes, so they can look them up
+ * here instead of going back to the tiles and the costing for each of them.
+ */
+class ExpansionCache {
+public:
+  struct Edge {
+    baldr::GraphId edgeid;
+    const baldr::DirectedEdge* directededge;
+    uint16_t outbound_heading;
+    // Seconds it takes to traverse the whole edge
+    float secs;
+    // Heuristic cost at the end node, only set if the tile of the end node could be loaded
+    bool reachable;
+    float heuristic;
+  };
+
+  struct Node {
+    graph_tile_ptr tile;
+    // Null if the tile could not be loaded
+    const baldr::NodeInfo* nodeinfo;
+    bool allowed;
+    // All edges but shortcuts and transit connections
+    std::vector<Edge> edges;
+    std::vector<baldr::GraphId> transitions;
+  };
+
+  /**
+   * @param approximator   approximates the distance to the measurement searched for
+   * @param search_radius  the search radius of the measurement searched for
+   */
+  ExpansionCache(const midgard::DistanceApproximator<midgard::PointLL>& approximator,
+                 const float search_radius)
+      : approximator_(approximator), search_radius_(search_radius),
+        search_rad2_(search_radius * search_radius) {
+  }
+
+  /**
+   * Estimate the cost from a location to a destination within the search radius of the
+   * measurement. It must not overestimate, so it is the distance to the measurement minus the
+   * search radius, or zero within the search radius
+   */
+  float heuristic(const midgard::PointLL& lnglat) const {
+    float d2 = approximator_.DistanceSquared(lnglat);
+    return (d2 < search_rad2_) ? 0.0f : sqrtf(d2) - search_radius_;
+  }
+
+  /**
+   * Get the expansion of a node, working it out the first time it is asked for. Only searches with
+   * the same costing can share a cache
+   */
+  const Node&
+  node(baldr::GraphReader& reader, const sif::cost_ptr_t& costing, const baldr::GraphId& nodeid);
+
+private:
+  midgard::DistanceApproximator<midgard::PointLL> approximator_;
+  float search_radius_;
+  float search_rad2_;
+  std::unordered_map<baldr::GraphId, Node> nodes_;
+};
+
+/**
+ * The route from an origin to the states of the next column. The origin is at index 0 of the
+ * locations routed between so it is also the destination 0
+ */
+struct ColumnRoute {
+  std::unordered_map<uint16_t, uint32_t> results;
+  labelset_ptr_t labelset;
+};
+
 /**
  * Find the shortest paths between an origin and a set of destinations.
  * @param reader            a graph reader for tile access
@@ -301,6 +383,36 @@ find_shortest_path(baldr::GraphReader& reader,
                    const float max_dist,
                    const float max_time);
 
+/**
+ * Find the shortest paths from each of the candidates of a column to the candidates of the next
+ * column. The searches share the expansion of the nodes they reach and the lookups of the
+ * destinations, but each origin keeps labels and a queue of its own so that its route is exactly
+ * the one find_shortest_path would find from it on its own.
+ * @param reader            a graph reader for tile access
+ * @param origins           the candidates to route from
+ * @param edgelabels        for each origin the last label of the route that leads to it, if any
+ * @param destinations      the candidates of the next column
+ * @param approximator      used for quick approximation of the distance to goal for a* heuristic
+ * @param search_radius     also used for a* heuristic
+ * @param costing           used for doing best first expansion and checking access/restrictions
+ * @param turn_cost_table   array of turn costs based on turn angle
+ * @param max_dist          how far to allow the expansions to run
+ * @param max_time          how long to allow the expansions to run
+ * @return for each origin the label of each destination it reached, the destinations are numbered
+ *         from 1 as the origin itself is destination 0, and the labels to recover the paths from
+ */
+std::vector<ColumnRoute>
+find_shortest_paths(baldr::GraphReader& reader,
+                    const std::vector<baldr::PathLocation>& origins,
+                    const std::vector<const Label*>& edgelabels,
+                    const std::vector<baldr::PathLocation>& destinations,
+                    const midgard::DistanceApproximator<midgard::PointLL>& approximator,
+                    const float search_radius,
+                    sif::cost_ptr_t costing,
+                    const float turn_cost_table[181],
+                    const float max_dist,
+                    const float max_time);
+
 // Route path iterator. Methods to assist recovering route paths from Labels.
 class RoutePathIterator : public std::iterator<std::forward_iterator_tag, const Label> {
 public:
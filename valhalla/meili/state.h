@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <valhalla/baldr/pathlocation.h>
@@ -18,7 +19,8 @@ namespace meili {
 class State {
 public:
   State(const StateId& stateid, const baldr::PathLocation& candidate)
-      : stateid_(stateid), candidate_(candidate), labelset_(nullptr), label_idx_() {
+      : stateid_(stateid), candidate_(candidate), labelset_(nullptr), label_idx_(),
+        label_time_(kInvalidTime) {
   }
 
   const StateId& stateid() const {
@@ -40,14 +42,18 @@ public:
       throw std::runtime_error("expect valid labelset but got nullptr");
     }
 
-    // Cache results
+    // Cache results, the destinations are the states of the next column so they are indexed by id
     label_idx_.clear();
+    label_time_ = stateids.empty() ? kInvalidTime : stateids.front().time();
     uint16_t dest = 1; // dest at 0 is reserved for the origin
     uint16_t found = 0;
     for (const auto& stateid : stateids) {
       const auto it = results.find(dest);
       if (it != results.end()) {
-        label_idx_[stateid] = it->second;
+        if (label_idx_.size() <= stateid.id()) {
+          label_idx_.resize(stateid.id() + 1, baldr::kInvalidLabel);
+        }
+        label_idx_[stateid.id()] = it->second;
         ++found;
       }
       ++dest;
@@ -57,17 +63,17 @@ public:
   }
 
   const Label* last_label(const State& state) const {
-    const auto it = label_idx_.find(state.stateid());
-    if (it != label_idx_.end()) {
-      return &labelset_->label(it->second);
+    const auto idx = label_idx(state.stateid());
+    if (idx != baldr::kInvalidLabel) {
+      return &labelset_->label(idx);
     }
     return nullptr;
   }
 
   RoutePathIterator RouteBegin(const State& state) const {
-    const auto it = label_idx_.find(state.stateid());
-    if (it != label_idx_.end()) {
-      return RoutePathIterator(labelset_.get(), it->second);
+    const auto idx = label_idx(state.stateid());
+    if (idx != baldr::kInvalidLabel) {
+      return RoutePathIterator(labelset_.get(), idx);
     }
     return RoutePathIterator(labelset_.get());
   }
@@ -76,14 +82,38 @@ public:
     return RoutePathIterator(labelset_.get());
   }
 
+  /**
+   * Roughly how much memory the state takes, along with its routes unless they were counted already
+   * @param labelsets  the routes counted so far
+   */
+  size_t memory(std::unordered_set<const LabelSet*>& labelsets) const {
+    size_t bytes = candidate_.edges.capacity() * sizeof(baldr::PathLocation::PathEdge) +
+                   label_idx_.capacity() * sizeof(uint32_t);
+    if (labelset_ && labelsets.insert(labelset_.get()).second) {
+      bytes += labelset_->memory();
+    }
+    return bytes;
+  }
+
 private:
+  uint32_t label_idx(const StateId& stateid) const {
+    if (stateid.time() != label_time_ || label_idx_.size() <= stateid.id()) {
+      return baldr::kInvalidLabel;
+    }
+    return label_idx_[stateid.id()];
+  }
+
   StateId stateid_;
 
   baldr::PathLocation candidate_;
 
   mutable std::shared_ptr<LabelSet> labelset_;
 
-  mutable std::unordered_map<StateId, uint32_t> label_idx_;
+  // The label the route ends with at each state of the next column, by id
+  mutable std::vector<uint32_t> label_idx_;
+
+  // The time of the next column
+  mutable StateId::Time label_time_;
 };
 
 class StateContainer {
@@ -124,6 +154,21 @@ public:
     return static_cast<StateId::Time>(columns_.size());
   }
 
+  // Roughly how much memory the measurements, the states and the routes between them take
+  size_t memory() const {
+    std::unordered_set<const LabelSet*> labelsets;
+    size_t bytes = measurements_.capacity() * sizeof(Measurement) +
+                   leave_times_.capacity() * sizeof(double) +
+                   columns_.capacity() * sizeof(Column);
+    for (const auto& column : columns_) {
+      bytes += column.capacity() * sizeof(State);
+      for (const auto& state : column) {
+        bytes += state.memory(labelsets);
+      }
+    }
+    return bytes;
+  }
+
   // Check to see if we have the minimum number of measurements and edge candidates to perform a map
   // match. We need at least one measurements with a non-zero number of edge candidates.
   bool HasMinimumCandidates() {
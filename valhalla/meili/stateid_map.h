@@ -0,0 +1,129 @@
+// -*- mode: c++ -*-
+#ifndef MMP_STATEID_MAP_H_
+#define MMP_STATEID_MAP_H_
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include <valhalla/meili/stateid.h>
+
+namespace valhalla {
+namespace meili {
+
+/**
+ * Maps state ids to values kept in flat arrays, first indexed by the time of the state and then by
+ * its id. The ids of a column count up from zero for its candidates and down from the largest id
+ * for the clones the top-k search makes of them, so each column has an array for either end. The
+ * arrays are kept when the map is cleared so that searching the next trace allocates nothing until
+ * it outgrows the previous ones.
+ */
+template <typename T> class StateIdMap {
+public:
+  StateIdMap() : columns_(), size_(0) {
+  }
+
+  /**
+   * Add a value unless the state has one already
+   * @return true if it was added
+   */
+  bool emplace(const StateId& stateid, const T& value) {
+    auto& slot = Slot(stateid);
+    if (slot.used) {
+      return false;
+    }
+    slot.used = true;
+    slot.value = value;
+    return true;
+  }
+
+  /**
+   * Remove the value of a state, the value is reset so it does not hold on to anything
+   * @return true if it had one
+   */
+  bool erase(const StateId& stateid) {
+    auto* slot = FindSlot(*this, stateid);
+    if (!slot || !slot->used) {
+      return false;
+    }
+    slot->used = false;
+    slot->value = T{};
+    return true;
+  }
+
+  /**
+   * @return the value of a state or null if it has none
+   */
+  const T* find(const StateId& stateid) const {
+    const auto* slot = FindSlot(*this, stateid);
+    return slot && slot->used ? &slot->value : nullptr;
+  }
+
+  bool contains(const StateId& stateid) const {
+    return find(stateid) != nullptr;
+  }
+
+  /**
+   * Forget all the values but keep the arrays around for reuse
+   */
+  void clear() {
+    for (StateId::Time time = 0; time < size_; ++time) {
+      columns_[time].low.clear();
+      columns_[time].high.clear();
+    }
+    size_ = 0;
+  }
+
+private:
+  struct slot_t {
+    T value{};
+    bool used{false};
+  };
+
+  struct column_t {
+    std::vector<slot_t> low;
+    std::vector<slot_t> high;
+  };
+
+  static constexpr StateId::Id kHighIds = std::numeric_limits<StateId::Id>::max() / 2;
+
+  static size_t Index(const StateId::Id id) {
+    return id <= kHighIds ? id : std::numeric_limits<StateId::Id>::max() - id;
+  }
+
+  slot_t& Slot(const StateId& stateid) {
+    if (size_ <= stateid.time()) {
+      if (columns_.size() <= stateid.time()) {
+        columns_.resize(stateid.time() + 1);
+      }
+      size_ = stateid.time() + 1;
+    }
+    auto& column = columns_[stateid.time()];
+    auto& slots = stateid.id() <= kHighIds ? column.low : column.high;
+    const auto index = Index(stateid.id());
+    if (slots.size() <= index) {
+      slots.resize(index + 1);
+    }
+    return slots[index];
+  }
+
+  // Shared by the const and the non const lookups
+  template <typename map_t>
+  static auto FindSlot(map_t& map, const StateId& stateid) -> decltype(&map.columns_[0].low[0]) {
+    if (!stateid.IsValid() || map.size_ <= stateid.time()) {
+      return nullptr;
+    }
+    auto& column = map.columns_[stateid.time()];
+    auto& slots = stateid.id() <= kHighIds ? column.low : column.high;
+    const auto index = Index(stateid.id());
+    return index < slots.size() ? &slots[index] : nullptr;
+  }
+
+  // Columns past size_ are left over from earlier uses and empty
+  std::vector<column_t> columns_;
+  StateId::Time size_;
+};
+
+} // namespace meili
+} // namespace valhalla
+#endif // MMP_STATEID_MAP_H_
@@ -0,0 +1,107 @@
+// -*- mode: c++ -*-
+#ifndef MMP_TRANSITION_CACHE_H_
+#define MMP_TRANSITION_CACHE_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <valhalla/baldr/graphid.h>
+#include <valhalla/baldr/location.h>
+#include <valhalla/baldr/pathlocation.h>
+#include <valhalla/meili/routing.h>
+#include <valhalla/midgard/pointll.h>
+#include <valhalla/proto/options.pb.h>
+
+namespace valhalla {
+namespace meili {
+
+// Default number of transitions a cache remembers before it starts over
+constexpr size_t kDefaultTransitionCacheSize = 10000;
+
+/**
+ * Remembers the routes found from a candidate to the candidates of the next column so that
+ * matching the same transition again, for example in another trace of a batch, does not route
+ * again. A route is only reused when everything its search depends on is identical: the costing,
+ * the label leading into the origin, where every candidate is along each of its edges, the
+ * measurement routed to and the limits. Matching with the cache therefore gives the same results as
+ * matching without it, whichever thread routed a transition first. The cache can be shared by the
+ * matchers of several threads as long as they are made from the same options.
+ */
+class TransitionCache {
+public:
+  /**
+   * Everything the search from a candidate to the candidates of the next column depends on
+   */
+  struct Transition {
+    /**
+     * @param costing        the costing the search is done with
+     * @param edgelabel      the label leading into the origin, if any
+     * @param origin         the candidate the search starts at
+     * @param destinations   the candidates of the next column
+     * @param target         where the measurement of the next column is
+     * @param search_radius  the search radius of the measurement of the next column
+     * @param max_distance   how far the search may go
+     * @param max_time       how long the search may take
+     */
+    Transition(const Costing costing,
+               const Label* edgelabel,
+               const baldr::PathLocation& origin,
+               const std::vector<baldr::PathLocation>& destinations,
+               const midgard::PointLL& target,
+               const float search_radius,
+               const float max_distance,
+               const float max_time);
+
+    bool operator==(const Transition& other) const;
+
+    Costing costing;
+    baldr::GraphId predecessor;
+    uint8_t restriction_idx;
+    baldr::Location::StopType stop_type;
+    // The edges of the origin and then of each destination, the candidates are separated by an
+    // invalid edge id
+    std::vector<std::pair<baldr::GraphId, double>> edges;
+    midgard::PointLL target;
+    float search_radius;
+    float max_distance;
+    float max_time;
+  };
+
+  explicit TransitionCache(const size_t max_size = kDefaultTransitionCacheSize);
+
+  /**
+   * Get the route of a transition
+   * @param transition  the transition
+   * @return the route or null if the transition was not routed yet
+   */
+  std::shared_ptr<const ColumnRoute> Find(const Transition& transition) const;
+
+  /**
+   * Remember the route of a transition. The cache starts over when it is full
+   * @param transition  the transition
+   * @param route       what the search found, its labels must not change anymore
+   */
+  void Insert(Transition transition, const ColumnRoute& route);
+
+  size_t size() const;
+
+  void Clear();
+
+private:
+  // Hashes the first edges of the origin and of the first destination along with the costing
+  struct TransitionHash {
+    size_t operator()(const Transition& transition) const;
+  };
+
+  const size_t max_size_;
+  mutable std::mutex mutex_;
+  std::unordered_map<Transition, std::shared_ptr<const ColumnRoute>, TransitionHash> routes_;
+};
+
+} // namespace meili
+} // namespace valhalla
+#endif // MMP_TRANSITION_CACHE_H_
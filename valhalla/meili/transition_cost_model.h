@@ -2,12 +2,16 @@
 #define MMP_TRANSITION_COST_MODEL_H_
 
 #include <functional>
+#include <memory>
 
 #include <valhalla/baldr/graphreader.h>
 #include <valhalla/meili/config.h>
 #include <valhalla/meili/measurement.h>
+#include <valhalla/meili/routing.h>
 #include <valhalla/meili/state.h>
+#include <valhalla/meili/stateid_map.h>
 #include <valhalla/meili/topk_search.h>
+#include <valhalla/meili/transition_cache.h>
 #include <valhalla/meili/viterbi_search.h>
 #include <valhalla/sif/dynamiccost.h>
 
@@ -51,6 +55,21 @@ public:
 
   float operator()(const StateId& lhs, const StateId& rhs) const;
 
+  /**
+   * Share the routes between states with other matchers through a cache
+   * @param cache    the cache to look the routes up in and add them to, null to stop sharing
+   * @param costing  the costing of the travel mode the routes are found with
+   */
+  void set_cache(const std::shared_ptr<TransitionCache>& cache, const Costing costing) {
+    cache_ = cache;
+    costing_ = costing;
+  }
+
+  /**
+   * Forget the routes found ahead of time for the states of the trace being matched
+   */
+  void Clear();
+
 private:
   void UpdateRoute(const StateId& lhs, const StateId& rhs) const;
 
@@ -93,6 +112,22 @@ private:
   float turn_cost_table_[181];
 
   bool match_on_restrictions_{false};
+
+  // Routes shared with other matchers, if any, and the costing they are found with
+  std::shared_ptr<TransitionCache> cache_;
+  Costing costing_;
+
+  // A route found along with the route of another state of its column, before it was known which
+  // label the state is reached with. It is only used if the state turns out to be reached with the
+  // same predecessor edge and restriction
+  struct speculative_route_t {
+    baldr::GraphId predecessor;
+    uint8_t restriction_idx{0};
+    ColumnRoute route;
+  };
+
+  // Shared by the copies of the model the searches make, so that all of them see what is found
+  std::shared_ptr<StateIdMap<speculative_route_t>> speculative_routes_;
 };
 
 } // namespace meili
@@ -9,6 +9,7 @@
 
 #include <valhalla/meili/priority_queue.h>
 #include <valhalla/meili/stateid.h>
+#include <valhalla/meili/stateid_map.h>
 
 namespace valhalla {
 namespace meili {
@@ -25,6 +26,7 @@ constexpr float DefaultTransitionCostModel(const StateId&, const StateId&) {
 class StateLabel {
 public:
   using id_type = StateId;
+  StateLabel() = default;
   // Required by SPQueue
   StateLabel(double costsofar, const StateId& stateid, const StateId& predecessor);
 
@@ -92,6 +94,13 @@ public:
   virtual StateId SearchWinner(StateId::Time time) = 0;
   virtual StateId Predecessor(const StateId& stateid) const = 0;
   virtual double AccumulatedCost(const StateId& stateid) const = 0;
+  /**
+   * Whether a state has been reached and waits to be expanded, so that the routes from it are
+   * needed unless the search ends before it gets to it. The naive search expands every state
+   */
+  virtual bool Pending(const StateId& stateid) const {
+    return true;
+  }
 
   bool HasStateId(const StateId& stateid) const;
   StateIdIterator SearchPathVS(StateId::Time time, bool allow_breaks = true);
@@ -116,7 +125,7 @@ protected:
   std::vector<StateId> winner_by_time;
 
 private:
-  std::unordered_set<StateId> added_states_;
+  StateIdMap<bool> added_states_;
   IEmissionCostModel emission_cost_model_;
   ITransitionCostModel transition_cost_model_;
   const stateid_iterator path_end_;
@@ -164,6 +173,14 @@ public:
   StateId SearchWinner(StateId::Time time) override;
   StateId Predecessor(const StateId& stateid) const override;
   double AccumulatedCost(const StateId& stateid) const override;
+  bool Pending(const StateId& stateid) const override;
+
+  /**
+   * Find the latest state that the best path to any state searched in the future has to go
+   * through. Everything up to it can not change anymore no matter what columns are added later
+   * @return the converged state or an invalid state if the paths still open have nothing in common
+   */
+  StateId ConvergedState() const;
 
 private:
   // Initialize labels from a column and push them into priority queue
@@ -173,7 +190,7 @@ private:
   constexpr static bool IsInvalidCost(double cost);
 
   std::vector<std::vector<StateId>> unreached_states_by_time;
-  std::unordered_map<StateId, StateLabel> scanned_labels_;
+  StateIdMap<StateLabel> scanned_labels_;
   SPQueue<StateLabel> queue_;
   StateId::Time earliest_time_{0};
 };
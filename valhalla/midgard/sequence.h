@@ -2,11 +2,14 @@
 #define VALHALLA_MJOLNIR_SEQUENCE_H_
 
 #include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <cmath>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <functional>
 #include <iostream>
@@ -14,8 +17,11 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <queue>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
@@ -322,6 +328,90 @@ public:
     return;
   }
 
+  // sort the file based on the predicate without needing all of it in memory at once. runs of at
+  // most buffer_size / threads elements are sorted on the threads into a temporary file next to
+  // this one, then the runs are merged back into this file with a heap. the sort is stable so the
+  // order is the same for any buffer size and number of threads
+  void external_sort(const std::function<bool(const T&, const T&)>& predicate,
+                     size_t buffer_size = 1024 * 1024 * 512 / sizeof(T),
+                     unsigned int threads = 1) {
+    flush();
+    const size_t count = memmap.size();
+    if (count == 0) {
+      return;
+    }
+    threads = std::max(threads, 1u);
+    const size_t run_size = std::max(buffer_size / threads, static_cast<size_t>(1));
+    const size_t run_count = (count + run_size - 1) / run_size;
+
+    // if it all fits in one run there is nothing to merge
+    if (run_count == 1) {
+      std::stable_sort(static_cast<T*>(memmap), static_cast<T*>(memmap) + count, predicate);
+      return;
+    }
+
+    // each thread copies the next run into its buffer, sorts it and writes it to the runs file
+    const std::string runs_name = file_name + ".runs";
+    mem_map<T> runs;
+    runs.create(runs_name, count, POSIX_MADV_SEQUENTIAL);
+    std::atomic<size_t> next_run(0);
+    std::exception_ptr error;
+    std::mutex error_lock;
+    auto sort_runs = [&]() {
+      try {
+        std::vector<T> run;
+        run.reserve(std::min(run_size, count));
+        for (size_t r = next_run++; r < run_count; r = next_run++) {
+          const T* begin = static_cast<const T*>(memmap) + r * run_size;
+          const T* end = begin + std::min(run_size, count - r * run_size);
+          run.assign(begin, end);
+          std::stable_sort(run.begin(), run.end(), predicate);
+          std::copy(run.begin(), run.end(), runs.get() + r * run_size);
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_lock);
+        error = std::current_exception();
+        next_run = run_count;
+      }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < std::min<size_t>(threads, run_count); ++i) {
+      pool.emplace_back(sort_runs);
+    }
+    sort_runs();
+    for (auto& thread : pool) {
+      thread.join();
+    }
+    if (error) {
+      runs.unmap();
+      std::remove(runs_name.c_str());
+      std::rethrow_exception(error);
+    }
+
+    // merge the runs back into this file. the runs are laid out in order in the runs file so when
+    // elements are equivalent the one with the lower address goes first, which keeps it stable
+    using cursor_t = std::pair<const T*, const T*>;
+    auto after = [&predicate](const cursor_t& a, const cursor_t& b) {
+      return predicate(*b.first, *a.first) || (!predicate(*a.first, *b.first) && b.first < a.first);
+    };
+    std::priority_queue<cursor_t, std::vector<cursor_t>, decltype(after)> heap(after);
+    for (size_t r = 0; r < run_count; ++r) {
+      const T* begin = runs.get() + r * run_size;
+      heap.emplace(begin, begin + std::min(run_size, count - r * run_size));
+    }
+    T* out = static_cast<T*>(memmap);
+    while (!heap.empty()) {
+      auto cursor = heap.top();
+      heap.pop();
+      *out++ = *cursor.first;
+      if (++cursor.first != cursor.second) {
+        heap.push(cursor);
+      }
+    }
+    runs.unmap();
+    std::remove(runs_name.c_str());
+  }
+
   // perform an volatile operation on all the items of this sequence
   void transform(const std::function<void(T&)>& predicate) {
     flush();
@@ -578,9 +668,40 @@ struct tar {
       uint64_t rsum = octal_to_int(chksum);
       return rsum == usum || static_cast<int64_t>(rsum) == sum;
     }
+    // a ustar header for an entry, typeflag '0' is a regular file and 'x' extended attributes
+    static header_t make(const std::string& name, uint64_t size, char typeflag = '0') {
+      if (name.size() >= sizeof(header_t::name) || size >= (1ull << 33)) {
+        throw std::runtime_error("Tar entry is too large to describe: " + name);
+      }
+      header_t h{};
+      std::memcpy(h.name, name.data(), name.size());
+      std::snprintf(h.mode, sizeof(h.mode), "%07o", 0644);
+      std::snprintf(h.uid, sizeof(h.uid), "%07o", 0);
+      std::snprintf(h.gid, sizeof(h.gid), "%07o", 0);
+      std::snprintf(h.size, sizeof(h.size), "%011llo", static_cast<unsigned long long>(size));
+      std::snprintf(h.mtime, sizeof(h.mtime), "%011llo", 0ull);
+      h.typeflag = typeflag;
+      std::memcpy(h.magic, "ustar", 6);
+      std::memcpy(h.version, "00", 2);
+      // the checksum is taken with the checksum field as spaces
+      std::memset(h.chksum, ' ', sizeof(h.chksum));
+      uint64_t sum = 0;
+      for (size_t i = 0; i < sizeof(header_t); ++i) {
+        sum += reinterpret_cast<const unsigned char*>(&h)[i];
+      }
+      std::snprintf(h.chksum, sizeof(h.chksum), "%06llo", static_cast<unsigned long long>(sum));
+      return h;
+    }
   };
 
-  tar(const std::string& tar_file, bool regular_files_only = true)
+  /**
+   * Maps a tar and finds its entries
+   * @param tar_file            the tar to map
+   * @param regular_files_only  whether to only keep track of regular files
+   * @param traverse            whether to go through the whole tar, otherwise only the first
+   *                            entry is looked at for tars that index their contents in it
+   */
+  tar(const std::string& tar_file, bool regular_files_only = true, bool traverse = true)
       : tar_file(tar_file), corrupt_blocks(0) {
     // get the file size
     struct stat s;
@@ -603,7 +724,7 @@ struct tar {
     // but we can concatenate tars and get empty blocks in between so we'll just be pretty
     // lax about it and we'll count the ones we cant make sense of
     const char* position = mm.get();
-    while (position < mm.get() + mm.size()) {
+    while (position < mm.get() + mm.size() && (traverse || position == mm.get())) {
       // get the header for this file
       const header_t* h = static_cast<const header_t*>(static_cast<const void*>(position));
       position += sizeof(header_t);
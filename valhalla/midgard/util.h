@@ -626,6 +626,80 @@ struct projector_t {
   DistanceApproximator<PointLL> approx;
 };
 
+/**
+ * Projects the segments of a shape onto many points at once, keeping the closest projection of
+ * each point. The points are kept in separate arrays so that several of them are projected with
+ * each simd instruction, which pays off when many points survey the same shapes as is the case for
+ * a bulk of locations in the same bin. Gives the same results as a projector_t (followed by its
+ * approx.DistanceSquared) for each of the points.
+ */
+class projector_batch_t {
+public:
+  // forget all the points but keep the memory
+  void clear() {
+    lng_.clear();
+    lat_.clear();
+    lon_scale_.clear();
+    m_per_lng_degree_.clear();
+    sq_distance_.clear();
+    closest_lng_.clear();
+    closest_lat_.clear();
+    closest_index_.clear();
+  }
+
+  // add a point to project onto
+  void add(const projector_t& projector) {
+    lng_.push_back(projector.lng);
+    lat_.push_back(projector.lat);
+    lon_scale_.push_back(projector.lon_scale);
+    m_per_lng_degree_.push_back(projector.approx.GetLngScale() * kMetersPerDegreeLat);
+    sq_distance_.push_back(std::numeric_limits<double>::max());
+    closest_lng_.push_back(0);
+    closest_lat_.push_back(0);
+    closest_index_.push_back(0);
+  }
+
+  size_t size() const {
+    return lng_.size();
+  }
+
+  // start over with a new shape, a point that is skipped never takes a projection
+  void reset(size_t i, bool skip) {
+    sq_distance_[i] =
+        skip ? std::numeric_limits<double>::lowest() : std::numeric_limits<double>::max();
+  }
+
+  // project the index-th segment of the shape onto all the points
+  void operator()(const PointLL& u, const PointLL& v, uint64_t index);
+
+  // the squared distance of the closest projection of a point so far
+  double sq_distance(size_t i) const {
+    return sq_distance_[i];
+  }
+
+  // the closest projection of a point so far
+  PointLL closest(size_t i) const {
+    return {closest_lng_[i], closest_lat_[i]};
+  }
+
+  // the index of the segment the closest projection of a point is on
+  uint64_t closest_index(size_t i) const {
+    return closest_index_[i];
+  }
+
+private:
+  // the points and what is needed to project onto them
+  std::vector<double> lng_;
+  std::vector<double> lat_;
+  std::vector<double> lon_scale_;
+  std::vector<double> m_per_lng_degree_;
+  // the closest projections so far
+  std::vector<double> sq_distance_;
+  std::vector<double> closest_lng_;
+  std::vector<double> closest_lat_;
+  std::vector<uint64_t> closest_index_;
+};
+
 /**
  * Convert the input units, in either imperial or metric, into meters.
  * @param   units_km_or_mi (kms or miles), to convert to meters
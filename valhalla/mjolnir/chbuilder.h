@@ -0,0 +1,41 @@
+#ifndef VALHALLA_MJOLNIR_CHBUILDER_H
+#define VALHALLA_MJOLNIR_CHBUILDER_H
+
+#include <memory>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <valhalla/baldr/ch_overlay.h>
+#include <valhalla/baldr/graphreader.h>
+#include <valhalla/sif/dynamiccost.h>
+
+namespace valhalla {
+namespace mjolnir {
+
+/**
+ * Class used to build the contraction hierarchy overlays the matrix uses for requests that don't
+ * change the default costing options.
+ */
+class CHBuilder {
+public:
+  /**
+   * Builds an overlay for each of mjolnir.ch_overlay_costings and writes them as
+   * <costing>.ch into mjolnir.ch_overlay_dir
+   * @param pt  the config
+   */
+  static void Build(const boost::property_tree::ptree& pt);
+
+  /**
+   * Contracts the road network (every level but transit) for a costing
+   * @param reader   gives access to the tiles
+   * @param costing  decides which edges can be used and what they cost
+   * @return the overlay
+   */
+  static std::shared_ptr<baldr::CHOverlay> Contract(baldr::GraphReader& reader,
+                                                    const sif::cost_ptr_t& costing);
+};
+
+} // namespace mjolnir
+} // namespace valhalla
+
+#endif // VALHALLA_MJOLNIR_CHBUILDER_H
@@ -65,6 +65,13 @@ public:
    */
   void StoreTileData();
 
+  /**
+   * Output the tile to file under a different directory than the one it was read from.
+   * Stores as binary data.
+   * @param  tile_dir  Base directory path to store the tile under
+   */
+  void StoreTileData(const std::string& tile_dir);
+
   /**
    * Update a graph tile with new nodes and directed edges. Assumes no new
    * nodes or edges are added. Attributes within existing nodes and edges
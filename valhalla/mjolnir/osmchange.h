@@ -0,0 +1,49 @@
+#ifndef VALHALLA_MJOLNIR_OSMCHANGE_H
+#define VALHALLA_MJOLNIR_OSMCHANGE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <valhalla/baldr/graphid.h>
+#include <valhalla/midgard/pointll.h>
+
+namespace valhalla {
+namespace mjolnir {
+
+/**
+ * The parts of an OSM change file (.osc or .osc.gz) that tell which tiles of the route graph it
+ * can change. Only the ids and locations are kept, tags are not needed to find the tiles.
+ */
+struct OSMChange {
+  // Ways that were created, modified or deleted or are members of a changed relation
+  std::unordered_set<uint64_t> way_ids;
+  // Where the created, modified and deleted nodes are. Deleted nodes are only here if the file
+  // kept their last location
+  std::vector<midgard::PointLL> points;
+
+  /**
+   * Reads a change file, which may be gzipped
+   * @param file_name  the file to read
+   * @return the change, throws if the file could not be read or is not an OSM change file
+   */
+  static OSMChange Read(const std::string& file_name);
+
+  /**
+   * Finds the tiles of the graph in mjolnir.tile_dir that need to be rebuilt for the change. These
+   * are the tiles of the most detailed level that hold a changed node or an edge of a changed way,
+   * the tiles of that level with edges ending in those and the tiles of the other levels covering
+   * any of them.
+   * @param pt  the config
+   * @return the affected tiles
+   */
+  std::unordered_set<baldr::GraphId> AffectedTiles(const boost::property_tree::ptree& pt) const;
+};
+
+} // namespace mjolnir
+} // namespace valhalla
+
+#endif // VALHALLA_MJOLNIR_OSMCHANGE_H
@@ -32,7 +32,10 @@
 #define __OSMPBFPARSER__
 
 #include <fstream>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 // this describes the low-level blob storage
 #include <valhalla/proto/fileformat.pb.h>
@@ -65,6 +68,17 @@ struct Member {
   Member(Member&& other);
 };
 
+// Works out what the tags of an object turn into ahead of its callback. Every decoder thread has a
+// transform of its own, so it can hold state that is not thread safe but must not touch anything
+// the callbacks change
+struct TagTransform {
+  virtual ~TagTransform(){};
+  // fills in the transformed tags and returns true, or returns false to leave the object to its
+  // callback
+  virtual bool
+  operator()(const Interest type, const uint64_t osmid, const Tags& tags, Tags& transformed) = 0;
+};
+
 // pure virtual interface for consumers to implement
 struct Callback {
   virtual ~Callback(){};
@@ -75,14 +89,44 @@ struct Callback {
   virtual void
   relation_callback(const uint64_t osmid, const Tags& tags, const std::vector<Member>& members) = 0;
   virtual void changeset_callback(const uint64_t changeset_id) = 0;
+
+  // a transform for a decoder thread, by default there is none and the tags are left as they are
+  virtual std::unique_ptr<TagTransform> tag_transform() {
+    return nullptr;
+  }
+  // the callbacks with the tags as transformed on a decoder thread, or null if they were not
+  virtual void node_callback(const uint64_t osmid,
+                             const double lng,
+                             const double lat,
+                             const Tags& tags,
+                             const Tags* transformed) {
+    node_callback(osmid, lng, lat, tags);
+  }
+  virtual void way_callback(const uint64_t osmid,
+                            const Tags& tags,
+                            const std::vector<uint64_t>& nodes,
+                            const Tags* transformed) {
+    way_callback(osmid, tags, nodes);
+  }
+  virtual void relation_callback(const uint64_t osmid,
+                                 const Tags& tags,
+                                 const std::vector<Member>& members,
+                                 const Tags* transformed) {
+    relation_callback(osmid, tags, members);
+  }
 };
 
 // the parser used to get data out of the osmpbf file
 class Parser {
 public:
   Parser() = delete;
-  // parse the pbf file for the things you are interested in
-  static void parse(std::ifstream& file, const Interest interest, Callback& callback);
+  // parse the pbf file for the things you are interested in. with more than one thread the blobs
+  // are inflated, decoded and their tags transformed in parallel but the callbacks are still made
+  // on the calling thread and in the same order as with one thread
+  static void parse(std::ifstream& file,
+                    const Interest interest,
+                    Callback& callback,
+                    const unsigned int threads = 1);
   // clean up protobuf library level memory, this will make protobuf unusable after its called
   static void free();
 };
@@ -0,0 +1,38 @@
+#ifndef VALHALLA_MJOLNIR_SPATIALINDEXBUILDER_H
+#define VALHALLA_MJOLNIR_SPATIALINDEXBUILDER_H
+
+#include <string>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <valhalla/baldr/graphreader.h>
+#include <valhalla/baldr/spatial_index.h>
+
+namespace valhalla {
+namespace mjolnir {
+
+/**
+ * Class used to build the spatial index loki uses to skip the shapes of far away edges when it
+ * searches for the edges near a location.
+ */
+class SpatialIndexBuilder {
+public:
+  /**
+   * Builds the index and writes it to mjolnir.spatial_index_file
+   * @param pt  the config
+   */
+  static void Build(const boost::property_tree::ptree& pt);
+
+  /**
+   * Collects the boxes of the edges in the bins of every tile of the most detailed level and
+   * writes them out
+   * @param reader     gives access to the tiles
+   * @param file_name  where to write the index
+   */
+  static void Build(baldr::GraphReader& reader, const std::string& file_name);
+};
+
+} // namespace mjolnir
+} // namespace valhalla
+
+#endif // VALHALLA_MJOLNIR_SPATIALINDEXBUILDER_H
@@ -0,0 +1,103 @@
+#ifndef VALHALLA_MJOLNIR_TILESCHEDULER_H
+#define VALHALLA_MJOLNIR_TILESCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <valhalla/baldr/graphid.h>
+
+namespace valhalla {
+namespace mjolnir {
+
+/**
+ * Hands out the tiles of a tile parallel build stage to its worker threads. The tiles are sorted
+ * by how much work they are expected to be and dealt out to a queue per worker so that every
+ * worker starts on the most expensive tiles it has. A worker that runs out of tiles steals the
+ * cheapest tile left in the queue of another worker, so a few dense tiles can not leave the other
+ * threads idle at the end of a stage. Every tile is handed out exactly once.
+ */
+class TileScheduler {
+public:
+  using tile_costs_t = std::vector<std::pair<baldr::GraphId, uint64_t>>;
+
+  /**
+   * @param tiles        the tiles and how much work each one is expected to be, in any unit
+   * @param concurrency  the most workers to use. There are never more workers than tiles
+   */
+  TileScheduler(tile_costs_t tiles, unsigned int concurrency);
+
+  /**
+   * Estimates the work for tiles by the sizes of their files in a tile directory
+   * @param tile_dir  the tile directory
+   * @param tiles     the tiles
+   * @return the tiles with the sizes of their files, zero for tiles without a file
+   */
+  template <typename tiles_t>
+  static tile_costs_t FileSizes(const std::string& tile_dir, const tiles_t& tiles) {
+    tile_costs_t costs;
+    for (const auto& tile_id : tiles) {
+      costs.emplace_back(tile_id, FileSize(tile_dir, tile_id));
+    }
+    return costs;
+  }
+
+  /**
+   * The number of workers, which is how many threads the stage should start
+   */
+  unsigned int concurrency() const {
+    return static_cast<unsigned int>(workers_.size());
+  }
+
+  /**
+   * The number of tiles to be handed out
+   */
+  size_t size() const {
+    return tile_count_;
+  }
+
+  /**
+   * Takes the next tile for a worker. Calling it again means the worker is done with the tile.
+   * @param worker   the index of the worker, less than concurrency()
+   * @param tile_id  set to the tile to work on
+   * @return false once there are no tiles left for any worker
+   */
+  bool Next(unsigned int worker, baldr::GraphId& tile_id);
+
+  /**
+   * Logs how long the stage took and how much of that time the workers spent on tiles. Call it
+   * once all the workers are done.
+   * @param stage  what the workers did to the tiles
+   */
+  void LogUtilization(const std::string& stage) const;
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  struct worker_t {
+    std::mutex lock;
+    std::deque<baldr::GraphId> tiles;
+    bool working = false;
+    clock::time_point started;
+    clock::duration busy{};
+    clock::time_point finished;
+  };
+
+  static uint64_t FileSize(const std::string& tile_dir, const baldr::GraphId& tile_id);
+
+  std::vector<std::unique_ptr<worker_t>> workers_;
+  size_t tile_count_;
+  clock::time_point start_;
+  std::atomic<size_t> stolen_;
+};
+
+} // namespace mjolnir
+} // namespace valhalla
+
+#endif // VALHALLA_MJOLNIR_TILESCHEDULER_H
@@ -38,7 +38,10 @@ enum class BuildStage : int8_t {
   kRestrictions = 12,
   kElevation = 13,
   kValidate = 14,
-  kCleanup = 15
+  kOverlay = 15,
+  kSpatialIndex = 16,
+  kExtract = 17,
+  kCleanup = 18
 };
 
 // Convert string to BuildStage
@@ -59,6 +62,9 @@ inline BuildStage string_to_buildstage(const std::string& s) {
        {"restrictions", BuildStage::kRestrictions},
        {"elevation", BuildStage::kElevation},
        {"validate", BuildStage::kValidate},
+       {"overlay", BuildStage::kOverlay},
+       {"spatialindex", BuildStage::kSpatialIndex},
+       {"extract", BuildStage::kExtract},
        {"cleanup", BuildStage::kCleanup}};
 
   auto i = stringToBuildStage.find(s);
@@ -83,6 +89,9 @@ inline std::string to_string(BuildStage stg) {
        {static_cast<int8_t>(BuildStage::kRestrictions), "restrictions"},
        {static_cast<int8_t>(BuildStage::kElevation), "elevation"},
        {static_cast<int8_t>(BuildStage::kValidate), "validate"},
+       {static_cast<int8_t>(BuildStage::kOverlay), "overlay"},
+       {static_cast<int8_t>(BuildStage::kSpatialIndex), "spatialindex"},
+       {static_cast<int8_t>(BuildStage::kExtract), "extract"},
        {static_cast<int8_t>(BuildStage::kCleanup), "cleanup"}};
 
   auto i = BuildStageStrings.find(static_cast<int8_t>(stg));
@@ -146,6 +155,24 @@ bool build_tile_set(const ptree& config,
                     const BuildStage end_stage = BuildStage::kValidate,
                     const bool release_osmpbf_memory = true);
 
+/**
+ * Builds a whole new tileset from the input pbfs in a directory next to the live one and swaps it
+ * in. It takes as long as building the tiles from scratch, only the tiles being read meanwhile are
+ * never in a half built state. mjolnir.tile_dir has to be a symlink to the live directory and is
+ * pointed at the new one with a single rename. The overlays and the spatial index have to be
+ * configured under the tile directory so they are swapped along with the tiles. GraphReaders keep
+ * reading the tileset that was live when they were made, so the tileset that was replaced is only
+ * removed by the next swap.
+ * @param config        Used to tell the function where and how to build the tiles
+ * @param input_files   The osm pbf files
+ * @param change_file   Optional OSM change file (.osc or .osc.gz) that was applied to the input
+ *                      files. Nothing is rebuilt if it affects none of the live tiles
+ * @return Returns true if no errors occur, false if an error occurs.
+ */
+bool swap_tile_set(const ptree& config,
+                   const std::vector<std::string>& input_files,
+                   const std::string& change_file = "");
+
 // The tile manifest is a JSON-serializable index of tiles to be processed during the build stage of
 // valhalla_build_tiles'. It can be used to distribute shard keys when building tiles with
 // parallelized, distributed batch processing. For example, a workflow orchestrator can partition
@@ -1,6 +1,7 @@
 #ifndef __VALHALLA_SAMPLE_H__
 #define __VALHALLA_SAMPLE_H__
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -13,6 +14,9 @@
 namespace valhalla {
 namespace skadi {
 
+// Default memory budget of the inflated tiles kept in memory, shared by all samplers
+constexpr size_t kDefaultElevationCacheSize = 134217728; // 128MB
+
 class sample {
 public:
   // non-default-constructable and non-copyable
@@ -25,8 +29,11 @@ public:
   /**
    * Constructor
    * @param data_source  directory name of the datasource from which to sample
+   * @param cache_size   bytes of inflated gzipped tiles to keep in memory. The memory is shared
+   *                     with all the other samplers of the process which get the largest size
+   *                     any of them asked for. At least the last tile is always kept
    */
-  sample(const std::string& data_source);
+  sample(const std::string& data_source, size_t cache_size = kDefaultElevationCacheSize);
 
   /**
    * Get a single sample from the datasource
@@ -58,9 +65,17 @@ protected:
 
   /**
    * @param  index  the index of the data tile being requested
-   * @return the array of data or nullptr if there was none
+   * @return the array of data or nullptr if there was none, it stays valid as long as it is held
+   */
+  std::shared_ptr<const int16_t> source(uint16_t index) const;
+
+  /**
+   * Bilinear interpolation of the pixels of a tile around a coordinate
+   * @param coord  the posting to sample, it must be inside of the tile
+   * @param tile   the array of data of the tile or nullptr if there was none
+   * @return the value at the posting or the no data value
    */
-  const int16_t* source(uint16_t index) const;
+  template <class coord_t> static double interpolate(const coord_t& coord, const int16_t* tile);
 
   enum class format_t { UNKNOWN = 0, GZIP = 1, RAW = 3 };
   /**
@@ -75,10 +90,12 @@ protected:
 
   // using memory maps
   mutable std::vector<std::pair<format_t, midgard::mem_map<char>>> mapped_cache;
+  // whether the memory map of a source is done, those that aren't are mapped under a lock
+  mutable std::unique_ptr<std::atomic<bool>[]> mapped_ready;
 
-  // TODO: make an LRU
-  using unzipped_t = std::pair<int16_t, std::vector<int16_t>>;
-  mutable unzipped_t unzipped_cache;
+  // inflated gzipped tiles, least recently used ones go first
+  class unzipped_cache_t;
+  std::shared_ptr<unzipped_cache_t> unzipped_cache;
 
   std::string data_source;
 };
@@ -0,0 +1,103 @@
+#ifndef VALHALLA_THOR_CHMATRIX_H_
+#define VALHALLA_THOR_CHMATRIX_H_
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <valhalla/baldr/ch_overlay.h>
+#include <valhalla/baldr/graphreader.h>
+#include <valhalla/proto/tripcommon.pb.h>
+#include <valhalla/sif/dynamiccost.h>
+#include <valhalla/thor/costmatrix.h>
+
+namespace valhalla {
+namespace thor {
+
+/**
+ * Computes time distance matrices over a contraction hierarchy overlay built ahead of time for a
+ * costing with its default options (see mjolnir::CHBuilder). Every target runs a search up the
+ * hierarchy and leaves its costs in buckets at the nodes it settles, then every source runs a
+ * search up the hierarchy and meets the targets in the buckets of the nodes it settles. The
+ * searches only ever settle a few hundred nodes regardless of how far apart the locations are.
+ *
+ * The overlay is node based and has no turn costs, no U-turn ban, no complex restrictions, no
+ * hierarchy limits and no destination only edges, so its paths can differ from those of CostMatrix
+ * and can even take turns that are not allowed. That is why it is only used when a request asks
+ * for it (see Options::ch_overlay).
+ */
+class CHMatrix {
+public:
+  /**
+   * @param overlay  the overlay for the costing the requests will use
+   */
+  explicit CHMatrix(std::shared_ptr<const baldr::CHOverlay> overlay);
+
+  /**
+   * Checks whether the overlay can route between the locations: the nodes of all their candidate
+   * edges have to be part of it, none of the edges can be destination only and their tiles must
+   * have the dataset id the overlay was built from
+   * @param  locations    the sources or the targets
+   * @param  graphreader  Graph reader for accessing routing graph.
+   * @return true if the overlay can be used for the locations
+   */
+  bool Covers(const google::protobuf::RepeatedPtrField<valhalla::Location>& locations,
+              baldr::GraphReader& graphreader) const;
+
+  /**
+   * Forms a time distance matrix from the set of source locations
+   * to the set of target locations.
+   * @param  source_location_list  List of source/origin locations.
+   * @param  target_location_list  List of target/destination locations.
+   * @param  graphreader           Graph reader for accessing routing graph.
+   * @param  mode_costing          Costing methods, must be those the overlay was built with.
+   * @param  mode                  Travel mode to use.
+   * @param  max_matrix_distance   Pairs further apart along the path are not found, it also
+   *                               bounds how far the searches go.
+   * @return time/distance from origin index to all other locations
+   */
+  std::vector<TimeDistance>
+  SourceToTarget(const google::protobuf::RepeatedPtrField<valhalla::Location>& source_location_list,
+                 const google::protobuf::RepeatedPtrField<valhalla::Location>& target_location_list,
+                 baldr::GraphReader& graphreader,
+                 const sif::mode_costing_t& mode_costing,
+                 const sif::TravelMode mode,
+                 const float max_matrix_distance);
+
+protected:
+  // Cost, time and length of the best path found to a node so far
+  struct label_t {
+    float cost;
+    float secs;
+    float length;
+  };
+
+  // What a target leaves at a node its search settled
+  struct bucket_entry_t {
+    uint32_t target;
+    label_t label;
+  };
+
+  using search_space_t = std::unordered_map<uint32_t, label_t>;
+
+  /**
+   * Runs a search from the seeds over the up arcs (or over the down arcs backwards)
+   * @param seeds       the nodes the search starts at and the labels they start with
+   * @param forward     whether to follow up arcs or down arcs
+   * @param max_length  nodes further than this are not settled
+   * @param settled     gets the labels of all the nodes the search reached
+   */
+  void Search(const search_space_t& seeds,
+              const bool forward,
+              const float max_length,
+              search_space_t& settled) const;
+
+  std::shared_ptr<const baldr::CHOverlay> overlay_;
+};
+
+} // namespace thor
+} // namespace valhalla
+
+#endif // VALHALLA_THOR_CHMATRIX_H_
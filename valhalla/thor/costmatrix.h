@@ -8,6 +8,8 @@
 #include <utility>
 #include <vector>
 
+#include <boost/property_tree/ptree.hpp>
+
 #include <valhalla/baldr/double_bucket_queue.h>
 #include <valhalla/baldr/graphid.h>
 #include <valhalla/baldr/graphreader.h>
@@ -88,10 +90,15 @@ struct BestCandidate {
 class CostMatrix {
 public:
   /**
-   * Default constructor. Most internal values are set when a query is made so
-   * the constructor mainly just sets some internals to a default empty value.
+   * Constructor. Most internal values are set when a query is made so the
+   * constructor mainly just sets some internals to a default empty value.
+   * If thor.costmatrix_threads is set in the config, that many threads (each
+   * with its own graph reader made from the mjolnir config) are started to
+   * expand the searches of the locations in parallel along with the calling
+   * thread. The results are identical to the single threaded expansion.
+   * @param  config  the valhalla config
    */
-  CostMatrix();
+  explicit CostMatrix(const boost::property_tree::ptree& config = {});
   ~CostMatrix();
 
   /**
@@ -159,6 +166,17 @@ protected:
   // List of best connections found so far
   std::vector<BestCandidate> best_connection_;
 
+  // Effects of an iteration of a search on the other searches. These are
+  // recorded while the searches are expanded (possibly in parallel) and
+  // applied in location order afterwards so that the results do not depend
+  // on the order in which the searches ran. Edges reached by the reverse
+  // search of each target, connections (target and label count) found by the
+  // forward search of each source and whether each search was exhausted.
+  std::vector<std::vector<baldr::GraphId>> target_reached_;
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> source_connections_;
+  std::vector<uint8_t> source_exhausted_;
+  std::vector<uint8_t> target_exhausted_;
+
   /**
    * Get the cost threshold based on the current mode and the max arc-length distance
    * for that mode.
@@ -194,10 +212,25 @@ protected:
 
   /**
    * Update status when a connection is found.
-   * @param  source  Source index
-   * @param  target  Target index
+   * @param  source       Source index
+   * @param  target       Target index
+   * @param  label_count  Number of edge labels of both searches when the connection was found
+   */
+  void UpdateStatus(const uint32_t source, const uint32_t target, const uint32_t label_count);
+
+  /**
+   * Apply the effects an iteration of the reverse search of a target had on
+   * the other searches and update the number of remaining targets.
+   * @param  index  Index of the target location.
    */
-  void UpdateStatus(const uint32_t source, const uint32_t target);
+  void FinishBackwardSearch(const uint32_t index);
+
+  /**
+   * Apply the effects an iteration of the forward search of a source had on
+   * the other searches and update the number of remaining sources.
+   * @param  index  Index of the source location.
+   */
+  void FinishForwardSearch(const uint32_t index);
 
   /**
    * Iterate the backward search from the target/destination location.
@@ -250,9 +283,13 @@ protected:
 
 private:
   class TargetMap;
+  class WorkerPool;
 
   // Mark each target edge with a list of target indexes that have reached it
   std::unique_ptr<TargetMap> targets_;
+
+  // Threads expanding the searches in parallel, null if single threaded
+  std::unique_ptr<WorkerPool> pool_;
 };
 
 } // namespace thor
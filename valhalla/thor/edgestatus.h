@@ -1,12 +1,13 @@
 #pragma once
 
-#include <unordered_map>
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
 #include <valhalla/baldr/graphid.h>
 #include <valhalla/baldr/graphtile.h>
 
-// handy macro for shifting the 7bit path index value so that it can be or'd with the tile/level id
-#define SHIFT_path_id(x) (static_cast<uint32_t>(x) << 25u)
-
 namespace valhalla {
 namespace thor {
 
@@ -48,37 +49,76 @@ struct EdgeStatusInfo {
  * edges within arrays for each tile. This allows the path algorithms to get
  * a pointer to the first edge status and iterate that pointer over sequential
  * edges. This reduces the number of map lookups.
+ *
+ * The arrays are found through a dense table indexed by level, path id and
+ * tile id (allocated in pages as tiles are touched) instead of a hash map.
+ * The arrays themselves come from a pool that is kept across calls to clear
+ * so that repeated searches with the same object don't have to allocate. The
+ * pool keeps its arrays no matter how few of them the last search used, but
+ * only up to kMaxPooledStatuses, so one huge expansion doesn't pin its memory
+ * for the lifetime of the object. Each
+ * table entry is stamped with the generation it was made in, clearing just
+ * starts a new generation which makes it O(1) regardless of the number of
+ * tiles the previous search touched.
  */
 class EdgeStatus {
 public:
+  // The most statuses (4 bytes each) the pool keeps across a clear
+  static constexpr size_t kMaxPooledStatuses = 1 << 22;
+
   /**
    * Default constructor.
    */
-  EdgeStatus() = default;
+  EdgeStatus() : generation_(1), used_(0) {
+  }
 
-  // in order no to delete objects twice in destructor we should explicitly
-  // forbid copying
+  // the arrays are owned by the pool so we forbid copying
   EdgeStatus(const EdgeStatus&) = delete;
   EdgeStatus& operator=(const EdgeStatus&) = delete;
   EdgeStatus(EdgeStatus&&) = default;
   EdgeStatus& operator=(EdgeStatus&&) = default;
 
   /**
-   * Destructor. Delete any allocated EdgeStatusInfo arrays.
+   * Destructor. The pool and table pages free themselves.
    */
-  ~EdgeStatus() {
-    clear();
-  }
+  ~EdgeStatus() = default;
 
   /**
-   * Clear the EdgeStatusInfo arrays and the edge status map.
+   * Clear the edge status of all edges. The EdgeStatusInfo arrays stay in the
+   * pool to be reused by the next search, up to kMaxPooledStatuses, the rest
+   * are freed. Algorithms clear more than once per search so what the last
+   * search used says nothing about what the next one needs.
    */
   void clear() {
-    // Delete any allocated arrays for tiles within the map.
-    for (auto& iter : edgestatus_) {
-      delete[] iter.second;
+    size_t kept = 0, pooled = 0;
+    while (kept < pool_.size() && pooled + pool_[kept].capacity <= kMaxPooledStatuses) {
+      pooled += pool_[kept++].capacity;
+    }
+    pool_.erase(pool_.begin() + kept, pool_.end());
+    used_ = 0;
+    // The generation stamp wrapped so we cant tell old entries apart anymore
+    if (++generation_ == 0) {
+      for (auto& pages : table_) {
+        for (auto& page : pages) {
+          if (page) {
+            std::fill(page.get(), page.get() + kPageSize, entry_t{0, 0});
+          }
+        }
+      }
+      generation_ = 1;
+    }
+  }
+
+  /**
+   * Returns the number of statuses the pool holds, whether in use or not.
+   * @return the pooled statuses
+   */
+  size_t capacity() const {
+    size_t pooled = 0;
+    for (const auto& block : pool_) {
+      pooled += block.capacity;
     }
-    edgestatus_.clear();
+    return pooled;
   }
 
   /**
@@ -96,16 +136,7 @@ public:
            const graph_tile_ptr& tile,
            const uint8_t path_id = 0) {
     assert(path_id <= baldr::kMaxMultiPathId);
-    auto p = edgestatus_.find(edgeid.tile_value() | SHIFT_path_id(path_id));
-    if (p != edgestatus_.end()) {
-      p->second[edgeid.id()] = {set, index};
-    } else {
-      // Tile is not in the map. Add an array of EdgeStatusInfo, sized to
-      // the number of directed edges in the specified tile.
-      auto inserted = edgestatus_.emplace(edgeid.tile_value() | SHIFT_path_id(path_id),
-                                          new EdgeStatusInfo[tile->header()->directededgecount()]);
-      inserted.first->second[edgeid.id()] = {set, index};
-    }
+    *GetPtr(edgeid, tile, path_id) = {set, index};
   }
 
   /**
@@ -118,9 +149,9 @@ public:
    */
   void Update(const baldr::GraphId& edgeid, const EdgeSet set, const uint8_t path_id = 0) {
     assert(path_id <= baldr::kMaxMultiPathId);
-    const auto p = edgestatus_.find(edgeid.tile_value() | SHIFT_path_id(path_id));
-    if (p != edgestatus_.end()) {
-      p->second[edgeid.id()].set_ = static_cast<uint32_t>(set);
+    const auto* entry = Find(edgeid, path_id);
+    if (entry != nullptr) {
+      pool_[entry->block].statuses[edgeid.id()].set_ = static_cast<uint32_t>(set);
     } else {
       throw std::runtime_error("EdgeStatus Update on edge not previously set");
     }
@@ -135,8 +166,8 @@ public:
    */
   EdgeStatusInfo Get(const baldr::GraphId& edgeid, const uint8_t path_id = 0) const {
     assert(path_id <= baldr::kMaxMultiPathId);
-    const auto p = edgestatus_.find(edgeid.tile_value() | SHIFT_path_id(path_id));
-    return (p == edgestatus_.end()) ? EdgeStatusInfo() : p->second[edgeid.id()];
+    const auto* entry = Find(edgeid, path_id);
+    return entry == nullptr ? EdgeStatusInfo() : pool_[entry->block].statuses[edgeid.id()];
   }
 
   /**
@@ -152,23 +183,100 @@ public:
   EdgeStatusInfo*
   GetPtr(const baldr::GraphId& edgeid, const graph_tile_ptr& tile, const uint8_t path_id = 0) {
     assert(path_id <= baldr::kMaxMultiPathId);
-    const auto p = edgestatus_.find(edgeid.tile_value() | SHIFT_path_id(path_id));
-    if (p != edgestatus_.end()) {
-      return &p->second[edgeid.id()];
-    } else {
-      // Tile is not in the map. Add an array of EdgeStatusInfo, sized to
-      // the number of directed edges in the specified tile.
-      auto inserted = edgestatus_.emplace(edgeid.tile_value() | SHIFT_path_id(path_id),
-                                          new EdgeStatusInfo[tile->header()->directededgecount()]);
-      return &(inserted.first->second)[edgeid.id()];
+    // Find the table entry for this tile, adding the page it lives in if need be
+    const size_t key = (static_cast<size_t>(path_id) << 3) | edgeid.level();
+    if (key >= table_.size()) {
+      table_.resize(key + 1);
+    }
+    auto& pages = table_[key];
+    const uint32_t page_id = edgeid.tileid() / kPageSize;
+    if (page_id >= pages.size()) {
+      pages.resize(page_id + 1);
+    }
+    auto& page = pages[page_id];
+    if (!page) {
+      page.reset(new entry_t[kPageSize]());
+    }
+    auto& entry = page[edgeid.tileid() % kPageSize];
+
+    // Tile hasn't been seen since the last clear. Take an array of EdgeStatusInfo
+    // from the pool, sized to the number of directed edges in the specified tile.
+    if (entry.generation != generation_) {
+      entry.generation = generation_;
+      entry.block = Allocate(tile->header()->directededgecount());
     }
+    return &pool_[entry.block].statuses[edgeid.id()];
   }
 
 private:
-  // Edge status - keys are the tile Ids (level and tile Id) and the
-  // values are dynamically allocated arrays of EdgeStatusInfo (sized
-  // based on the directed edge count within the tile).
-  std::unordered_map<uint32_t, EdgeStatusInfo*> edgestatus_;
+  // Number of tiles per page of the table
+  static constexpr uint32_t kPageSize = 256;
+
+  // Locates the status array of a tile in the pool. It's only valid if it was
+  // made in the current generation
+  struct entry_t {
+    uint32_t generation;
+    uint32_t block;
+  };
+
+  // A status array of the pool along with how many edges it can hold
+  struct block_t {
+    std::unique_ptr<EdgeStatusInfo[]> statuses;
+    uint32_t capacity;
+  };
+
+  /**
+   * Find the table entry of the tile of the edge if it was set in the current generation
+   * @param  edgeid   the edge whose tile we want
+   * @param  path_id  the path the status belongs to
+   * @return the entry or nullptr if the tile has no status array yet
+   */
+  const entry_t* Find(const baldr::GraphId& edgeid, const uint8_t path_id) const {
+    const size_t key = (static_cast<size_t>(path_id) << 3) | edgeid.level();
+    if (key >= table_.size()) {
+      return nullptr;
+    }
+    const auto& pages = table_[key];
+    const uint32_t page_id = edgeid.tileid() / kPageSize;
+    if (page_id >= pages.size() || !pages[page_id]) {
+      return nullptr;
+    }
+    const auto& entry = pages[page_id][edgeid.tileid() % kPageSize];
+    return entry.generation == generation_ ? &entry : nullptr;
+  }
+
+  /**
+   * Take the next free status array from the pool, growing it or the pool if
+   * need be, and reset it to unreached
+   * @param  count  the number of edges the array must hold
+   * @return the index of the array within the pool
+   */
+  uint32_t Allocate(const uint32_t count) {
+    if (used_ == pool_.size()) {
+      pool_.push_back({std::unique_ptr<EdgeStatusInfo[]>(new EdgeStatusInfo[count]), count});
+      return used_++;
+    }
+    auto& block = pool_[used_];
+    if (block.capacity < count) {
+      block.statuses.reset(new EdgeStatusInfo[count]);
+      block.capacity = count;
+    } else {
+      std::fill(block.statuses.get(), block.statuses.get() + count, EdgeStatusInfo());
+    }
+    return used_++;
+  }
+
+  // Dense table from tile to status array. Its indexed first by path id and
+  // level, then by tile id in pages of kPageSize tiles which are only
+  // allocated once a tile in their range gets touched
+  std::vector<std::vector<std::unique_ptr<entry_t[]>>> table_;
+
+  // The generation entries of the table must have to be valid, bumped by clear
+  uint32_t generation_;
+
+  // Pool of status arrays, the first used_ are in use by the current generation
+  std::vector<block_t> pool_;
+  uint32_t used_;
 };
 
 } // namespace thor
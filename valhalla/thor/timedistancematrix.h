@@ -8,6 +8,8 @@
 #include <utility>
 #include <vector>
 
+#include <boost/property_tree/ptree.hpp>
+
 #include <valhalla/baldr/double_bucket_queue.h>
 #include <valhalla/baldr/graphid.h>
 #include <valhalla/baldr/graphreader.h>
@@ -22,14 +24,53 @@
 namespace valhalla {
 namespace thor {
 
+/**
+ * Costs of the edges expanded by the searches of a batch so that the cost of
+ * each edge is only evaluated once for all of them. Like the EdgeStatus the
+ * costs are kept in an array per tile, so the edges of a node can be walked
+ * with a pointer. Costs that have not been evaluated yet are negative.
+ */
+class EdgeCostCache {
+public:
+  /**
+   * Get a pointer to the cached cost of a directed edge, the costs of the
+   * following edges in the tile come after it.
+   * @param   edgeid  GraphId of the directed edge.
+   * @param   tile    Graph tile of the directed edge.
+   * @return  Returns a pointer to the cached cost of this edge.
+   */
+  sif::Cost* GetPtr(const baldr::GraphId& edgeid, const graph_tile_ptr& tile) {
+    auto& costs = costs_[edgeid.tile_value()];
+    if (costs.empty()) {
+      costs.resize(tile->header()->directededgecount(), sif::Cost(-1.0f, -1.0f));
+    }
+    return &costs[edgeid.id()];
+  }
+
+  /**
+   * Forget all the cached costs.
+   */
+  void clear() {
+    costs_.clear();
+  }
+
+private:
+  std::unordered_map<uint32_t, std::vector<sif::Cost>> costs_;
+};
+
 // Class to compute time + distance matrices among locations.
 class TimeDistanceMatrix {
 public:
   /**
-   * Default constructor. Most internal values are set when a query is made so
-   * the constructor mainly just sets some internals to a default empty value.
+   * Constructor. Most internal values are set when a query is made so the
+   * constructor mainly just sets some internals to a default empty value.
+   * If thor.timedistancematrix_batch_size is more than 1, SourceToTarget runs
+   * that many of its one to many (or many to one) searches in lockstep. They
+   * set up the destinations once, share the cost of every edge they expand
+   * and walk the same tiles together. The results are the same either way.
+   * @param  config  the valhalla config
    */
-  TimeDistanceMatrix();
+  explicit TimeDistanceMatrix(const boost::property_tree::ptree& config = {});
 
   /**
    * One to many time and distance cost matrix. Computes time and distance
@@ -142,6 +183,67 @@ protected:
 
   sif::TravelMode mode_;
 
+  // Number of searches SourceToTarget runs in lockstep
+  uint32_t batch_size_;
+
+  // The searches of the current batch
+  std::vector<std::unique_ptr<TimeDistanceMatrix>> batch_;
+
+  // Edge costs shared by the searches of a batch
+  EdgeCostCache edge_cost_cache_;
+
+  // The cache of the batch this search is part of, null when not batched
+  EdgeCostCache* edge_costs_;
+
+  /**
+   * Set the mode, costing and cost threshold for a search from a location and
+   * reset the state of the previous search.
+   * @param  origin        Location the search starts from.
+   * @param  mode_costing  Costing methods.
+   * @param  mode          Travel mode to use.
+   * @param  max_matrix_distance   Maximum arc-length distance for current mode.
+   */
+  void InitializeSearch(const valhalla::Location& origin,
+                        const sif::mode_costing_t& mode_costing,
+                        const sif::TravelMode mode,
+                        const float max_matrix_distance);
+
+  /**
+   * Settle the next edge of the search, update the destinations along it and
+   * expand from its end node.
+   * @param  origin        Location the search started from.
+   * @param  locations     List of locations.
+   * @param  graphreader   Graph reader for accessing routing graph.
+   * @param  forward       Whether this is a one to many (forward) or a many
+   *                       to one (reverse) search.
+   * @return Returns true when the search is done.
+   */
+  bool ExpandNext(const valhalla::Location& origin,
+                  const google::protobuf::RepeatedPtrField<valhalla::Location>& locations,
+                  baldr::GraphReader& graphreader,
+                  const bool forward);
+
+  /**
+   * Run the one to many (or many to one) searches from the origins in
+   * batches of searches advancing in lockstep.
+   * @param  origins       List of locations to start the searches from.
+   * @param  locations     List of locations to find.
+   * @param  graphreader   Graph reader for accessing routing graph.
+   * @param  mode_costing  Costing methods.
+   * @param  mode          Travel mode to use.
+   * @param  max_matrix_distance   Maximum arc-length distance for current mode.
+   * @param  forward       Whether the searches are one to many or many to one.
+   * @return Returns the results of the searches in the order of the origins.
+   */
+  std::vector<TimeDistance>
+  SourceToTargetBatched(const google::protobuf::RepeatedPtrField<valhalla::Location>& origins,
+                        const google::protobuf::RepeatedPtrField<valhalla::Location>& locations,
+                        baldr::GraphReader& graphreader,
+                        const sif::mode_costing_t& mode_costing,
+                        const sif::TravelMode mode,
+                        const float max_matrix_distance,
+                        const bool forward);
+
   /**
    * Expand from the node along the forward search path. Immediately expands
    * from the end node of any transition edge (so no transition edges are added
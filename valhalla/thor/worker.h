@@ -1,7 +1,15 @@
 #ifndef __VALHALLA_THOR_SERVICE_H__
 #define __VALHALLA_THOR_SERVICE_H__
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -22,8 +30,11 @@
 #include <valhalla/thor/attributes_controller.h>
 #include <valhalla/thor/bidirectional_astar.h>
 #include <valhalla/thor/centroid.h>
+#include <valhalla/thor/chmatrix.h>
+#include <valhalla/thor/costmatrix.h>
 #include <valhalla/thor/isochrone.h>
 #include <valhalla/thor/multimodal.h>
+#include <valhalla/thor/timedistancematrix.h>
 #include <valhalla/thor/timedep.h>
 #include <valhalla/thor/triplegbuilder.h>
 #include <valhalla/tyr/actor.h>
@@ -61,6 +72,8 @@ public:
   std::string isochrones(Api& request);
   void trace_route(Api& request);
   std::string trace_attributes(Api& request);
+  std::string trace_attributes_batch(Api& request);
+  std::string online_match(Api& request);
   std::string expansion(Api& request);
   void centroid(Api& request);
 
@@ -120,6 +133,12 @@ protected:
   MultiModalPathAlgorithm multi_modal_astar;
   TimeDepForward timedep_forward;
   TimeDepReverse timedep_reverse;
+  CostMatrix cost_matrix;
+  TimeDistanceMatrix time_distance_matrix;
+
+  // Matrices over the contraction hierarchy overlays by costing, along with the serialized default
+  // options of the costing since an overlay can't answer requests that change them
+  std::unordered_map<std::string, std::pair<CHMatrix, std::string>> ch_matrices;
 
   Isochrone isochrone_gen;
   std::shared_ptr<meili::MapMatcher> matcher;
@@ -130,6 +149,56 @@ protected:
   std::shared_ptr<baldr::GraphReader> reader;
   AttributesController controller;
   Centroid centroid_gen;
+
+  // The additional threads a batch of traces is matched with, started on first use
+  class batch_pool_t;
+  std::unique_ptr<batch_pool_t> batch_pool;
+  boost::property_tree::ptree batch_config;
+  uint32_t batch_threads;
+  size_t transition_cache_size;
+
+  boost::property_tree::ptree online_config;
+  std::chrono::seconds online_session_timeout;
+  size_t max_online_sessions;
+  // In bytes, what the windows of the sessions may hold on to before no more sessions are started
+  size_t max_online_session_memory;
+};
+
+/**
+ * A fixed number of threads, each with a worker of its own, that stay around between batches. The
+ * threads take the next item nobody has started yet until there are none left, the calling thread
+ * joins in with its worker.
+ */
+class thor_worker_t::batch_pool_t {
+public:
+  using task_t = std::function<void(const int, thor_worker_t&)>;
+
+  batch_pool_t(const boost::property_tree::ptree& config, const uint32_t thread_count);
+  ~batch_pool_t();
+
+  const std::vector<std::unique_ptr<thor_worker_t>>& workers() const {
+    return workers_;
+  }
+
+  // Runs the task for every index in [0, count) and waits for all of them to finish
+  void run(const int count, thor_worker_t& worker, const task_t& task);
+
+protected:
+  void drain(thor_worker_t& worker);
+  void work(const size_t index);
+
+  std::vector<std::unique_ptr<thor_worker_t>> workers_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable finished_;
+  const task_t* task_;
+  int count_;
+  std::atomic<int> next_;
+  uint64_t generation_;
+  size_t busy_;
+  bool done_;
+  std::exception_ptr error_;
 };
 
 } // namespace thor
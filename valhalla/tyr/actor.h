@@ -39,6 +39,12 @@ public:
   std::string trace_attributes(const std::string& request_str,
                                const std::function<void()>* interrupt = nullptr,
                                Api* api = nullptr);
+  std::string trace_attributes_batch(const std::string& request_str,
+                                     const std::function<void()>* interrupt = nullptr,
+                                     Api* api = nullptr);
+  std::string online_match(const std::string& request_str,
+                           const std::function<void()>* interrupt = nullptr,
+                           Api* api = nullptr);
   std::string height(const std::string& request_str,
                      const std::function<void()>* interrupt = nullptr,
                      Api* api = nullptr);
@@ -52,6 +58,14 @@ public:
                        const std::function<void()>* interrupt = nullptr,
                        Api* api = nullptr);
 
+  /**
+   * Does the work for a request that was already parsed, whatever its action asks for
+   * @param request    the parsed request, it gets filled out along the way
+   * @param interrupt  a function that throws when the work should be abandoned
+   * @return the serialized response
+   */
+  std::string act(Api& request, const std::function<void()>* interrupt = nullptr);
+
 protected:
   struct pimpl_t;
   std::shared_ptr<pimpl_t> pimpl;
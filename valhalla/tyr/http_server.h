@@ -0,0 +1,89 @@
+#ifndef VALHALLA_TYR_HTTP_SERVER_H_
+#define VALHALLA_TYR_HTTP_SERVER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+
+namespace valhalla {
+namespace tyr {
+
+// Largest request (headers and body) we accept by default
+constexpr size_t kDefaultMaxRequestSize = 10485760; // 10MB
+// Seconds a connection may go without sending or reading anything before we hang up
+constexpr uint32_t kDefaultIdleTimeout = 60;
+// Seconds a client has to send a whole request once it started sending it
+constexpr uint32_t kDefaultReadTimeout = 30;
+
+/**
+ * Serves the api over http from within a single process without the zmq pipeline of prime_server.
+ * Every worker thread has its own actor_t and its own listening socket, the kernel spreads the
+ * connections over them, and answers the requests of its connections from start to finish (loki,
+ * thor, odin and tyr) in memory, so requests are neither serialized between the stages nor handed
+ * between threads. Connections are kept alive and pipelined requests are answered in order.
+ *
+ * A connection that doesn't read its responses stops being read from, so neither what it sent nor
+ * what it is sent piles up without bound. Connections are hung up on after
+ * httpd.service.idle_timeout seconds without any bytes going either way, and get a 408 if they
+ * take longer than httpd.service.read_timeout seconds to send a request.
+ *
+ * The sockets are driven by epoll so this is only available on linux.
+ */
+class http_server_t {
+public:
+  /**
+   * Binds the listening sockets, the workers only start once serve is called
+   * @param config            the config the actors of the workers are made from
+   * @param listen            where to listen: tcp://host:port, use * as host for all interfaces
+   *                          and 0 as port to get any free one (see port())
+   * @param worker_count      number of worker threads
+   * @param max_request_size  requests larger than this are turned away with a 413
+   */
+  http_server_t(const boost::property_tree::ptree& config,
+                const std::string& listen,
+                size_t worker_count,
+                size_t max_request_size = kDefaultMaxRequestSize);
+  ~http_server_t();
+
+  http_server_t(const http_server_t&) = delete;
+  http_server_t& operator=(const http_server_t&) = delete;
+
+  /**
+   * Answers requests until stop is called, blocks the calling thread. If a worker fails the others
+   * are stopped too and its exception is thrown from here
+   */
+  void serve();
+
+  /**
+   * Makes serve return once the workers have answered the requests they are busy with, can be
+   * called from any thread
+   */
+  void stop();
+
+  /**
+   * @return the port the server listens on
+   */
+  uint16_t port() const {
+    return port_;
+  }
+
+protected:
+  const boost::property_tree::ptree config_;
+  const size_t max_request_size_;
+  const std::chrono::seconds idle_timeout_;
+  const std::chrono::seconds read_timeout_;
+  std::vector<int> listeners_;
+  int stop_fd_;
+  uint16_t port_;
+  std::atomic<bool> stopped_;
+};
+
+} // namespace tyr
+} // namespace valhalla
+
+#endif // VALHALLA_TYR_HTTP_SERVER_H_
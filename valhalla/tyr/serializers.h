@@ -95,6 +95,21 @@ std::string serializeTraceAttributes(
     const thor::AttributesController& controller,
     std::vector<std::tuple<float, float, std::vector<meili::MatchResult>>>& results);
 
+/**
+ * Turn the matches an online map matching request made final into json
+ *
+ * @param request      The request, its options have the id of the session
+ * @param results      The matched points in the order of the trace
+ * @param segments     The edges the points were matched to
+ * @param first_point  How many points of the session were given back before these
+ * @param first_edge   How many edges of the session were given back before these
+ */
+std::string serializeOnlineMatch(const Api& request,
+                                 const std::vector<meili::MatchResult>& results,
+                                 const std::vector<meili::EdgeSegment>& segments,
+                                 size_t first_point,
+                                 size_t first_edge);
+
 // Return a JSON array of OpenLR 1.5 line location references for each edge of a map matching
 // result. For the time being, result is only non-empty for auto costing requests.
 void route_references(baldr::json::MapPtr& route_json,
@@ -109,21 +124,22 @@ void openlr(const valhalla::Api& api, int route_index, rapidjson::writer_wrapper
 namespace osrm {
 
 /*
- * Serialize a location into a osrm waypoint
- * http://project-osrm.org/docs/v5.5.1/api/#waypoint-object
+ * Stream a location into the writer as an osrm waypoint
  */
-valhalla::baldr::json::MapPtr
-waypoint(const valhalla::Location& location, bool is_tracepoint = false, bool is_optimized = false);
+void waypoint(const valhalla::Location& location,
+              rapidjson::writer_wrapper_t& writer,
+              bool is_tracepoint = false,
+              bool is_optimized = false);
 
 /*
- * Serialize locations into osrm waypoints
+ * Stream locations into the writer as osrm waypoints, the caller starts and ends the array
  */
-valhalla::baldr::json::ArrayPtr
-waypoints(const google::protobuf::RepeatedPtrField<valhalla::Location>& locations,
-          bool tracepoints = false);
-valhalla::baldr::json::ArrayPtr waypoints(const valhalla::Trip& locations);
+void waypoints(const google::protobuf::RepeatedPtrField<valhalla::Location>& locations,
+               rapidjson::writer_wrapper_t& writer,
+               bool tracepoints = false);
+void waypoints(const valhalla::Trip& trip, rapidjson::writer_wrapper_t& writer);
 
-void serializeIncidentProperties(rapidjson::Writer<rapidjson::StringBuffer>& writer,
+void serializeIncidentProperties(rapidjson::writer_wrapper_t& writer,
                                  const valhalla::IncidentsTile::Metadata& incident_metadata,
                                  const int begin_shape_index,
                                  const int end_shape_index,
@@ -1,6 +1,8 @@
 #ifndef __VALHALLA_SERVICE_H__
 #define __VALHALLA_SERVICE_H__
+#include <list>
 #include <string>
+#include <unordered_map>
 
 #include <valhalla/baldr/json.h>
 #include <valhalla/baldr/rapidjson_utils.h>
@@ -27,6 +29,7 @@ const std::unordered_map<unsigned, std::string> error_codes{
     {112, "Insufficiently specified required parameter 'locations' or 'sources & targets'"},
     {113, "Insufficiently specified required parameter 'contours'"},
     {114, "Insufficiently specified required parameter 'shape' or 'encoded_polyline'"},
+    {115, "Insufficiently specified required parameter 'traces'"},
 
     {120, "Insufficient number of locations provided"},
     {121, "Insufficient number of sources provided"},
@@ -69,6 +72,7 @@ const std::unordered_map<unsigned, std::string> error_codes{
     {164, "Invalid shape format"},
     {165, "Date and time required for destination for date_type of invariant"},
     {166, "Exceeded max distance"},
+    {167, "Exceeded max traces"},
 
     {170, "Locations are in unconnected regions. Go check/edit the map at osm.org"},
     {171, "No suitable edges near location"},
@@ -125,6 +129,8 @@ const std::unordered_map<unsigned, std::string> error_codes{
     {444, "Map Match algorithm failed to find path"},
     {445, "Shape match algorithm specification in api request is incorrect. Please see "
           "documentation for valid shape_match input."},
+    {446, "Unknown or expired online map matching session"},
+    {447, "Exceeded max online map matching sessions"},
 
     {499, "Unknown"},
 
@@ -166,6 +172,19 @@ inline midgard::scoped_timer<> measure_scope_time(Api& api, const std::string& s
 
 // TODO: this will go away and Options will be the request object
 void ParseApi(const std::string& json_request, Options::Action action, Api& api);
+
+// query parameters of an http request, each key can be given more than one value
+using query_t = std::unordered_map<std::string, std::list<std::string>>;
+
+/**
+ * Parses an http request into the api, the action comes from the path and the options from the
+ * json query parameter, or the body if there is none, plus all the other query parameters
+ * @param path   the path of the request, ie. /route
+ * @param query  the decoded query parameters
+ * @param body   the body of the request
+ * @param api    gets the parsed request
+ */
+void ParseApi(const std::string& path, const query_t& query, const std::string& body, Api& api);
 #ifdef HAVE_HTTP
 void ParseApi(const prime_server::http_request_t& http_request, Api& api);
 #endif